@@ -69,6 +69,11 @@ static inline uint32_t Atomic_OrUInt32 (volatile atomic_uint32_t *atomic, uint32
 	return InterlockedOr ((volatile LONG *)&atomic->value, val);
 }
 
+static inline uint32_t Atomic_ExchangeUInt32 (volatile atomic_uint32_t *atomic, uint32_t desired)
+{
+	return InterlockedExchange ((volatile LONG *)&atomic->value, desired);
+}
+
 static inline uint32_t Atomic_IncrementUInt32 (volatile atomic_uint32_t *atomic)
 {
 	return InterlockedIncrement ((volatile LONG *)&atomic->value) - 1;
@@ -141,6 +146,11 @@ static inline uint32_t Atomic_OrUInt32 (atomic_uint32_t *atomic, uint32_t value)
 	return atomic_fetch_or (atomic, value);
 }
 
+static inline uint32_t Atomic_ExchangeUInt32 (atomic_uint32_t *atomic, uint32_t desired)
+{
+	return atomic_exchange (atomic, desired);
+}
+
 static inline uint32_t Atomic_IncrementUInt32 (atomic_uint32_t *atomic)
 {
 	return atomic_fetch_add (atomic, 1);
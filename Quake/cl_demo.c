@@ -20,9 +20,18 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 
 #include "quakedef.h"
+#include "net_deflate.h"
 
 static void CL_FinishTimeDemo (void);
 
+cvar_t cl_demospeed = {"cl_demospeed", "1", CVAR_NONE};                // demo playback speed, 0 freezes it
+cvar_t cl_demokeyframe = {"cl_demokeyframe", "10", CVAR_NONE};         // seconds of demo time between demoseek rewind points
+cvar_t cl_democompress = {"cl_democompress", "0", CVAR_NONE};          // record packed demos, which only we can play
+cvar_t timedemo_log = {"timedemo_log", "", CVAR_NONE};                 // .csv for every frame, else a .json summary of each timedemo
+cvar_t benchmark_warmup = {"benchmark_warmup", "1", CVAR_NONE};        // untimed runs of each demo before the timed ones
+cvar_t benchmark_log = {"benchmark_log", "benchmark.json", CVAR_NONE}; // .csv for one row per run
+cvar_t benchmark_quit = {"benchmark_quit", "0", CVAR_NONE};            // quit when the benchmark is done, for scripted runs
+
 /*
 ==============================================================================
 
@@ -33,9 +42,62 @@ NET_GetMessages are read from the demo file.
 
 Whenever cl.time gets past the last received message, another message is
 read from the demo file.
+
+CL_PlayDemo_f scans the whole file once for where each message starts and the
+latest svc_time before it, which is the seek index. While messages are parsed,
+also when fast-forwarding, a keyframe is taken every cl_demokeyframe seconds of
+demo time: the client state that the following messages don't rebuild on their
+own, i.e. the entity states, lightstyles, stats and scoreboard. demoseek
+fast-forwards by parsing ahead without rendering, and rewinds by restoring the
+last keyframe before the target first. Keyframes live in cl, so they go away
+with their map and there's no rewinding past a level change.
 ==============================================================================
 */
 
+typedef struct
+{
+	long  offset; // of the message's length prefix
+	float time;   // latest svc_time at or before it
+} demoindex_t;
+
+typedef struct
+{
+	entity_state_t   netstate;
+	struct qmodel_s *model;
+	double           msgtime;
+	int              update_type;
+} demoentity_t;
+
+typedef struct
+{
+	char  name[MAX_SCOREBOARDNAME];
+	float entertime;
+	int   frags;
+	int   colors;
+} demoscore_t;
+
+typedef struct demokeyframe_s
+{
+	int           message; // the first demo_index entry that wasn't parsed yet
+	double        mtime[2];
+	vec3_t        mviewangles[2];
+	vec3_t        mvelocity[2];
+	int           stats[MAX_CL_STATS];
+	float         statsf[MAX_CL_STATS];
+	int           items;
+	int           intermission;
+	int           completed_time;
+	int           viewentity;
+	lightstyle_t  lightstyles[MAX_LIGHTSTYLES];
+	demoscore_t  *scores; // [cl.maxclients]
+	demoentity_t *entities;
+	int           numentities;
+} demokeyframe_t;
+
+static demoindex_t *demo_index;
+static int          demo_numindex;
+static int          demo_message; // the next one CL_ReadDemoMessage reads
+
 /*
 ==============
 CL_StopPlayback
@@ -53,11 +115,194 @@ void CL_StopPlayback (void)
 	cls.demopaused = false;
 	cls.demofile = NULL;
 	cls.state = ca_disconnected;
+	SAFE_FREE (demo_index);
+	demo_numindex = demo_message = 0;
 
 	if (cls.timedemo)
 		CL_FinishTimeDemo ();
 }
 
+/*
+==============================================================================
+
+DEMO WRITER
+
+While recording, the main thread never touches the demo file. Messages go into
+a ring buffer that a worker task drains into the file, so a slow disk only
+backs up the ring and the main thread waits only when the ring is full. The
+main thread moves the head and the task moves the tail, and a new drain task
+is only submitted after the last one finished, so there's one of each.
+
+With cl_democompress the file starts with DEMO_PACKEDMAGIC instead of the cd
+track line, and what follows are chunks of the plain demo: the plain and the
+packed length, then net_deflate's raw deflate data, or the plain bytes if they
+didn't shrink. playdemo unpacks these into a temporary file before playing.
+==============================================================================
+*/
+
+#define DEMO_RINGSIZE    0x100000 // must be a power of two
+#define DEMO_CHUNKSIZE   0x8000   // of the plain demo per packed chunk
+#define DEMO_PACKEDMAGIC "QDZ1"
+
+static struct
+{
+	byte           *ring;
+	atomic_uint32_t head; // moved by the main thread
+	atomic_uint32_t tail; // moved by the drain task
+	task_handle_t   task;
+	qboolean        running;
+	qboolean        failed; // a write went wrong, set by the task
+	int             stalls; // times the main thread waited for the disk
+	deflater_t     *deflater; // the rest is for cl_democompress only
+	byte           *chunk;
+	int             chunklen;
+	byte           *packed;
+} demo_writer;
+
+static void CL_DemoWriterPutChunk (void)
+{
+	int packedlen = Deflate_CompressWith (demo_writer.deflater, demo_writer.chunk, demo_writer.chunklen, demo_writer.packed, demo_writer.chunklen - 1);
+	int header[2];
+
+	header[0] = LittleLong (demo_writer.chunklen);
+	header[1] = LittleLong (packedlen > 0 ? packedlen : demo_writer.chunklen);
+	if (fwrite (header, 4, 2, cls.demofile) != 2 ||
+		fwrite (packedlen > 0 ? demo_writer.packed : demo_writer.chunk, packedlen > 0 ? packedlen : demo_writer.chunklen, 1, cls.demofile) != 1)
+		demo_writer.failed = true;
+	demo_writer.chunklen = 0;
+}
+
+/*
+====================
+CL_DemoWriterDrain
+
+Writes out what's in the ring, on a worker
+====================
+*/
+static void CL_DemoWriterDrain (void *unused)
+{
+	uint32_t head = Atomic_LoadUInt32 (&demo_writer.head);
+	uint32_t tail = Atomic_LoadUInt32 (&demo_writer.tail);
+	int      pos, len;
+
+	while (tail != head)
+	{
+		pos = tail & (DEMO_RINGSIZE - 1);
+		len = q_min ((int)(head - tail), DEMO_RINGSIZE - pos);
+		if (demo_writer.deflater)
+		{
+			len = q_min (len, DEMO_CHUNKSIZE - demo_writer.chunklen);
+			memcpy (demo_writer.chunk + demo_writer.chunklen, demo_writer.ring + pos, len);
+			demo_writer.chunklen += len;
+			if (demo_writer.chunklen == DEMO_CHUNKSIZE)
+				CL_DemoWriterPutChunk ();
+		}
+		else if (fwrite (demo_writer.ring + pos, 1, len, cls.demofile) != (size_t)len)
+			demo_writer.failed = true;
+		tail += len;
+		Atomic_StoreUInt32 (&demo_writer.tail, tail);
+	}
+	fflush (cls.demofile);
+}
+
+/*
+====================
+CL_DemoWriterIdle
+
+Waits up to timeout ms for the drain task, returns true once it finished
+====================
+*/
+static qboolean CL_DemoWriterIdle (uint32_t timeout)
+{
+	if (demo_writer.running && !Task_Join (demo_writer.task, timeout))
+		return false;
+	demo_writer.running = false;
+	return true;
+}
+
+static void CL_DemoWriterKick (void)
+{
+	if (CL_DemoWriterIdle (0) && Atomic_LoadUInt32 (&demo_writer.head) != Atomic_LoadUInt32 (&demo_writer.tail))
+	{
+		demo_writer.running = true;
+		demo_writer.task = Task_AllocateAssignFuncAndSubmit (CL_DemoWriterDrain, NULL, 0);
+	}
+}
+
+static void CL_DemoWrite (const void *data, int len)
+{
+	uint32_t head = Atomic_LoadUInt32 (&demo_writer.head);
+	int      pos, part;
+
+	if (DEMO_RINGSIZE - (int)(head - Atomic_LoadUInt32 (&demo_writer.tail)) < len)
+	{
+		demo_writer.stalls++;
+		do
+		{
+			CL_DemoWriterKick ();
+			CL_DemoWriterIdle (SDL_MUTEX_MAXWAIT);
+		} while (DEMO_RINGSIZE - (int)(head - Atomic_LoadUInt32 (&demo_writer.tail)) < len);
+	}
+
+	pos = head & (DEMO_RINGSIZE - 1);
+	part = q_min (len, DEMO_RINGSIZE - pos);
+	memcpy (demo_writer.ring + pos, data, part);
+	memcpy (demo_writer.ring, (const byte *)data + part, len - part);
+	Atomic_StoreUInt32 (&demo_writer.head, head + len);
+}
+
+/*
+====================
+CL_DemoWriterStart
+
+cls.demofile has just been created
+====================
+*/
+static void CL_DemoWriterStart (void)
+{
+	demo_writer.ring = (byte *)Mem_Alloc (DEMO_RINGSIZE);
+	Atomic_StoreUInt32 (&demo_writer.head, 0);
+	Atomic_StoreUInt32 (&demo_writer.tail, 0);
+	demo_writer.running = false;
+	demo_writer.failed = false;
+	demo_writer.stalls = 0;
+
+	if (cl_democompress.value)
+	{
+		demo_writer.deflater = Deflate_AllocState ();
+		demo_writer.chunk = (byte *)Mem_Alloc (DEMO_CHUNKSIZE);
+		demo_writer.packed = (byte *)Mem_Alloc (DEMO_CHUNKSIZE);
+		demo_writer.chunklen = 0;
+		fwrite (DEMO_PACKEDMAGIC, 1, 4, cls.demofile);
+	}
+}
+
+/*
+====================
+CL_DemoWriterFinish
+
+Writes out the rest, before cls.demofile is closed
+====================
+*/
+static void CL_DemoWriterFinish (void)
+{
+	CL_DemoWriterIdle (SDL_MUTEX_MAXWAIT);
+	CL_DemoWriterDrain (NULL); // no task is running anymore
+	if (demo_writer.deflater && demo_writer.chunklen)
+		CL_DemoWriterPutChunk ();
+	fflush (cls.demofile);
+
+	if (demo_writer.failed)
+		Con_Printf ("ERROR: couldn't write all of the demo\n");
+	if (demo_writer.stalls)
+		Con_DPrintf ("Demo recording waited for the disk %i times\n", demo_writer.stalls);
+
+	SAFE_FREE (demo_writer.ring);
+	SAFE_FREE (demo_writer.deflater);
+	SAFE_FREE (demo_writer.chunk);
+	SAFE_FREE (demo_writer.packed);
+}
+
 /*
 ====================
 CL_WriteDemoMessage
@@ -67,47 +312,181 @@ Dumps the current net message, prefixed by the length and view angles
 */
 static void CL_WriteDemoMessage (void)
 {
-	int   len;
+	int   header[4];
 	int   i;
 	float f;
 
-	len = LittleLong (net_message.cursize);
-	fwrite (&len, 4, 1, cls.demofile);
+	header[0] = LittleLong (net_message.cursize);
 	for (i = 0; i < 3; i++)
 	{
 		f = LittleFloat (cl.viewangles[i]);
-		fwrite (&f, 4, 1, cls.demofile);
+		memcpy (&header[i + 1], &f, 4);
 	}
-	fwrite (net_message.data, net_message.cursize, 1, cls.demofile);
-	fflush (cls.demofile);
+	CL_DemoWrite (header, sizeof (header));
+	CL_DemoWrite (net_message.data, net_message.cursize);
+	CL_DemoWriterKick ();
 }
 
-static int CL_GetDemoMessage (void)
+/*
+====================
+CL_FreeDemoKeyframes
+====================
+*/
+void CL_FreeDemoKeyframes (void)
 {
-	int   r, i;
-	float f;
+	int i;
 
-	if (cls.demopaused)
-		return 0;
+	for (i = 0; i < cl.numdemokeyframes; i++)
+	{
+		Mem_Free (cl.demokeyframes[i].scores);
+		Mem_Free (cl.demokeyframes[i].entities);
+	}
+	SAFE_FREE (cl.demokeyframes);
+	cl.numdemokeyframes = cl.maxdemokeyframes = 0;
+}
 
-	// decide if it is time to grab the next message
-	if (cls.signon == SIGNONS) // always grab until fully connected
+/*
+====================
+CL_DemoKeyframe
+
+Takes a keyframe before the next message is read, if the last one is old enough
+====================
+*/
+static void CL_DemoKeyframe (void)
+{
+	demokeyframe_t *k;
+	int             i;
+
+	if (cls.signon != SIGNONS || cls.timedemo || cl_demokeyframe.value <= 0 || demo_message >= demo_numindex)
+		return;
+	if (cl.numdemokeyframes)
 	{
-		if (cls.timedemo)
+		// after a rewind, the keyframes ahead are still good
+		k = &cl.demokeyframes[cl.numdemokeyframes - 1];
+		if (demo_message <= k->message || cl.mtime[0] - k->mtime[0] < cl_demokeyframe.value)
+			return;
+	}
+
+	if (cl.numdemokeyframes == cl.maxdemokeyframes)
+	{
+		cl.maxdemokeyframes = q_max (cl.maxdemokeyframes * 2, 16);
+		cl.demokeyframes = (demokeyframe_t *)Mem_Realloc (cl.demokeyframes, cl.maxdemokeyframes * sizeof (demokeyframe_t));
+	}
+	k = &cl.demokeyframes[cl.numdemokeyframes++];
+
+	k->message = demo_message;
+	k->mtime[0] = cl.mtime[0];
+	k->mtime[1] = cl.mtime[1];
+	VectorCopy (cl.mviewangles[0], k->mviewangles[0]);
+	VectorCopy (cl.mviewangles[1], k->mviewangles[1]);
+	VectorCopy (cl.mvelocity[0], k->mvelocity[0]);
+	VectorCopy (cl.mvelocity[1], k->mvelocity[1]);
+	memcpy (k->stats, cl.stats, sizeof (k->stats));
+	memcpy (k->statsf, cl.statsf, sizeof (k->statsf));
+	k->items = cl.items;
+	k->intermission = cl.intermission;
+	k->completed_time = cl.completed_time;
+	k->viewentity = cl.viewentity;
+	memcpy (k->lightstyles, cl_lightstyle, sizeof (k->lightstyles));
+
+	k->scores = (demoscore_t *)Mem_Alloc (cl.maxclients * sizeof (demoscore_t));
+	for (i = 0; i < cl.maxclients; i++)
+	{
+		q_strlcpy (k->scores[i].name, cl.scores[i].name, sizeof (k->scores[i].name));
+		k->scores[i].entertime = cl.scores[i].entertime;
+		k->scores[i].frags = cl.scores[i].frags;
+		k->scores[i].colors = cl.scores[i].colors;
+	}
+
+	k->numentities = cl.num_entities;
+	k->entities = (demoentity_t *)Mem_Alloc (cl.num_entities * sizeof (demoentity_t));
+	for (i = 0; i < cl.num_entities; i++)
+	{
+		k->entities[i].netstate = cl.entities[i].netstate;
+		k->entities[i].model = cl.entities[i].model;
+		k->entities[i].msgtime = cl.entities[i].msgtime;
+		k->entities[i].update_type = cl.entities[i].update_type;
+	}
+}
+
+/*
+====================
+CL_DemoRestoreKeyframe
+
+Puts the client back into the state it was in when the keyframe was taken,
+and the demo file at the message that followed
+====================
+*/
+static void CL_DemoRestoreKeyframe (demokeyframe_t *k)
+{
+	entity_t *ent;
+	int       i;
+
+	if (fseek (cls.demofile, demo_index[k->message].offset, SEEK_SET))
+		return;
+	demo_message = k->message;
+
+	for (i = 0; i < cl.num_entities; i++)
+	{
+		ent = &cl.entities[i];
+		if (i < k->numentities)
 		{
-			if (host_framecount == cls.td_lastframe)
-				return 0; // already read this frame's message
-			cls.td_lastframe = host_framecount;
-			// if this is the second frame, grab the real td_starttime
-			// so the bogus time on the first frame doesn't count
-			if (host_framecount == cls.td_startframe + 1)
-				cls.td_starttime = realtime;
+			ent->netstate = k->entities[i].netstate;
+			ent->model = k->entities[i].model;
+			ent->msgtime = k->entities[i].msgtime;
+			ent->update_type = k->entities[i].update_type;
 		}
-		else if (/* cl.time > 0 && */ cl.time <= cl.mtime[0])
+		else
+		{ // didn't exist yet
+			ent->netstate = ent->baseline;
+			ent->model = NULL;
+			ent->msgtime = 0;
+			ent->update_type = 0;
+		}
+		ent->forcelink = true;
+		ent->lerpflags |= LERP_RESETMOVE | LERP_RESETANIM;
+	}
+	InvalidateTraceLineCache ();
+
+	cl.mtime[0] = k->mtime[0];
+	cl.mtime[1] = k->mtime[1];
+	VectorCopy (k->mviewangles[0], cl.mviewangles[0]);
+	VectorCopy (k->mviewangles[1], cl.mviewangles[1]);
+	VectorCopy (k->mvelocity[0], cl.mvelocity[0]);
+	VectorCopy (k->mvelocity[1], cl.mvelocity[1]);
+	memcpy (cl.stats, k->stats, sizeof (cl.stats));
+	memcpy (cl.statsf, k->statsf, sizeof (cl.statsf));
+	cl.items = k->items;
+	cl.intermission = k->intermission;
+	cl.completed_time = k->completed_time;
+	cl.viewentity = k->viewentity;
+	memcpy (cl_lightstyle, k->lightstyles, sizeof (cl_lightstyle));
+	vid.recalc_refdef = true; // STAT_VIEWZOOM
+
+	for (i = 0; i < cl.maxclients; i++)
+	{
+		q_strlcpy (cl.scores[i].name, k->scores[i].name, sizeof (cl.scores[i].name));
+		cl.scores[i].entertime = k->scores[i].entertime;
+		cl.scores[i].frags = k->scores[i].frags;
+		if (cl.scores[i].colors != k->scores[i].colors)
 		{
-			return 0; // don't need another message yet
+			cl.scores[i].colors = k->scores[i].colors;
+			CL_NewTranslation (i);
 		}
 	}
+}
+
+/*
+====================
+CL_ReadDemoMessage
+
+Reads the next message into net_message, stopping playback at the end of the file
+====================
+*/
+static int CL_ReadDemoMessage (void)
+{
+	int   r, i;
+	float f;
 
 	// get the next message
 	if (fread (&net_message.cursize, 4, 1, cls.demofile) != 1)
@@ -136,9 +515,38 @@ static int CL_GetDemoMessage (void)
 		return 0;
 	}
 
+	demo_message++;
 	return 1;
 }
 
+static int CL_GetDemoMessage (void)
+{
+	if (cls.demopaused)
+		return 0;
+
+	// decide if it is time to grab the next message
+	if (cls.signon == SIGNONS) // always grab until fully connected
+	{
+		if (cls.timedemo)
+		{
+			if (host_framecount == cls.td_lastframe)
+				return 0; // already read this frame's message
+			cls.td_lastframe = host_framecount;
+			// if this is the second frame, grab the real td_starttime
+			// so the bogus time on the first frame doesn't count
+			if (host_framecount == cls.td_startframe + 1)
+				cls.td_starttime = realtime;
+		}
+		else if (/* cl.time > 0 && */ cl.time <= cl.mtime[0])
+		{
+			return 0; // don't need another message yet
+		}
+	}
+
+	CL_DemoKeyframe ();
+	return CL_ReadDemoMessage ();
+}
+
 /*
 ====================
 CL_GetMessage
@@ -197,6 +605,7 @@ void CL_Stop_f (void)
 	CL_WriteDemoMessage ();
 
 	// finish up
+	CL_DemoWriterFinish ();
 	fclose (cls.demofile);
 	cls.demofile = NULL;
 	cls.demorecording = false;
@@ -432,6 +841,7 @@ void CL_Record_f (void)
 {
 	int  c;
 	char name[MAX_OSPATH];
+	char trackline[16];
 	int  track;
 
 	if (cmd_source != src_command)
@@ -515,7 +925,9 @@ void CL_Record_f (void)
 	}
 
 	cls.forcetrack = track;
-	fprintf (cls.demofile, "%i\n", cls.forcetrack);
+	CL_DemoWriterStart ();
+	q_snprintf (trackline, sizeof (trackline), "%i\n", cls.forcetrack);
+	CL_DemoWrite (trackline, strlen (trackline));
 
 	cls.demorecording = true;
 
@@ -539,6 +951,115 @@ void CL_Record_f (void)
 	}
 }
 
+/*
+====================
+CL_BuildDemoIndex
+
+Finds where every message up to end starts, leaving the file where it was
+====================
+*/
+static void CL_BuildDemoIndex (long end)
+{
+	long  start = ftell (cls.demofile);
+	long  offset = start;
+	int   maxindex = 0;
+	int   length;
+	float time = 0;
+	byte  header[16 + 5]; // length and view angles, then enough of the message for an svc_time
+
+	SAFE_FREE (demo_index);
+	demo_numindex = demo_message = 0;
+
+	while (offset + 16 <= end && !fseek (cls.demofile, offset, SEEK_SET))
+	{
+		if (fread (header, 1, sizeof (header), cls.demofile) < 16)
+			break;
+		memcpy (&length, header, 4);
+		length = LittleLong (length);
+		if (length < 0 || length > MAX_MSGLEN || offset + 16 + length > end)
+			break; // truncated, playback will stop there too
+		if (length >= 5 && header[16] == svc_time)
+		{
+			memcpy (&time, header + 17, 4);
+			time = LittleFloat (time);
+		}
+
+		if (demo_numindex == maxindex)
+		{
+			maxindex = q_max (maxindex * 2, 1024);
+			demo_index = (demoindex_t *)Mem_Realloc (demo_index, maxindex * sizeof (demoindex_t));
+		}
+		demo_index[demo_numindex].offset = offset;
+		demo_index[demo_numindex].time = time;
+		demo_numindex++;
+		offset += 16 + length;
+	}
+	fseek (cls.demofile, start, SEEK_SET);
+}
+
+/*
+====================
+CL_UnpackDemo
+
+Swaps a packed demo for a temporary file with the plain demo in it
+====================
+*/
+static qboolean CL_UnpackDemo (long *start, int *length)
+{
+	char     magic[4];
+	int      header[2];
+	int      remaining, rawlen, packedlen;
+	byte    *raw, *packed;
+	qboolean ok = true;
+	FILE    *f;
+
+	if (*length < 4 || fread (magic, 1, 4, cls.demofile) != 4 || memcmp (magic, DEMO_PACKEDMAGIC, 4))
+	{
+		fseek (cls.demofile, *start, SEEK_SET);
+		return true;
+	}
+
+	f = tmpfile ();
+	if (!f)
+	{
+		Con_Printf ("ERROR: couldn't create a temporary file to unpack the demo in\n");
+		return false;
+	}
+
+	raw = (byte *)Mem_Alloc (DEMO_CHUNKSIZE);
+	packed = (byte *)Mem_Alloc (DEMO_CHUNKSIZE);
+	for (remaining = *length - 4; ok && remaining > 0; remaining -= 8 + packedlen)
+	{
+		if (remaining < 8 || fread (header, 4, 2, cls.demofile) != 2)
+		{
+			ok = false;
+			break;
+		}
+		rawlen = LittleLong (header[0]);
+		packedlen = LittleLong (header[1]);
+		ok = rawlen > 0 && rawlen <= DEMO_CHUNKSIZE && packedlen > 0 && packedlen <= rawlen && packedlen <= remaining - 8 &&
+			 fread (packed, packedlen, 1, cls.demofile) == 1;
+		if (ok && packedlen < rawlen)
+			ok = Deflate_Decompress (packed, packedlen, raw, DEMO_CHUNKSIZE) == rawlen;
+		else if (ok)
+			memcpy (raw, packed, rawlen);
+		ok = ok && fwrite (raw, rawlen, 1, f) == 1;
+	}
+	Mem_Free (raw);
+	Mem_Free (packed);
+
+	// a recording that was cut short still plays up to where it broke off
+	if (!ok)
+		Con_Printf ("WARNING: demo is damaged, playing what's left of it\n");
+
+	fclose (cls.demofile);
+	cls.demofile = f;
+	*start = 0;
+	*length = ftell (f);
+	rewind (f);
+	return true;
+}
+
 /*
 ====================
 CL_PlayDemo_f
@@ -549,6 +1070,8 @@ play [demoname]
 void CL_PlayDemo_f (void)
 {
 	char name[MAX_OSPATH];
+	int  length;
+	long start;
 
 	if (cmd_source != src_command)
 		return;
@@ -568,19 +1091,20 @@ void CL_PlayDemo_f (void)
 
 	Con_Printf ("Playing demo from %s.\n", name);
 
-	COM_FOpenFile (name, &cls.demofile, NULL);
+	length = COM_FOpenFile (name, &cls.demofile, NULL);
 	if (!cls.demofile)
 	{
 		Con_Printf ("ERROR: couldn't open %s\n", name);
 		cls.demonum = -1; // stop demo loop
 		return;
 	}
+	start = ftell (cls.demofile); // not 0 inside a pak
 
 	// ZOID, fscanf is evil
 	// O.S.: if a space character e.g. 0x20 (' ') follows '\n',
 	// fscanf skips that byte too and screws up further reads.
 	//	fscanf (cls.demofile, "%i\n", &cls.forcetrack);
-	if (fscanf (cls.demofile, "%i", &cls.forcetrack) != 1 || fgetc (cls.demofile) != '\n')
+	if (!CL_UnpackDemo (&start, &length) || fscanf (cls.demofile, "%i", &cls.forcetrack) != 1 || fgetc (cls.demofile) != '\n')
 	{
 		fclose (cls.demofile);
 		cls.demofile = NULL;
@@ -588,6 +1112,7 @@ void CL_PlayDemo_f (void)
 		Con_Printf ("ERROR: demo \"%s\" is invalid\n", name);
 		return;
 	}
+	CL_BuildDemoIndex (start + length);
 
 	cls.demoplayback = true;
 	cls.demopaused = false;
@@ -597,6 +1122,215 @@ void CL_PlayDemo_f (void)
 	key_dest = key_game;
 }
 
+/*
+==============================================================================
+
+TIMEDEMO AND BENCHMARK
+
+While a timedemo runs, _Host_Frame hands every frame's host_speeds splits to
+CL_TimeDemoFrame, which keeps them with the wall time since the previous frame.
+When the demo ends the percentiles of each are printed and, with timedemo_log
+set, written out. benchmark runs a list of demos through timedemo a number of
+times each, after benchmark_warmup untimed runs, and reports all of them.
+==============================================================================
+*/
+
+#define TD_NUMPHASES        4
+#define MAX_BENCHMARK_DEMOS 32
+
+static const char *td_phasenames[TD_NUMPHASES] = {"frame", "server", "gfx", "snd"};
+
+typedef struct
+{
+	float ms[TD_NUMPHASES]; // the whole frame, then the host_speeds splits
+} tdframe_t;
+
+typedef struct
+{
+	double min, avg, p50, p95, p99, max;
+} tdstats_t;
+
+typedef struct
+{
+	int       demo;
+	int       frames;
+	double    seconds;
+	tdstats_t frametime;
+} benchrun_t;
+
+static tdframe_t *td_frames;
+static int        td_numframes;
+static int        td_maxframes;
+static double     td_lastframetime;
+static char       td_demoname[MAX_QPATH];
+
+static struct
+{
+	qboolean    active;
+	char        demos[MAX_BENCHMARK_DEMOS][MAX_QPATH];
+	int         numdemos;
+	int         runs;
+	int         warmup;
+	int         demo; // the one being played
+	int         pass; // counts the warm-up runs too
+	benchrun_t *results;
+	int         numresults;
+} benchmark;
+
+static void CL_BenchmarkFinishedRun (int frames, float time, const tdstats_t *frametime);
+
+/*
+====================
+CL_TimeDemoFrame
+
+Called at the end of each host frame during a timedemo
+====================
+*/
+void CL_TimeDemoFrame (double server, double gfx, double snd)
+{
+	double     now = Sys_DoubleTime ();
+	tdframe_t *frame;
+
+	// like the fps count, leave out the frame that loaded the map
+	if (host_framecount >= cls.td_startframe + 2 && td_lastframetime)
+	{
+		if (td_numframes == td_maxframes)
+		{
+			td_maxframes = q_max (td_maxframes * 2, 1024);
+			td_frames = (tdframe_t *)Mem_Realloc (td_frames, td_maxframes * sizeof (tdframe_t));
+		}
+		frame = &td_frames[td_numframes++];
+		frame->ms[0] = (now - td_lastframetime) * 1000;
+		frame->ms[1] = server;
+		frame->ms[2] = gfx;
+		frame->ms[3] = snd;
+	}
+	td_lastframetime = now;
+}
+
+static int CL_CompareFloats (const void *a, const void *b)
+{
+	float x = *(const float *)a;
+	float y = *(const float *)b;
+	return (x > y) - (x < y);
+}
+
+static double CL_Percentile (const float *sorted, int count, double percent)
+{
+	// nearest rank
+	int rank = (int)ceil (percent / 100 * count);
+	return sorted[CLAMP (1, rank, count) - 1];
+}
+
+/*
+====================
+CL_TimeDemoStats
+====================
+*/
+static void CL_TimeDemoStats (int phase, tdstats_t *stats)
+{
+	float *sorted = (float *)Mem_Alloc (td_numframes * sizeof (float));
+	double total = 0;
+	int    i;
+
+	for (i = 0; i < td_numframes; i++)
+	{
+		sorted[i] = td_frames[i].ms[phase];
+		total += sorted[i];
+	}
+	qsort (sorted, td_numframes, sizeof (float), CL_CompareFloats);
+
+	stats->min = sorted[0];
+	stats->avg = total / td_numframes;
+	stats->p50 = CL_Percentile (sorted, td_numframes, 50);
+	stats->p95 = CL_Percentile (sorted, td_numframes, 95);
+	stats->p99 = CL_Percentile (sorted, td_numframes, 99);
+	stats->max = sorted[td_numframes - 1];
+	Mem_Free (sorted);
+}
+
+static void CL_WriteJSONString (FILE *f, const char *s)
+{
+	fputc ('"', f);
+	for (; *s; s++)
+	{
+		if (*s == '"' || *s == '\\')
+			fprintf (f, "\\%c", *s);
+		else if ((unsigned char)*s < ' ')
+			fprintf (f, "\\u%04x", *s);
+		else
+			fputc (*s, f);
+	}
+	fputc ('"', f);
+}
+
+static void CL_WriteJSONStats (FILE *f, const tdstats_t *stats)
+{
+	fprintf (
+		f, "{\"min\": %.3f, \"avg\": %.3f, \"p50\": %.3f, \"p95\": %.3f, \"p99\": %.3f, \"max\": %.3f}", stats->min, stats->avg, stats->p50, stats->p95,
+		stats->p99, stats->max);
+}
+
+/*
+====================
+CL_OpenResultsFile
+
+Results go in the game directory, as csv if the name says so and json otherwise
+====================
+*/
+static FILE *CL_OpenResultsFile (const char *name, qboolean *csv)
+{
+	FILE *f;
+
+	if (strstr (name, ".."))
+	{
+		Con_Printf ("Relative pathnames are not allowed.\n");
+		return NULL;
+	}
+	*csv = !q_strcasecmp (COM_FileGetExtension (name), "csv");
+	f = fopen (va ("%s/%s", com_gamedir, name), "w");
+	if (!f)
+		Con_Printf ("ERROR: couldn't open %s.\n", name);
+	return f;
+}
+
+/*
+====================
+CL_WriteTimeDemoLog
+====================
+*/
+static void CL_WriteTimeDemoLog (int frames, float time, const tdstats_t *stats)
+{
+	qboolean csv;
+	FILE    *f;
+	int      i;
+
+	f = CL_OpenResultsFile (timedemo_log.string, &csv);
+	if (!f)
+		return;
+
+	if (csv)
+	{
+		fprintf (f, "frame,frame_ms,server_ms,gfx_ms,snd_ms\n");
+		for (i = 0; i < td_numframes; i++)
+			fprintf (f, "%i,%.3f,%.3f,%.3f,%.3f\n", i, td_frames[i].ms[0], td_frames[i].ms[1], td_frames[i].ms[2], td_frames[i].ms[3]);
+	}
+	else
+	{
+		fprintf (f, "{\n\t\"demo\": ");
+		CL_WriteJSONString (f, td_demoname);
+		fprintf (f, ",\n\t\"frames\": %i,\n\t\"seconds\": %.3f,\n\t\"fps\": %.2f", frames, time, frames / time);
+		for (i = 0; i < TD_NUMPHASES; i++)
+		{
+			fprintf (f, ",\n\t\"%s_ms\": ", td_phasenames[i]);
+			CL_WriteJSONStats (f, &stats[i]);
+		}
+		fprintf (f, "\n}\n");
+	}
+	fclose (f);
+	Con_Printf ("Wrote %s.\n", timedemo_log.string);
+}
+
 /*
 ====================
 CL_FinishTimeDemo
@@ -605,8 +1339,10 @@ CL_FinishTimeDemo
 */
 static void CL_FinishTimeDemo (void)
 {
-	int   frames;
-	float time;
+	int       frames;
+	float     time;
+	tdstats_t stats[TD_NUMPHASES];
+	int       i;
 
 	cls.timedemo = false;
 
@@ -616,6 +1352,26 @@ static void CL_FinishTimeDemo (void)
 	if (!time)
 		time = 1;
 	Con_Printf ("%i frames %5.1f seconds %5.1f fps\n", frames, time, frames / time);
+
+	memset (stats, 0, sizeof (stats));
+	if (td_numframes)
+	{
+		Con_Printf ("%-6s %7s %7s %7s %7s %7s %7s ms\n", "", "min", "avg", "p50", "p95", "p99", "max");
+		for (i = 0; i < TD_NUMPHASES; i++)
+		{
+			CL_TimeDemoStats (i, &stats[i]);
+			Con_Printf (
+				"%-6s %7.2f %7.2f %7.2f %7.2f %7.2f %7.2f\n", td_phasenames[i], stats[i].min, stats[i].avg, stats[i].p50, stats[i].p95, stats[i].p99,
+				stats[i].max);
+		}
+		if (*timedemo_log.string)
+			CL_WriteTimeDemoLog (frames, time, stats);
+	}
+	SAFE_FREE (td_frames);
+	td_numframes = td_maxframes = 0;
+
+	if (benchmark.active)
+		CL_BenchmarkFinishedRun (frames, time, &stats[0]);
 }
 
 /*
@@ -638,7 +1394,14 @@ void CL_TimeDemo_f (void)
 
 	CL_PlayDemo_f ();
 	if (!cls.demofile)
+	{
+		if (benchmark.active)
+		{
+			Con_Printf ("Benchmark stopped.\n");
+			benchmark.active = false;
+		}
 		return;
+	}
 
 	// cls.td_starttime will be grabbed at the second frame of the demo, so
 	// all the loading time doesn't get counted
@@ -646,4 +1409,289 @@ void CL_TimeDemo_f (void)
 	cls.timedemo = true;
 	cls.td_startframe = host_framecount;
 	cls.td_lastframe = -1; // get a new message this frame
+
+	q_strlcpy (td_demoname, Cmd_Argv (1), sizeof (td_demoname));
+	td_numframes = 0;
+	td_lastframetime = 0;
+}
+
+/*
+====================
+CL_WriteBenchmarkLog
+====================
+*/
+static void CL_WriteBenchmarkLog (void)
+{
+	qboolean    csv;
+	FILE       *f;
+	benchrun_t *run;
+	int         i, j;
+
+	f = CL_OpenResultsFile (benchmark_log.string, &csv);
+	if (!f)
+		return;
+
+	if (csv)
+	{
+		fprintf (f, "demo,run,frames,seconds,fps,min_ms,avg_ms,p50_ms,p95_ms,p99_ms,max_ms\n");
+		for (i = 0, j = 0; i < benchmark.numresults; i++)
+		{
+			run = &benchmark.results[i];
+			j = (i && run->demo == run[-1].demo) ? j + 1 : 0;
+			fprintf (
+				f, "%s,%i,%i,%.3f,%.2f,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f\n", benchmark.demos[run->demo], j, run->frames, run->seconds,
+				run->frames / run->seconds, run->frametime.min, run->frametime.avg, run->frametime.p50, run->frametime.p95, run->frametime.p99,
+				run->frametime.max);
+		}
+	}
+	else
+	{
+		fprintf (f, "{\n\t\"runs_per_demo\": %i,\n\t\"warmup\": %i,\n\t\"runs\": [", benchmark.runs, benchmark.warmup);
+		for (i = 0; i < benchmark.numresults; i++)
+		{
+			run = &benchmark.results[i];
+			fprintf (f, "%s\n\t\t{\"demo\": ", i ? "," : "");
+			CL_WriteJSONString (f, benchmark.demos[run->demo]);
+			fprintf (f, ", \"frames\": %i, \"seconds\": %.3f, \"fps\": %.2f, \"frame_ms\": ", run->frames, run->seconds, run->frames / run->seconds);
+			CL_WriteJSONStats (f, &run->frametime);
+			fprintf (f, "}");
+		}
+		fprintf (f, "\n\t]\n}\n");
+	}
+	fclose (f);
+	Con_Printf ("Wrote %s.\n", benchmark_log.string);
+}
+
+/*
+====================
+CL_BenchmarkReport
+
+Summarizes the timed runs of each demo
+====================
+*/
+static void CL_BenchmarkReport (void)
+{
+	benchrun_t *run;
+	double      fps, sum, sumsq, minfps, maxfps, p50, p99;
+	int         i, j, count;
+
+	Con_Printf ("\n%-16s %4s %8s %8s %8s %6s %8s %8s\n", "demo", "runs", "avg fps", "min fps", "max fps", "stddev", "p50 ms", "p99 ms");
+	for (i = 0; i < benchmark.numdemos; i++)
+	{
+		count = 0;
+		sum = sumsq = p50 = p99 = 0;
+		minfps = maxfps = 0;
+		for (j = 0; j < benchmark.numresults; j++)
+		{
+			run = &benchmark.results[j];
+			if (run->demo != i)
+				continue;
+			fps = run->frames / run->seconds;
+			minfps = count ? q_min (minfps, fps) : fps;
+			maxfps = count ? q_max (maxfps, fps) : fps;
+			sum += fps;
+			sumsq += fps * fps;
+			p50 += run->frametime.p50;
+			p99 = q_max (p99, run->frametime.p99); // worst run
+			count++;
+		}
+		if (!count)
+			continue;
+		sum /= count;
+		Con_Printf (
+			"%-16s %4i %8.1f %8.1f %8.1f %6.2f %8.2f %8.2f\n", benchmark.demos[i], count, sum, minfps, maxfps, sqrt (q_max (sumsq / count - sum * sum, 0.0)),
+			p50 / count, p99);
+	}
+
+	if (*benchmark_log.string)
+		CL_WriteBenchmarkLog ();
+}
+
+/*
+====================
+CL_BenchmarkNext
+
+Starts the next run, or wraps up after the last one
+====================
+*/
+static void CL_BenchmarkNext (void)
+{
+	if (benchmark.demo == benchmark.numdemos)
+	{
+		CL_BenchmarkReport ();
+		benchmark.active = false;
+		if (benchmark_quit.value)
+		{
+			key_dest = key_console; // quit without the menu asking first
+			Cbuf_AddText ("quit\n");
+		}
+		return;
+	}
+
+	if (benchmark.pass < benchmark.warmup)
+		Con_Printf ("benchmark: %s warm-up %i of %i\n", benchmark.demos[benchmark.demo], benchmark.pass + 1, benchmark.warmup);
+	else
+		Con_Printf ("benchmark: %s run %i of %i\n", benchmark.demos[benchmark.demo], benchmark.pass - benchmark.warmup + 1, benchmark.runs);
+	Cbuf_AddText (va ("timedemo \"%s\"\n", benchmark.demos[benchmark.demo]));
+}
+
+static void CL_BenchmarkFinishedRun (int frames, float time, const tdstats_t *frametime)
+{
+	benchrun_t *run;
+
+	if (benchmark.pass >= benchmark.warmup && frames > 0)
+	{
+		run = &benchmark.results[benchmark.numresults++];
+		run->demo = benchmark.demo;
+		run->frames = frames;
+		run->seconds = time;
+		run->frametime = *frametime;
+	}
+	if (++benchmark.pass == benchmark.warmup + benchmark.runs)
+	{
+		benchmark.pass = 0;
+		benchmark.demo++;
+	}
+	CL_BenchmarkNext ();
+}
+
+/*
+====================
+CL_Benchmark_f
+
+benchmark <runs> <demo> [demo...]
+====================
+*/
+void CL_Benchmark_f (void)
+{
+	int i;
+
+	if (cmd_source != src_command)
+		return;
+
+	if (Cmd_Argc () == 2 && !q_strcasecmp (Cmd_Argv (1), "stop"))
+	{
+		if (benchmark.active)
+		{
+			benchmark.active = false;
+			Con_Printf ("Benchmark stopped.\n");
+		}
+		return;
+	}
+
+	if (Cmd_Argc () < 3 || atoi (Cmd_Argv (1)) < 1)
+	{
+		Con_Printf ("benchmark <runs> <demo> [demo...] : timedemos each demo runs times, after benchmark_warmup more\n");
+		Con_Printf ("benchmark stop : gives up on the current benchmark\n");
+		return;
+	}
+	if (Cmd_Argc () - 2 > MAX_BENCHMARK_DEMOS)
+	{
+		Con_Printf ("benchmark: at most %i demos\n", MAX_BENCHMARK_DEMOS);
+		return;
+	}
+
+	SAFE_FREE (benchmark.results);
+	memset (&benchmark, 0, sizeof (benchmark));
+	benchmark.runs = atoi (Cmd_Argv (1));
+	benchmark.warmup = q_max ((int)benchmark_warmup.value, 0);
+	benchmark.numdemos = Cmd_Argc () - 2;
+	for (i = 0; i < benchmark.numdemos; i++)
+		q_strlcpy (benchmark.demos[i], Cmd_Argv (i + 2), sizeof (benchmark.demos[i]));
+	benchmark.results = (benchrun_t *)Mem_Alloc (benchmark.numdemos * benchmark.runs * sizeof (benchrun_t));
+	benchmark.active = true;
+
+	cls.demonum = -1; // keep the demo loop from starting between runs
+	CL_BenchmarkNext ();
+}
+
+static const char *CL_DemoTimeString (double time)
+{
+	int seconds = (int)q_max (time, 0.0);
+
+	return va ("%i:%02i", seconds / 60, seconds % 60);
+}
+
+/*
+====================
+CL_DemoSeek_f
+
+demoseek [+|-]<seconds or mm:ss>
+====================
+*/
+void CL_DemoSeek_f (void)
+{
+	const char     *arg;
+	const char     *colon;
+	double          target;
+	demokeyframe_t *k;
+	int             sign = 0;
+	int             i;
+
+	if (cmd_source != src_command)
+		return;
+
+	if (!cls.demoplayback || cls.timedemo)
+	{
+		Con_Printf ("Not playing a demo.\n");
+		return;
+	}
+	if (cls.signon != SIGNONS)
+	{
+		Con_Printf ("Wait for the demo to start.\n");
+		return;
+	}
+	if (Cmd_Argc () != 2)
+	{
+		Con_Printf ("demoseek [+|-]<seconds or mm:ss> : jumps to that demo time, or that far ahead or back\n");
+		Con_Printf (
+			"at %s of %s, %i rewind points on this map\n", CL_DemoTimeString (cl.mtime[0]),
+			CL_DemoTimeString (demo_numindex ? demo_index[demo_numindex - 1].time : 0), cl.numdemokeyframes);
+		return;
+	}
+
+	arg = Cmd_Argv (1);
+	if (*arg == '+' || *arg == '-')
+		sign = (*arg++ == '+') ? 1 : -1;
+	target = atof (arg);
+	if ((colon = strchr (arg, ':')) != NULL)
+		target = target * 60 + atof (colon + 1);
+	if (sign)
+		target = cl.mtime[0] + sign * target;
+
+	if (target < cl.mtime[0])
+	{
+		if (!cl.numdemokeyframes)
+		{
+			Con_Printf ("No rewind points yet (cl_demokeyframe is %s).\n", cl_demokeyframe.string);
+			return;
+		}
+		// the last keyframe before the target, or the first one if the target's before that
+		for (i = cl.numdemokeyframes - 1; i > 0 && cl.demokeyframes[i].mtime[0] > target; i--)
+			;
+		k = &cl.demokeyframes[i];
+		if (k->mtime[0] > target)
+			Con_Printf ("Can't rewind past the start of the map.\n");
+		CL_DemoRestoreKeyframe (k);
+	}
+
+	// parse ahead until we're there, unless the demo ends or changes maps first
+	while (cls.demoplayback && cls.signon == SIGNONS && cl.mtime[0] < target)
+	{
+		CL_DemoKeyframe ();
+		if (!CL_ReadDemoMessage ())
+			break;
+		CL_ParseServerMessage ();
+	}
+	if (!cls.demoplayback)
+		return;
+
+	// don't lerp from where we were, or keep whatever the skipped messages started
+	cl.time = cl.oldtime = cl.mtime[0];
+	S_StopAllSounds (true);
+	R_ClearParticles ();
+	memset (cl_dlights, 0, sizeof (cl_dlights));
+	for (i = 0; i < MAX_BEAMS; i++)
+		cl_beams[i].endtime = 0;
+	Con_ClearNotify ();
 }
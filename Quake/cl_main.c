@@ -108,6 +108,7 @@ void CL_FreeState (void)
 	for (i = 0; i < cl.num_efragallocs; ++i)
 		Mem_Free (cl.efrag_allocs[i]);
 	Mem_Free (cl.efrag_allocs);
+	CL_FreeDemoKeyframes ();
 	memset (&cl, 0, sizeof (cl));
 }
 
@@ -279,6 +280,7 @@ void CL_SignonReply (void)
 
 	case 4:
 		SCR_EndLoadingPlaque (); // allow normal screen updates
+		Con_DPrintf ("Signon took %.2f seconds\n", realtime - cls.signonstart);
 		break;
 	}
 }
@@ -997,7 +999,10 @@ int CL_ReadFromServer (void)
 	int        i;                 // johnfitz
 
 	cl.oldtime = cl.time;
-	cl.time += host_frametime;
+	if (cls.demoplayback && !cls.timedemo)
+		cl.time += host_frametime * q_max (cl_demospeed.value, 0.f);
+	else
+		cl.time += host_frametime;
 
 	needs_relink = true;
 	do
@@ -1279,6 +1284,13 @@ void CL_Init (void)
 	Cvar_RegisterVariable (&cl_minpitch); // johnfitz -- variable pitch clamping
 
 	Cvar_RegisterVariable (&cl_startdemos);
+	Cvar_RegisterVariable (&cl_demospeed);
+	Cvar_RegisterVariable (&cl_demokeyframe);
+	Cvar_RegisterVariable (&cl_democompress);
+	Cvar_RegisterVariable (&timedemo_log);
+	Cvar_RegisterVariable (&benchmark_warmup);
+	Cvar_RegisterVariable (&benchmark_log);
+	Cvar_RegisterVariable (&benchmark_quit);
 
 	Cmd_AddCommand ("entities", CL_PrintEntities_f);
 	Cmd_AddCommand ("disconnect", CL_Disconnect_f);
@@ -1286,6 +1298,8 @@ void CL_Init (void)
 	Cmd_AddCommand ("stop", CL_Stop_f);
 	Cmd_AddCommand ("playdemo", CL_PlayDemo_f);
 	Cmd_AddCommand ("timedemo", CL_TimeDemo_f);
+	Cmd_AddCommand ("demoseek", CL_DemoSeek_f);
+	Cmd_AddCommand ("benchmark", CL_Benchmark_f);
 
 	Cmd_AddCommand ("tracepos", CL_Tracepos_f); // johnfitz
 	Cmd_AddCommand ("viewpos", CL_Viewpos_f);   // johnfitz
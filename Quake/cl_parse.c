@@ -865,6 +865,7 @@ static void CL_ParseServerInfo (void)
 	char        sound_precache[MAX_SOUNDS][MAX_QPATH];
 
 	Con_DPrintf ("Serverinfo packet received.\n");
+	cls.signonstart = realtime;
 
 	// ericw -- bring up loading plaque for map changes within a demo.
 	//          it will be hidden in CL_SignonReply.
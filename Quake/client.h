@@ -134,6 +134,7 @@ typedef struct
 
 	// connection information
 	int               signon; // 0 to SIGNONS
+	double            signonstart; // realtime of the last svc_serverinfo, to report how long the signon took
 	struct qsocket_s *netcon;
 	sizebuf_t         message; // writing buffer to send to server
 
@@ -264,6 +265,10 @@ typedef struct
 	qboolean     requestresend;
 	qboolean     sendprespawn;
 
+	struct demokeyframe_s *demokeyframes; // demoseek rewind points on this map, see cl_demo.c
+	int                    numdemokeyframes;
+	int                    maxdemokeyframes;
+
 	qcvm_t qcvm; // for csqc.
 
 	char serverinfo[8192]; // \key\value infostring data.
@@ -308,6 +313,13 @@ extern cvar_t m_forward;
 extern cvar_t m_side;
 
 extern cvar_t cl_startdemos;
+extern cvar_t cl_demospeed;
+extern cvar_t cl_demokeyframe;
+extern cvar_t cl_democompress;
+extern cvar_t timedemo_log;
+extern cvar_t benchmark_warmup;
+extern cvar_t benchmark_log;
+extern cvar_t benchmark_quit;
 
 #define MAX_TEMP_ENTITIES 256 // johnfitz -- was 64
 
@@ -379,11 +391,15 @@ void CL_ClearTrailStates (void);
 //
 void CL_StopPlayback (void);
 int  CL_GetMessage (void);
+void CL_FreeDemoKeyframes (void);
 
 void CL_Stop_f (void);
 void CL_Record_f (void);
 void CL_PlayDemo_f (void);
 void CL_TimeDemo_f (void);
+void CL_DemoSeek_f (void);
+void CL_Benchmark_f (void);
+void CL_TimeDemoFrame (double server, double gfx, double snd);
 
 //
 // cl_parse.c
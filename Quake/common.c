@@ -41,6 +41,7 @@ static qboolean com_modified; // set true if using non-id files
 qboolean fitzmode;
 
 static void COM_Path_f (void);
+static void StrHash_Stats_f (void);
 
 // if a packfile directory differs from this, it is assumed to be hacked
 #define PAK0_COUNT      339   /* id1/pak0.pak - v1.0x */
@@ -2459,6 +2460,7 @@ void COM_InitFilesystem (void) // johnfitz -- modified based on topaz's tutorial
 	Cvar_RegisterVariable (&cmdline);
 	Cmd_AddCommand ("path", COM_Path_f);
 	Cmd_AddCommand ("game", COM_Game_f); // johnfitz
+	Cmd_AddCommand ("hashstats", StrHash_Stats_f);
 
 	i = COM_CheckParm ("-basedir");
 	if (i && i < com_argc - 1)
@@ -2809,6 +2811,212 @@ unsigned COM_HashString (const char *str)
 	return hash;
 }
 
+/*
+==============================================================================
+
+STRING HASH TABLES
+
+Chained hash tables keyed by an interned copy of a string plus an optional
+owner pointer. Several entries may share a key; lookups return the most
+recently inserted one. Only the texture list can actually hold duplicates,
+and as new textures go in front of it, its linear search found the newest
+too. Tables can be zero-initialized statically and allocate on first insert.
+They are not thread safe, callers lock as needed; only the statistics are
+atomic.
+
+==============================================================================
+*/
+
+#define STRHASH_MIN_BUCKETS 64
+
+static strhash_t *strhash_tables; // every table that has been used, for hashstats
+
+struct strhash_entry_s
+{
+	strhash_entry_t *next;
+	const void      *owner;
+	void            *value;
+	unsigned         hash;
+	char             key[1]; // interned copy, allocated to fit
+};
+
+/*
+================
+StrHash_Hash
+================
+*/
+static unsigned StrHash_Hash (const char *key, const void *owner)
+{
+	unsigned hash = COM_HashString (key);
+	uintptr_t o = (uintptr_t)owner;
+	hash ^= (unsigned)(o ^ (o >> 16) ^ ((uint64_t)o >> 32));
+	return hash * 0x01000193u;
+}
+
+/*
+================
+StrHash_Resize
+================
+*/
+static void StrHash_Resize (strhash_t *table, int numbuckets)
+{
+	strhash_entry_t **buckets = (strhash_entry_t **)Mem_Alloc (numbuckets * sizeof (strhash_entry_t *));
+	int               i;
+
+	// walk each chain back to front so equal keys keep their order
+	for (i = 0; i < table->numbuckets; i++)
+	{
+		strhash_entry_t *entry = table->buckets[i], *reversed = NULL, *next;
+		for (; entry; entry = next)
+		{
+			next = entry->next;
+			entry->next = reversed;
+			reversed = entry;
+		}
+		for (entry = reversed; entry; entry = next)
+		{
+			strhash_entry_t **bucket = &buckets[entry->hash & (numbuckets - 1)];
+			next = entry->next;
+			entry->next = *bucket;
+			*bucket = entry;
+		}
+	}
+
+	Mem_Free (table->buckets);
+	table->buckets = buckets;
+	table->numbuckets = numbuckets;
+}
+
+/*
+================
+StrHash_Insert
+================
+*/
+void StrHash_Insert (strhash_t *table, const char *key, const void *owner, void *value)
+{
+	const size_t     keylen = strlen (key);
+	strhash_entry_t *entry;
+	strhash_entry_t **bucket;
+
+	if (!table->buckets)
+	{
+		StrHash_Resize (table, STRHASH_MIN_BUCKETS);
+		table->next = strhash_tables;
+		strhash_tables = table;
+	}
+	else if (table->count >= table->numbuckets)
+		StrHash_Resize (table, table->numbuckets * 2);
+
+	entry = (strhash_entry_t *)Mem_Alloc (sizeof (strhash_entry_t) + keylen);
+	memcpy (entry->key, key, keylen + 1);
+	entry->owner = owner;
+	entry->value = value;
+	entry->hash = StrHash_Hash (key, owner);
+
+	bucket = &table->buckets[entry->hash & (table->numbuckets - 1)];
+	entry->next = *bucket;
+	*bucket = entry;
+	table->count++;
+}
+
+/*
+================
+StrHash_Find
+================
+*/
+void *StrHash_Find (strhash_t *table, const char *key, const void *owner)
+{
+	strhash_entry_t *entry;
+	unsigned         hash;
+	uint32_t         compares = 0;
+	void            *value = NULL;
+
+	Atomic_IncrementUInt32 (&table->lookups);
+	if (!table->buckets)
+		return NULL;
+
+	hash = StrHash_Hash (key, owner);
+	for (entry = table->buckets[hash & (table->numbuckets - 1)]; entry; entry = entry->next)
+	{
+		compares++;
+		if (entry->hash == hash && entry->owner == owner && !strcmp (entry->key, key))
+		{
+			value = entry->value;
+			Atomic_IncrementUInt32 (&table->hits);
+			break;
+		}
+	}
+	Atomic_AddUInt32 (&table->compares, compares);
+	return value;
+}
+
+/*
+================
+StrHash_Remove
+
+Removes the entry for key and owner that points to value
+================
+*/
+void StrHash_Remove (strhash_t *table, const char *key, const void *owner, void *value)
+{
+	strhash_entry_t **link;
+	unsigned          hash;
+
+	if (!table->buckets)
+		return;
+
+	hash = StrHash_Hash (key, owner);
+	for (link = &table->buckets[hash & (table->numbuckets - 1)]; *link; link = &(*link)->next)
+	{
+		strhash_entry_t *entry = *link;
+		if (entry->value == value && entry->owner == owner && !strcmp (entry->key, key))
+		{
+			*link = entry->next;
+			Mem_Free (entry);
+			table->count--;
+			return;
+		}
+	}
+}
+
+/*
+================
+StrHash_Clear
+================
+*/
+void StrHash_Clear (strhash_t *table)
+{
+	int i;
+
+	for (i = 0; i < table->numbuckets; i++)
+	{
+		strhash_entry_t *entry, *next;
+		for (entry = table->buckets[i]; entry; entry = next)
+		{
+			next = entry->next;
+			Mem_Free (entry);
+		}
+		table->buckets[i] = NULL;
+	}
+	table->count = 0;
+}
+
+/*
+================
+StrHash_Stats_f
+================
+*/
+static void StrHash_Stats_f (void)
+{
+	strhash_t *table;
+
+	Con_Printf ("table            entries buckets   lookups      hits  compares\n");
+	for (table = strhash_tables; table; table = table->next)
+		Con_Printf (
+			"%-16s %7i %7i %9u %9u %9u\n", table->name, table->count, table->numbuckets, Atomic_LoadUInt32 (&table->lookups),
+			Atomic_LoadUInt32 (&table->hits), Atomic_LoadUInt32 (&table->compares));
+}
+
 static size_t mz_zip_file_read_func (void *opaque, mz_uint64 ofs, void *buf, size_t n)
 {
 	if (SDL_RWseek ((SDL_RWops *)opaque, (Sint64)ofs, RW_SEEK_SET) < 0)
@@ -39,6 +39,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #endif /* _MSC_VER */
 #endif /* _WIN32 */
 
+#include "atomics.h"
+
 #undef min
 #undef max
 
@@ -233,6 +235,22 @@ char *va (const char *format, ...) FUNC_PRINTF (1, 2);
 
 unsigned COM_HashString (const char *str);
 
+typedef struct strhash_entry_s strhash_entry_t;
+typedef struct strhash_s
+{
+	const char        *name; // shown by hashstats
+	strhash_entry_t  **buckets;
+	int                numbuckets;
+	int                count;
+	atomic_uint32_t    lookups, hits, compares; // bumped by lookups under different locks
+	struct strhash_s  *next;
+} strhash_t;
+
+void  StrHash_Insert (strhash_t *table, const char *key, const void *owner, void *value);
+void *StrHash_Find (strhash_t *table, const char *key, const void *owner);
+void  StrHash_Remove (strhash_t *table, const char *key, const void *owner, void *value);
+void  StrHash_Clear (strhash_t *table);
+
 // localization support for 2021 rerelease version:
 void        LOC_Init (void);
 void        LOC_Shutdown (void);
@@ -43,6 +43,8 @@ qpic_t *Draw_PicFromWad (const char *name);
 qpic_t *Draw_CachePic (const char *path);
 qpic_t *Draw_TryCachePic (const char *path, unsigned int texflags);
 void    Draw_NewGame (void);
+void    Draw_Batch (cb_context_t *cbx, const RgRasterizedGeometryUploadInfo *info);
+void    Draw_Flush (cb_context_t *cbx);
 
 void GL_Viewport (cb_context_t *cbx, float x, float y, float width, float height, float min_depth, float max_depth);
 void GL_SetCanvas (cb_context_t *cbx, canvastype newcanvas); // johnfitz
@@ -92,8 +92,9 @@ typedef struct cachepic_s
 } cachepic_t;
 
 #define MAX_CACHED_PICS 512 // Spike -- increased to avoid csqc issues.
-cachepic_t menu_cachepics[MAX_CACHED_PICS];
-int        menu_numcachepics;
+cachepic_t       menu_cachepics[MAX_CACHED_PICS];
+int              menu_numcachepics;
+static strhash_t menu_cachepics_hash = {"cachepics"};
 
 byte menuplyr_pixels[4096];
 
@@ -195,13 +196,12 @@ qpic_t *Draw_PicFromWad2 (const char *name, unsigned int texflags)
 	lumpinfo_t  *info;
 
 	// Spike -- added cachepic stuff here, to avoid glitches if the function is called multiple times with the same image.
-	for (pic = menu_cachepics, i = 0; i < menu_numcachepics; pic++, i++)
-	{
-		if (!strcmp (name, pic->name))
-			return &pic->pic;
-	}
+	pic = (cachepic_t *)StrHash_Find (&menu_cachepics_hash, name, NULL);
+	if (pic)
+		return &pic->pic;
 	if (menu_numcachepics == MAX_CACHED_PICS)
 		Sys_Error ("menu_numcachepics == MAX_CACHED_PICS");
+	pic = &menu_cachepics[menu_numcachepics];
 
 	p = (qpic_t *)W_GetLumpName (name, &info);
 	if (!p)
@@ -258,6 +258,7 @@ qpic_t *Draw_PicFromWad2 (const char *name, unsigned int texflags)
 
 	menu_numcachepics++;
 	strcpy (pic->name, name);
+	StrHash_Insert (&menu_cachepics_hash, pic->name, NULL, pic);
 	pic->pic = *p;
 	memcpy (pic->pic.data, &gl, sizeof (glpic_t));
 
@@ -271,15 +272,8 @@ qpic_t *Draw_PicFromWad (const char *name)
 
 qpic_t *Draw_GetCachedPic (const char *path)
 {
-	cachepic_t *pic;
-	int         i;
-
-	for (pic = menu_cachepics, i = 0; i < menu_numcachepics; pic++, i++)
-	{
-		if (!strcmp (path, pic->name))
-			return &pic->pic;
-	}
-	return NULL;
+	cachepic_t *pic = (cachepic_t *)StrHash_Find (&menu_cachepics_hash, path, NULL);
+	return pic ? &pic->pic : NULL;
 }
 
 /*
@@ -290,17 +284,15 @@ Draw_CachePic
 qpic_t *Draw_TryCachePic (const char *path, unsigned int texflags)
 {
 	cachepic_t *pic;
-	int         i;
 	qpic_t     *dat;
 	glpic_t     gl;
 
-	for (pic = menu_cachepics, i = 0; i < menu_numcachepics; pic++, i++)
-	{
-		if (!strcmp (path, pic->name))
-			return &pic->pic;
-	}
+	pic = (cachepic_t *)StrHash_Find (&menu_cachepics_hash, path, NULL);
+	if (pic)
+		return &pic->pic;
 	if (menu_numcachepics == MAX_CACHED_PICS)
 		Sys_Error ("menu_numcachepics == MAX_CACHED_PICS");
+	pic = &menu_cachepics[menu_numcachepics];
 
 	//
 	// load the pic from disk
@@ -312,6 +304,7 @@ qpic_t *Draw_TryCachePic (const char *path, unsigned int texflags)
 
 	menu_numcachepics++;
 	strcpy (pic->name, path);
+	StrHash_Insert (&menu_cachepics_hash, pic->name, NULL, pic);
 
 	// HACK HACK HACK --- we need to keep the bytes for
 	// the translatable player picture just for the menu
@@ -418,6 +411,7 @@ void Draw_NewGame (void)
 	for (pic = menu_cachepics, i = 0; i < menu_numcachepics; pic++, i++)
 		pic->name[0] = 0;
 	menu_numcachepics = 0;
+	StrHash_Clear (&menu_cachepics_hash);
 
 	// reload wad pics
 	W_LoadWadFile (); // johnfitz -- filename is now hard-coded for honesty
@@ -457,6 +451,81 @@ void Draw_Init (void)
 //
 //==============================================================================
 
+/*
+================
+Draw_Flush
+
+Uploads the 2D geometry batched on cbx. Called whenever the batch state,
+the canvas or the viewport changes, and at the end of the frame.
+================
+*/
+void Draw_Flush (cb_context_t *cbx)
+{
+	draw2d_batch_t *batch = &cbx->draw2d;
+
+	if (!batch->numverts)
+		return;
+
+	batch->info.vertexCount = batch->numverts;
+	batch->info.pVertices = batch->verts;
+
+	RgResult r = rgUploadRasterizedGeometry (vulkan_globals.instance, &batch->info, cbx->cur_viewprojection, &cbx->cur_viewport);
+	RG_CHECK (r);
+
+	batch->numverts = 0;
+	Atomic_IncrementUInt32 (&rs_2dbatches);
+}
+
+/*
+================
+Draw_SameBatchState
+================
+*/
+static qboolean Draw_SameBatchState (const RgRasterizedGeometryUploadInfo *a, const RgRasterizedGeometryUploadInfo *b)
+{
+	return a->renderType == b->renderType && a->material == b->material && a->pipelineState == b->pipelineState &&
+	       a->blendFuncSrc == b->blendFuncSrc && a->blendFuncDst == b->blendFuncDst && !memcmp (a->color, b->color, sizeof (a->color)) &&
+	       !memcmp (&a->transform, &b->transform, sizeof (a->transform));
+}
+
+/*
+================
+Draw_Batch
+
+Appends the non-indexed triangles in info to the batch of cbx, flushing
+first if their state differs from what is pending
+================
+*/
+void Draw_Batch (cb_context_t *cbx, const RgRasterizedGeometryUploadInfo *info)
+{
+	draw2d_batch_t *batch = &cbx->draw2d;
+
+	if (!info->vertexCount)
+		return;
+
+	Atomic_AddUInt32 (&rs_2dquads, info->vertexCount / 6);
+
+	if (batch->numverts &&
+	    (batch->numverts + (int)info->vertexCount > MAX_DRAW2D_VERTS || info->indexCount || !Draw_SameBatchState (&batch->info, info)))
+		Draw_Flush (cbx);
+
+	if (info->vertexCount > MAX_DRAW2D_VERTS || info->indexCount)
+	{
+		RgResult r = rgUploadRasterizedGeometry (vulkan_globals.instance, info, cbx->cur_viewprojection, &cbx->cur_viewport);
+		RG_CHECK (r);
+		Atomic_IncrementUInt32 (&rs_2dbatches);
+		return;
+	}
+
+	if (!batch->verts)
+		batch->verts = (RgVertex *)Mem_Alloc (MAX_DRAW2D_VERTS * sizeof (RgVertex));
+	if (!batch->numverts)
+		batch->info = *info;
+
+	memcpy (batch->verts + batch->numverts, info->pVertices, info->vertexCount * sizeof (RgVertex));
+	batch->numverts += info->vertexCount;
+}
+
 /*
 ================
 Draw_FillCharacterQuad
@@ -552,8 +621,7 @@ void Draw_Character (cb_context_t *cbx, int x, int y, int num)
 		.blendFuncDst = 0,
 	};
 
-	RgResult r = rgUploadRasterizedGeometry (vulkan_globals.instance, &info, cbx->cur_viewprojection, &cbx->cur_viewport);
-	RG_CHECK (r);
+	Draw_Batch (cbx, &info);
 }
 
 /*
@@ -600,8 +668,7 @@ void Draw_String (cb_context_t *cbx, int x, int y, const char *str)
 		.blendFuncDst = 0,
 	};
 
-	RgResult r = rgUploadRasterizedGeometry (vulkan_globals.instance, &info, cbx->cur_viewprojection, &cbx->cur_viewport);
-	RG_CHECK (r);
+	Draw_Batch (cbx, &info);
 }
 
 /*
@@ -671,8 +738,7 @@ void Draw_Pic (cb_context_t *cbx, int x, int y, qpic_t *pic, float alpha, qboole
 		.blendFuncDst = alpha_blend ? RG_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA : 0,
 	};
 
-	RgResult r = rgUploadRasterizedGeometry (vulkan_globals.instance, &info, cbx->cur_viewprojection, &cbx->cur_viewport);
-	RG_CHECK (r);
+	Draw_Batch (cbx, &info);
 }
 
 void Draw_SubPic (cb_context_t *cbx, float x, float y, float w, float h, qpic_t *pic, float s1, float t1, float s2, float t2, float *rgb, float alpha)
@@ -745,8 +811,7 @@ void Draw_SubPic (cb_context_t *cbx, float x, float y, float w, float h, qpic_t
 		.blendFuncDst = alpha_blend ? RG_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA : 0,
 	};
 
-	RgResult r = rgUploadRasterizedGeometry (vulkan_globals.instance, &info, cbx->cur_viewprojection, &cbx->cur_viewport);
-	RG_CHECK (r);
+	Draw_Batch (cbx, &info);
 }
 
 /*
@@ -865,8 +930,7 @@ void Draw_TileClear (cb_context_t *cbx, int x, int y, int w, int h)
 		.blendFuncDst = RG_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
 	};
 
-	RgResult r = rgUploadRasterizedGeometry (vulkan_globals.instance, &info, cbx->cur_viewprojection, &cbx->cur_viewport);
-	RG_CHECK (r);
+	Draw_Batch (cbx, &info);
 }
 
 /*
@@ -928,8 +992,7 @@ void Draw_Fill (cb_context_t *cbx, int x, int y, int w, int h, int c, float alph
 		.blendFuncDst = RG_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
 	};
 
-	RgResult r = rgUploadRasterizedGeometry (vulkan_globals.instance, &info, cbx->cur_viewprojection, &cbx->cur_viewport);
-	RG_CHECK (r);
+	Draw_Batch (cbx, &info);
 }
 
 /*
@@ -985,8 +1048,7 @@ void Draw_FadeScreen (cb_context_t *cbx)
 		.blendFuncDst = RG_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
 	};
 
-	RgResult r = rgUploadRasterizedGeometry (vulkan_globals.instance, &info, cbx->cur_viewprojection, &cbx->cur_viewport);
-	RG_CHECK (r);
+	Draw_Batch (cbx, &info);
 }
 
 /*
@@ -1029,6 +1091,9 @@ GL_Viewport
 void GL_Viewport (cb_context_t *cbx, float x, float y, float width, float height, float min_depth, float max_depth)
 {
 	RgViewport viewport;
+
+	Draw_Flush (cbx);
+
 	viewport.x = x;
 	viewport.y = (float)vid.height - (y + height);
 	viewport.width = width;
@@ -1049,6 +1114,8 @@ void GL_SetCanvas (cb_context_t *cbx, canvastype newcanvas)
 	if (newcanvas == cbx->current_canvas)
 		return;
 
+	Draw_Flush (cbx);
+
 	float pad = CVAR_TO_INT32 (rt_hud_padding);
 
 	extern vrect_t scr_vrect;
@@ -287,7 +287,6 @@ void BuildTris (void)
 }
 
 static void GL_MakeAliasModelDisplayLists_VBO (void);
-static void GLMesh_LoadVertexBuffer (qmodel_t *m, const aliashdr_t *hdr);
 
 /*
 ================
@@ -465,7 +464,7 @@ Upload the given alias model's mesh to a VBO
 Original code by MH from RMQEngine
 ================
 */
-static void GLMesh_LoadVertexBuffer (qmodel_t *m, const aliashdr_t *hdr)
+void GLMesh_LoadVertexBuffer (qmodel_t *m, const aliashdr_t *hdr)
 {
     GLMesh_DeleteVertexBuffer (m);
 
@@ -28,11 +28,15 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 static void      Mod_LoadSpriteModel (qmodel_t *mod, void *buffer);
 static void      Mod_LoadBrushModel (qmodel_t *mod, const char *loadname, void *buffer);
-static void      Mod_LoadAliasModel (qmodel_t *mod, void *buffer);
+static void      Mod_LoadAliasModel (qmodel_t *mod, void *buffer, int buffersize);
 static qmodel_t *Mod_LoadModel (qmodel_t *mod, qboolean crash);
+static void      Mod_MapBenchmark_f (void);
 
 cvar_t external_ents = {"external_ents", "1", CVAR_ARCHIVE};
 cvar_t external_vis = {"external_vis", "1", CVAR_ARCHIVE};
+cvar_t mod_aliascache = {"mod_aliascache", "1", CVAR_ARCHIVE};
+cvar_t mod_parallelload = {"mod_parallelload", "1", CVAR_NONE};
+cvar_t mod_pvsbudget = {"mod_pvsbudget", "32", CVAR_ARCHIVE}; // megabytes of decompressed PVS rows per map
 
 static byte *mod_novis;
 static int   mod_novis_capacity;
@@ -40,15 +44,23 @@ static int   mod_novis_capacity;
 static byte *mod_decompressed;
 static int   mod_decompressed_capacity;
 
+#define VIS_READ_PADDING 8 // Mod_DecompressVisRow reads compressed rows a word at a time
+
 #define MAX_MOD_KNOWN 2048 /*johnfitz -- was 512 */
 qmodel_t mod_known[MAX_MOD_KNOWN];
 int      mod_numknown;
 
+static strhash_t mod_known_hash = {"models"};
+
 texture_t *r_notexture_mip;  // johnfitz -- moved here from r_main.c
 texture_t *r_notexture_mip2; // johnfitz -- used for non-lightmapped surfs with a missing texture
 
 SDL_mutex *lightcache_mutex;
 
+static SDL_mutex         *pvscache_mutex;
+static THREAD_LOCAL byte *pvscache_row; // this thread's copy of the last row from Mod_CachedPVS
+static THREAD_LOCAL int   pvscache_rowsize;
+
 extern cvar_t rt_brush_metal;
 extern cvar_t rt_brush_rough;
 extern cvar_t rt_model_metal;
@@ -100,6 +112,10 @@ void Mod_Init (void)
 {
 	Cvar_RegisterVariable (&external_vis);
 	Cvar_RegisterVariable (&external_ents);
+	Cvar_RegisterVariable (&mod_aliascache);
+	Cvar_RegisterVariable (&mod_parallelload);
+	Cvar_RegisterVariable (&mod_pvsbudget);
+	Cmd_AddCommand ("mapbench", Mod_MapBenchmark_f);
 
 	// johnfitz -- create notexture miptex
 	r_notexture_mip = (texture_t *)Mem_Alloc (sizeof (texture_t));
@@ -111,6 +127,7 @@ void Mod_Init (void)
 	r_notexture_mip2->height = r_notexture_mip2->width = 32;
 
 	lightcache_mutex = SDL_CreateMutex ();
+	pvscache_mutex = SDL_CreateMutex ();
 	// johnfitz
 }
 
@@ -157,6 +174,56 @@ mleaf_t *Mod_PointInLeaf (float *p, qmodel_t *model)
 	return NULL; // never reached
 }
 
+/*
+===================
+Mod_DecompressVisRow
+
+Expands one run-length encoded PVS row into out. Literal bytes are copied
+a word at a time until a zero byte shows up, zero runs are cleared with
+memset. The compressed data needs VIS_READ_PADDING readable bytes past its
+end for the word reads.
+===================
+*/
+static void Mod_DecompressVisRow (const byte *in, byte *out, int rowbytes)
+{
+	byte *outend = out + rowbytes;
+	int   c;
+
+	if (!in)
+	{ // no vis info, so make all visible
+		memset (out, 0xff, rowbytes);
+		return;
+	}
+
+	while (out < outend)
+	{
+		if (outend - out >= 8)
+		{
+			uint64_t v;
+			memcpy (&v, in, sizeof (v));
+			if (!((v - 0x0101010101010101ull) & ~v & 0x8080808080808080ull)) // no zero byte
+			{
+				memcpy (out, &v, sizeof (v));
+				in += 8;
+				out += 8;
+				continue;
+			}
+		}
+
+		if (*in)
+		{
+			*out++ = *in++;
+			continue;
+		}
+
+		// now that we're dynamically allocating pvs buffers, we have to be more careful to avoid heap overflows with buggy maps.
+		c = q_min (in[1], outend - out);
+		in += 2;
+		memset (out, 0, c);
+		out += c;
+	}
+}
+
 /*
 ===================
 Mod_DecompressVis
@@ -164,10 +231,7 @@ Mod_DecompressVis
 */
 byte *Mod_DecompressVis (byte *in, qmodel_t *model)
 {
-	int   c;
-	byte *out;
-	byte *outend;
-	int   row;
+	int row;
 
 	row = (model->numleafs + 31) / 8;
 	if (mod_decompressed == NULL || row > mod_decompressed_capacity)
@@ -177,50 +241,63 @@ byte *Mod_DecompressVis (byte *in, qmodel_t *model)
 		if (!mod_decompressed)
 			Sys_Error ("Mod_DecompressVis: realloc() failed on %d bytes", mod_decompressed_capacity);
 	}
-	out = mod_decompressed;
-	outend = mod_decompressed + row;
 
-	if (!in)
-	{ // no vis info, so make all visible
-		while (row)
-		{
-			*out++ = 0xff;
-			row--;
-		}
-		return mod_decompressed;
+	Mod_DecompressVisRow (in, mod_decompressed, row);
+	return mod_decompressed;
+}
+
+/*
+===================
+Mod_CachedPVS
+
+Returns the row for leafnum from the model's LRU, decompressing it into the
+least recently used slot on a miss. The server and the renderer's tasks share
+the LRU, so it's locked and the row is copied out: what's returned belongs to
+the calling thread and stays valid until its next call
+===================
+*/
+static byte *Mod_CachedPVS (qmodel_t *model, mleaf_t *leaf, int leafnum)
+{
+	pvscache_t *cache = model->pvscache;
+	int         slot;
+
+	if (pvscache_rowsize < model->pvsstride)
+	{
+		pvscache_rowsize = model->pvsstride;
+		pvscache_row = (byte *)Mem_Realloc (pvscache_row, pvscache_rowsize);
 	}
 
-	do
+	SDL_LockMutex (pvscache_mutex);
+	slot = cache->slotforleaf[leafnum];
+
+	if (slot < 0)
 	{
-		if (*in)
-		{
-			*out++ = *in++;
-			continue;
-		}
+		slot = cache->tail;
+		if (cache->leafforslot[slot] >= 0)
+			cache->slotforleaf[cache->leafforslot[slot]] = -1;
+		cache->leafforslot[slot] = leafnum;
+		cache->slotforleaf[leafnum] = slot;
+		Mod_DecompressVisRow (leaf->compressed_vis, cache->rows + (size_t)slot * model->pvsstride, (model->numleafs + 31) / 8);
+	}
 
-		c = in[1];
-		in += 2;
-		if (c > row - (out - mod_decompressed))
-			c = row -
-			    (out -
-			     mod_decompressed); // now that we're dynamically allocating pvs buffers, we have to be more careful to avoid heap overflows with buggy maps.
-		while (c)
-		{
-			if (out == outend)
-			{
-				if (!model->viswarn)
-				{
-					model->viswarn = true;
-					Con_Warning ("Mod_DecompressVis: output overrun on model \"%s\"\n", model->name);
-				}
-				return mod_decompressed;
-			}
-			*out++ = 0;
-			c--;
-		}
-	} while (out - mod_decompressed < row);
+	if (slot != cache->head)
+	{
+		// unlink
+		cache->next[cache->prev[slot]] = cache->next[slot];
+		if (slot == cache->tail)
+			cache->tail = cache->prev[slot];
+		else
+			cache->prev[cache->next[slot]] = cache->prev[slot];
+		// move to front
+		cache->prev[slot] = -1;
+		cache->next[slot] = cache->head;
+		cache->prev[cache->head] = slot;
+		cache->head = slot;
+	}
 
-	return mod_decompressed;
+	memcpy (pvscache_row, cache->rows + (size_t)slot * model->pvsstride, model->pvsstride);
+	SDL_UnlockMutex (pvscache_mutex);
+	return pvscache_row;
 }
 
 /*
@@ -230,11 +307,103 @@ Mod_LeafPVS
 */
 byte *Mod_LeafPVS (mleaf_t *leaf, qmodel_t *model)
 {
+	int leafnum;
+
 	if (leaf == model->leafs)
 		return Mod_NoVisPVS (model);
+
+	leafnum = leaf - model->leafs - 1;
+	if (leafnum < model->numleafs)
+	{
+		if (model->pvsmatrix)
+			return model->pvsmatrix + (size_t)leafnum * model->pvsstride;
+		if (model->pvscache)
+			return Mod_CachedPVS (model, leaf, leafnum);
+	}
 	return Mod_DecompressVis (leaf->compressed_vis, model);
 }
 
+typedef struct decompress_pvs_task_args_s
+{
+	qmodel_t *mod;
+} decompress_pvs_task_args_t;
+
+/*
+===================
+Mod_DecompressPVSTask
+===================
+*/
+static void Mod_DecompressPVSTask (int i, decompress_pvs_task_args_t *args)
+{
+	qmodel_t *mod = args->mod;
+	Mod_DecompressVisRow (mod->leafs[i + 1].compressed_vis, mod->pvsmatrix + (size_t)i * mod->pvsstride, (mod->numleafs + 31) / 8);
+}
+
+/*
+===================
+Mod_BuildPVSCache
+
+Decompresses the whole PVS up front if it fits in mod_pvsbudget, otherwise
+sets up an LRU of decompressed rows of that size. Must run after
+Mod_SetupSubmodels has trimmed numleafs to the world's visleafs.
+===================
+*/
+static void Mod_BuildPVSCache (qmodel_t *mod)
+{
+	const int    rowbytes = (mod->numleafs + 31) / 8;
+	const int    stride = (rowbytes + 15) & ~15;
+	const size_t budget = (size_t)(q_max (mod_pvsbudget.value, 0.0f) * 1024.0f * 1024.0f);
+	int          i;
+
+	if (!mod->visdata || !CVAR_TO_BOOL (rt_enable_pvs) || mod->numleafs <= 0 || budget < (size_t)stride)
+		return;
+
+	mod->pvsstride = stride;
+	if ((size_t)mod->numleafs * stride <= budget)
+	{
+		decompress_pvs_task_args_t args = {mod};
+
+		mod->pvsmatrix = (byte *)Mem_Alloc ((size_t)mod->numleafs * stride);
+		if (!Tasks_IsWorker () && (mod->numleafs > 1))
+		{
+			task_handle_t task =
+				Task_AllocateAssignIndexedFuncAndSubmit ((task_indexed_func_t)Mod_DecompressPVSTask, mod->numleafs, &args, sizeof (args));
+			Task_Join (task, SDL_MUTEX_MAXWAIT);
+		}
+		else
+		{
+			for (i = 0; i < mod->numleafs; ++i)
+				Mod_DecompressPVSTask (i, &args);
+		}
+		Con_DPrintf ("%s: %d KB PVS matrix\n", mod->name, (int)(((size_t)mod->numleafs * stride) / 1024));
+	}
+	else
+	{
+		const int   numslots = budget / stride;
+		const int   numints = mod->numleafs + 3 * numslots;
+		const int   rowsofs = (sizeof (pvscache_t) + numints * sizeof (int) + 15) & ~15;
+		pvscache_t *cache = (pvscache_t *)Mem_Alloc (rowsofs + (size_t)numslots * stride);
+
+		cache->slotforleaf = (int *)(cache + 1);
+		cache->leafforslot = cache->slotforleaf + mod->numleafs;
+		cache->prev = cache->leafforslot + numslots;
+		cache->next = cache->prev + numslots;
+		cache->rows = (byte *)cache + rowsofs;
+		for (i = 0; i < mod->numleafs; ++i)
+			cache->slotforleaf[i] = -1;
+		for (i = 0; i < numslots; ++i)
+		{
+			cache->leafforslot[i] = -1;
+			cache->prev[i] = i - 1;
+			cache->next[i] = (i + 1 < numslots) ? i + 1 : -1;
+		}
+		cache->head = 0;
+		cache->tail = numslots - 1;
+		mod->pvscache = cache;
+		Con_DPrintf ("%s: PVS cache of %d/%d rows\n", mod->name, numslots, mod->numleafs);
+	}
+}
+
 /*
 ===================
 Mod_NoVisPVS
@@ -327,6 +496,8 @@ static void Mod_FreeModelMemory (qmodel_t *mod)
 		SAFE_FREE (mod->textures);
 		mod->numtextures = 0;
 		SAFE_FREE (mod->visdata);
+		SAFE_FREE (mod->pvsmatrix);
+		SAFE_FREE (mod->pvscache);
 		SAFE_FREE (mod->lightdata);
 		SAFE_FREE (mod->entities);
 		SAFE_FREE (mod->extradata);
@@ -378,6 +549,7 @@ void Mod_ResetAll (void)
 		memset (mod, 0, sizeof (qmodel_t));
 	}
 	mod_numknown = 0;
+	StrHash_Clear (&mod_known_hash);
 
 	InvalidateTraceLineCache ();
 }
@@ -390,7 +562,6 @@ Mod_FindName
 */
 qmodel_t *Mod_FindName (const char *name)
 {
-	int       i;
 	qmodel_t *mod;
 
 	if (!name[0])
@@ -399,17 +570,16 @@ qmodel_t *Mod_FindName (const char *name)
 	//
 	// search the currently loaded models
 	//
-	for (i = 0, mod = mod_known; i < mod_numknown; i++, mod++)
-		if (!strcmp (mod->name, name))
-			break;
-
-	if (i == mod_numknown)
+	mod = (qmodel_t *)StrHash_Find (&mod_known_hash, name, NULL);
+	if (!mod)
 	{
 		if (mod_numknown == MAX_MOD_KNOWN)
 			Sys_Error ("mod_numknown == MAX_MOD_KNOWN");
+		mod = &mod_known[mod_numknown];
 		q_strlcpy (mod->name, name, MAX_QPATH);
 		mod->needload = true;
 		mod_numknown++;
+		StrHash_Insert (&mod_known_hash, mod->name, NULL, mod);
 		InvalidateTraceLineCache ();
 	}
 
@@ -474,7 +644,7 @@ static qmodel_t *Mod_LoadModel (qmodel_t *mod, qboolean crash)
 	switch (mod_type)
 	{
 	case IDPOLYHEADER:
-		Mod_LoadAliasModel (mod, buf);
+		Mod_LoadAliasModel (mod, buf, com_filesize);
 		break;
 
 	case IDSPRITEHEADER:
@@ -999,7 +1169,7 @@ static void Mod_LoadVisibility (qmodel_t *mod, byte *mod_base, lump_t *l)
 		mod->visdata = NULL;
 		return;
 	}
-	mod->visdata = (byte *)Mem_Alloc (l->filelen);
+	mod->visdata = (byte *)Mem_Alloc (l->filelen + VIS_READ_PADDING);
 	memcpy (mod->visdata, mod_base + l->fileofs, l->filelen);
 }
 
@@ -2340,7 +2510,7 @@ static byte *Mod_LoadVisibilityExternal (FILE *f)
 	if (filelen <= 0)
 		return NULL;
 	Con_DPrintf ("...%d bytes visibility data\n", filelen);
-	visdata = (byte *)Mem_Alloc (filelen);
+	visdata = (byte *)Mem_Alloc (filelen + VIS_READ_PADDING);
 	if (fread (visdata, filelen, 1, f) != 1)
 		return NULL;
 	return visdata;
@@ -2435,6 +2605,252 @@ static void Mod_SetupSubmodels (qmodel_t *mod)
 	}
 }
 
+/*
+=================
+Mod_WantsExternalVis
+=================
+*/
+static qboolean Mod_WantsExternalVis (qmodel_t *mod, const char *loadname)
+{
+	return mod->bspversion == BSPVERSION && external_vis.value && sv.modelname[0] && !q_strcasecmp (loadname, sv.name);
+}
+
+/*
+=================
+Mod_LoadExternalVis
+
+Replaces the vis and leaf lumps with a matching external .vis file if there is one
+=================
+*/
+static qboolean Mod_LoadExternalVis (qmodel_t *mod, const char *loadname)
+{
+	FILE *fvis;
+
+	if (!Mod_WantsExternalVis (mod, loadname))
+		return false;
+
+	Con_DPrintf ("trying to open external vis file\n");
+	fvis = Mod_FindVisibilityExternal (mod, loadname);
+	if (!fvis)
+		return false;
+
+	mod->leafs = NULL;
+	mod->numleafs = 0;
+	Con_DPrintf ("found valid external .vis file for map\n");
+	mod->visdata = Mod_LoadVisibilityExternal (fvis);
+	if (mod->visdata)
+	{
+		Mod_LoadLeafsExternal (mod, fvis);
+	}
+	fclose (fvis);
+	if (mod->visdata && mod->leafs && mod->numleafs)
+		return true;
+
+	Con_DPrintf ("External VIS data failed, using standard vis.\n");
+	return false;
+}
+
+typedef struct load_lump_task_args_s
+{
+	qmodel_t  *mod;
+	byte      *mod_base;
+	dheader_t *header;
+	int        bsp2;
+} load_lump_task_args_t;
+
+static void Mod_LoadVertexesTask (load_lump_task_args_t *args)
+{
+	Mod_LoadVertexes (args->mod, args->mod_base, &args->header->lumps[LUMP_VERTEXES]);
+}
+
+static void Mod_LoadEdgesTask (load_lump_task_args_t *args)
+{
+	Mod_LoadEdges (args->mod, args->mod_base, &args->header->lumps[LUMP_EDGES], args->bsp2);
+}
+
+static void Mod_LoadSurfedgesTask (load_lump_task_args_t *args)
+{
+	Mod_LoadSurfedges (args->mod, args->mod_base, &args->header->lumps[LUMP_SURFEDGES]);
+}
+
+static void Mod_LoadLightingTask (load_lump_task_args_t *args)
+{
+	Mod_LoadLighting (args->mod, args->mod_base, &args->header->lumps[LUMP_LIGHTING]);
+}
+
+static void Mod_LoadPlanesTask (load_lump_task_args_t *args)
+{
+	Mod_LoadPlanes (args->mod, args->mod_base, &args->header->lumps[LUMP_PLANES]);
+}
+
+static void Mod_LoadFacesTask (load_lump_task_args_t *args)
+{
+	Mod_LoadFaces (args->mod, args->mod_base, &args->header->lumps[LUMP_FACES], args->bsp2);
+}
+
+static void Mod_LoadMarksurfacesTask (load_lump_task_args_t *args)
+{
+	Mod_LoadMarksurfaces (args->mod, args->mod_base, &args->header->lumps[LUMP_MARKSURFACES], args->bsp2);
+}
+
+static void Mod_LoadVisibilityTask (load_lump_task_args_t *args)
+{
+	Mod_LoadVisibility (args->mod, args->mod_base, &args->header->lumps[LUMP_VISIBILITY]);
+}
+
+static void Mod_LoadLeafsTask (load_lump_task_args_t *args)
+{
+	Mod_LoadLeafs (args->mod, args->mod_base, &args->header->lumps[LUMP_LEAFS], args->bsp2);
+}
+
+static void Mod_LoadNodesTask (load_lump_task_args_t *args)
+{
+	Mod_LoadNodes (args->mod, args->mod_base, &args->header->lumps[LUMP_NODES], args->bsp2);
+}
+
+static void Mod_LoadClipnodesTask (load_lump_task_args_t *args)
+{
+	Mod_LoadClipnodes (args->mod, args->mod_base, &args->header->lumps[LUMP_CLIPNODES], args->bsp2);
+}
+
+static void Mod_LoadEntitiesTask (load_lump_task_args_t *args)
+{
+	Mod_LoadEntities (args->mod, args->mod_base, &args->header->lumps[LUMP_ENTITIES]);
+}
+
+static void Mod_LoadSubmodelsTask (load_lump_task_args_t *args)
+{
+	Mod_LoadSubmodels (args->mod, args->mod_base, &args->header->lumps[LUMP_MODELS]);
+}
+
+static void Mod_MakeHull0Task (load_lump_task_args_t *args)
+{
+	Mod_MakeHull0 (args->mod);
+}
+
+static void Mod_CheckWaterVisTask (load_lump_task_args_t *args)
+{
+	Mod_CheckWaterVis (args->mod);
+}
+
+/*
+=================
+Mod_LoadBrushLumpsSerial
+=================
+*/
+static void Mod_LoadBrushLumpsSerial (qmodel_t *mod, const char *loadname, byte *mod_base, dheader_t *header, int bsp2)
+{
+	Mod_LoadVertexes (mod, mod_base, &header->lumps[LUMP_VERTEXES]);
+	Mod_LoadEdges (mod, mod_base, &header->lumps[LUMP_EDGES], bsp2);
+	Mod_LoadSurfedges (mod, mod_base, &header->lumps[LUMP_SURFEDGES]);
+	Mod_LoadTextures (mod, mod_base, &header->lumps[LUMP_TEXTURES]);
+	Mod_LoadLighting (mod, mod_base, &header->lumps[LUMP_LIGHTING]);
+	Mod_LoadPlanes (mod, mod_base, &header->lumps[LUMP_PLANES]);
+	Mod_LoadTexinfo (mod, mod_base, &header->lumps[LUMP_TEXINFO]);
+	Mod_LoadFaces (mod, mod_base, &header->lumps[LUMP_FACES], bsp2);
+	Mod_LoadMarksurfaces (mod, mod_base, &header->lumps[LUMP_MARKSURFACES], bsp2);
+
+	if (!Mod_LoadExternalVis (mod, loadname))
+	{
+		Mod_LoadVisibility (mod, mod_base, &header->lumps[LUMP_VISIBILITY]);
+		Mod_LoadLeafs (mod, mod_base, &header->lumps[LUMP_LEAFS], bsp2);
+	}
+	Mod_LoadNodes (mod, mod_base, &header->lumps[LUMP_NODES], bsp2);
+	Mod_LoadClipnodes (mod, mod_base, &header->lumps[LUMP_CLIPNODES], bsp2);
+	Mod_LoadEntities (mod, mod_base, &header->lumps[LUMP_ENTITIES]);
+	Mod_LoadSubmodels (mod, mod_base, &header->lumps[LUMP_MODELS]);
+
+	Mod_MakeHull0 (mod);
+	Mod_CheckWaterVis (mod);
+}
+
+/*
+=================
+Mod_LoadBrushLumpsParallel
+
+Same work as Mod_LoadBrushLumpsSerial, expressed as a task graph so that
+independent lumps load on the workers. Textures and texinfo stay on the
+calling thread since Mod_LoadTextures spawns its own tasks. The .lit and
+.ent lookups go through the shared file handle table, so entities is
+chained after lighting.
+=================
+*/
+static void Mod_LoadBrushLumpsParallel (qmodel_t *mod, const char *loadname, byte *mod_base, dheader_t *header, int bsp2)
+{
+	load_lump_task_args_t args = {mod, mod_base, header, bsp2};
+	task_handle_t         vertexes, edges, surfedges, lighting, planes, clipnodes, entities, submodels;
+	task_handle_t         faces, marksurfaces, leafs, nodes, hull0, watervis;
+	task_handle_t         handles[8];
+	int                   numhandles = 0;
+
+	// lumps that only need the file contents
+	vertexes = Task_AllocateAndAssignFunc ((task_func_t)Mod_LoadVertexesTask, &args, sizeof (args));
+	edges = Task_AllocateAndAssignFunc ((task_func_t)Mod_LoadEdgesTask, &args, sizeof (args));
+	surfedges = Task_AllocateAndAssignFunc ((task_func_t)Mod_LoadSurfedgesTask, &args, sizeof (args));
+	lighting = Task_AllocateAndAssignFunc ((task_func_t)Mod_LoadLightingTask, &args, sizeof (args));
+	planes = Task_AllocateAndAssignFunc ((task_func_t)Mod_LoadPlanesTask, &args, sizeof (args));
+	clipnodes = Task_AllocateAndAssignFunc ((task_func_t)Mod_LoadClipnodesTask, &args, sizeof (args));
+	entities = Task_AllocateAndAssignFunc ((task_func_t)Mod_LoadEntitiesTask, &args, sizeof (args));
+	submodels = Task_AllocateAndAssignFunc ((task_func_t)Mod_LoadSubmodelsTask, &args, sizeof (args));
+	Task_AddDependency (planes, clipnodes);
+	Task_AddDependency (lighting, entities);
+	handles[numhandles++] = vertexes;
+	handles[numhandles++] = edges;
+	handles[numhandles++] = surfedges;
+	handles[numhandles++] = lighting;
+	handles[numhandles++] = planes;
+	handles[numhandles++] = clipnodes;
+	handles[numhandles++] = entities;
+	handles[numhandles++] = submodels;
+	Tasks_Submit (numhandles, handles);
+
+	Mod_LoadTextures (mod, mod_base, &header->lumps[LUMP_TEXTURES]);
+	Mod_LoadTexinfo (mod, mod_base, &header->lumps[LUMP_TEXINFO]);
+
+	faces = Task_AllocateAndAssignFunc ((task_func_t)Mod_LoadFacesTask, &args, sizeof (args));
+	Task_AddDependency (vertexes, faces);
+	Task_AddDependency (edges, faces);
+	Task_AddDependency (surfedges, faces);
+	Task_AddDependency (lighting, faces);
+	Task_AddDependency (planes, faces);
+	marksurfaces = Task_AllocateAndAssignFunc ((task_func_t)Mod_LoadMarksurfacesTask, &args, sizeof (args));
+	Task_AddDependency (faces, marksurfaces);
+	Task_Submit (faces);
+	Task_Submit (marksurfaces);
+
+	nodes = Task_AllocateAndAssignFunc ((task_func_t)Mod_LoadNodesTask, &args, sizeof (args));
+	watervis = Task_AllocateAndAssignFunc ((task_func_t)Mod_CheckWaterVisTask, &args, sizeof (args));
+	Task_AddDependency (planes, nodes);
+	Task_AddDependency (faces, watervis);
+	Task_AddDependency (submodels, watervis);
+
+	// the external leafs point into marksurfaces, so that has to be done first
+	if (Mod_WantsExternalVis (mod, loadname))
+		Task_Join (marksurfaces, SDL_MUTEX_MAXWAIT);
+	if (!Mod_LoadExternalVis (mod, loadname))
+	{
+		task_handle_t visibility = Task_AllocateAndAssignFunc ((task_func_t)Mod_LoadVisibilityTask, &args, sizeof (args));
+		leafs = Task_AllocateAndAssignFunc ((task_func_t)Mod_LoadLeafsTask, &args, sizeof (args));
+		Task_AddDependency (visibility, leafs);
+		Task_AddDependency (marksurfaces, leafs);
+		Task_AddDependency (leafs, nodes);
+		Task_AddDependency (leafs, watervis);
+		Task_Submit (visibility);
+		Task_Submit (leafs);
+	}
+
+	hull0 = Task_AllocateAndAssignFunc ((task_func_t)Mod_MakeHull0Task, &args, sizeof (args));
+	Task_AddDependency (nodes, hull0);
+	Task_Submit (nodes);
+	Task_Submit (hull0);
+	Task_Submit (watervis);
+
+	Task_Join (hull0, SDL_MUTEX_MAXWAIT);
+	Task_Join (watervis, SDL_MUTEX_MAXWAIT);
+	Task_Join (clipnodes, SDL_MUTEX_MAXWAIT);
+	Task_Join (entities, SDL_MUTEX_MAXWAIT);
+}
+
 /*
 =================
 Mod_LoadBrushModel
@@ -2478,55 +2894,100 @@ static void Mod_LoadBrushModel (qmodel_t *mod, const char *loadname, void *buffe
 		((int *)header)[i] = LittleLong (((int *)header)[i]);
 
 	// load into heap
+	if (mod_parallelload.value && !Tasks_IsWorker ())
+		Mod_LoadBrushLumpsParallel (mod, loadname, mod_base, header, bsp2);
+	else
+		Mod_LoadBrushLumpsSerial (mod, loadname, mod_base, header, bsp2);
 
-	Mod_LoadVertexes (mod, mod_base, &header->lumps[LUMP_VERTEXES]);
-	Mod_LoadEdges (mod, mod_base, &header->lumps[LUMP_EDGES], bsp2);
-	Mod_LoadSurfedges (mod, mod_base, &header->lumps[LUMP_SURFEDGES]);
-	Mod_LoadTextures (mod, mod_base, &header->lumps[LUMP_TEXTURES]);
-	Mod_LoadLighting (mod, mod_base, &header->lumps[LUMP_LIGHTING]);
-	Mod_LoadPlanes (mod, mod_base, &header->lumps[LUMP_PLANES]);
-	Mod_LoadTexinfo (mod, mod_base, &header->lumps[LUMP_TEXINFO]);
-	Mod_LoadFaces (mod, mod_base, &header->lumps[LUMP_FACES], bsp2);
-	Mod_LoadMarksurfaces (mod, mod_base, &header->lumps[LUMP_MARKSURFACES], bsp2);
+	mod->numframes = 2; // regular and alternate animation
+
+	Mod_SetupSubmodels (mod);
+	Mod_BuildPVSCache (mod);
+}
 
-	if (mod->bspversion == BSPVERSION && external_vis.value && sv.modelname[0] && !q_strcasecmp (loadname, sv.name))
+/*
+=================
+Mod_MapBenchmark_f
+
+mapbench <map> [map ...]
+
+Loads each map several times with mod_parallelload off and on and reports
+the brush model load times. Only usable while disconnected, since loading
+replaces the inline submodels.
+=================
+*/
+#define MAPBENCH_PASSES 3
+static void Mod_MapBenchmark_f (void)
+{
+	int   i, mode, pass;
+	float parallelload = mod_parallelload.value;
+
+	if (Cmd_Argc () < 2)
+	{
+		Con_Printf ("mapbench <map> [map ...] : time brush model loading\n");
+		return;
+	}
+	if (sv.active || cls.state == ca_connected)
 	{
-		FILE *fvis;
-		Con_DPrintf ("trying to open external vis file\n");
-		fvis = Mod_FindVisibilityExternal (mod, loadname);
-		if (fvis)
+		Con_Printf ("mapbench: disconnect first\n");
+		return;
+	}
+
+	for (i = 1; i < Cmd_Argc (); i++)
+	{
+		char         filename[MAX_QPATH];
+		char         loadname[MAX_QPATH];
+		byte        *buf;
+		int          bufsize, bspversion = 0;
+		unsigned int path_id;
+		double       times[2] = {0.0, 0.0};
+
+		q_snprintf (filename, sizeof (filename), "maps/%s", Cmd_Argv (i));
+		COM_AddExtension (filename, ".bsp", sizeof (filename));
+		buf = COM_LoadFile (filename, &path_id);
+		if (!buf)
 		{
-			mod->leafs = NULL;
-			mod->numleafs = 0;
-			Con_DPrintf ("found valid external .vis file for map\n");
-			mod->visdata = Mod_LoadVisibilityExternal (fvis);
-			if (mod->visdata)
-			{
-				Mod_LoadLeafsExternal (mod, fvis);
-			}
-			fclose (fvis);
-			if (mod->visdata && mod->leafs && mod->numleafs)
+			Con_Printf ("mapbench: %s not found\n", filename);
+			continue;
+		}
+		bufsize = com_filesize;
+		COM_FileBase (filename, loadname, sizeof (loadname));
+
+		for (mode = 0; mode < 2; mode++)
+		{
+			Cvar_SetValueQuick (&mod_parallelload, mode);
+			for (pass = 0; pass < MAPBENCH_PASSES; pass++)
 			{
-				goto visdone;
+				qmodel_t *mod = (qmodel_t *)Mem_Alloc (sizeof (qmodel_t));
+				byte     *copy = (byte *)Mem_Alloc (bufsize);
+				double    start;
+
+				memcpy (copy, buf, bufsize);
+				q_strlcpy (mod->name, filename, sizeof (mod->name));
+				mod->path_id = path_id;
+
+				start = Sys_DoubleTime ();
+				Mod_LoadBrushModel (mod, loadname, copy);
+				times[mode] += Sys_DoubleTime () - start;
+
+				bspversion = mod->bspversion;
+				Mod_FreeModelMemory (mod);
+				Mem_Free (copy);
+				Mem_Free (mod);
 			}
-			Con_DPrintf ("External VIS data failed, using standard vis.\n");
 		}
-	}
 
-	Mod_LoadVisibility (mod, mod_base, &header->lumps[LUMP_VISIBILITY]);
-	Mod_LoadLeafs (mod, mod_base, &header->lumps[LUMP_LEAFS], bsp2);
-visdone:
-	Mod_LoadNodes (mod, mod_base, &header->lumps[LUMP_NODES], bsp2);
-	Mod_LoadClipnodes (mod, mod_base, &header->lumps[LUMP_CLIPNODES], bsp2);
-	Mod_LoadEntities (mod, mod_base, &header->lumps[LUMP_ENTITIES]);
-	Mod_LoadSubmodels (mod, mod_base, &header->lumps[LUMP_MODELS]);
+		Con_Printf (
+			"%-24s %s  serial %7.1f ms  parallel %7.1f ms  (%.2fx)\n", loadname,
+			(bspversion == BSP2VERSION_BSP2 || bspversion == BSP2VERSION_2PSB) ? "bsp2" : "bsp ", times[0] * 1000.0 / MAPBENCH_PASSES,
+			times[1] * 1000.0 / MAPBENCH_PASSES, times[1] > 0.0 ? times[0] / times[1] : 0.0);
+		Mem_Free (buf);
+	}
 
-	Mod_MakeHull0 (mod);
+	Cvar_SetValueQuick (&mod_parallelload, parallelload);
 
-	mod->numframes = 2; // regular and alternate animation
-
-	Mod_CheckWaterVis (mod);
-	Mod_SetupSubmodels (mod);
+	// the inline submodels now point at freed memory
+	Mod_ClearAll ();
 }
 
 /*
@@ -2728,6 +3189,7 @@ typedef struct load_skin_task_args_s
 	qmodel_t *mod;
 	byte     *mod_base;
 	byte    **ppskintypes;
+	qboolean  floodfill; // false if the skins were already filled by the alias cache
 } load_skin_task_args_t;
 
 static void Mod_LoadSkinTask (int i, load_skin_task_args_t *args)
@@ -2756,7 +3218,8 @@ static void Mod_LoadSkinTask (int i, load_skin_task_args_t *args)
 	if (ReadLongUnaligned (pskintype + offsetof (daliasskintype_t, type)) == ALIAS_SKIN_SINGLE)
 	{
 		skin = pskintype + sizeof (daliasskintype_t);
-		Mod_FloodFillSkin (skin, pheader->skinwidth, pheader->skinheight);
+		if (args->floodfill)
+			Mod_FloodFillSkin (skin, pheader->skinwidth, pheader->skinheight);
 
 		// save 8 bit texels for the player model to remap
 		texels = (byte *)Mem_Alloc (size);
@@ -2805,7 +3268,8 @@ static void Mod_LoadSkinTask (int i, load_skin_task_args_t *args)
 
 		for (j = 0; j < groupskins; j++)
 		{
-			Mod_FloodFillSkin (skin, pheader->skinwidth, pheader->skinheight);
+			if (args->floodfill)
+				Mod_FloodFillSkin (skin, pheader->skinwidth, pheader->skinheight);
 			if (j == 0)
 			{
 				texels = (byte *)Mem_Alloc (size);
@@ -2855,7 +3319,7 @@ static void Mod_LoadSkinTask (int i, load_skin_task_args_t *args)
 Mod_LoadAllSkins
 ===============
 */
-void *Mod_LoadAllSkins (qmodel_t *mod, byte *mod_base, int numskins, byte *pskintype)
+void *Mod_LoadAllSkins (qmodel_t *mod, byte *mod_base, int numskins, byte *pskintype, qboolean floodfill)
 {
 	if (numskins < 1 || numskins > MAX_SKINS)
 		Sys_Error ("Mod_LoadAliasModel: Invalid # of skins: %d", numskins);
@@ -2885,6 +3349,7 @@ void *Mod_LoadAllSkins (qmodel_t *mod, byte *mod_base, int numskins, byte *pskin
 		.mod = mod,
 		.mod_base = mod_base,
 		.ppskintypes = ppskintypes,
+		.floodfill = floodfill,
 	};
 	if (!Tasks_IsWorker () && (numskins > 1))
 	{
@@ -3018,26 +3483,276 @@ void Mod_SetExtraFlags (qmodel_t *mod)
 #endif
 }
 
+//=========================================================================
+//
+// ALIAS MODEL CACHE
+//
+// The triangle strips, vbo mesh, bounds and flood filled skins of an alias
+// model only depend on the .mdl contents, so they are written to
+// <gamedir>/cache/<model>.cache after the first load and read back with a
+// single read on subsequent runs. The source checksum guards against stale
+// entries, the struct sizes against caches written by a different build.
+//
+//=========================================================================
+
+#define ALIASCACHE_IDENT   (('C' << 24) + ('A' << 16) + ('K' << 8) + 'V')
+#define ALIASCACHE_VERSION 1
+#define ALIASCACHE_ALIGN(x) (((x) + 15) & ~15)
+
+typedef struct
+{
+	int      ident;
+	int      version;
+	int      structsizes[4]; // aliashdr_t, maliasframedesc_t, aliasmesh_t, RgVertex
+	int      srcsize;        // size of the .mdl
+	unsigned srcchecksum;    // Com_BlockChecksum of the .mdl
+	int      size;           // payload size, the payload starts with the aliashdr_t
+	unsigned checksum;       // Com_BlockChecksum of the payload
+	int      skins;          // flood filled skin data, copied back over the .mdl
+	int      skinssize;
+	int      rtindices; // 0 if the mesh was not built (dedicated server)
+	int      rtvertices;
+	int      synctype;
+	vec3_t   mins, maxs;
+	vec3_t   ymins, ymaxs;
+	vec3_t   rmins, rmaxs;
+} aliascache_t;
+
+static void Mod_AliasCachePath (qmodel_t *mod, char *path, size_t pathsize)
+{
+	q_snprintf (path, pathsize, "%s/cache/%s.cache", com_gamedir, mod->name);
+}
+
+static void Mod_AliasCacheStructSizes (int structsizes[4])
+{
+	structsizes[0] = sizeof (aliashdr_t);
+	structsizes[1] = sizeof (maliasframedesc_t);
+	structsizes[2] = sizeof (aliasmesh_t);
+	structsizes[3] = sizeof (RgVertex);
+}
+
 /*
 =================
-Mod_LoadAliasModel
+Mod_LoadAliasCache
+
+Returns true if the model was set up from the cache
 =================
 */
-static void Mod_LoadAliasModel (qmodel_t *mod, void *buffer)
+static qboolean Mod_LoadAliasCache (qmodel_t *mod, byte *mod_base, int buffersize, unsigned srcchecksum)
 {
-	int   i, j;
-	byte *pinstverts;
-	byte *pintriangles;
-	int   version, numframes;
-	int   size;
-	byte *pframetype;
-	byte *pskintype;
-	byte *mod_base = (byte *)buffer; // johnfitz
+	char         path[MAX_OSPATH];
+	aliascache_t cache;
+	int          handle, filesize;
+	int          structsizes[4];
+	byte        *payload;
+	aliashdr_t  *hdr;
+
+	Mod_AliasCachePath (mod, path, sizeof (path));
+	filesize = Sys_FileOpenRead (path, &handle);
+	if (filesize < (int)sizeof (cache))
+	{
+		if (filesize >= 0)
+			Sys_FileClose (handle);
+		return false;
+	}
+
+	Mod_AliasCacheStructSizes (structsizes);
+	if (Sys_FileRead (handle, &cache, sizeof (cache)) != sizeof (cache) || cache.ident != ALIASCACHE_IDENT || cache.version != ALIASCACHE_VERSION ||
+		memcmp (cache.structsizes, structsizes, sizeof (structsizes)) || cache.srcsize != buffersize || cache.srcchecksum != srcchecksum ||
+		cache.size != filesize - (int)sizeof (cache) || cache.size < (int)sizeof (aliashdr_t) || cache.skins < (int)sizeof (aliashdr_t) || cache.skinssize < 0 ||
+		cache.skins + cache.skinssize > cache.size || cache.skinssize > buffersize - (int)sizeof (mdl_t))
+	{
+		Sys_FileClose (handle);
+		Con_DPrintf ("%s: alias cache is stale\n", mod->name);
+		return false;
+	}
+
+	payload = (byte *)Mem_Alloc (cache.size);
+	if (Sys_FileRead (handle, payload, cache.size) != cache.size || Com_BlockChecksum (payload, cache.size) != cache.checksum)
+	{
+		Sys_FileClose (handle);
+		Mem_Free (payload);
+		Con_DPrintf ("%s: alias cache is corrupt\n", mod->name);
+		return false;
+	}
+	Sys_FileClose (handle);
+
+	hdr = (aliashdr_t *)payload;
+	if (hdr->numskins < 1 || hdr->numskins > MAX_SKINS || hdr->numframes < 1 ||
+		cache.skins < (int)(sizeof (aliashdr_t) + (hdr->numframes - 1) * sizeof (hdr->frames[0])))
+	{
+		Mem_Free (payload);
+		return false;
+	}
+
+	pheader = hdr;
+	mod->flags = ReadLongUnaligned (mod_base + offsetof (mdl_t, flags));
+	mod->synctype = (synctype_t)cache.synctype;
+	mod->numframes = hdr->numframes;
+	VectorCopy (cache.mins, mod->mins);
+	VectorCopy (cache.maxs, mod->maxs);
+	VectorCopy (cache.ymins, mod->ymins);
+	VectorCopy (cache.ymaxs, mod->ymaxs);
+	VectorCopy (cache.rmins, mod->rmins);
+	VectorCopy (cache.rmaxs, mod->rmaxs);
+
+	// the textures still have to be created, but from the already filled skins
+	memcpy (mod_base + sizeof (mdl_t), payload + cache.skins, cache.skinssize);
+	Mod_LoadAllSkins (mod, mod_base, hdr->numskins, mod_base + sizeof (mdl_t), false);
+
+	mod->type = mod_alias;
+
+	Mod_SetExtraFlags (mod); // johnfitz
+
+	if (!isDedicated)
+	{
+		if (cache.rtindices && cache.rtvertices)
+		{
+			SAFE_FREE (mod->rtindices);
+			SAFE_FREE (mod->rtvertices);
+			mod->rtindices = Mem_Alloc (hdr->numindexes * sizeof (uint32_t));
+			memcpy (mod->rtindices, payload + cache.rtindices, hdr->numindexes * sizeof (uint32_t));
+			mod->rtvertices = Mem_Alloc (hdr->numposes * hdr->numverts_vbo * sizeof (RgVertex));
+			memcpy (mod->rtvertices, payload + cache.rtvertices, hdr->numposes * hdr->numverts_vbo * sizeof (RgVertex));
+		}
+		else
+			GLMesh_LoadVertexBuffer (mod, hdr);
+	}
+
+	// the skins and the RT geometry are last and have been copied out, keep one copy
+	payload = (byte *)Mem_Realloc (payload, cache.skins);
+	pheader = (aliashdr_t *)payload;
+	mod->extradata = payload;
+	return true;
+}
+
+/*
+=================
+Mod_WriteAliasCache
+=================
+*/
+static void Mod_WriteAliasCache (qmodel_t *mod, byte *mod_base, byte *skinsend, unsigned srcchecksum, int buffersize)
+{
+	char         path[MAX_OSPATH];
+	aliascache_t cache;
+	int          handle;
+	int          hdrsize, numcommands, count;
+	int          commandsofs, posedataofs, vertexesofs, indexesofs, meshdescofs;
+	const int   *cmds;
+	byte        *payload;
+	aliashdr_t  *hdr;
+
+	// the command list is terminated by a zero count
+	cmds = (const int *)((byte *)pheader + pheader->commands);
+	for (numcommands = 0; (count = cmds[numcommands]) != 0;)
+		numcommands += 1 + 2 * abs (count);
+	numcommands++;
+
+	memset (&cache, 0, sizeof (cache));
+	cache.ident = ALIASCACHE_IDENT;
+	cache.version = ALIASCACHE_VERSION;
+	Mod_AliasCacheStructSizes (cache.structsizes);
+	cache.srcsize = buffersize;
+	cache.srcchecksum = srcchecksum;
+	cache.synctype = mod->synctype;
+	VectorCopy (mod->mins, cache.mins);
+	VectorCopy (mod->maxs, cache.maxs);
+	VectorCopy (mod->ymins, cache.ymins);
+	VectorCopy (mod->ymaxs, cache.ymaxs);
+	VectorCopy (mod->rmins, cache.rmins);
+	VectorCopy (mod->rmaxs, cache.rmaxs);
+
+	hdrsize = sizeof (aliashdr_t) + (pheader->numframes - 1) * sizeof (pheader->frames[0]);
+	cache.size = ALIASCACHE_ALIGN (hdrsize);
+	commandsofs = cache.size;
+	cache.size += ALIASCACHE_ALIGN (numcommands * sizeof (int));
+	posedataofs = cache.size;
+	cache.size += ALIASCACHE_ALIGN (pheader->numposes * pheader->poseverts * sizeof (trivertx_t));
+	vertexesofs = cache.size;
+	cache.size += ALIASCACHE_ALIGN (pheader->numposes * pheader->numverts * sizeof (trivertx_t));
+	indexesofs = cache.size;
+	cache.size += ALIASCACHE_ALIGN (pheader->numindexes * sizeof (unsigned short));
+	meshdescofs = cache.size;
+	cache.size += ALIASCACHE_ALIGN (pheader->numverts_vbo * sizeof (aliasmesh_t));
+	cache.skins = cache.size;
+	cache.skinssize = skinsend - (mod_base + sizeof (mdl_t));
+	cache.size += ALIASCACHE_ALIGN (cache.skinssize);
+	if (mod->rtindices && mod->rtvertices)
+	{
+		cache.rtindices = cache.size;
+		cache.size += ALIASCACHE_ALIGN (pheader->numindexes * sizeof (uint32_t));
+		cache.rtvertices = cache.size;
+		cache.size += pheader->numposes * pheader->numverts_vbo * sizeof (RgVertex);
+	}
+
+	payload = (byte *)Mem_Alloc (cache.size);
+	hdr = (aliashdr_t *)payload;
+	memcpy (hdr, pheader, hdrsize);
+	memset (hdr->gltextures, 0, sizeof (hdr->gltextures));
+	memset (hdr->fbtextures, 0, sizeof (hdr->fbtextures));
+	memset (hdr->texels, 0, sizeof (hdr->texels));
+	hdr->commands = commandsofs;
+	hdr->posedata = posedataofs;
+	hdr->vertexes = vertexesofs;
+	hdr->indexes = indexesofs;
+	hdr->meshdesc = meshdescofs;
+	memcpy (payload + commandsofs, cmds, numcommands * sizeof (int));
+	memcpy (payload + posedataofs, (byte *)pheader + pheader->posedata, pheader->numposes * pheader->poseverts * sizeof (trivertx_t));
+	memcpy (payload + vertexesofs, (byte *)pheader + pheader->vertexes, pheader->numposes * pheader->numverts * sizeof (trivertx_t));
+	memcpy (payload + indexesofs, (byte *)pheader + pheader->indexes, pheader->numindexes * sizeof (unsigned short));
+	memcpy (payload + meshdescofs, (byte *)pheader + pheader->meshdesc, pheader->numverts_vbo * sizeof (aliasmesh_t));
+	memcpy (payload + cache.skins, mod_base + sizeof (mdl_t), cache.skinssize);
+	if (cache.rtindices)
+	{
+		memcpy (payload + cache.rtindices, mod->rtindices, pheader->numindexes * sizeof (uint32_t));
+		memcpy (payload + cache.rtvertices, mod->rtvertices, pheader->numposes * pheader->numverts_vbo * sizeof (RgVertex));
+	}
+	cache.checksum = Com_BlockChecksum (payload, cache.size);
+
+	Mod_AliasCachePath (mod, path, sizeof (path));
+	COM_CreatePath (path);
+	handle = Sys_FileOpenWrite (path);
+	if (handle != -1)
+	{
+		Sys_FileWrite (handle, &cache, sizeof (cache));
+		Sys_FileWrite (handle, payload, cache.size);
+		Sys_FileClose (handle);
+	}
+	else
+		Con_DPrintf ("Couldn't write alias cache %s\n", path);
+
+	Mem_Free (payload);
+}
+
+/*
+=================
+Mod_LoadAliasModel
+=================
+*/
+static void Mod_LoadAliasModel (qmodel_t *mod, void *buffer, int buffersize)
+{
+	int      i, j;
+	byte    *pinstverts;
+	byte    *pintriangles;
+	int      version, numframes;
+	int      size;
+	byte    *pframetype;
+	byte    *pskintype;
+	byte    *mod_base = (byte *)buffer; // johnfitz
+	unsigned srcchecksum = 0;
 
 	version = ReadLongUnaligned (mod_base + offsetof (mdl_t, version));
 	if (version != ALIAS_VERSION)
 		Sys_Error ("%s has wrong version number (%i should be %i)", mod->name, version, ALIAS_VERSION);
 
+	if (mod_aliascache.value)
+	{
+		// checksum before the skins get flood filled in place
+		srcchecksum = Com_BlockChecksum (buffer, buffersize);
+		if (Mod_LoadAliasCache (mod, mod_base, buffersize, srcchecksum))
+			return;
+	}
+
 	//
 	// allocate space for a working header, plus all the data except the frames,
 	// skin and group info
@@ -3094,7 +3809,7 @@ static void Mod_LoadAliasModel (qmodel_t *mod, void *buffer)
 	// load the skins
 	//
 	pskintype = mod_base + sizeof (mdl_t);
-	pskintype = Mod_LoadAllSkins (mod, mod_base, pheader->numskins, pskintype);
+	pskintype = Mod_LoadAllSkins (mod, mod_base, pheader->numskins, pskintype, true);
 
 	//
 	// load base s and t vertices
@@ -3158,6 +3873,9 @@ static void Mod_LoadAliasModel (qmodel_t *mod, void *buffer)
 	// move the complete, relocatable alias model to the cache
 	//
 	mod->extradata = (byte *)pheader;
+
+	if (mod_aliascache.value)
+		Mod_WriteAliasCache (mod, mod_base, pskintype, srcchecksum, buffersize);
 }
 
 //=============================================================================
@@ -495,9 +495,12 @@ typedef struct qmodel_s
 	int         numtextures;
 	texture_t **textures;
 
-	byte *visdata;
-	byte *lightdata;
-	char *entities;
+	byte              *visdata;
+	byte              *pvsmatrix; // all decompressed rows, if they fit in mod_pvsbudget
+	struct pvscache_s *pvscache;  // otherwise an LRU of decompressed rows
+	int                pvsstride;
+	byte              *lightdata;
+	char              *entities;
 
 	qboolean viswarn; // for Mod_DecompressVis()
 
@@ -517,6 +520,15 @@ typedef struct qmodel_s
 
 } qmodel_t;
 
+typedef struct pvscache_s
+{
+	int   head, tail; // most and least recently used slot
+	int  *slotforleaf; // -1 if not cached
+	int  *leafforslot;
+	int  *prev, *next;
+	byte *rows;
+} pvscache_t;
+
 //============================================================================
 
 void      Mod_Init (void);
@@ -77,42 +77,21 @@ DYNAMIC LIGHTS
 =============================================================================
 */
 
+COMPILE_TIME_ASSERT (dlightbits, MAX_DLIGHTS <= 64);
+
 /*
 =============
-R_MarkLights -- johnfitz -- rewritten to use LordHavoc's lighting speedup
+R_MarkSurfacesForLight
 =============
 */
-void R_MarkLights (dlight_t *light, int num, mnode_t *node)
+static void R_MarkSurfacesForLight (const dlight_t *light, int num, const mnode_t *node, float dist)
 {
-	mplane_t    *splitplane;
 	msurface_t  *surf;
 	vec3_t       impact;
-	float        dist, l, maxdist;
+	float        l, maxdist;
 	unsigned int i;
 	int          j, s, t;
 
-start:
-
-	if (node->contents < 0)
-		return;
-
-	splitplane = node->plane;
-	if (splitplane->type < 3)
-		dist = light->origin[splitplane->type] - splitplane->dist;
-	else
-		dist = DotProduct (light->origin, splitplane->normal) - splitplane->dist;
-
-	if (dist > light->radius)
-	{
-		node = node->children[0];
-		goto start;
-	}
-	if (dist < -light->radius)
-	{
-		node = node->children[1];
-		goto start;
-	}
-
 	maxdist = light->radius * light->radius;
 	// mark the polygons
 	surf = cl.worldmodel->surfaces + node->firstsurface;
@@ -140,6 +119,7 @@ start:
 		{
 			if (surf->dlightframe != r_dlightframecount) // not dynamic until now
 			{
+				memset (surf->dlightbits, 0, sizeof (surf->dlightbits));
 				surf->dlightbits[num >> 5] = 1U << (num & 31);
 				surf->dlightframe = r_dlightframecount;
 			}
@@ -147,11 +127,89 @@ start:
 				surf->dlightbits[num >> 5] |= 1U << (num & 31);
 		}
 	}
+}
+
+/*
+=============
+R_MarkLights -- johnfitz -- rewritten to use LordHavoc's lighting speedup
+
+Walks the tree once for all the lights in 'lightbits' (bit n is
+cl_dlights[n]), descending into each child with only the lights
+that reach it
+=============
+*/
+void R_MarkLights (uint64_t lightbits, mnode_t *node)
+{
+	mplane_t *splitplane;
+	dlight_t *light;
+	float     dist;
+	uint64_t  front, back, bits;
+	int       num;
+
+start:
+
+	if (node->contents < 0 || !lightbits)
+		return;
+
+	splitplane = node->plane;
+	front = back = 0;
+	for (bits = lightbits; bits; bits &= bits - 1)
+	{
+		num = FindFirstBitNonZero64 (bits);
+		light = &cl_dlights[num];
+
+		if (splitplane->type < 3)
+			dist = light->origin[splitplane->type] - splitplane->dist;
+		else
+			dist = DotProduct (light->origin, splitplane->normal) - splitplane->dist;
+
+		if (dist > light->radius)
+			front |= 1ull << num;
+		else if (dist < -light->radius)
+			back |= 1ull << num;
+		else
+		{
+			front |= 1ull << num;
+			back |= 1ull << num;
+			R_MarkSurfacesForLight (light, num, node, dist);
+		}
+	}
+
+	// follow a single side without recursing, like the per light version did
+	if (!back)
+	{
+		node = node->children[0];
+		lightbits = front;
+		goto start;
+	}
+	if (!front)
+	{
+		node = node->children[1];
+		lightbits = back;
+		goto start;
+	}
+
+	R_MarkLights (front, node->children[0]);
+	node = node->children[1];
+	lightbits = back;
+	goto start;
+}
+
+/*
+=============
+R_ActiveDlightBits
+=============
+*/
+uint64_t R_ActiveDlightBits (void)
+{
+	uint64_t lightbits = 0;
+	int      i;
+
+	for (i = 0; i < MAX_DLIGHTS; i++)
+		if (cl_dlights[i].die >= cl.time && cl_dlights[i].radius)
+			lightbits |= 1ull << i;
 
-	if (node->children[0]->contents >= 0)
-		R_MarkLights (light, num, node->children[0]);
-	if (node->children[1]->contents >= 0)
-		R_MarkLights (light, num, node->children[1]);
+	return lightbits;
 }
 
 /*
@@ -161,19 +219,10 @@ R_PushDlights
 */
 void R_PushDlights (void)
 {
-	int       i;
-	dlight_t *l;
-
 	r_dlightframecount = r_framecount + 1; // because the count hasn't
 	                                       //  advanced yet for this frame
-	l = cl_dlights;
 
-	for (i = 0; i < MAX_DLIGHTS; i++, l++)
-	{
-		if (l->die < cl.time || !l->radius)
-			continue;
-		R_MarkLights (l, i, cl.worldmodel->nodes);
-	}
+	R_MarkLights (R_ActiveDlightBits (), cl.worldmodel->nodes);
 }
 
 /*
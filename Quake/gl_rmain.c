@@ -36,6 +36,7 @@ qboolean    rt_lavaeffects = false;
 
 // johnfitz -- rendering statistics
 atomic_uint32_t rs_brushpolys, rs_aliaspolys, rs_skypolys, rs_particles, rs_fogpolys;
+atomic_uint32_t rs_2dquads, rs_2dbatches; // counted by SCR_DrawGUI, so these are from the previous frame
 atomic_uint32_t rs_dynamiclightmaps, rs_brushpasses, rs_aliaspasses, rs_skypasses;
 
 //
@@ -887,10 +888,24 @@ static void R_DrawParticlesTask (void *unused)
 	Fog_EnableGFog (&vulkan_globals.secondary_cb_contexts[CBX_PARTICLES]); // johnfitz
 	R_DrawParticles (&vulkan_globals.secondary_cb_contexts[CBX_PARTICLES]);
 #ifdef PSET_SCRIPT
-	PScript_DrawParticles (&vulkan_globals.secondary_cb_contexts[CBX_PARTICLES]);
+	PScript_PrepareParticles ();
 #endif
 }
 
+#ifdef PSET_SCRIPT
+/*
+================
+R_DrawScriptParticlesTask
+
+Runs after the particle types were simulated by PScript_RunParticleTypes
+================
+*/
+static void R_DrawScriptParticlesTask (void *unused)
+{
+	PScript_DrawParticles (&vulkan_globals.secondary_cb_contexts[CBX_PARTICLES]);
+}
+#endif
+
 /*
 ================
 R_DrawViewModelTask
@@ -975,17 +990,37 @@ void R_RenderView (qboolean use_tasks, task_handle_t begin_rendering_task, task_
 		task_handle_t draw_particles_task = Task_AllocateAndAssignFunc (R_DrawParticlesTask, NULL, 0);
 		Task_AddDependency (before_mark, draw_particles_task);
 		Task_AddDependency (begin_rendering_task, draw_particles_task);
+#ifdef PSET_SCRIPT
+		task_handle_t run_particle_types_task = Task_AllocateAndAssignIndexedFunc (PScript_RunParticleTypes, Tasks_NumWorkers (), NULL, 0);
+		task_handle_t draw_script_particles_task = Task_AllocateAndAssignFunc (R_DrawScriptParticlesTask, NULL, 0);
+		Task_AddDependency (draw_particles_task, run_particle_types_task);
+		Task_AddDependency (run_particle_types_task, draw_script_particles_task);
+		Task_AddDependency (draw_script_particles_task, draw_done_task);
+#else
 		Task_AddDependency (draw_particles_task, draw_done_task);
+#endif
+
+		// world lightmaps queued while chaining are rebuilt in slices, then uploaded
+		// together with the ones brush entities rebuilt
+		task_handle_t build_lightmaps_task = Task_AllocateAndAssignIndexedFunc (R_BuildQueuedLightmaps, Tasks_NumWorkers (), NULL, 0);
+		Task_AddDependency (cull_surfaces, build_lightmaps_task);
+		Task_AddDependency (chain_surfaces, build_lightmaps_task);
 
 		task_handle_t update_lightmaps_task = Task_AllocateAndAssignFunc (R_UpdateLightmaps, NULL, 0);
-		Task_AddDependency (cull_surfaces, update_lightmaps_task);
+		Task_AddDependency (build_lightmaps_task, update_lightmaps_task);
+		Task_AddDependency (draw_entities_task, update_lightmaps_task);
+		Task_AddDependency (draw_alpha_entities_task, update_lightmaps_task);
 		Task_AddDependency (begin_rendering_task, update_lightmaps_task);
 		Task_AddDependency (update_lightmaps_task, draw_done_task);
 
 		// RT: no need for draw_world_task, as it's done on R_NewMap
-		task_handle_t tasks[] = {before_mark,          store_efrags,		                         draw_world_task,     draw_sky_and_water_task,
-		                         draw_view_model_task, draw_entities_task, draw_alpha_entities_task, draw_particles_task, update_lightmaps_task};
+		task_handle_t tasks[] = {before_mark,          store_efrags,       draw_world_task,          draw_sky_and_water_task, draw_view_model_task,
+		                         draw_entities_task,   draw_alpha_entities_task, draw_particles_task, build_lightmaps_task,    update_lightmaps_task};
 		Tasks_Submit ((sizeof (tasks) / sizeof (task_handle_t)), tasks);
+#ifdef PSET_SCRIPT
+		Task_Submit (run_particle_types_task);
+		Task_Submit (draw_script_particles_task);
+#endif
 		if (store_efrags != cull_surfaces)
 		{
 			Task_Submit (cull_surfaces);
@@ -996,15 +1031,20 @@ void R_RenderView (qboolean use_tasks, task_handle_t begin_rendering_task, task_
 	{
 		R_SetupViewBeforeMark (NULL);
 		R_MarkSurfaces (use_tasks, INVALID_TASK_HANDLE, NULL, NULL, NULL); // johnfitz -- create texture chains from PVS
+		for (int i = 0; i < Tasks_NumWorkers (); ++i)
+			R_BuildQueuedLightmaps (i, NULL);
 		R_DrawWorldTask (0, NULL);
 		R_DrawSkyAndWaterTask (NULL);
 		for (int i = 0; i < NUM_ENTITIES_CBX; ++i)
 			R_DrawEntitiesTask (i, NULL);
 		R_DrawAlphaEntitiesTask (NULL);
 		R_DrawParticlesTask (NULL);
+#ifdef PSET_SCRIPT
+		PScript_RunParticleTypes (0, NULL);
+		R_DrawScriptParticlesTask (NULL);
+#endif
 		R_DrawViewModelTask (NULL);
-		if (r_gpulightmapupdate.value)
-			R_UpdateLightmaps (NULL);
+		R_UpdateLightmaps (NULL);
 	}
 
 	// johnfitz
@@ -1017,9 +1057,11 @@ void R_RenderView (qboolean use_tasks, task_handle_t begin_rendering_task, task_
 			(int)cl.entities[cl.viewentity].origin[2], (int)cl.viewangles[PITCH], (int)cl.viewangles[YAW], (int)cl.viewangles[ROLL]);
 	else if (r_speeds.value == 2)
 		Con_Printf (
-			"%6.3f ms  %4u/%4u wpoly %4u/%4u epoly %3u lmap %4u/%4u sky\n", (time2 - time1) * 1000.0, rs_brushpolys, rs_brushpasses, rs_aliaspolys,
-			rs_aliaspasses, rs_dynamiclightmaps, rs_skypolys, rs_skypasses);
+			"%6.3f ms  %4u/%4u wpoly %4u/%4u epoly %3u lmap %4u/%4u sky %4u/%3u 2d\n", (time2 - time1) * 1000.0, rs_brushpolys, rs_brushpasses,
+			rs_aliaspolys, rs_aliaspasses, rs_dynamiclightmaps, rs_skypolys, rs_skypasses, rs_2dquads, rs_2dbatches);
 	else if (r_speeds.value)
-		Con_Printf ("%3i ms  %4i wpoly %4i epoly %3i lmap\n", (int)((time2 - time1) * 1000), rs_brushpolys, rs_aliaspolys, rs_dynamiclightmaps);
+		Con_Printf (
+			"%3i ms  %4i wpoly %4i epoly %3i lmap %3i 2d\n", (int)((time2 - time1) * 1000), rs_brushpolys, rs_aliaspolys, rs_dynamiclightmaps,
+			rs_2dbatches);
 	// johnfitz
 }
@@ -985,6 +985,9 @@ static void SCR_DrawGUI (void *unused)
 {
 	cb_context_t *cbx = &vulkan_globals.secondary_cb_contexts[CBX_GUI];
 
+	Atomic_StoreUInt32 (&rs_2dquads, 0u);
+	Atomic_StoreUInt32 (&rs_2dbatches, 0u);
+
 	GL_SetCanvas (cbx, CANVAS_DEFAULT);
 
 	// FIXME: only call this when needed
@@ -1031,6 +1034,7 @@ static void SCR_DrawGUI (void *unused)
 		SCR_DrawConsole (cbx);
 		M_Draw (cbx);
 	}
+	Draw_Flush (cbx);
 	R_EndDebugUtilsLabel (cbx);
 }
 
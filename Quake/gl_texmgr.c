@@ -54,6 +54,7 @@ extern cvar_t rt_emis_fullbright_dflt;
 #define MAX_MIPS 16
 static int          numgltextures;
 static gltexture_t *active_gltextures, *free_gltextures;
+static strhash_t    gltexture_hash = {"textures"}; // name and owner of active_gltextures
 gltexture_t        *notexture, *nulltexture, *whitetexture, *greytexture;
 
 unsigned int d_8to24table[256];
@@ -421,15 +422,8 @@ gltexture_t *TexMgr_FindTexture (qmodel_t *owner, const char *name)
 	gltexture_t *glt = NULL;
 
 	if (name)
-	{
-		for (glt = active_gltextures; glt; glt = glt->next)
-		{
-			if (glt->owner == owner && !strcmp (glt->name, name))
-				goto unlock_mutex;
-		}
-	}
+		glt = (gltexture_t *)StrHash_Find (&gltexture_hash, name, owner);
 
-unlock_mutex:
 	SDL_UnlockMutex (texmgr_mutex);
 	return glt;
 }
@@ -437,9 +431,12 @@ unlock_mutex:
 /*
 ================
 TexMgr_NewTexture
+
+Names the texture and hashes it in the same critical section, so it's never
+on the active list without being findable
 ================
 */
-gltexture_t *TexMgr_NewTexture (void)
+gltexture_t *TexMgr_NewTexture (qmodel_t *owner, const char *name)
 {
 	SDL_LockMutex (texmgr_mutex);
 	gltexture_t *glt;
@@ -448,6 +445,9 @@ gltexture_t *TexMgr_NewTexture (void)
 	free_gltextures = glt->next;
 	glt->next = active_gltextures;
 	active_gltextures = glt;
+	glt->owner = owner;
+	q_strlcpy (glt->name, name, sizeof (glt->name));
+	StrHash_Insert (&gltexture_hash, glt->name, glt->owner, glt);
 
 	numgltextures++;
 	SDL_UnlockMutex (texmgr_mutex);
@@ -472,6 +472,8 @@ void TexMgr_FreeTexture (gltexture_t *kill)
 		goto unlock_mutex;
 	}
 
+	StrHash_Remove (&gltexture_hash, kill->name, kill->owner, kill);
+
 	if (active_gltextures == kill)
 	{
 		active_gltextures = kill->next;
@@ -692,6 +694,7 @@ void TexMgr_Init (void)
 	Cvar_RegisterVariable (&gl_max_size);
 	Cvar_RegisterVariable (&gl_picmip);
 	Cmd_AddCommand ("imagelist", &TexMgr_Imagelist_f);
+	Cmd_AddCommand ("imagebench", &Image_Benchmark_f);
 
 	// load notexture images
 	notexture = TexMgr_LoadImage (
@@ -1122,11 +1125,11 @@ gltexture_t *TexMgr_LoadImage (
 			return glt;
 	}
 	else
-		glt = TexMgr_NewTexture ();
+	{
+		glt = TexMgr_NewTexture (owner, name);
+	}
 
 	// copy data
-	glt->owner = owner;
-	q_strlcpy (glt->name, name, sizeof (glt->name));
 	glt->width = width;
 	glt->height = height;
 	glt->flags = flags;
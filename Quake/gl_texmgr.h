@@ -108,7 +108,7 @@ extern unsigned int d_8to24table_pants[256];
 // TEXTURE MANAGER
 
 gltexture_t *TexMgr_FindTexture (qmodel_t *owner, const char *name);
-gltexture_t *TexMgr_NewTexture (void);
+gltexture_t *TexMgr_NewTexture (qmodel_t *owner, const char *name);
 void         TexMgr_FreeTexture (gltexture_t *kill);
 void         TexMgr_FreeTextures (unsigned int flags, unsigned int mask);
 void         TexMgr_FreeTexturesForOwner (qmodel_t *owner);
@@ -1252,6 +1252,11 @@ static void GL_EndRenderingTask (end_rendering_parms_t *parms)
 	};
 	memcpy (info.view, vulkan_globals.view_matrix, 16 * sizeof(float));
 
+	// 2D geometry still batched on any context has to be uploaded before the frame is submitted
+	Draw_Flush (&vulkan_globals.primary_cb_context);
+	for (int i = 0; i < CBX_NUM; i++)
+		Draw_Flush (&vulkan_globals.secondary_cb_contexts[i]);
+
 	RgResult r = rgDrawFrame (vulkan_globals.instance, &info);
 	RG_CHECK (r);
 }
@@ -1306,7 +1311,9 @@ void VID_Shutdown (void)
 			{
 				Mem_Free (vulkan_globals.secondary_cb_contexts[i].batch_indices);
 				Mem_Free (vulkan_globals.secondary_cb_contexts[i].batch_verts);
+				Mem_Free (vulkan_globals.secondary_cb_contexts[i].draw2d.verts);
 			}
+			Mem_Free (vulkan_globals.primary_cb_context.draw2d.verts);
 		}
 
 		SDL_QuitSubSystem (SDL_INIT_VIDEO);
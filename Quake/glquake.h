@@ -76,24 +76,12 @@ typedef enum
 	pt_blob2
 } ptype_t;
 
-// !!! if this is changed, it must be changed in d_ifacea.h too !!!
-typedef struct particle_s
-{
-	// driver-usable fields
-	vec3_t             org;
-	float              color;
-	// drivers never touch the following fields
-	struct particle_s *next;
-	vec3_t             vel;
-	float              ramp;
-	float              die;
-	ptype_t            type;
-} particle_t;
-
 #define P_INVALID -1
 #ifdef PSET_SCRIPT
 void PScript_InitParticles (void);
 void PScript_Shutdown (void);
+void PScript_PrepareParticles (void);
+void PScript_RunParticleTypes (int index, void *unused);
 void PScript_DrawParticles (cb_context_t *cbx);
 void PScript_DrawParticles_ShowTris (cb_context_t *cbx);
 struct trailstate_s;
@@ -131,6 +119,7 @@ extern int r_trace_line_cache_counter;
 
 #define MAX_BATCH_INDICES 65536
 #define MAX_BATCH_VERTS   8196
+#define MAX_DRAW2D_VERTS  (6 * 4096)
 #define NUM_WORLD_CBX     6
 #define NUM_ENTITIES_CBX  6
 
@@ -158,6 +147,13 @@ typedef enum
 	CBX_NUM,
 } secondary_cb_contexts_t;
 
+typedef struct draw2d_batch_s
+{
+	RgRasterizedGeometryUploadInfo info; // state shared by the pending quads
+	RgVertex                      *verts; // MAX_DRAW2D_VERTS, allocated on first use
+	int                            numverts;
+} draw2d_batch_t;
+
 typedef struct cb_context_s
 {
 	canvastype current_canvas;
@@ -168,6 +164,8 @@ typedef struct cb_context_s
 	uint32_t *batch_indices;
 	int       batch_verts_count;
 	int       batch_indices_count;
+
+	draw2d_batch_t draw2d; // see Draw_Flush
 } cb_context_t;
 
 typedef struct
@@ -248,6 +246,7 @@ extern cvar_t gl_nocolors;
 
 // johnfitz -- rendering statistics
 extern atomic_uint32_t rs_brushpolys, rs_aliaspolys, rs_skypolys, rs_particles, rs_fogpolys;
+extern atomic_uint32_t rs_2dquads, rs_2dbatches;
 extern atomic_uint32_t rs_dynamiclightmaps, rs_brushpasses, rs_aliaspasses, rs_skypasses;
 
 extern size_t total_device_vulkan_allocation_size;
@@ -293,16 +292,11 @@ extern int gl_lightmap_format;
 	     // uploading...)
 #define LMBLOCK_HEIGHT 1024 // Alternatively, use texture arrays, which would avoid the need to switch textures as often.
 
-typedef struct glRect_s
-{
-	unsigned short l, t, w, h;
-} glRect_t;
 struct lightmap_s
 {
 	gltexture_t    *texture;
 	glpoly_t       *polys;
 	atomic_uint32_t modified;
-	glRect_t        rectchange;
 
 	// the lightmap texture data needs to be kept in
 	// main memory so texsubimage can update properly
@@ -337,7 +331,8 @@ qboolean R_CullBox (vec3_t emins, vec3_t emaxs);
 void     R_StoreEfrags (efrag_t **ppefrag);
 qboolean R_CullModelForEntity (entity_t *e);
 void     R_RotateForEntity (float matrix[16], vec3_t origin, vec3_t angles);
-void     R_MarkLights (dlight_t *light, int num, mnode_t *node);
+void     R_MarkLights (uint64_t lightbits, mnode_t *node);
+uint64_t R_ActiveDlightBits (void);
 
 void R_InitParticles (void);
 void R_DrawParticles (cb_context_t *cbx);
@@ -358,6 +353,7 @@ void GL_BuildLightmaps (void);
 void GL_DeleteBModelVertexBuffer (void);
 void GL_BuildBModelVertexBuffer (void);
 void GL_PrepareSIMDData (void);
+void GLMesh_LoadVertexBuffer (qmodel_t *m, const aliashdr_t *hdr);
 void GLMesh_LoadVertexBuffers (void);
 void GLMesh_DeleteVertexBuffers (void);
 
@@ -368,6 +364,8 @@ void RT_UploadAllElights (void);
 void GL_SubdivideSurface (msurface_t *fa);
 void R_BuildLightMap (msurface_t *surf, byte *dest, int stride);
 void R_RenderDynamicLightmaps (msurface_t *fa);
+void R_QueueDynamicLightmap (msurface_t *fa);
+void R_BuildQueuedLightmaps (int index, void *unused);
 void R_UploadLightmaps (void);
 
 void R_DrawWorld_ShowTris (cb_context_t *cbx);
@@ -25,6 +25,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 #include "bgmusic.h"
 #include "tasks.h"
+#include "net_loadbot.h"
 #include <setjmp.h>
 
 /*
@@ -66,6 +67,8 @@ cvar_t cl_nocsqc = {"cl_nocsqc", "0", CVAR_NONE};           // spike -- blocks t
 
 cvar_t sys_ticrate = {"sys_ticrate", "0.025", CVAR_NONE}; // dedicated server
 cvar_t serverprofile = {"serverprofile", "0", CVAR_NONE};
+static int    serverprofile_frames; // Host_ServerFrame timings, reported with the serverprofile line
+static double serverprofile_total, serverprofile_max, serverprofile_send;
 
 cvar_t fraglimit = {"fraglimit", "0", CVAR_NOTIFY | CVAR_SERVERINFO};
 cvar_t timelimit = {"timelimit", "0", CVAR_NOTIFY | CVAR_SERVERINFO};
@@ -689,6 +692,10 @@ void Host_ServerFrame (void)
 {
 	int      i, active; // johnfitz
 	edict_t *ent;       // johnfitz
+	double   time1 = 0, time2 = 0;
+
+	if (serverprofile.value)
+		time1 = Sys_DoubleTime ();
 
 	// run the world state
 	pr_global_struct->frametime = host_frametime;
@@ -724,7 +731,18 @@ void Host_ServerFrame (void)
 	// johnfitz
 
 	// send all messages to the clients
+	if (time1)
+		time2 = Sys_DoubleTime ();
 	SV_SendClientMessages ();
+
+	if (time1)
+	{
+		double time3 = Sys_DoubleTime ();
+		serverprofile_frames++;
+		serverprofile_total += time3 - time1;
+		serverprofile_max = q_max (serverprofile_max, time3 - time1);
+		serverprofile_send += time3 - time2;
+	}
 }
 
 static void CL_LoadCSProgs (void)
@@ -811,6 +829,7 @@ void _Host_Frame (double time)
 	static double time2 = 0;
 	static double time3 = 0;
 	double        pass1, pass2, pass3;
+	qboolean      timing;
 
 	if (setjmp (host_abortserver))
 		return; // something bad happened, or the server disconnected
@@ -823,7 +842,9 @@ void _Host_Frame (double time)
 	if (!Host_FilterTime (time))
 		return; // don't run too fast, or packets will flood out
 
-	if (host_speeds.value)
+	// timedemo keeps the same splits for its report
+	timing = host_speeds.value || cls.timedemo;
+	if (timing)
 		time3 = Sys_DoubleTime ();
 
 	// get new key events
@@ -869,6 +890,7 @@ void _Host_Frame (double time)
 		}
 
 		CL_SendCmd ();
+		LoadBot_Frame ();
 		if (sv.active)
 		{
 			PR_SwitchQCVM (&sv.qcvm);
@@ -895,14 +917,14 @@ void _Host_Frame (double time)
 		CL_ReadFromServer ();
 
 	// update video
-	if (host_speeds.value)
+	if (timing)
 		time1 = Sys_DoubleTime ();
 
 	SCR_UpdateScreen (true);
 
 	CL_RunParticles (); // johnfitz -- seperated from rendering
 
-	if (host_speeds.value)
+	if (timing)
 		time2 = Sys_DoubleTime ();
 
 	// update audio
@@ -917,13 +939,16 @@ void _Host_Frame (double time)
 
 	CDAudio_Update ();
 
-	if (host_speeds.value)
+	if (timing)
 	{
 		pass1 = (time1 - time3) * 1000;
 		time3 = Sys_DoubleTime ();
 		pass2 = (time2 - time1) * 1000;
 		pass3 = (time3 - time2) * 1000;
-		Con_Printf ("%5.2f tot %5.2f server %5.2f gfx %5.2f snd\n", pass1 + pass2 + pass3, pass1, pass2, pass3);
+		if (host_speeds.value)
+			Con_Printf ("%5.2f tot %5.2f server %5.2f gfx %5.2f snd\n", pass1 + pass2 + pass3, pass1, pass2, pass3);
+		if (cls.timedemo)
+			CL_TimeDemoFrame (pass1, pass2, pass3);
 	}
 
 	host_framecount++;
@@ -962,7 +987,17 @@ void Host_Frame (double time)
 			c++;
 	}
 
-	Con_Printf ("serverprofile: %2i clients %2i msec\n", c, m);
+	if (!serverprofile_frames)
+	{
+		Con_Printf ("serverprofile: %2i clients %2i msec\n", c, m);
+		return;
+	}
+
+	Con_Printf (
+		"serverprofile: %2i clients %2i msec, server frame %.2f msec (%.2f max), SV_SendClientMessages %.2f msec\n", c, m,
+		serverprofile_total * 1000 / serverprofile_frames, serverprofile_max * 1000, serverprofile_send * 1000 / serverprofile_frames);
+	serverprofile_frames = 0;
+	serverprofile_total = serverprofile_max = serverprofile_send = 0;
 }
 
 /*
@@ -993,6 +1028,7 @@ void Host_Init (void)
 	PR_Init ();
 	Mod_Init ();
 	NET_Init ();
+	LoadBot_Init ();
 	SV_Init ();
 
 	Con_Printf ("Exe: " __TIME__ " " __DATE__ "\n");
@@ -1074,6 +1110,7 @@ void Host_Shutdown (void)
 
 	Host_WriteConfiguration ();
 
+	LoadBot_Shutdown ();
 	NET_Shutdown ();
 
 	if (cls.state != ca_dedicated)
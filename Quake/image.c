@@ -22,6 +22,11 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // image.c -- image loading
 
 #include "quakedef.h"
+#ifndef _WIN32
+#include <dirent.h>
+#else
+#include <windows.h>
+#endif
 
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_STATIC
@@ -52,38 +57,196 @@ void lodepng_free (void *ptr)
 
 static THREAD_LOCAL char loadfilename[MAX_OSPATH]; // file scope so that error messages can use it
 
-typedef struct stdio_buffer_s
+#define IMAGE_READ_PADDING 16 // slack at the end of the file data so SIMD loads never run off the allocation
+
+typedef struct mem_buffer_s
+{
+	const byte *pos;
+	const byte *end;
+} mem_buffer_t;
+
+/*
+============
+Buf_ReadFile
+
+Reads 'size' bytes from 'f' with a single fread instead of pulling
+the image through a small stdio buffer one byte at a time
+============
+*/
+static byte *Buf_ReadFile (FILE *f, int size, mem_buffer_t *buf)
+{
+	byte *data = (byte *)Mem_Alloc (q_max (size, 0) + IMAGE_READ_PADDING);
+	size_t read = (size > 0) ? fread (data, 1, size, f) : 0;
+	buf->pos = data;
+	buf->end = data + read;
+	return data;
+}
+
+static inline int Buf_GetC (mem_buffer_t *buf)
 {
-	FILE         *f;
-	unsigned char buffer[1024];
-	int           size;
-	int           pos;
-} stdio_buffer_t;
+	if (buf->pos >= buf->end)
+		return EOF;
+	return *buf->pos++;
+}
 
-static stdio_buffer_t *Buf_Alloc (FILE *f)
+static inline int Buf_Remaining (const mem_buffer_t *buf)
 {
-	stdio_buffer_t *buf = (stdio_buffer_t *)Mem_Alloc (sizeof (stdio_buffer_t));
-	buf->f = f;
-	return buf;
+	return (int)(buf->end - buf->pos);
 }
 
-static void Buf_Free (stdio_buffer_t *buf)
+/*
+============
+Image_MakePixel
+
+Packs r, g, b, a into a 32 bit word that is laid out as RGBA in memory
+============
+*/
+static inline uint32_t Image_MakePixel (byte r, byte g, byte b, byte a)
 {
-	Mem_Free (buf);
+	const byte rgba[4] = {r, g, b, a};
+	uint32_t   pixel;
+	memcpy (&pixel, rgba, sizeof (pixel));
+	return pixel;
 }
 
-static inline int Buf_GetC (stdio_buffer_t *buf)
+/*
+============
+Image_FillPixels
+
+Expands a run of 'count' identical pixels
+============
+*/
+static void Image_FillPixels (uint32_t *dst, uint32_t pixel, int count)
 {
-	if (buf->pos >= buf->size)
+#ifdef USE_SSE2
+	if (use_simd)
 	{
-		buf->size = fread (buf->buffer, 1, sizeof (buf->buffer), buf->f);
-		buf->pos = 0;
+		const __m128i v = _mm_set1_epi32 (pixel);
+		while (count >= 8)
+		{
+			_mm_storeu_si128 ((__m128i *)dst, v);
+			_mm_storeu_si128 ((__m128i *)(dst + 4), v);
+			dst += 8;
+			count -= 8;
+		}
+		if (count >= 4)
+		{
+			_mm_storeu_si128 ((__m128i *)dst, v);
+			dst += 4;
+			count -= 4;
+		}
+	}
+#endif // def USE_SSE2
+
+	while (count-- > 0)
+		*dst++ = pixel;
+}
+
+/*
+============
+Image_BGRToRGBA
 
-		if (buf->size == 0)
-			return EOF;
+Swizzles 'count' 24 bit BGR pixels to RGBA with opaque alpha
+============
+*/
+static void Image_BGRToRGBA (uint32_t *dst, const byte *src, int count)
+{
+#ifdef USE_SSE2
+	if (use_simd)
+	{
+		const __m128i m0 = _mm_setr_epi32 (0x00ffffff, 0, 0, 0);
+		const __m128i m1 = _mm_setr_epi32 (0, 0x00ffffff, 0, 0);
+		const __m128i m2 = _mm_setr_epi32 (0, 0, 0x00ffffff, 0);
+		const __m128i m3 = _mm_setr_epi32 (0, 0, 0, 0x00ffffff);
+		const __m128i vgreen = _mm_set1_epi32 (0x0000ff00);
+		const __m128i vlow = _mm_set1_epi32 (0x000000ff);
+		const __m128i valpha = _mm_set1_epi32 (0xff000000);
+
+		// each iteration loads 16 bytes but only consumes 12 (4 pixels)
+		while (count >= 6)
+		{
+			__m128i x = _mm_loadu_si128 ((const __m128i *)src);
+			__m128i v = _mm_and_si128 (x, m0);
+			v = _mm_or_si128 (v, _mm_and_si128 (_mm_slli_si128 (x, 1), m1));
+			v = _mm_or_si128 (v, _mm_and_si128 (_mm_slli_si128 (x, 2), m2));
+			v = _mm_or_si128 (v, _mm_and_si128 (_mm_slli_si128 (x, 3), m3));
+
+			// v holds BGR0 per lane, swap red and blue
+			__m128i out = _mm_or_si128 (_mm_and_si128 (v, vgreen), valpha);
+			out = _mm_or_si128 (out, _mm_and_si128 (_mm_srli_epi32 (v, 16), vlow));
+			out = _mm_or_si128 (out, _mm_slli_epi32 (_mm_and_si128 (v, vlow), 16));
+			_mm_storeu_si128 ((__m128i *)dst, out);
+
+			src += 12;
+			dst += 4;
+			count -= 4;
+		}
 	}
+#endif // def USE_SSE2
 
-	return buf->buffer[buf->pos++];
+	while (count-- > 0)
+	{
+		*dst++ = Image_MakePixel (src[2], src[1], src[0], 255);
+		src += 3;
+	}
+}
+
+/*
+============
+Image_BGRAToRGBA
+
+Swizzles 'count' 32 bit BGRA pixels to RGBA
+============
+*/
+static void Image_BGRAToRGBA (uint32_t *dst, const byte *src, int count)
+{
+#ifdef USE_SSE2
+	if (use_simd)
+	{
+		const __m128i vag = _mm_set1_epi32 (0xff00ff00);
+		const __m128i vlow = _mm_set1_epi32 (0x000000ff);
+
+		while (count >= 4)
+		{
+			__m128i v = _mm_loadu_si128 ((const __m128i *)src);
+			__m128i out = _mm_and_si128 (v, vag);
+			out = _mm_or_si128 (out, _mm_and_si128 (_mm_srli_epi32 (v, 16), vlow));
+			out = _mm_or_si128 (out, _mm_slli_epi32 (_mm_and_si128 (v, vlow), 16));
+			_mm_storeu_si128 ((__m128i *)dst, out);
+
+			src += 16;
+			dst += 4;
+			count -= 4;
+		}
+	}
+#endif // def USE_SSE2
+
+	while (count-- > 0)
+	{
+		*dst++ = Image_MakePixel (src[2], src[1], src[0], src[3]);
+		src += 4;
+	}
+}
+
+/*
+============
+Image_PalettedToRGBA
+============
+*/
+static void Image_PalettedToRGBA (uint32_t *dst, const byte *src, const uint32_t *palette, int count)
+{
+	while (count >= 4)
+	{
+		dst[0] = palette[src[0]];
+		dst[1] = palette[src[1]];
+		dst[2] = palette[src[2]];
+		dst[3] = palette[src[3]];
+		src += 4;
+		dst += 4;
+		count -= 4;
+	}
+	while (count-- > 0)
+		*dst++ = palette[*src++];
 }
 
 /*
@@ -129,28 +292,6 @@ typedef struct targaheader_s
 
 #define TARGAHEADERSIZE 18 // size on disk
 
-int fgetLittleShort (FILE *f)
-{
-	byte b1, b2;
-
-	b1 = fgetc (f);
-	b2 = fgetc (f);
-
-	return (short)(b1 + b2 * 256);
-}
-
-int fgetLittleLong (FILE *f)
-{
-	byte b1, b2, b3, b4;
-
-	b1 = fgetc (f);
-	b2 = fgetc (f);
-	b3 = fgetc (f);
-	b4 = fgetc (f);
-
-	return b1 + (b2 << 8) + (b3 << 16) + (b4 << 24);
-}
-
 /*
 ============
 Image_WriteTGA -- writes RGB or RGBA data to a TGA file
@@ -200,233 +341,191 @@ qboolean Image_WriteTGA (const char *name, byte *data, int width, int height, in
 /*
 =============
 Image_LoadTGA
+
+The whole file is read up front and decoded from memory. Rows are written
+straight to their final position, so bottom-up targas need no separate flip.
 =============
 */
 byte *Image_LoadTGA (FILE *fin, int *width, int *height, const char *name)
 {
-	targaheader_t   targa_header;
-	int             columns, rows, numPixels;
-	byte           *pixbuf;
-	int             row, column;
-	byte           *targa_rgba;
-	int             realrow;     // johnfitz -- fix for upside-down targas
-	qboolean        upside_down; // johnfitz -- fix for upside-down targas
-	stdio_buffer_t *buf;
-
-	targa_header.id_length = fgetc (fin);
-	targa_header.colormap_type = fgetc (fin);
-	targa_header.image_type = fgetc (fin);
-
-	targa_header.colormap_index = fgetLittleShort (fin);
-	targa_header.colormap_length = fgetLittleShort (fin);
-	targa_header.colormap_size = fgetc (fin);
-	targa_header.x_origin = fgetLittleShort (fin);
-	targa_header.y_origin = fgetLittleShort (fin);
-	targa_header.width = fgetLittleShort (fin);
-	targa_header.height = fgetLittleShort (fin);
-	targa_header.pixel_size = fgetc (fin);
-	targa_header.attributes = fgetc (fin);
+	targaheader_t targa_header;
+	byte          header[TARGAHEADERSIZE];
+	int           columns, rows, numPixels;
+	int           filerow, column, bytes_per_pixel;
+	uint32_t     *targa_rgba;
+	uint32_t     *pixbuf;
+	qboolean      upside_down; // johnfitz -- fix for upside-down targas
+	mem_buffer_t  buf;
+	byte         *filedata;
+
+	filedata = Buf_ReadFile (fin, com_filesize, &buf);
+	fclose (fin);
+
+	if (Buf_Remaining (&buf) < TARGAHEADERSIZE)
+	{
+		Con_Printf ("Image_LoadTGA: %s is truncated\n", loadfilename);
+		Mem_Free (filedata);
+		return NULL;
+	}
+	memcpy (header, buf.pos, TARGAHEADERSIZE);
+	buf.pos += TARGAHEADERSIZE;
+
+	targa_header.id_length = header[0];
+	targa_header.colormap_type = header[1];
+	targa_header.image_type = header[2];
+	targa_header.colormap_index = header[3] | (header[4] << 8);
+	targa_header.colormap_length = header[5] | (header[6] << 8);
+	targa_header.colormap_size = header[7];
+	targa_header.x_origin = header[8] | (header[9] << 8);
+	targa_header.y_origin = header[10] | (header[11] << 8);
+	targa_header.width = header[12] | (header[13] << 8);
+	targa_header.height = header[14] | (header[15] << 8);
+	targa_header.pixel_size = header[16];
+	targa_header.attributes = header[17];
 
 	if (targa_header.image_type == 1)
 	{
 		Con_Warning ("paletted TGA (less compatible): %s\n", name);
 		if (targa_header.pixel_size != 8 || targa_header.colormap_size != 24 || targa_header.colormap_length > 256)
-			Sys_Error ("Image_LoadTGA: %s has an %ibit palette", loadfilename, targa_header.colormap_type);
+		{
+			Con_Printf ("Image_LoadTGA: %s has an %ibit palette\n", loadfilename, targa_header.colormap_type);
+			Mem_Free (filedata);
+			return NULL;
+		}
 	}
 	else
 	{
 		if (targa_header.image_type != 2 && targa_header.image_type != 10)
-			Sys_Error ("Image_LoadTGA: %s is not a type 2 or type 10 targa (%i)", loadfilename, targa_header.image_type);
+		{
+			Con_Printf ("Image_LoadTGA: %s is not a type 2 or type 10 targa (%i)\n", loadfilename, targa_header.image_type);
+			Mem_Free (filedata);
+			return NULL;
+		}
 
 		if (targa_header.colormap_type != 0 || (targa_header.pixel_size != 32 && targa_header.pixel_size != 24))
-			Sys_Error ("Image_LoadTGA: %s is not a 24bit or 32bit targa", loadfilename);
+		{
+			Con_Printf ("Image_LoadTGA: %s is not a 24bit or 32bit targa\n", loadfilename);
+			Mem_Free (filedata);
+			return NULL;
+		}
 	}
 
 	columns = targa_header.width;
 	rows = targa_header.height;
+	if (columns <= 0 || rows <= 0 || (int64_t)columns * rows > INT_MAX / 4)
+	{
+		Con_Printf ("Image_LoadTGA: %s has a bad size (%ix%i)\n", loadfilename, columns, rows);
+		Mem_Free (filedata);
+		return NULL;
+	}
 	numPixels = columns * rows;
 	upside_down = !(targa_header.attributes & 0x20); // johnfitz -- fix for upside-down targas
+	bytes_per_pixel = targa_header.pixel_size / 8;
 
-	targa_rgba = (byte *)Mem_Alloc (numPixels * 4);
+	targa_rgba = (uint32_t *)Mem_Alloc (numPixels * 4);
 
-	if (targa_header.id_length != 0)
-		fseek (fin, targa_header.id_length, SEEK_CUR); // skip TARGA image comment
+	buf.pos += q_min (targa_header.id_length, Buf_Remaining (&buf)); // skip TARGA image comment
 
-	buf = Buf_Alloc (fin);
+	// johnfitz -- fix for upside-down targas
+#define TARGA_ROW(filerow) (targa_rgba + (upside_down ? (rows - 1 - (filerow)) : (filerow)) * columns)
 
 	if (targa_header.image_type == 1) // Uncompressed, paletted images
 	{
-		byte palette[256 * 4];
-		int  i;
-		// palette data comes first
-		for (i = 0; i < targa_header.colormap_length; i++)
-		{ // this palette data is bgr.
-			palette[i * 3 + 2] = Buf_GetC (buf);
-			palette[i * 3 + 1] = Buf_GetC (buf);
-			palette[i * 3 + 0] = Buf_GetC (buf);
-			palette[i * 3 + 3] = 255;
-		}
-		for (i = targa_header.colormap_length * 4; i < sizeof (palette); i++)
+		uint32_t palette[256];
+		int      i;
+		// palette data comes first, this palette data is bgr.
+		for (i = 0; i < targa_header.colormap_length && Buf_Remaining (&buf) >= 3; i++, buf.pos += 3)
+			palette[i] = Image_MakePixel (buf.pos[2], buf.pos[1], buf.pos[0], 255);
+		for (; i < 256; i++)
 			palette[i] = 0;
-		for (row = rows - 1; row >= 0; row--)
+		for (filerow = 0; filerow < rows; filerow++)
 		{
-			realrow = upside_down ? row : rows - 1 - row;
-			pixbuf = targa_rgba + realrow * columns * 4;
-
-			for (column = 0; column < columns; column++)
-			{
-				i = Buf_GetC (buf);
-				*pixbuf++ = palette[i * 3 + 0];
-				*pixbuf++ = palette[i * 3 + 1];
-				*pixbuf++ = palette[i * 3 + 2];
-				*pixbuf++ = palette[i * 3 + 3];
-			}
+			const int count = q_min (columns, Buf_Remaining (&buf));
+			Image_PalettedToRGBA (TARGA_ROW (filerow), buf.pos, palette, count);
+			buf.pos += count;
+			if (count < columns)
+				break;
 		}
 	}
 	else if (targa_header.image_type == 2) // Uncompressed, RGB images
 	{
-		for (row = rows - 1; row >= 0; row--)
+		for (filerow = 0; filerow < rows; filerow++)
 		{
-			// johnfitz -- fix for upside-down targas
-			realrow = upside_down ? row : rows - 1 - row;
-			pixbuf = targa_rgba + realrow * columns * 4;
-			// johnfitz
-			for (column = 0; column < columns; column++)
-			{
-				unsigned char red, green, blue, alphabyte;
-				switch (targa_header.pixel_size)
-				{
-				case 24:
-					blue = Buf_GetC (buf);
-					green = Buf_GetC (buf);
-					red = Buf_GetC (buf);
-					*pixbuf++ = red;
-					*pixbuf++ = green;
-					*pixbuf++ = blue;
-					*pixbuf++ = 255;
-					break;
-				case 32:
-					blue = Buf_GetC (buf);
-					green = Buf_GetC (buf);
-					red = Buf_GetC (buf);
-					alphabyte = Buf_GetC (buf);
-					*pixbuf++ = red;
-					*pixbuf++ = green;
-					*pixbuf++ = blue;
-					*pixbuf++ = alphabyte;
-					break;
-				}
-			}
+			const int count = q_min (columns, Buf_Remaining (&buf) / bytes_per_pixel);
+			if (bytes_per_pixel == 3)
+				Image_BGRToRGBA (TARGA_ROW (filerow), buf.pos, count);
+			else
+				Image_BGRAToRGBA (TARGA_ROW (filerow), buf.pos, count);
+			buf.pos += count * bytes_per_pixel;
+			if (count < columns)
+				break;
 		}
 	}
 	else if (targa_header.image_type == 10) // Runlength encoded RGB images
 	{
-		unsigned char red, green, blue, alphabyte, packetHeader, packetSize, j;
-		for (row = rows - 1; row >= 0; row--)
+		filerow = 0;
+		column = 0;
+		pixbuf = TARGA_ROW (0);
+		while (filerow < rows && buf.pos < buf.end)
 		{
-			// johnfitz -- fix for upside-down targas
-			realrow = upside_down ? row : rows - 1 - row;
-			pixbuf = targa_rgba + realrow * columns * 4;
-			// johnfitz
-			for (column = 0; column < columns;)
+			const int packetHeader = *buf.pos++;
+			int       packetSize = 1 + (packetHeader & 0x7f);
+			uint32_t  pixel = 0;
+			qboolean  truncated = false;
+
+			if (packetHeader & 0x80) // run-length packet
+			{
+				if (Buf_Remaining (&buf) < bytes_per_pixel)
+					break;
+				if (bytes_per_pixel == 3)
+					pixel = Image_MakePixel (buf.pos[2], buf.pos[1], buf.pos[0], 255);
+				else
+					pixel = Image_MakePixel (buf.pos[2], buf.pos[1], buf.pos[0], buf.pos[3]);
+				buf.pos += bytes_per_pixel;
+			}
+			else if (packetSize * bytes_per_pixel > Buf_Remaining (&buf)) // non run-length packet
+			{
+				packetSize = Buf_Remaining (&buf) / bytes_per_pixel;
+				truncated = true;
+			}
+
+			// packets may span across rows
+			while (packetSize > 0)
 			{
-				packetHeader = Buf_GetC (buf);
-				packetSize = 1 + (packetHeader & 0x7f);
-				if (packetHeader & 0x80) // run-length packet
+				const int count = q_min (packetSize, columns - column);
+				if (packetHeader & 0x80)
+					Image_FillPixels (pixbuf + column, pixel, count);
+				else
 				{
-					switch (targa_header.pixel_size)
-					{
-					case 24:
-						blue = Buf_GetC (buf);
-						green = Buf_GetC (buf);
-						red = Buf_GetC (buf);
-						alphabyte = 255;
-						break;
-					case 32:
-						blue = Buf_GetC (buf);
-						green = Buf_GetC (buf);
-						red = Buf_GetC (buf);
-						alphabyte = Buf_GetC (buf);
-						break;
-					default: /* avoid compiler warnings */
-						blue = red = green = alphabyte = 0;
-					}
-
-					for (j = 0; j < packetSize; j++)
-					{
-						*pixbuf++ = red;
-						*pixbuf++ = green;
-						*pixbuf++ = blue;
-						*pixbuf++ = alphabyte;
-						column++;
-						if (column == columns) // run spans across rows
-						{
-							column = 0;
-							if (row > 0)
-								row--;
-							else
-								goto breakOut;
-							// johnfitz -- fix for upside-down targas
-							realrow = upside_down ? row : rows - 1 - row;
-							pixbuf = targa_rgba + realrow * columns * 4;
-							// johnfitz
-						}
-					}
+					if (bytes_per_pixel == 3)
+						Image_BGRToRGBA (pixbuf + column, buf.pos, count);
+					else
+						Image_BGRAToRGBA (pixbuf + column, buf.pos, count);
+					buf.pos += count * bytes_per_pixel;
 				}
-				else // non run-length packet
+				column += count;
+				packetSize -= count;
+				if (column == columns)
 				{
-					for (j = 0; j < packetSize; j++)
-					{
-						switch (targa_header.pixel_size)
-						{
-						case 24:
-							blue = Buf_GetC (buf);
-							green = Buf_GetC (buf);
-							red = Buf_GetC (buf);
-							*pixbuf++ = red;
-							*pixbuf++ = green;
-							*pixbuf++ = blue;
-							*pixbuf++ = 255;
-							break;
-						case 32:
-							blue = Buf_GetC (buf);
-							green = Buf_GetC (buf);
-							red = Buf_GetC (buf);
-							alphabyte = Buf_GetC (buf);
-							*pixbuf++ = red;
-							*pixbuf++ = green;
-							*pixbuf++ = blue;
-							*pixbuf++ = alphabyte;
-							break;
-						default: /* avoid compiler warnings */
-							blue = red = green = alphabyte = 0;
-						}
-						column++;
-						if (column == columns) // pixel packet run spans across rows
-						{
-							column = 0;
-							if (row > 0)
-								row--;
-							else
-								goto breakOut;
-							// johnfitz -- fix for upside-down targas
-							realrow = upside_down ? row : rows - 1 - row;
-							pixbuf = targa_rgba + realrow * columns * 4;
-							// johnfitz
-						}
-					}
+					column = 0;
+					if (++filerow == rows)
+						break;
+					pixbuf = TARGA_ROW (filerow);
 				}
 			}
-		breakOut:;
+
+			if (truncated)
+				break;
 		}
 	}
 
-	Buf_Free (buf);
-	fclose (fin);
+#undef TARGA_ROW
+
+	Mem_Free (filedata);
 
 	*width = (int)(targa_header.width);
 	*height = (int)(targa_header.height);
-	return targa_rgba;
+	return (byte *)targa_rgba;
 }
 
 //==============================================================================
@@ -458,16 +557,28 @@ Image_LoadPCX
 */
 byte *Image_LoadPCX (FILE *f, int *width, int *height)
 {
-	pcxheader_t     pcx;
-	int             x, y, w, h, readbyte, runlength, start;
-	byte           *p, *data;
-	byte            palette[768];
-	stdio_buffer_t *buf;
+	pcxheader_t  pcx;
+	int          x, y, w, h, readbyte, runlength;
+	uint32_t    *p, *data;
+	uint32_t     palette[256];
+	const byte  *palbytes;
+	mem_buffer_t buf;
+	byte        *filedata;
+	int          i;
+
+	// read from the current position, since we might be inside a pak file
+	filedata = Buf_ReadFile (f, com_filesize, &buf);
+	fclose (f);
 
-	start = ftell (f); // save start of file (since we might be inside a pak file, SEEK_SET might not be the start of the pcx)
+	if (Buf_Remaining (&buf) < (int)sizeof (pcx) + 768)
+	{
+		Con_Printf ("'%s' is not a valid PCX file\n", loadfilename);
+		Mem_Free (filedata);
+		return NULL;
+	}
 
-	if (fread (&pcx, sizeof (pcx), 1, f) != 1)
-		Sys_Error ("'%s' is not a valid PCX file", loadfilename);
+	memcpy (&pcx, buf.pos, sizeof (pcx));
+	buf.pos += sizeof (pcx);
 
 	pcx.xmin = (unsigned short)LittleShort (pcx.xmin);
 	pcx.ymin = (unsigned short)LittleShort (pcx.ymin);
@@ -476,63 +587,78 @@ byte *Image_LoadPCX (FILE *f, int *width, int *height)
 	pcx.bytes_per_line = (unsigned short)LittleShort (pcx.bytes_per_line);
 
 	if (pcx.signature != 0x0A)
-		Sys_Error ("'%s' is not a valid PCX file", loadfilename);
+	{
+		Con_Printf ("'%s' is not a valid PCX file\n", loadfilename);
+		Mem_Free (filedata);
+		return NULL;
+	}
 
 	if (pcx.version != 5)
-		Sys_Error ("'%s' is version %i, should be 5", loadfilename, pcx.version);
+	{
+		Con_Printf ("'%s' is version %i, should be 5\n", loadfilename, pcx.version);
+		Mem_Free (filedata);
+		return NULL;
+	}
 
 	if (pcx.encoding != 1 || pcx.bits_per_pixel != 8 || pcx.color_planes != 1)
-		Sys_Error ("'%s' has wrong encoding or bit depth", loadfilename);
+	{
+		Con_Printf ("'%s' has wrong encoding or bit depth\n", loadfilename);
+		Mem_Free (filedata);
+		return NULL;
+	}
 
 	w = pcx.xmax - pcx.xmin + 1;
 	h = pcx.ymax - pcx.ymin + 1;
+	if (w <= 0 || h <= 0 || (int64_t)w * h > INT_MAX / 4)
+	{
+		Con_Printf ("'%s' has a bad size (%ix%i)\n", loadfilename, w, h);
+		Mem_Free (filedata);
+		return NULL;
+	}
 
-	data = (byte *)Mem_Alloc ((w * h + 1) * 4); //+1 to allow reading padding byte on last line
-
-	// load palette
-	fseek (f, start + com_filesize - 768, SEEK_SET);
-	if (fread (palette, 1, 768, f) != 768)
-		Sys_Error ("'%s' is not a valid PCX file", loadfilename);
-
-	// back to start of image data
-	fseek (f, start + sizeof (pcx), SEEK_SET);
+	data = (uint32_t *)Mem_Alloc (w * h * 4);
 
-	buf = Buf_Alloc (f);
+	// palette sits at the end of the file
+	buf.end -= 768;
+	palbytes = buf.end;
+	for (i = 0; i < 256; i++)
+		palette[i] = Image_MakePixel (palbytes[i * 3], palbytes[i * 3 + 1], palbytes[i * 3 + 2], 255);
 
 	for (y = 0; y < h; y++)
 	{
-		p = data + y * w * 4;
+		p = data + y * w;
 
 		for (x = 0; x < (pcx.bytes_per_line);) // read the extra padding byte if necessary
 		{
-			readbyte = Buf_GetC (buf);
+			readbyte = Buf_GetC (&buf);
+			if (readbyte == EOF)
+				goto done;
 
 			if (readbyte >= 0xC0)
 			{
 				runlength = readbyte & 0x3F;
-				readbyte = Buf_GetC (buf);
+				readbyte = Buf_GetC (&buf);
+				if (readbyte == EOF)
+					goto done;
+				if (x < w)
+					Image_FillPixels (p + x, palette[readbyte], q_min (runlength, w - x));
+				x += runlength;
 			}
 			else
-				runlength = 1;
-
-			while (runlength--)
 			{
-				p[0] = palette[readbyte * 3];
-				p[1] = palette[readbyte * 3 + 1];
-				p[2] = palette[readbyte * 3 + 2];
-				p[3] = 255;
-				p += 4;
+				if (x < w)
+					p[x] = palette[readbyte];
 				x++;
 			}
 		}
 	}
 
-	Buf_Free (buf);
-	fclose (f);
+done:
+	Mem_Free (filedata);
 
 	*width = w;
 	*height = h;
-	return data;
+	return (byte *)data;
 }
 
 //==============================================================================
@@ -657,3 +783,149 @@ qboolean Image_WritePNG (const char *name, byte *data, int width, int height, in
 
 	return (error == 0);
 }
+
+//==============================================================================
+//
+//  BENCHMARK
+//
+//==============================================================================
+
+typedef struct
+{
+	char   name[MAX_QPATH];
+	double time;
+	int    pixels;
+} imagebench_file_t;
+
+/*
+============
+Image_Benchmark_AddFile
+============
+*/
+static void Image_Benchmark_AddFile (const char *dir, const char *filename, imagebench_file_t **files, int *numfiles)
+{
+	const char *ext = COM_FileGetExtension (filename);
+	int         i;
+
+	if (q_strcasecmp (ext, "tga") && q_strcasecmp (ext, "pcx"))
+		return;
+
+	imagebench_file_t file;
+	memset (&file, 0, sizeof (file));
+	q_snprintf (file.name, sizeof (file.name), "%s/%s", dir, filename);
+	for (i = 0; i < *numfiles; i++)
+		if (!strcmp ((*files)[i].name, file.name))
+			return; // shadowed by an earlier game directory
+
+	*files = (imagebench_file_t *)Mem_Realloc (*files, (*numfiles + 1) * sizeof (imagebench_file_t));
+	(*files)[(*numfiles)++] = file;
+}
+
+/*
+============
+Image_Benchmark_f
+
+imagebench <dir> [passes]
+
+Decodes every tga/pcx file found in <dir> of the game directories and
+reports the decode time. Toggle r_simd to compare the scalar paths.
+============
+*/
+void Image_Benchmark_f (void)
+{
+	imagebench_file_t *files = NULL;
+	int                numfiles = 0;
+	int                passes, pass, i;
+	searchpath_t      *search;
+	char               filestring[MAX_OSPATH];
+	const char        *dir;
+	double             total_time = 0.0;
+	double             total_pixels = 0.0;
+	int                slowest = -1;
+
+	if (Cmd_Argc () < 2)
+	{
+		Con_Printf ("imagebench <dir> [passes] : decode all tga/pcx images in <dir>\n");
+		return;
+	}
+
+	dir = Cmd_Argv (1);
+	passes = (Cmd_Argc () >= 3) ? q_max (atoi (Cmd_Argv (2)), 1) : 3;
+
+	for (search = com_searchpaths; search; search = search->next)
+	{
+		if (!*search->filename) // pakfiles are not listed
+			continue;
+#ifdef _WIN32
+		WIN32_FIND_DATA fdat;
+		HANDLE          fhnd;
+		q_snprintf (filestring, sizeof (filestring), "%s/%s/*.*", search->filename, dir);
+		fhnd = FindFirstFile (filestring, &fdat);
+		if (fhnd == INVALID_HANDLE_VALUE)
+			continue;
+		do
+		{
+			Image_Benchmark_AddFile (dir, fdat.cFileName, &files, &numfiles);
+		} while (FindNextFile (fhnd, &fdat));
+		FindClose (fhnd);
+#else
+		DIR           *dir_p;
+		struct dirent *dir_t;
+		q_snprintf (filestring, sizeof (filestring), "%s/%s", search->filename, dir);
+		dir_p = opendir (filestring);
+		if (dir_p == NULL)
+			continue;
+		while ((dir_t = readdir (dir_p)) != NULL)
+			Image_Benchmark_AddFile (dir, dir_t->d_name, &files, &numfiles);
+		closedir (dir_p);
+#endif
+	}
+
+	if (!numfiles)
+	{
+		Con_Printf ("no tga/pcx images found in %s\n", dir);
+		return;
+	}
+
+	for (pass = 0; pass < passes; pass++)
+	{
+		for (i = 0; i < numfiles; i++)
+		{
+			FILE  *f;
+			byte  *data = NULL;
+			int    width = 0, height = 0;
+			double start;
+
+			q_strlcpy (loadfilename, files[i].name, sizeof (loadfilename));
+			COM_FOpenFile (loadfilename, &f, NULL);
+			if (!f)
+				continue;
+
+			start = Sys_DoubleTime ();
+			if (!q_strcasecmp (COM_FileGetExtension (loadfilename), "tga"))
+				data = Image_LoadTGA (f, &width, &height, loadfilename);
+			else
+				data = Image_LoadPCX (f, &width, &height);
+			files[i].time += Sys_DoubleTime () - start;
+			files[i].pixels = width * height;
+			Mem_Free (data);
+		}
+	}
+
+	for (i = 0; i < numfiles; i++)
+	{
+		const double ms = files[i].time * 1000.0 / passes;
+		Con_DPrintf ("%8.3f ms  %5.1f Mpix/s  %s\n", ms, files[i].time > 0.0 ? files[i].pixels * passes / files[i].time / 1e6 : 0.0, files[i].name);
+		total_time += files[i].time;
+		total_pixels += (double)files[i].pixels * passes;
+		if (slowest < 0 || files[i].time > files[slowest].time)
+			slowest = i;
+	}
+
+	Con_Printf (
+		"%i images, %i passes: %.3f ms per pass, %.1f Mpix/s (simd %s)\n", numfiles, passes, total_time * 1000.0 / passes,
+		total_time > 0.0 ? total_pixels / total_time / 1e6 : 0.0, use_simd ? "on" : "off");
+	Con_Printf ("slowest: %s, %.3f ms\n", files[slowest].name, files[slowest].time * 1000.0 / passes);
+
+	Mem_Free (files);
+}
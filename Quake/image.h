@@ -34,4 +34,6 @@ qboolean Image_WriteTGA (const char *name, byte *data, int width, int height, in
 qboolean Image_WritePNG (const char *name, byte *data, int width, int height, int bpp, qboolean upsidedown);
 qboolean Image_WriteJPG (const char *name, byte *data, int width, int height, int bpp, int quality, qboolean upsidedown);
 
+void Image_Benchmark_f (void);
+
 #endif /* GL_IMAGE_H */
@@ -55,6 +55,8 @@ struct qsocket_s *NET_CheckNewConnections (void);
 
 struct qsocket_s *NET_Connect (const char *host);
 // called by client to connect to a host.  Returns -1 if not able to
+struct qsocket_s *NET_ConnectAddress (const char *host);
+// like NET_Connect, but without the server list lookup
 
 double      NET_QSocketGetTime (const struct qsocket_s *sock);
 const char *NET_QSocketGetTrueAddressString (const struct qsocket_s *sock);
@@ -91,6 +93,9 @@ int NET_SendUnreliableMessage (struct qsocket_s *sock, sizebuf_t *data);
 int NET_SendToAll (sizebuf_t *data, double blocktime);
 // This is a reliable *blocking* send to all attached clients.
 
+void NET_BatchWrites (qboolean batch);
+// Lets the lan drivers collect datagrams and send them with fewer syscalls.
+
 void NET_Close (struct qsocket_s *sock);
 // if a dead connection is returned by a get or send function, this function
 // should be called when it is convenient
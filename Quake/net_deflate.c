@@ -0,0 +1,293 @@
+/*
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// net_deflate.c -- NETEXT_DEFLATE message compression
+
+/*
+Every message is compressed on its own into a raw deflate stream, so a lost unreliable never breaks the ones after it.
+Our miniz is built without its compressor, so the encoder here is a small greedy LZ77 that emits a single block with
+the fixed huffman codes, and miniz's tinfl decodes it. Both sides prime the window with deflate_dictionary, strings
+taken from typical signon and gameplay traffic (precache lists, stufftext, obituaries), which is what makes short
+messages compress at all. The dictionary is part of the protocol: changing it breaks NETEXT_DEFLATE with older builds,
+and compressed demos recorded with them. Deflate_Compress and Deflate_Decompress share one window and are for the main
+thread; other threads compress with a deflater_t of their own.
+*/
+
+#include "quakedef.h"
+#include "miniz.h"
+#include "net_deflate.h"
+
+#define DEFLATE_HASHBITS 13
+#define DEFLATE_HASHSIZE (1 << DEFLATE_HASHBITS)
+#define DEFLATE_MINMATCH 3
+#define DEFLATE_MAXMATCH 258
+#define DEFLATE_MAXDIST  32768
+#define DEFLATE_MAXCHAIN 32 // match candidates looked at per position
+
+// the most common strings go last, where their distances are shortest
+static const char deflate_dictionary[] =
+	" was gibbed by \n\0 was ax-murdered by \n\0 was nailed by \n\0 was punctured by \n\0 eats \0's pineapple\n\0 rides \0's rocket\n\0"
+	" accepts \0's shaft\n\0 chewed on \0's boomstick\n\0 ate 2 loads of \0's buckshot\n\0 was telefragged by \n\0 becomes bored with life\n\0"
+	" tried to leave\n\0 sleeps with the fishes\n\0 visits the Volcano God\n\0 entered the game\n\0 left the game with \0 frags\n\0"
+	"ambience/buzz1.wav\0ambience/fire1.wav\0ambience/hum1.wav\0ambience/drip1.wav\0ambience/comp1.wav\0ambience/swamp1.wav\0"
+	"ambience/swamp2.wav\0ambience/water1.wav\0ambience/wind2.wav\0ambience/thunder1.wav\0doors/drclos4.wav\0doors/doormv1.wav\0"
+	"doors/stndr1.wav\0doors/stndr2.wav\0doors/basesec1.wav\0doors/basesec2.wav\0doors/medtry.wav\0doors/meduse.wav\0"
+	"plats/plat1.wav\0plats/plat2.wav\0plats/medplat1.wav\0plats/medplat2.wav\0buttons/switch21.wav\0buttons/airbut1.wav\0"
+	"misc/null.wav\0misc/talk.wav\0misc/water1.wav\0misc/water2.wav\0misc/outwater.wav\0misc/h2ohit1.wav\0misc/r_tele1.wav\0"
+	"misc/r_tele2.wav\0misc/r_tele3.wav\0misc/r_tele4.wav\0misc/r_tele5.wav\0misc/power.wav\0misc/secret.wav\0misc/trigger1.wav\0"
+	"items/armor1.wav\0items/health1.wav\0items/r_item1.wav\0items/r_item2.wav\0items/itembk2.wav\0items/damage.wav\0"
+	"items/damage2.wav\0items/damage3.wav\0items/protect.wav\0items/protect2.wav\0items/protect3.wav\0items/inv1.wav\0"
+	"player/plyrjmp8.wav\0player/land.wav\0player/land2.wav\0player/drown1.wav\0player/drown2.wav\0player/gasp1.wav\0"
+	"player/gasp2.wav\0player/h2odeath.wav\0player/h2ojump.wav\0player/inh2o.wav\0player/inlava.wav\0player/slimbrn2.wav\0"
+	"player/lburn1.wav\0player/lburn2.wav\0player/tornoff2.wav\0player/udeath.wav\0player/gib.wav\0player/teledth1.wav\0"
+	"player/pain1.wav\0player/pain2.wav\0player/pain3.wav\0player/pain4.wav\0player/pain5.wav\0player/pain6.wav\0"
+	"player/death1.wav\0player/death2.wav\0player/death3.wav\0player/death4.wav\0player/death5.wav\0demon/dland2.wav\0"
+	"weapons/r_exp3.wav\0weapons/rocket1i.wav\0weapons/sgun1.wav\0weapons/guncock.wav\0weapons/ric1.wav\0weapons/ric2.wav\0"
+	"weapons/ric3.wav\0weapons/spike2.wav\0weapons/tink1.wav\0weapons/grenade.wav\0weapons/bounce.wav\0weapons/shotgn2.wav\0"
+	"weapons/lhit.wav\0weapons/lstart.wav\0weapons/pkup.wav\0weapons/ax1.wav\0weapons/lock4.wav\0weapons/noammo.wav\0"
+	"maps/b_bh10.bsp\0maps/b_bh25.bsp\0maps/b_bh100.bsp\0maps/b_shell0.bsp\0maps/b_shell1.bsp\0maps/b_nail0.bsp\0"
+	"maps/b_nail1.bsp\0maps/b_rock0.bsp\0maps/b_rock1.bsp\0maps/b_batt0.bsp\0maps/b_batt1.bsp\0maps/b_explob.bsp\0"
+	"progs/s_bubble.spr\0progs/s_explod.spr\0progs/s_light.spr\0progs/bolt.mdl\0progs/bolt2.mdl\0progs/bolt3.mdl\0"
+	"progs/lavaball.mdl\0progs/missile.mdl\0progs/grenade.mdl\0progs/spike.mdl\0progs/s_spike.mdl\0progs/backpack.mdl\0"
+	"progs/zom_gib.mdl\0progs/armor.mdl\0progs/g_shot.mdl\0progs/g_nail.mdl\0progs/g_nail2.mdl\0progs/g_rock.mdl\0"
+	"progs/g_rock2.mdl\0progs/g_light.mdl\0progs/quaddama.mdl\0progs/invulner.mdl\0progs/invisibl.mdl\0progs/suit.mdl\0"
+	"progs/v_axe.mdl\0progs/v_shot.mdl\0progs/v_shot2.mdl\0progs/v_nail.mdl\0progs/v_nail2.mdl\0progs/v_rock.mdl\0"
+	"progs/v_rock2.mdl\0progs/v_light.mdl\0progs/gib1.mdl\0progs/gib2.mdl\0progs/gib3.mdl\0progs/h_player.mdl\0"
+	"progs/eyes.mdl\0progs/player.mdl\0*20\0*19\0*18\0*17\0*16\0*15\0*14\0*13\0*12\0*11\0*10\0*9\0*8\0*7\0*6\0*5\0*4\0*3\0*2\0*1\0"
+	"deathmatch\0coop\0teamplay\0fraglimit\0timelimit\0samelevel\0noexit\0skill\0"
+	"cmd prespawn\n\0cmd spawn \n\0cmd begin\n\0cmd pext\n\0reconnect\n\0fov 90\n\0bf\n\0";
+
+#define DEFLATE_DICTSIZE ((int)sizeof (deflate_dictionary) - 1)
+
+static const unsigned short length_base[] = {3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+                                             31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const byte           length_extra[] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const unsigned short dist_base[] = {1,   2,   3,   4,   5,   7,    9,    13,   17,   25,   33,   49,   65,    97,    129,
+                                           193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const byte           dist_extra[] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+struct deflater_s
+{
+	byte window[DEFLATE_DICTSIZE + NET_MAXMESSAGE]; // the dictionary, then the message being worked on
+	int  head[DEFLATE_HASHSIZE];
+	int  prev[DEFLATE_DICTSIZE + NET_MAXMESSAGE];
+};
+
+static deflater_t         deflate_state;
+static int                deflate_dicthead[DEFLATE_HASHSIZE]; // head with only the dictionary in it
+static tinfl_decompressor deflate_inflator;
+
+typedef struct
+{
+	byte        *out;
+	int          outlen; // keeps counting past outmax, so the caller can tell it overflowed
+	int          outmax;
+	unsigned int bits;
+	int          numbits;
+} bitwriter_t;
+
+static unsigned int Deflate_Hash (const byte *p)
+{
+	return (((unsigned int)p[0] << 16 | (unsigned int)p[1] << 8 | p[2]) * 2654435761u) >> (32 - DEFLATE_HASHBITS);
+}
+
+static void Deflate_Insert (deflater_t *d, int pos)
+{
+	unsigned int h = Deflate_Hash (d->window + pos);
+
+	d->prev[pos] = d->head[h];
+	d->head[h] = pos;
+}
+
+// deflate packs everything from the least significant bit up
+static void Deflate_PutBits (bitwriter_t *w, unsigned int value, int count)
+{
+	w->bits |= value << w->numbits;
+	w->numbits += count;
+	while (w->numbits >= 8)
+	{
+		if (w->outlen < w->outmax)
+			w->out[w->outlen] = (byte)w->bits;
+		w->outlen++;
+		w->bits >>= 8;
+		w->numbits -= 8;
+	}
+}
+
+// ...except huffman codes, which start at their most significant bit
+static void Deflate_PutCode (bitwriter_t *w, unsigned int code, int length)
+{
+	unsigned int reversed = 0;
+	int          i;
+
+	for (i = 0; i < length; i++, code >>= 1)
+		reversed = (reversed << 1) | (code & 1);
+	Deflate_PutBits (w, reversed, length);
+}
+
+static void Deflate_PutSymbol (bitwriter_t *w, int symbol)
+{
+	if (symbol < 144)
+		Deflate_PutCode (w, 0x30 + symbol, 8);
+	else if (symbol < 256)
+		Deflate_PutCode (w, 0x190 + symbol - 144, 9);
+	else if (symbol < 280)
+		Deflate_PutCode (w, symbol - 256, 7);
+	else
+		Deflate_PutCode (w, 0xc0 + symbol - 280, 8);
+}
+
+static void Deflate_PutMatch (bitwriter_t *w, int length, int distance)
+{
+	int i;
+
+	for (i = countof (length_base) - 1; length_base[i] > length; i--)
+		;
+	Deflate_PutSymbol (w, 257 + i);
+	Deflate_PutBits (w, length - length_base[i], length_extra[i]);
+
+	for (i = countof (dist_base) - 1; dist_base[i] > distance; i--)
+		;
+	Deflate_PutCode (w, i, 5);
+	Deflate_PutBits (w, distance - dist_base[i], dist_extra[i]);
+}
+
+/*
+===================
+Deflate_Init
+===================
+*/
+void Deflate_Init (void)
+{
+	int i;
+
+	memcpy (deflate_state.window, deflate_dictionary, DEFLATE_DICTSIZE);
+	for (i = 0; i < DEFLATE_HASHSIZE; i++)
+		deflate_state.head[i] = -1;
+	for (i = 0; i + DEFLATE_MINMATCH <= DEFLATE_DICTSIZE; i++)
+		Deflate_Insert (&deflate_state, i);
+	memcpy (deflate_dicthead, deflate_state.head, sizeof (deflate_dicthead));
+}
+
+/*
+===================
+Deflate_AllocState
+
+The dictionary part of the window and its hash chains never change, so a copy is ready to go. Free with Mem_Free.
+===================
+*/
+deflater_t *Deflate_AllocState (void)
+{
+	deflater_t *d = (deflater_t *)Mem_Alloc (sizeof (deflater_t));
+
+	memcpy (d->window, deflate_state.window, DEFLATE_DICTSIZE);
+	memcpy (d->prev, deflate_state.prev, DEFLATE_DICTSIZE * sizeof (int));
+	return d;
+}
+
+/*
+===================
+Deflate_CompressWith
+
+Returns the compressed length, or -1 if it would take more than outmax bytes
+===================
+*/
+int Deflate_CompressWith (deflater_t *d, const byte *in, int inlen, byte *out, int outmax)
+{
+	bitwriter_t w = {out, 0, outmax, 0, 0};
+	int         end = DEFLATE_DICTSIZE + inlen;
+	int         pos, match, length, maxlength, bestlength, bestdistance, chain;
+
+	if (inlen <= 0 || inlen > NET_MAXMESSAGE)
+		return -1;
+	memcpy (d->window + DEFLATE_DICTSIZE, in, inlen);
+	memcpy (d->head, deflate_dicthead, sizeof (d->head));
+
+	Deflate_PutBits (&w, 1 | (1 << 1), 3); // final block, fixed huffman codes
+	for (pos = DEFLATE_DICTSIZE; pos < end && w.outlen <= outmax;)
+	{
+		maxlength = q_min (end - pos, DEFLATE_MAXMATCH);
+		bestlength = bestdistance = 0;
+		if (maxlength >= DEFLATE_MINMATCH)
+		{
+			match = d->head[Deflate_Hash (d->window + pos)];
+			for (chain = DEFLATE_MAXCHAIN; match >= 0 && pos - match <= DEFLATE_MAXDIST && chain--; match = d->prev[match])
+			{
+				if (d->window[match + bestlength] != d->window[pos + bestlength])
+					continue; // can't beat what we have
+				for (length = 0; length < maxlength && d->window[match + length] == d->window[pos + length]; length++)
+					;
+				if (length > bestlength)
+				{
+					bestlength = length;
+					bestdistance = pos - match;
+					if (length == maxlength)
+						break;
+				}
+			}
+		}
+
+		if (bestlength >= DEFLATE_MINMATCH)
+			Deflate_PutMatch (&w, bestlength, bestdistance);
+		else
+		{
+			Deflate_PutSymbol (&w, d->window[pos]);
+			bestlength = 1;
+		}
+		for (; bestlength--; pos++)
+			if (pos + DEFLATE_MINMATCH <= end)
+				Deflate_Insert (d, pos);
+	}
+	Deflate_PutSymbol (&w, 256); // end of block
+	Deflate_PutBits (&w, 0, 7);  // flush the last partial byte
+
+	return (w.outlen <= outmax) ? w.outlen : -1;
+}
+
+/*
+===================
+Deflate_Compress
+===================
+*/
+int Deflate_Compress (const byte *in, int inlen, byte *out, int outmax)
+{
+	return Deflate_CompressWith (&deflate_state, in, inlen, out, outmax);
+}
+
+/*
+===================
+Deflate_Decompress
+
+Returns the decompressed length, or -1 if the data is corrupt or inflates to more than outmax bytes
+===================
+*/
+int Deflate_Decompress (const byte *in, int inlen, byte *out, int outmax)
+{
+	size_t       insize = inlen;
+	size_t       outsize = q_min (outmax, NET_MAXMESSAGE);
+	tinfl_status status;
+
+	tinfl_init (&deflate_inflator);
+	status = tinfl_decompress (
+		&deflate_inflator, in, &insize, deflate_state.window, deflate_state.window + DEFLATE_DICTSIZE, &outsize, TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+	if (status != TINFL_STATUS_DONE)
+		return -1;
+
+	memcpy (out, deflate_state.window + DEFLATE_DICTSIZE, outsize);
+	return (int)outsize;
+}
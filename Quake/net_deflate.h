@@ -0,0 +1,31 @@
+/*
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+#ifndef __NET_DEFLATE_H
+#define __NET_DEFLATE_H
+
+// net_deflate.h -- NETEXT_DEFLATE message compression
+typedef struct deflater_s deflater_t;
+
+void        Deflate_Init (void);
+deflater_t *Deflate_AllocState (void);
+int         Deflate_CompressWith (deflater_t *d, const byte *in, int inlen, byte *out, int outmax);
+int         Deflate_Compress (const byte *in, int inlen, byte *out, int outmax);
+int         Deflate_Decompress (const byte *in, int inlen, byte *out, int outmax);
+
+#endif /* __NET_DEFLATE_H */
@@ -54,6 +54,7 @@ struct qsockaddr
 #define NETFLAG_NAK         0x00040000
 #define NETFLAG_EOM         0x00080000
 #define NETFLAG_UNRELIABLE  0x00100000
+#define NETFLAG_COMPRESSED  0x00200000 // NETEXT_DEFLATE: the message this belongs to was deflated
 #define NETFLAG_CTL         0x80000000
 
 #if (NETFLAG_LENGTH_MASK & NET_MAXMESSAGE) != NET_MAXMESSAGE
@@ -79,6 +80,12 @@ General notes:
 CCREQ_CONNECT
         string	game_name		"QUAKE"
         byte	net_protocol_version	NET_PROTOCOL_VERSION
+    optional, proquake:
+        byte	mod			1
+        byte	mod_version
+        byte	mod_flags
+        long	mod_password
+        long	net_extensions		NETEXT_* the client supports
 
 CCREQ_SERVER_INFO
         string	game_name		"QUAKE"
@@ -92,6 +99,11 @@ CCREQ_RULE_INFO
 
 CCREP_ACCEPT
         long	port
+    optional, only if the client sent the proquake fields:
+        byte	mod			1
+        byte	mod_version
+        byte	mod_flags
+        long	net_extensions		NETEXT_* both sides will use
 
 CCREP_REJECT
         string	reason
@@ -141,22 +153,33 @@ CCREP_RULE_INFO
 #define CCREP_RULE_INFO   0x85
 #define CCREP_RCON        0x86
 
+// net_extensions bits
+#define NETEXT_WINDOW  0x00000001 // windowed reliable stream with selective acks instead of stop-and-wait
+#define NETEXT_DEFLATE 0x00000002 // large messages may be deflated, see net_deflate.c. only together with NETEXT_WINDOW
+
 typedef struct qsocket_s
 {
-	struct qsocket_s *next;
-	double            connecttime;
-	double            lastMessageTime;
-	double            lastSendTime;
+	struct qsocket_s  *next;
+	struct qsocket_s  *hashnext; // address hash chain, see NET_HashQSocket
+	struct qsocket_s **hashprev;
+	struct qsocket_s  *wheelnext; // resend/timeout timer wheel, see NET_ScheduleQSocket
+	struct qsocket_s **wheelprev;
+	int64_t            wheeltick;
+	double             connecttime;
+	double             lastMessageTime;
+	double             lastSendTime;
 
 	qboolean isvirtual; // qsocket is emulated by the network layer (closing will not close any system sockets).
 	qboolean disconnected;
 	qboolean canSend;
 	qboolean sendNext;
 
-	int          driver;
-	int          landriver;
-	sys_socket_t socket;
-	void        *driverdata;
+	int                 driver;
+	int                 landriver;
+	sys_socket_t        socket;
+	void               *driverdata;
+	struct netwindow_s *window;   // NETEXT_WINDOW state, if negotiated
+	qboolean            compress; // NETEXT_DEFLATE negotiated
 
 	unsigned int ackSequence;
 	unsigned int sendSequence;
@@ -176,6 +199,16 @@ typedef struct qsocket_s
 	qboolean proquake_angle_hack;  // 1 if we're trying, 2 if the server acked.
 	int      max_datagram;         // 32000 for local, 1442 for 666, 1024 for 15. this is for reliable fragments.
 	int      pending_max_datagram; // don't change the mtu if we're resending, as that would confuse the peer.
+
+	// NETEXT_DEFLATE accounting, for net_compressstats
+	int64_t deflateIn;  // bytes offered to the compressor
+	int64_t deflateOut; // what went on the wire for them, compressed or not
+	int64_t inflateIn;
+	int64_t inflateOut;
+	int     deflateMessages;
+	int     inflateMessages;
+	double  deflateTime;
+	double  inflateTime;
 } qsocket_t;
 
 extern qsocket_t *net_activeSockets;
@@ -206,6 +239,7 @@ typedef struct
 	int (*AddrCompare) (struct qsockaddr *addr1, struct qsockaddr *addr2);
 	int (*GetSocketPort) (struct qsockaddr *addr);
 	int (*SetSocketPort) (struct qsockaddr *addr, int port);
+	void (*BatchWrites) (qboolean batch); // optional, queues Writes until called with false
 
 	sys_socket_t listeningSock;
 } net_landriver_t;
@@ -249,6 +283,15 @@ extern int unreliableMessagesReceived;
 
 qsocket_t *NET_NewQSocket (void);
 void       NET_FreeQSocket (qsocket_t *);
+void       NET_HashQSocket (qsocket_t *sock);
+void       NET_UnhashQSocket (qsocket_t *sock);
+qsocket_t *NET_FindQSocket (int landriver, struct qsockaddr *addr);
+
+#define NET_WHEEL_SLOTS 256  // must be a power of two
+#define NET_WHEEL_HZ    64.0 // wheel ticks per second, the wheel spans NET_WHEEL_SLOTS / NET_WHEEL_HZ seconds
+void       NET_ScheduleQSocket (qsocket_t *sock, double when);
+void       NET_UnscheduleQSocket (qsocket_t *sock);
+qsocket_t *NET_NextDueQSocket (void);
 double     SetNetTime (void);
 
 #define HOSTCACHESIZE 128 // fixme: make dynamic.
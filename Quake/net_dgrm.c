@@ -28,6 +28,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "quakedef.h"
 #include "net_defs.h"
 #include "net_dgrm.h"
+#include "net_sim.h"
+#include "net_deflate.h"
 
 // these two macros are to make the code more readable
 #define sfunc net_landrivers[sock->landriver]
@@ -61,6 +63,10 @@ cvar_t net_masters[] = {
 	{"net_masterextra3", "dpmaster.tchr.no:27950"},
 	{NULL}};
 cvar_t        rcon_password = {"rcon_password", ""};
+cvar_t        net_window = {"net_window", "1"}; // offer/accept NETEXT_WINDOW on new connections
+cvar_t        net_compress = {"net_compress", "1"}; // offer/accept NETEXT_DEFLATE on new connections
+cvar_t        net_compress_min = {"net_compress_min", "128"}; // reliables shorter than this are sent as they are
+cvar_t        net_compress_unreliable = {"net_compress_unreliable", "0"}; // deflate unreliables too, of any size
 extern cvar_t net_messagetimeout;
 extern cvar_t net_connecttimeout;
 
@@ -71,6 +77,42 @@ static struct
 	byte         data[MAX_DATAGRAM];
 } packetBuffer;
 
+/*
+NETEXT_WINDOW reliable stream:
+Reliable messages are cut into fragments of up to NET_WINDOW_FRAGSIZE bytes, the last one flagged with NETFLAG_EOM.
+Up to NET_WINDOW_SIZE fragments may be unacked at any time, and the receiver buffers that far ahead of the next one it
+needs. Every data packet is answered with an ack whose sequence is the first fragment not received yet (everything
+before it arrived), followed by two big-endian longs: bit i of that 64-bit mask means sequence+1+i arrived too.
+Fragments are resent when they're older than the RTT-based retransmit timeout, or when three later fragments got
+acked without them.
+*/
+#define NET_WINDOW_SIZE     64  // fragments in flight, and how far ahead the receiver buffers
+#define NET_WINDOW_QUEUE    128 // outgoing fragments queued per connection, must be a power of two
+#define NET_WINDOW_FRAGSIZE 1400
+#define NET_WINDOW_MINRTO   0.2
+#define NET_WINDOW_MAXRTO   3.0
+
+typedef struct
+{
+	double   sendtime;
+	int      sends; // 0 while it's waiting for the window to open
+	qboolean acked; // selectively acked when sending, arrived when receiving
+	qboolean eom;
+	qboolean compressed;
+	int      length;
+	byte     data[NET_WINDOW_FRAGSIZE];
+} netfragment_t;
+
+typedef struct netwindow_s
+{
+	netfragment_t send[NET_WINDOW_QUEUE]; // by sequence & (NET_WINDOW_QUEUE - 1)
+	netfragment_t recv[NET_WINDOW_SIZE];  // by sequence % NET_WINDOW_SIZE
+	unsigned int  txSequence;             // first queued fragment that hasn't been sent yet
+	double        srtt;
+	double        rttvar;
+	double        rto;
+} netwindow_t;
+
 static int myDriverLevel;
 
 extern qboolean m_return_onerror;
@@ -148,6 +190,419 @@ static void NET_Ban_f (void)
 }
 #endif // BAN_TEST
 
+static netwindow_t *Datagram_NewWindow (void)
+{
+	netwindow_t *w = (netwindow_t *)Mem_Alloc (sizeof (netwindow_t));
+	w->rto = 1.0; // same as the old fixed resend delay until we have an rtt sample
+	return w;
+}
+
+static unsigned int Datagram_Extensions (void)
+{
+	if (!net_window.value)
+		return 0; // NETEXT_DEFLATE only flags the windowed stream's fragments
+	return NETEXT_WINDOW | (net_compress.value ? NETEXT_DEFLATE : 0);
+}
+
+/*
+===================
+Datagram_Compress
+
+Deflates an outgoing message for a NETEXT_DEFLATE connection, if that makes it
+any smaller. The result is only valid until the next call.
+===================
+*/
+static qboolean Datagram_Compress (qsocket_t *sock, const byte **data, int *length)
+{
+	static byte deflated[NET_MAXMESSAGE];
+	double      time = Sys_DoubleTime ();
+	int         size = Deflate_Compress (*data, *length, deflated, *length - 1);
+
+	sock->deflateTime += Sys_DoubleTime () - time;
+	sock->deflateMessages++;
+	sock->deflateIn += *length;
+	if (size <= 0)
+	{
+		sock->deflateOut += *length;
+		return false;
+	}
+	sock->deflateOut += size;
+	*data = deflated;
+	*length = size;
+	return true;
+}
+
+/*
+===================
+Datagram_Deliver
+
+Puts a received message into net_message, inflating it if it was sent
+compressed. Returns false for corrupt or over-sized data.
+===================
+*/
+static qboolean Datagram_Deliver (qsocket_t *sock, const byte *data, int length, qboolean compressed)
+{
+	double time;
+	int    size;
+
+	SZ_Clear (&net_message);
+	if (!compressed)
+	{
+		SZ_Write (&net_message, data, length);
+		return true;
+	}
+	if (!sock->compress)
+		return false;
+
+	time = Sys_DoubleTime ();
+	size = Deflate_Decompress (data, length, net_message.data, net_message.maxsize);
+	sock->inflateTime += Sys_DoubleTime () - time;
+	if (size < 0)
+		return false;
+
+	net_message.cursize = size;
+	sock->inflateMessages++;
+	sock->inflateIn += length;
+	sock->inflateOut += size;
+	return true;
+}
+
+static void Datagram_WindowCanSend (qsocket_t *sock)
+{
+	// leave room for the largest message the caller might hand us next
+	int fragsize = q_min (sock->pending_max_datagram, NET_WINDOW_FRAGSIZE);
+	int needed = q_min ((NET_MAXMESSAGE + fragsize - 1) / fragsize, NET_WINDOW_QUEUE);
+
+	sock->canSend = NET_WINDOW_QUEUE - (int)(sock->sendSequence - sock->ackSequence) >= needed;
+}
+
+static int Datagram_WindowTransmit (qsocket_t *sock, unsigned int sequence)
+{
+	netfragment_t *frag = &sock->window->send[sequence & (NET_WINDOW_QUEUE - 1)];
+	unsigned int   packetLen = NET_HEADERSIZE + frag->length;
+
+	packetBuffer.length = BigLong (packetLen | NETFLAG_DATA | (frag->eom ? NETFLAG_EOM : 0) | (frag->compressed ? NETFLAG_COMPRESSED : 0));
+	packetBuffer.sequence = BigLong (sequence);
+	memcpy (packetBuffer.data, frag->data, frag->length);
+
+	if (frag->sends++)
+		packetsReSent++;
+	else
+		packetsSent++;
+	frag->sendtime = net_time;
+	sock->lastSendTime = net_time;
+
+	return sfunc.Write (sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr);
+}
+
+/*
+===================
+Datagram_WindowFill
+
+Sends queued fragments for as long as the window has room
+===================
+*/
+static int Datagram_WindowFill (qsocket_t *sock)
+{
+	netwindow_t *w = sock->window;
+
+	while (w->txSequence != sock->sendSequence && w->txSequence - sock->ackSequence < NET_WINDOW_SIZE)
+	{
+		if (Datagram_WindowTransmit (sock, w->txSequence++) == -1)
+			return -1;
+	}
+	return 1;
+}
+
+static void Datagram_WindowRTT (netwindow_t *w, double rtt)
+{
+	if (!w->srtt)
+	{
+		w->srtt = rtt;
+		w->rttvar = rtt / 2;
+	}
+	else
+	{
+		w->rttvar = 0.75 * w->rttvar + 0.25 * fabs (w->srtt - rtt);
+		w->srtt = 0.875 * w->srtt + 0.125 * rtt;
+	}
+	w->rto = CLAMP (NET_WINDOW_MINRTO, w->srtt + 4 * w->rttvar, NET_WINDOW_MAXRTO);
+}
+
+/*
+===================
+Datagram_WindowTimeouts
+
+Resends every fragment that has been in flight for longer than the retransmit
+timeout, and backs the timeout off if there were any
+===================
+*/
+static void Datagram_WindowTimeouts (qsocket_t *sock)
+{
+	netwindow_t   *w = sock->window;
+	netfragment_t *frag;
+	unsigned int   sequence;
+	qboolean       lost = false;
+
+	for (sequence = sock->ackSequence; sequence != w->txSequence; sequence++)
+	{
+		frag = &w->send[sequence & (NET_WINDOW_QUEUE - 1)];
+		if (!frag->acked && net_time - frag->sendtime > w->rto)
+		{
+			Datagram_WindowTransmit (sock, sequence);
+			lost = true;
+		}
+	}
+	if (lost)
+		w->rto = q_min (w->rto * 2, NET_WINDOW_MAXRTO);
+}
+
+static double Datagram_WindowDeadline (qsocket_t *sock)
+{
+	netwindow_t   *w = sock->window;
+	netfragment_t *frag;
+	unsigned int   sequence;
+	double         when = DBL_MAX;
+
+	for (sequence = sock->ackSequence; sequence != w->txSequence; sequence++)
+	{
+		frag = &w->send[sequence & (NET_WINDOW_QUEUE - 1)];
+		if (!frag->acked)
+			when = q_min (when, frag->sendtime + w->rto);
+	}
+	return when;
+}
+
+static qboolean Datagram_WindowPending (qsocket_t *sock)
+{
+	return sock->window->recv[sock->receiveSequence % NET_WINDOW_SIZE].acked;
+}
+
+/*
+===================
+Datagram_NextCheck
+
+When Datagram_GetAnyMessage next needs to look at a virtual qsocket
+===================
+*/
+static double Datagram_NextCheck (qsocket_t *sock)
+{
+	double when;
+
+	if (sock->sendNext)
+		return net_time;
+	if (sock->window && Datagram_WindowPending (sock))
+		return net_time;
+
+	when = sock->lastMessageTime + ((!sock->ackSequence) ? net_connecttimeout.value : net_messagetimeout.value);
+	if (sock->window)
+		when = q_min (when, Datagram_WindowDeadline (sock));
+	else if (!sock->canSend)
+		when = q_min (when, sock->lastSendTime + 1.0);
+	return when;
+}
+
+static void Datagram_Reschedule (qsocket_t *sock)
+{
+	if (sock->isvirtual)
+		NET_ScheduleQSocket (sock, Datagram_NextCheck (sock));
+}
+
+static int Datagram_WindowSendMessage (qsocket_t *sock, sizebuf_t *data)
+{
+	netwindow_t   *w = sock->window;
+	netfragment_t *frag;
+	const byte    *payload = data->data;
+	int            length = data->cursize;
+	qboolean       compressed = false;
+	int            fragsize = q_min (sock->pending_max_datagram, NET_WINDOW_FRAGSIZE);
+	int            count, offset, i;
+
+	if (sock->compress && length >= net_compress_min.value)
+		compressed = Datagram_Compress (sock, &payload, &length);
+
+	count = q_max (1, (length + fragsize - 1) / fragsize);
+	if (count > NET_WINDOW_QUEUE - (int)(sock->sendSequence - sock->ackSequence))
+		return -1; // caller ignored canSend
+
+	for (i = 0, offset = 0; i < count; i++, offset += frag->length)
+	{
+		frag = &w->send[sock->sendSequence++ & (NET_WINDOW_QUEUE - 1)];
+		frag->length = q_min (fragsize, length - offset);
+		frag->eom = (i == count - 1);
+		frag->compressed = compressed;
+		frag->acked = false;
+		frag->sends = 0;
+		memcpy (frag->data, payload + offset, frag->length);
+	}
+
+	Datagram_WindowCanSend (sock);
+	if (Datagram_WindowFill (sock) == -1)
+		return -1;
+	Datagram_Reschedule (sock);
+	return 1;
+}
+
+/*
+===================
+Datagram_WindowAck
+
+Handles an ack for the windowed stream, length is that of the whole packet
+===================
+*/
+static void Datagram_WindowAck (qsocket_t *sock, unsigned int sequence, unsigned int length)
+{
+	netwindow_t   *w = sock->window;
+	netfragment_t *frag;
+	uint64_t       sack = 0;
+	unsigned int   s;
+	double         rtt = -1;
+	int            above;
+
+	if (sequence - sock->ackSequence > w->txSequence - sock->ackSequence)
+	{
+		Con_DPrintf ("Stale ACK received\n");
+		return;
+	}
+	// copy the mask out now, resending reuses packetBuffer
+	if (length >= NET_HEADERSIZE + 8)
+		sack = ((uint64_t)BigLong (((int *)packetBuffer.data)[0]) << 32) | (uint32_t)BigLong (((int *)packetBuffer.data)[1]);
+
+	// everything before sequence arrived. karn: only fragments that were sent once give a usable rtt
+	for (; sock->ackSequence != sequence; sock->ackSequence++)
+	{
+		frag = &w->send[sock->ackSequence & (NET_WINDOW_QUEUE - 1)];
+		if (frag->sends == 1 && !frag->acked)
+			rtt = net_time - frag->sendtime;
+	}
+	for (s = 0; s < NET_WINDOW_SIZE - 1; s++)
+	{
+		if (!(sack & ((uint64_t)1 << s)) || sequence + 1 + s - sock->ackSequence >= w->txSequence - sock->ackSequence)
+			continue;
+		frag = &w->send[(sequence + 1 + s) & (NET_WINDOW_QUEUE - 1)];
+		if (frag->sends == 1 && !frag->acked)
+			rtt = net_time - frag->sendtime;
+		frag->acked = true;
+	}
+	if (rtt >= 0)
+		Datagram_WindowRTT (w, rtt);
+
+	// fast retransmit for holes that three later fragments overtook, once they're also
+	// older than an rtt plus a quarter for reordering (which also limits it to once per rtt).
+	// without an rtt sample yet that would be every ack, so leave it to the timeout
+	for (s = w->txSequence, above = 0; s != sock->ackSequence;)
+	{
+		frag = &w->send[--s & (NET_WINDOW_QUEUE - 1)];
+		if (frag->acked)
+			above++;
+		else if (above >= 3 && w->srtt > 0 && net_time - frag->sendtime > w->srtt * 1.25)
+			Datagram_WindowTransmit (sock, s);
+	}
+
+	Datagram_WindowCanSend (sock);
+	Datagram_WindowFill (sock);
+	Datagram_Reschedule (sock);
+}
+
+static void Datagram_WindowSendAck (qsocket_t *sock)
+{
+	netwindow_t *w = sock->window;
+	unsigned int sequence, s;
+	uint64_t     sack = 0;
+
+	for (sequence = sock->receiveSequence; sequence - sock->receiveSequence < NET_WINDOW_SIZE; sequence++)
+		if (!w->recv[sequence % NET_WINDOW_SIZE].acked)
+			break;
+	for (s = sequence + 1; s - sock->receiveSequence < NET_WINDOW_SIZE; s++)
+		if (w->recv[s % NET_WINDOW_SIZE].acked)
+			sack |= (uint64_t)1 << (s - sequence - 1);
+
+	packetBuffer.length = BigLong ((NET_HEADERSIZE + 8) | NETFLAG_ACK);
+	packetBuffer.sequence = BigLong (sequence);
+	((int *)packetBuffer.data)[0] = BigLong ((int)(sack >> 32));
+	((int *)packetBuffer.data)[1] = BigLong ((int)sack);
+	sfunc.Write (sock->socket, (byte *)&packetBuffer, NET_HEADERSIZE + 8, &sock->addr);
+}
+
+/*
+===================
+Datagram_WindowDeliver
+
+Moves in-order fragments into the receive buffer until a message is complete.
+Returns 1 when net_message holds it, -1 when the peer sent more than fits or
+garbage. The stream can't be resynced after that, the caller drops the peer.
+===================
+*/
+static int Datagram_WindowDeliver (qsocket_t *sock)
+{
+	netwindow_t   *w = sock->window;
+	netfragment_t *frag;
+
+	while ((frag = &w->recv[sock->receiveSequence % NET_WINDOW_SIZE])->acked)
+	{
+		frag->acked = false;
+		sock->receiveSequence++;
+
+		if (sock->receiveMessageLength + frag->length > (int)sizeof (sock->receiveMessage) ||
+			(frag->eom && sock->receiveMessageLength + frag->length > net_message.maxsize))
+		{
+			Con_Printf ("Over-sized reliable\n");
+			sock->receiveMessageLength = 0;
+			return -1;
+		}
+		memcpy (sock->receiveMessage + sock->receiveMessageLength, frag->data, frag->length);
+		sock->receiveMessageLength += frag->length;
+
+		if (frag->eom)
+		{
+			int length = sock->receiveMessageLength;
+
+			sock->receiveMessageLength = 0;
+			if (!Datagram_Deliver (sock, sock->receiveMessage, length, frag->compressed))
+			{
+				Con_Printf ("Bad compressed reliable\n");
+				return -1;
+			}
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+===================
+Datagram_WindowData
+
+Buffers a data fragment for the windowed stream and acks it, then returns
+what Datagram_WindowDeliver does. length is that of the whole packet.
+===================
+*/
+static int Datagram_WindowData (qsocket_t *sock, unsigned int sequence, unsigned int flags, unsigned int length)
+{
+	netfragment_t *frag;
+
+	length -= NET_HEADERSIZE;
+	if (sequence - sock->receiveSequence < NET_WINDOW_SIZE && length <= NET_WINDOW_FRAGSIZE)
+	{
+		frag = &sock->window->recv[sequence % NET_WINDOW_SIZE];
+		if (!frag->acked)
+		{
+			frag->acked = true;
+			frag->eom = !!(flags & NETFLAG_EOM);
+			frag->compressed = !!(flags & NETFLAG_COMPRESSED);
+			frag->length = length;
+			memcpy (frag->data, packetBuffer.data, length);
+		}
+		else
+			receivedDuplicateCount++;
+	}
+	else
+		receivedDuplicateCount++; // an old resend whose ack got lost, or garbage
+	Datagram_WindowSendAck (sock);
+
+	return Datagram_WindowDeliver (sock);
+}
+
 int Datagram_SendMessage (qsocket_t *sock, sizebuf_t *data)
 {
 	unsigned int packetLen;
@@ -165,6 +620,9 @@ int Datagram_SendMessage (qsocket_t *sock, sizebuf_t *data)
 		Sys_Error ("SendMessage: called with canSend == false");
 #endif
 
+	if (sock->window)
+		return Datagram_WindowSendMessage (sock, data);
+
 	memcpy (sock->sendMessage, data->data, data->cursize);
 	sock->sendMessageLength = data->cursize;
 
@@ -187,11 +645,12 @@ int Datagram_SendMessage (qsocket_t *sock, sizebuf_t *data)
 	memcpy (packetBuffer.data, sock->sendMessage, dataLen);
 
 	sock->canSend = false;
+	sock->lastSendTime = net_time;
+	Datagram_Reschedule (sock);
 
 	if (sfunc.Write (sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
 		return -1;
 
-	sock->lastSendTime = net_time;
 	packetsSent++;
 	return 1;
 }
@@ -273,7 +732,10 @@ qboolean Datagram_CanSendUnreliableMessage (qsocket_t *sock)
 
 int Datagram_SendUnreliableMessage (qsocket_t *sock, sizebuf_t *data)
 {
-	int packetLen;
+	const byte  *payload = data->data;
+	int          length = data->cursize;
+	unsigned int flags = NETFLAG_UNRELIABLE;
+	int          packetLen;
 
 #ifdef DEBUG
 	if (data->cursize == 0)
@@ -283,11 +745,13 @@ int Datagram_SendUnreliableMessage (qsocket_t *sock, sizebuf_t *data)
 		Sys_Error ("Datagram_SendUnreliableMessage: message too big: %u", data->cursize);
 #endif
 
-	packetLen = NET_HEADERSIZE + data->cursize;
+	if (sock->compress && net_compress_unreliable.value && Datagram_Compress (sock, &payload, &length))
+		flags |= NETFLAG_COMPRESSED;
+	packetLen = NET_HEADERSIZE + length;
 
-	packetBuffer.length = BigLong (packetLen | NETFLAG_UNRELIABLE);
+	packetBuffer.length = BigLong (packetLen | flags);
 	packetBuffer.sequence = BigLong (sock->unreliableSendSequence++);
-	memcpy (packetBuffer.data, data->data, data->cursize);
+	memcpy (packetBuffer.data, payload, length);
 
 	if (sfunc.Write (sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
 		return -1;
@@ -298,6 +762,29 @@ int Datagram_SendUnreliableMessage (qsocket_t *sock, sizebuf_t *data)
 
 static void _Datagram_ServerControlPacket (sys_socket_t acceptsock, struct qsockaddr *clientaddr, byte *data, unsigned int length);
 
+/*
+===================
+Datagram_DropClient
+
+Kicks the client on a server side qsocket, returns false if there is none
+===================
+*/
+static qboolean Datagram_DropClient (qsocket_t *sock)
+{
+	int i;
+
+	for (i = 0; i < svs.maxclients; i++)
+	{
+		if (svs.clients[i].netconnection == sock)
+		{
+			host_client = &svs.clients[i];
+			SV_DropClient (false);
+			return true;
+		}
+	}
+	return false;
+}
+
 qboolean Datagram_ProcessPacket (unsigned int length, qsocket_t *sock)
 {
 	unsigned int flags;
@@ -342,13 +829,35 @@ qboolean Datagram_ProcessPacket (unsigned int length, qsocket_t *sock)
 			Con_Printf ("Over-sized unreliable\n");
 			return true;
 		}
-		SZ_Clear (&net_message);
-		SZ_Write (&net_message, packetBuffer.data, length);
+		if (!Datagram_Deliver (sock, packetBuffer.data, length, !!(flags & NETFLAG_COMPRESSED)))
+		{
+			Con_DPrintf ("Bad compressed datagram\n");
+			return false;
+		}
 
 		unreliableMessagesReceived++;
 		return true; // parse the unreliable
 	}
 
+	if ((flags & NETFLAG_ACK) && sock->window)
+	{
+		Datagram_WindowAck (sock, sequence, length);
+		return false;
+	}
+
+	if ((flags & NETFLAG_DATA) && sock->window)
+	{
+		int ret = Datagram_WindowData (sock, sequence, flags, length);
+		if (ret == -1)
+		{
+			if (!Datagram_DropClient (sock))
+				NET_Close (sock);
+			return false;
+		}
+		Datagram_Reschedule (sock); // there may be more complete messages waiting behind this one
+		return ret == 1;
+	}
+
 	if (flags & NETFLAG_ACK)
 	{
 		if (sequence != (sock->sendSequence - 1))
@@ -372,6 +881,7 @@ qboolean Datagram_ProcessPacket (unsigned int length, qsocket_t *sock)
 		{
 			memmove (sock->sendMessage, sock->sendMessage + sock->max_datagram, sock->sendMessageLength);
 			sock->sendNext = true;
+			Datagram_Reschedule (sock);
 		}
 		else
 		{
@@ -458,54 +968,66 @@ qsocket_t *Datagram_GetAnyMessage (void)
 			}
 
 			// figure out which qsocket it was for
-			for (s = net_activeSockets; s; s = s->next)
+			s = NET_FindQSocket (net_landriverlevel, &addr);
+			if (s)
 			{
-				if (s->driver != net_driverlevel)
-					continue;
-				if (s->disconnected)
-					continue;
-				if (!s->isvirtual)
-					continue;
-				if (dfunc.AddrCompare (&addr, &s->addr) == 0)
+				// okay, looks like this is us. try to process it, and if there's new data
+				if (Datagram_ProcessPacket (length, s))
 				{
-					// okay, looks like this is us. try to process it, and if there's new data
-					if (Datagram_ProcessPacket (length, s))
-					{
-						s->lastMessageTime = net_time;
-						return s; // the server needs to parse that packet.
-					}
+					s->lastMessageTime = net_time;
+					return s; // the server needs to parse that packet.
 				}
 			}
 			// stray packet... ignore it and just try the next
 		}
 	}
-	for (s = net_activeSockets; s; s = s->next)
+	// only visit the connections that have a resend or timeout due
+	while ((s = NET_NextDueQSocket ()) != NULL)
 	{
 		if (s->driver != net_driverlevel)
 			continue;
 		if (!s->isvirtual)
 			continue;
 
-		if (s->sendNext)
-			SendMessageNext (s);
-		if (!s->canSend)
-			if ((net_time - s->lastSendTime) > 1.0)
-				ReSendMessage (s);
-
-		if (net_time - s->lastMessageTime > ((!s->ackSequence) ? net_connecttimeout.value : net_messagetimeout.value))
-		{ // timed out, kick them
-			// FIXME: add a proper challenge rather than assuming spoofers won't fake acks
-			int i;
-			for (i = 0; i < svs.maxclients; i++)
+		if (s->window)
+		{
+			int ret = Datagram_WindowDeliver (s);
+			if (ret == -1)
+			{
+				if (!Datagram_DropClient (s))
+					NET_Close (s);
+				continue;
+			}
+			if (ret)
 			{
-				if (svs.clients[i].netconnection == s)
+				Datagram_Reschedule (s);
+				if (ret == 1)
 				{
-					host_client = &svs.clients[i];
-					SV_DropClient (false);
-					break;
+					s->lastMessageTime = net_time;
+					return s;
 				}
 			}
+			Datagram_WindowTimeouts (s);
+		}
+		else
+		{
+			if (s->sendNext)
+				SendMessageNext (s);
+			if (!s->canSend)
+				if ((net_time - s->lastSendTime) > 1.0)
+					ReSendMessage (s);
+		}
+
+		if (net_time - s->lastMessageTime > ((!s->ackSequence) ? net_connecttimeout.value : net_messagetimeout.value))
+		{ // timed out, kick them
+			// FIXME: add a proper challenge rather than assuming spoofers won't fake acks
+			Datagram_DropClient (s);
+			if (s->disconnected)
+				continue;
 		}
+
+		// not before the next tick, or a connection that stays due would keep us spinning here
+		NET_ScheduleQSocket (s, q_max (Datagram_NextCheck (s), net_time + 1.0 / NET_WHEEL_HZ));
 	}
 
 	return NULL;
@@ -520,7 +1042,14 @@ int Datagram_GetMessage (qsocket_t *sock)
 	unsigned int     sequence;
 	unsigned int     count;
 
-	if (!sock->canSend)
+	if (sock->window)
+	{
+		Datagram_WindowTimeouts (sock);
+		ret = Datagram_WindowDeliver (sock);
+		if (ret)
+			return ret;
+	}
+	else if (!sock->canSend)
 		if ((net_time - sock->lastSendTime) > 1.0)
 			ReSendMessage (sock);
 
@@ -582,13 +1111,30 @@ int Datagram_GetMessage (qsocket_t *sock)
 
 			length -= NET_HEADERSIZE;
 
-			SZ_Clear (&net_message);
-			SZ_Write (&net_message, packetBuffer.data, length);
+			if (!Datagram_Deliver (sock, packetBuffer.data, length, !!(flags & NETFLAG_COMPRESSED)))
+			{
+				Con_DPrintf ("Bad compressed datagram\n");
+				continue;
+			}
 
 			ret = 2;
 			break;
 		}
 
+		if ((flags & NETFLAG_ACK) && sock->window)
+		{
+			Datagram_WindowAck (sock, sequence, length);
+			continue;
+		}
+
+		if ((flags & NETFLAG_DATA) && sock->window)
+		{
+			ret = Datagram_WindowData (sock, sequence, flags, length);
+			if (ret)
+				break;
+			continue;
+		}
+
 		if (flags & NETFLAG_ACK)
 		{
 			if (sequence != (sock->sendSequence - 1))
@@ -674,6 +1220,9 @@ static void PrintStats (qsocket_t *s)
 	Con_Printf ("canSend = %4u   \n", s->canSend);
 	Con_Printf ("sendSeq = %4u   ", s->sendSequence);
 	Con_Printf ("recvSeq = %4u   \n", s->receiveSequence);
+	if (s->window)
+		Con_Printf (
+			"window  = %4u   srtt = %.3f   rto = %.3f\n", s->window->txSequence - s->ackSequence, s->window->srtt, s->window->rto);
 	Con_Printf ("\n");
 }
 
@@ -725,6 +1274,39 @@ static void NET_Stats_f (void)
 	}
 }
 
+/*
+===================
+NET_CompressStats_f
+
+Per connection NETEXT_DEFLATE savings and the time spent on them
+===================
+*/
+static void NET_CompressStats_f (void)
+{
+	qsocket_t *s;
+	int        count = 0;
+
+	for (s = net_activeSockets; s; s = s->next)
+	{
+		if (!s->compress)
+			continue;
+		Con_Printf ("%s\n", s->trueaddress);
+		if (s->deflateMessages)
+			Con_Printf (
+				"  deflate: %i msgs, %.1f KB -> %.1f KB (%.1f%%), %.2f ms total, %.1f us/msg\n", s->deflateMessages, s->deflateIn / 1024.0,
+				s->deflateOut / 1024.0, 100.0 * s->deflateOut / q_max (s->deflateIn, 1), s->deflateTime * 1000.0,
+				s->deflateTime * 1000000.0 / s->deflateMessages);
+		if (s->inflateMessages)
+			Con_Printf (
+				"  inflate: %i msgs, %.1f KB -> %.1f KB (%.1f%%), %.2f ms total, %.1f us/msg\n", s->inflateMessages, s->inflateIn / 1024.0,
+				s->inflateOut / 1024.0, 100.0 * s->inflateIn / q_max (s->inflateOut, 1), s->inflateTime * 1000.0,
+				s->inflateTime * 1000000.0 / s->inflateMessages);
+		count++;
+	}
+	if (!count)
+		Con_Printf ("no connections are using compression\n");
+}
+
 // recognize ip:port (based on ProQuake)
 static const char *Strip_Port (const char *host)
 {
@@ -1025,6 +1607,12 @@ int Datagram_Init (void)
 	myDriverLevel = net_driverlevel;
 
 	Cmd_AddCommand ("net_stats", NET_Stats_f);
+	Cmd_AddCommand ("net_compressstats", NET_CompressStats_f);
+	Cvar_RegisterVariable (&net_window);
+	Cvar_RegisterVariable (&net_compress);
+	Cvar_RegisterVariable (&net_compress_min);
+	Cvar_RegisterVariable (&net_compress_unreliable);
+	Deflate_Init ();
 
 	if (safemode || COM_CheckParm ("-nolan"))
 		return -1;
@@ -1044,6 +1632,8 @@ int Datagram_Init (void)
 	if (num_inited == 0)
 		return -1;
 
+	NetSim_Init ();
+
 	Cmd_AddCommand ("test", Test_f);
 	Cmd_AddCommand ("test2", Test2_f);
 
@@ -1055,6 +1645,7 @@ void Datagram_Shutdown (void)
 	int i;
 
 	Datagram_Listen (false);
+	NetSim_Shutdown ();
 
 	//
 	// shutdown the lan drivers
@@ -1073,6 +1664,8 @@ void Datagram_Close (qsocket_t *sock)
 {
 	if (sock->isvirtual)
 	{
+		NET_UnhashQSocket (sock);
+		NET_UnscheduleQSocket (sock);
 		sock->isvirtual = false;
 		sock->socket = INVALID_SOCKET;
 	}
@@ -1142,9 +1735,9 @@ static void _Datagram_ServerControlPacket (sys_socket_t acceptsock, struct qsock
 	qsocket_t       *s;
 	int              command;
 	int              control;
-	int              ret;
 	int              plnum;
 	int              mod; //, mod_ver, mod_flags, mod_passwd;	//proquake extensions
+	unsigned int     netext = 0;
 
 	control = BigLong (*((int *)data));
 	if (control == -1)
@@ -1431,6 +2024,18 @@ static void _Datagram_ServerControlPacket (sys_socket_t acceptsock, struct qsock
 	(void)mod_flags;
 	(void)mod_passwd;
 #endif
+	if (mod == 1)
+	{ // our own extensions ride after the proquake fields
+		MSG_ReadByte ();
+		MSG_ReadByte ();
+		MSG_ReadLong ();
+		netext = MSG_ReadLong ();
+		if (msg_badread)
+			netext = 0;
+		netext &= Datagram_Extensions ();
+		if (!(netext & NETEXT_WINDOW))
+			netext &= ~NETEXT_DEFLATE;
+	}
 
 #ifdef BAN_TEST
 	// check for a ban
@@ -1456,61 +2061,55 @@ static void _Datagram_ServerControlPacket (sys_socket_t acceptsock, struct qsock
 #endif
 
 	// see if this guy is already connected
-	for (s = net_activeSockets; s; s = s->next)
+	s = NET_FindQSocket (net_landriverlevel, clientaddr);
+	if (s)
 	{
-		if (s->driver != net_driverlevel)
-			continue;
-		if (s->disconnected)
-			continue;
-		ret = dfunc.AddrCompare (clientaddr, &s->addr);
-		if (ret == 0)
-		{
-			int i;
+		int i;
 
-			// is this a duplicate connection reqeust?
-			if (ret == 0 && net_time - s->connecttime < 2.0)
+		// is this a duplicate connection reqeust?
+		if (net_time - s->connecttime < 2.0)
+		{
+			// yes, so send a duplicate reply
+			SZ_Clear (&net_message);
+			// save space for the header, filled in later
+			MSG_WriteLong (&net_message, 0);
+			MSG_WriteByte (&net_message, CCREP_ACCEPT);
+			dfunc.GetSocketAddr (s->socket, &newaddr);
+			MSG_WriteLong (&net_message, dfunc.GetSocketPort (&newaddr));
+			if (s->proquake_angle_hack)
 			{
-				// yes, so send a duplicate reply
-				SZ_Clear (&net_message);
-				// save space for the header, filled in later
-				MSG_WriteLong (&net_message, 0);
-				MSG_WriteByte (&net_message, CCREP_ACCEPT);
-				dfunc.GetSocketAddr (s->socket, &newaddr);
-				MSG_WriteLong (&net_message, dfunc.GetSocketPort (&newaddr));
-				if (s->proquake_angle_hack)
-				{
-					MSG_WriteByte (&net_message, 1);  // proquake
-					MSG_WriteByte (&net_message, 30); // ver 30 should be safe. 34 screws with our single-server-socket stuff.
-					MSG_WriteByte (&net_message, 0);  // no flags
-				}
-				*((int *)net_message.data) = BigLong (NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
-				dfunc.Write (acceptsock, net_message.data, net_message.cursize, clientaddr);
-				SZ_Clear (&net_message);
-				return;
+				MSG_WriteByte (&net_message, 1);  // proquake
+				MSG_WriteByte (&net_message, 30); // ver 30 should be safe. 34 screws with our single-server-socket stuff.
+				MSG_WriteByte (&net_message, 0);  // no flags
+				MSG_WriteLong (&net_message, (s->window ? NETEXT_WINDOW : 0) | (s->compress ? NETEXT_DEFLATE : 0));
 			}
-			// it's somebody coming back in from a crash/disconnect
-			// so close the old qsocket and let their retry get them back in
-			//			NET_Close(s);
-			//			return;
-
-			// FIXME: ideally we would just switch the connection over and restart it with a serverinfo packet.
-			// warning: there might be packets in-flight which might mess up unreliable sequences.
-			// so we attempt to ignore the request, and let the user restart.
-			// FIXME: if this is an issue, it should be possible to reuse the previous connection's outgoing unreliable sequence. reliables should be less of an
-			// issue as stray ones will be ignored anyway.
-			// FIXME: needs challenges, so that other clients can't determine ip's and spoof a reconnect.
-			for (i = 0; i < svs.maxclients; i++)
+			*((int *)net_message.data) = BigLong (NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+			dfunc.Write (acceptsock, net_message.data, net_message.cursize, clientaddr);
+			SZ_Clear (&net_message);
+			return;
+		}
+		// it's somebody coming back in from a crash/disconnect
+		// so close the old qsocket and let their retry get them back in
+		//			NET_Close(s);
+		//			return;
+
+		// FIXME: ideally we would just switch the connection over and restart it with a serverinfo packet.
+		// warning: there might be packets in-flight which might mess up unreliable sequences.
+		// so we attempt to ignore the request, and let the user restart.
+		// FIXME: if this is an issue, it should be possible to reuse the previous connection's outgoing unreliable sequence. reliables should be less of an
+		// issue as stray ones will be ignored anyway.
+		// FIXME: needs challenges, so that other clients can't determine ip's and spoof a reconnect.
+		for (i = 0; i < svs.maxclients; i++)
+		{
+			if (svs.clients[i].netconnection == s)
 			{
-				if (svs.clients[i].netconnection == s)
-				{
-					NET_Close (s); // close early, to avoid svc_disconnects confusing things.
-					host_client = &svs.clients[i];
-					SV_DropClient (false);
-					break;
-				}
+				NET_Close (s); // close early, to avoid svc_disconnects confusing things.
+				host_client = &svs.clients[i];
+				SV_DropClient (false);
+				break;
 			}
-			return;
 		}
+		return;
 	}
 
 	// find a free player slot
@@ -1536,6 +2135,9 @@ static void _Datagram_ServerControlPacket (sys_socket_t acceptsock, struct qsock
 	}
 
 	sock->proquake_angle_hack = (mod == 1);
+	if (netext & NETEXT_WINDOW)
+		sock->window = Datagram_NewWindow ();
+	sock->compress = !!(netext & NETEXT_DEFLATE);
 
 	// everything is allocated, just fill in the details
 	sock->isvirtual = true;
@@ -1544,6 +2146,8 @@ static void _Datagram_ServerControlPacket (sys_socket_t acceptsock, struct qsock
 	sock->addr = *clientaddr;
 	strcpy (sock->trueaddress, dfunc.AddrToString (clientaddr, false));
 	strcpy (sock->maskedaddress, dfunc.AddrToString (clientaddr, true));
+	NET_HashQSocket (sock);
+	Datagram_Reschedule (sock);
 
 	// send him back the info about the server connection he has been allocated
 	SZ_Clear (&net_message);
@@ -1558,6 +2162,7 @@ static void _Datagram_ServerControlPacket (sys_socket_t acceptsock, struct qsock
 		MSG_WriteByte (&net_message, 1);  // proquake
 		MSG_WriteByte (&net_message, 30); // ver 30 should be safe. 34 screws with our single-server-socket stuff.
 		MSG_WriteByte (&net_message, 0);
+		MSG_WriteLong (&net_message, netext);
 	}
 	*((int *)net_message.data) = BigLong (NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
 	dfunc.Write (acceptsock, net_message.data, net_message.cursize, clientaddr);
@@ -2054,6 +2659,7 @@ static qsocket_t *_Datagram_Connect (struct qsockaddr *serveraddr)
 			MSG_WriteByte (&net_message, 34); /*'mod' version*/
 			MSG_WriteByte (&net_message, 0);  /*flags*/
 			MSG_WriteLong (&net_message, 0);  // strtoul(password.string, NULL, 0)); /*password*/
+			MSG_WriteLong (&net_message, Datagram_Extensions ()); /*net_extensions*/
 		}
 		*((int *)net_message.data) = BigLong (NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
 		dfunc.Write (newsock, net_message.data, net_message.cursize, serveraddr);
@@ -2190,8 +2796,15 @@ static qsocket_t *_Datagram_Connect (struct qsockaddr *serveraddr)
 		byte mod = (msg_readcount < net_message.cursize) ? MSG_ReadByte () : 0;
 		byte ver = (msg_readcount < net_message.cursize) ? MSG_ReadByte () : 0;
 		byte flags = (msg_readcount < net_message.cursize) ? MSG_ReadByte () : 0;
+		int  netext = (msg_readcount + 4 <= net_message.cursize) ? MSG_ReadLong () : 0;
 		(void)ver;
 
+		if (netext & NETEXT_WINDOW)
+		{
+			sock->window = Datagram_NewWindow ();
+			sock->compress = !!(netext & NETEXT_DEFLATE);
+		}
+
 		if (mod == 1 /*MOD_PROQUAKE*/)
 		{
 			if (flags & 1 /*CHEATFREE*/)
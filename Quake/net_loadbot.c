@@ -0,0 +1,917 @@
+/*
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// net_loadbot.c -- headless load-generator clients for server benchmarking
+
+/*
+Load bots are real network clients without a renderer, sound or client state. Each one connects with NET_ConnectAddress,
+answers the signon sequence the way CL_SignonReply does, sends randomized clc_move commands and walks every server
+message far enough to stay in sync, without keeping any of it. They are meant to run in their own process next to the
+server under test, since the connect handshake blocks until the server replies:
+
+	vkquake -dedicated -port 26001 -botclients 32 +loadbot_connect 127.0.0.1:26000
+
+The bots only speak the NetQuake, FitzQuake and RMQ protocols; they never answer the FTE extension query, so the server
+falls back to sv_protocol. loadbot_stats reports bandwidth and unreliable packet loss per bot; set serverprofile on the
+server to see its frame and SV_SendClientMessages times as the bots join.
+*/
+
+#include "q_stdinc.h"
+#include "arch_def.h"
+#include "net_sys.h"
+#include "quakedef.h"
+#include "net_defs.h"
+#include "net_loadbot.h"
+
+#define LOADBOT_MAX         255  // NET_Init reserves a qsocket for each bot, see LoadBot_MaxBots
+#define LOADBOT_MESSAGESIZE 1024 // reliable stringcmds queued per bot
+
+static cvar_t loadbot_movehz = {"loadbot_movehz", "72", CVAR_NONE}; // clc_move rate, capped by the host frame rate
+static cvar_t loadbot_attack = {"loadbot_attack", "0", CVAR_NONE};  // percent of course changes that hold +attack
+static cvar_t loadbot_jump = {"loadbot_jump", "10", CVAR_NONE};     // percent of course changes that jump
+static cvar_t loadbot_seed = {"loadbot_seed", "1", CVAR_NONE};
+
+typedef enum
+{
+	LOADBOT_FREE,
+	LOADBOT_PENDING, // waiting for its turn to connect
+	LOADBOT_CONNECTED,
+	LOADBOT_DROPPED
+} loadbotstate_t;
+
+typedef struct
+{
+	loadbotstate_t state;
+	qsocket_t     *sock;
+	sizebuf_t      message;
+	byte           messagedata[LOADBOT_MESSAGESIZE];
+
+	int          signon;
+	int          protocol;
+	unsigned int protocolflags;
+	float        mtime; // last svc_time, echoed in clc_move for the server's ping times
+	double       signonstart;
+	double       signontime;
+
+	uint32_t rng;
+	double   nextmove;
+	double   nextcourse;
+	float    yaw;
+	int      forwardmove, sidemove, buttons;
+
+	unsigned int bytesin, bytesout;
+	unsigned int reliablein, unreliablein;
+	unsigned int firstunreliable; // unreliable sequence when the stats were reset
+	qboolean     unreliableknown;
+	unsigned int parseerrors;
+} loadbot_t;
+
+static loadbot_t loadbots[LOADBOT_MAX];
+static int       loadbot_count;
+static char      loadbot_address[NET_NAMELEN];
+static double    loadbot_statstime;
+
+/*
+====================
+LoadBot_MaxBots
+
+Number of bots requested with -botclients; NET_Init adds this many qsockets to its pool.
+====================
+*/
+int LoadBot_MaxBots (void)
+{
+	int i = COM_CheckParm ("-botclients");
+
+	if (i && i < com_argc - 1)
+		return CLAMP (0, atoi (com_argv[i + 1]), LOADBOT_MAX);
+	return 0;
+}
+
+static float LoadBot_Random (loadbot_t *bot)
+{
+	uint32_t x = bot->rng;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	bot->rng = x;
+	return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+static void LoadBot_StringCmd (loadbot_t *bot, const char *cmd)
+{
+	MSG_WriteByte (&bot->message, clc_stringcmd);
+	MSG_WriteString (&bot->message, cmd);
+}
+
+static void LoadBot_Drop (loadbot_t *bot, const char *reason)
+{
+	sizebuf_t buf;
+	byte      data[4];
+
+	if (bot->sock)
+	{
+		buf.data = data;
+		buf.maxsize = sizeof (data);
+		buf.cursize = 0;
+		MSG_WriteByte (&buf, clc_disconnect);
+		NET_SendUnreliableMessage (bot->sock, &buf);
+		NET_Close (bot->sock);
+		bot->sock = NULL;
+	}
+	if (reason)
+		Con_Printf ("loadbot %i: %s\n", (int)(bot - loadbots), reason);
+	bot->state = LOADBOT_DROPPED;
+}
+
+static void LoadBot_ResetStats (loadbot_t *bot)
+{
+	bot->bytesin = bot->bytesout = 0;
+	bot->reliablein = bot->unreliablein = 0;
+	bot->parseerrors = 0;
+	bot->unreliableknown = false;
+}
+
+/*
+====================
+LoadBot_SignonReply
+
+The bot's side of CL_SignonReply
+====================
+*/
+static void LoadBot_SignonReply (loadbot_t *bot)
+{
+	int i = (int)(bot - loadbots);
+
+	switch (bot->signon)
+	{
+	case 1:
+		LoadBot_StringCmd (bot, va ("name \"loadbot%02i\"\n", i));
+		LoadBot_StringCmd (bot, "prespawn");
+		break;
+
+	case 2:
+		LoadBot_StringCmd (bot, va ("color %i %i\n", i % 14, (i / 14) % 14));
+		LoadBot_StringCmd (bot, "spawn ");
+		break;
+
+	case 3:
+		LoadBot_StringCmd (bot, "begin");
+		break;
+
+	case 4:
+		bot->signontime = realtime - bot->signonstart;
+		break;
+	}
+}
+
+/*
+====================
+LoadBot_StuffText
+
+Only answers the "cmd" queries a server uses to probe its clients, and notices map changes
+====================
+*/
+static void LoadBot_StuffText (loadbot_t *bot, const char *text)
+{
+	char   line[256];
+	size_t len;
+
+	while (*text)
+	{
+		len = strcspn (text, "\n");
+		if (len > 4 && !strncmp (text, "cmd ", 4))
+		{
+			q_strlcpy (line, text + 4, q_min (len - 4 + 1, sizeof (line)));
+			LoadBot_StringCmd (bot, line);
+		}
+		else if (len >= 9 && !strncmp (text, "reconnect", 9))
+			bot->signon = 0;
+		text += len;
+		if (*text)
+			text++;
+	}
+}
+
+static void LoadBot_SkipCoords (loadbot_t *bot, int count)
+{
+	while (count--)
+		MSG_ReadCoord (bot->protocolflags);
+}
+
+static qboolean LoadBot_ParseServerInfo (loadbot_t *bot)
+{
+	int i;
+
+	i = MSG_ReadLong ();
+	if (i != PROTOCOL_NETQUAKE && i != PROTOCOL_FITZQUAKE && i != PROTOCOL_RMQ)
+	{
+		LoadBot_Drop (bot, va ("server uses unsupported protocol %i", i));
+		return false;
+	}
+	bot->protocol = i;
+	bot->protocolflags = (bot->protocol == PROTOCOL_RMQ) ? (unsigned int)MSG_ReadLong () : 0;
+
+	MSG_ReadByte (); // maxclients
+	MSG_ReadByte (); // gametype
+	MSG_ReadString ();
+	while (*MSG_ReadString () && !msg_badread) // models
+		;
+	while (*MSG_ReadString () && !msg_badread) // sounds
+		;
+
+	bot->signon = 0;
+	bot->signonstart = realtime;
+	return true;
+}
+
+static void LoadBot_ParseUpdate (loadbot_t *bot, int bits)
+{
+	int i;
+
+	if (bot->signon == SIGNONS - 1)
+	{
+		// first update is the final signon stage
+		bot->signon = SIGNONS;
+		LoadBot_SignonReply (bot);
+	}
+
+	if (bits & U_MOREBITS)
+		bits |= MSG_ReadByte () << 8;
+	if (bot->protocol == PROTOCOL_FITZQUAKE || bot->protocol == PROTOCOL_RMQ)
+	{
+		if (bits & U_EXTEND1)
+			bits |= MSG_ReadByte () << 16;
+		if (bits & U_EXTEND2)
+			bits |= MSG_ReadByte () << 24;
+	}
+
+	if (bits & U_LONGENTITY)
+		MSG_ReadShort ();
+	else
+		MSG_ReadByte ();
+
+	if (bits & U_MODEL)
+		MSG_ReadByte ();
+	if (bits & U_FRAME)
+		MSG_ReadByte ();
+	if (bits & U_COLORMAP)
+		MSG_ReadByte ();
+	if (bits & U_SKIN)
+		MSG_ReadByte ();
+	if (bits & U_EFFECTS)
+		MSG_ReadByte ();
+	for (i = 0; i < 3; i++)
+	{
+		if (bits & (U_ORIGIN1 << i))
+			MSG_ReadCoord (bot->protocolflags);
+		if (bits & (i == 0 ? U_ANGLE1 : i == 1 ? U_ANGLE2 : U_ANGLE3))
+			MSG_ReadAngle (bot->protocolflags);
+	}
+
+	if (bot->protocol == PROTOCOL_FITZQUAKE || bot->protocol == PROTOCOL_RMQ)
+	{
+		if (bits & U_ALPHA)
+			MSG_ReadByte ();
+		if (bits & U_SCALE)
+			MSG_ReadByte ();
+		if (bits & U_FRAME2)
+			MSG_ReadByte ();
+		if (bits & U_MODEL2)
+			MSG_ReadByte ();
+		if (bits & U_LERPFINISH)
+			MSG_ReadByte ();
+	}
+	else if (bits & U_TRANS) // nehahra
+	{
+		float a = MSG_ReadFloat ();
+		MSG_ReadFloat (); // alpha
+		if (a == 2)
+			MSG_ReadFloat (); // fullbright
+	}
+}
+
+static void LoadBot_ParseBaseline (loadbot_t *bot, int version)
+{
+	int bits = (version == 2) ? MSG_ReadByte () : 0;
+	int i;
+
+	if (bits & B_LARGEMODEL)
+		MSG_ReadShort ();
+	else
+		MSG_ReadByte ();
+	if (bits & B_LARGEFRAME)
+		MSG_ReadShort ();
+	else
+		MSG_ReadByte ();
+	MSG_ReadByte (); // colormap
+	MSG_ReadByte (); // skin
+	for (i = 0; i < 3; i++)
+	{
+		MSG_ReadCoord (bot->protocolflags);
+		MSG_ReadAngle (bot->protocolflags);
+	}
+	if (bits & B_ALPHA)
+		MSG_ReadByte ();
+}
+
+static void LoadBot_ParseClientdata (void)
+{
+	static const int highbytes[] = {SU_WEAPON2, SU_ARMOR2, SU_AMMO2, SU_SHELLS2, SU_NAILS2, SU_ROCKETS2, SU_CELLS2, SU_WEAPONFRAME2, SU_WEAPONALPHA};
+	int              bits, i;
+
+	bits = (unsigned short)MSG_ReadShort ();
+	if (bits & SU_EXTEND1)
+		bits |= MSG_ReadByte () << 16;
+	if (bits & SU_EXTEND2)
+		bits |= MSG_ReadByte () << 24;
+
+	if (bits & SU_VIEWHEIGHT)
+		MSG_ReadChar ();
+	if (bits & SU_IDEALPITCH)
+		MSG_ReadChar ();
+	for (i = 0; i < 3; i++)
+	{
+		if (bits & (SU_PUNCH1 << i))
+			MSG_ReadChar ();
+		if (bits & (SU_VELOCITY1 << i))
+			MSG_ReadChar ();
+	}
+	if (bits & SU_ITEMS)
+		MSG_ReadLong ();
+	if (bits & SU_WEAPONFRAME)
+		MSG_ReadByte ();
+	if (bits & SU_ARMOR)
+		MSG_ReadByte ();
+	if (bits & SU_WEAPON)
+		MSG_ReadByte ();
+	MSG_ReadShort (); // health
+	MSG_ReadByte ();  // ammo
+	for (i = 0; i < 4; i++)
+		MSG_ReadByte ();
+	MSG_ReadByte (); // active weapon
+
+	for (i = 0; i < (int)countof (highbytes); i++)
+		if (bits & highbytes[i])
+			MSG_ReadByte ();
+}
+
+static void LoadBot_ParseSound (loadbot_t *bot)
+{
+	int field_mask = MSG_ReadByte ();
+
+	if (field_mask & SND_VOLUME)
+		MSG_ReadByte ();
+	if (field_mask & SND_ATTENUATION)
+		MSG_ReadByte ();
+	if (field_mask & SND_LARGEENTITY)
+	{
+		MSG_ReadShort ();
+		MSG_ReadByte ();
+	}
+	else
+		MSG_ReadShort ();
+	if (field_mask & SND_LARGESOUND)
+		MSG_ReadShort ();
+	else
+		MSG_ReadByte ();
+	LoadBot_SkipCoords (bot, 3);
+}
+
+static qboolean LoadBot_ParseTEnt (loadbot_t *bot)
+{
+	switch (MSG_ReadByte ())
+	{
+	case TE_WIZSPIKE:
+	case TE_KNIGHTSPIKE:
+	case TE_SPIKE:
+	case TE_SUPERSPIKE:
+	case TE_GUNSHOT:
+	case TE_EXPLOSION:
+	case TE_TAREXPLOSION:
+	case TE_LAVASPLASH:
+	case TE_TELEPORT:
+		LoadBot_SkipCoords (bot, 3);
+		return true;
+
+	case TE_LIGHTNING1:
+	case TE_LIGHTNING2:
+	case TE_LIGHTNING3:
+	case TE_BEAM:
+		MSG_ReadShort ();
+		LoadBot_SkipCoords (bot, 6);
+		return true;
+
+	case TE_EXPLOSION2:
+		LoadBot_SkipCoords (bot, 3);
+		MSG_ReadByte ();
+		MSG_ReadByte ();
+		return true;
+
+	case TEDP_PARTICLERAIN:
+	case TEDP_PARTICLESNOW:
+		LoadBot_SkipCoords (bot, 9);
+		MSG_ReadShort ();
+		MSG_ReadByte ();
+		return true;
+	}
+	return false;
+}
+
+/*
+====================
+LoadBot_ParseServerMessage
+
+Walks net_message the way CL_ParseServerMessage does, keeping only what the bot needs to answer the server.
+Returns false if the bot was dropped.
+====================
+*/
+static qboolean LoadBot_ParseServerMessage (loadbot_t *bot)
+{
+	int cmd, i;
+
+	MSG_BeginReading ();
+	while (1)
+	{
+		if (msg_badread)
+		{
+			bot->parseerrors++;
+			return true;
+		}
+
+		cmd = MSG_ReadByte ();
+		if (cmd == -1)
+			return true;
+
+		if (cmd & U_SIGNAL)
+		{
+			LoadBot_ParseUpdate (bot, cmd & 127);
+			continue;
+		}
+
+		switch (cmd)
+		{
+		default:
+			// an svc we don't know how to skip; the rest of this message is lost
+			bot->parseerrors++;
+			return true;
+
+		case svc_nop:
+		case svc_killedmonster:
+		case svc_foundsecret:
+		case svc_intermission:
+		case svc_sellscreen:
+		case svc_bf:
+			break;
+
+		case svc_time:
+			bot->mtime = MSG_ReadFloat ();
+			break;
+
+		case svc_clientdata:
+			LoadBot_ParseClientdata ();
+			break;
+
+		case svc_version:
+			bot->protocol = MSG_ReadLong ();
+			break;
+
+		case svc_disconnect:
+			LoadBot_Drop (bot, "server disconnected");
+			return false;
+
+		case svc_print:
+		case svc_centerprint:
+		case svc_finale:
+		case svc_cutscene:
+		case svc_skybox:
+		case svc_achievement:
+			MSG_ReadString ();
+			break;
+
+		case svc_stufftext:
+			LoadBot_StuffText (bot, MSG_ReadString ());
+			break;
+
+		case svc_damage:
+			MSG_ReadByte ();
+			MSG_ReadByte ();
+			LoadBot_SkipCoords (bot, 3);
+			break;
+
+		case svc_serverinfo:
+			if (!LoadBot_ParseServerInfo (bot))
+				return false;
+			break;
+
+		case svc_setangle:
+			for (i = 0; i < 3; i++)
+				MSG_ReadAngle (bot->protocolflags);
+			break;
+
+		case svc_setview:
+		case svc_stopsound:
+			MSG_ReadShort ();
+			break;
+
+		case svc_lightstyle:
+		case svc_updatename:
+			MSG_ReadByte ();
+			MSG_ReadString ();
+			break;
+
+		case svc_sound:
+			LoadBot_ParseSound (bot);
+			break;
+
+		case svc_updatefrags:
+			MSG_ReadByte ();
+			MSG_ReadShort ();
+			break;
+
+		case svc_updatecolors:
+		case svc_cdtrack:
+			MSG_ReadByte ();
+			MSG_ReadByte ();
+			break;
+
+		case svc_particle:
+			LoadBot_SkipCoords (bot, 3);
+			for (i = 0; i < 5; i++) // direction, count and color
+				MSG_ReadByte ();
+			break;
+
+		case svc_spawnbaseline:
+			MSG_ReadShort ();
+			LoadBot_ParseBaseline (bot, 1);
+			break;
+
+		case svc_spawnbaseline2:
+			MSG_ReadShort ();
+			LoadBot_ParseBaseline (bot, 2);
+			break;
+
+		case svc_spawnstatic:
+			LoadBot_ParseBaseline (bot, 1);
+			break;
+
+		case svc_spawnstatic2:
+			LoadBot_ParseBaseline (bot, 2);
+			break;
+
+		case svc_temp_entity:
+			if (!LoadBot_ParseTEnt (bot))
+			{
+				bot->parseerrors++;
+				return true;
+			}
+			break;
+
+		case svc_setpause:
+			MSG_ReadByte ();
+			break;
+
+		case svc_signonnum:
+			i = MSG_ReadByte ();
+			if (i <= bot->signon)
+			{
+				LoadBot_Drop (bot, va ("received signon %i when at %i", i, bot->signon));
+				return false;
+			}
+			bot->signon = i;
+			LoadBot_SignonReply (bot);
+			break;
+
+		case svc_updatestat:
+			MSG_ReadByte ();
+			MSG_ReadLong ();
+			break;
+
+		case svc_spawnstaticsound:
+		case svc_spawnstaticsound2:
+			LoadBot_SkipCoords (bot, 3);
+			if (cmd == svc_spawnstaticsound2)
+				MSG_ReadShort ();
+			else
+				MSG_ReadByte ();
+			MSG_ReadByte ();
+			MSG_ReadByte ();
+			break;
+
+		case svc_fog:
+			for (i = 0; i < 4; i++)
+				MSG_ReadByte ();
+			MSG_ReadShort ();
+			break;
+
+		case svc_localsound:
+			if (MSG_ReadByte () & SND_LARGESOUND)
+				MSG_ReadShort ();
+			else
+				MSG_ReadByte ();
+			break;
+		}
+	}
+}
+
+/*
+====================
+LoadBot_SendMove
+
+Wanders in a random direction, changing course every half second to two seconds
+====================
+*/
+static void LoadBot_SendMove (loadbot_t *bot)
+{
+	sizebuf_t buf;
+	byte      data[64];
+	int       i;
+
+	if (realtime >= bot->nextcourse)
+	{
+		bot->nextcourse = realtime + 0.5 + LoadBot_Random (bot) * 1.5;
+		bot->yaw = LoadBot_Random (bot) * 360;
+		bot->forwardmove = LoadBot_Random (bot) < 0.5f ? 200 : 400;
+		bot->sidemove = (int)((LoadBot_Random (bot) * 2 - 1) * 350);
+		bot->buttons = 0;
+		if (LoadBot_Random (bot) * 100 < loadbot_attack.value)
+			bot->buttons |= 1;
+		if (LoadBot_Random (bot) * 100 < loadbot_jump.value)
+			bot->buttons |= 2;
+	}
+
+	buf.data = data;
+	buf.maxsize = sizeof (data);
+	buf.cursize = 0;
+
+	MSG_WriteByte (&buf, clc_move);
+	MSG_WriteFloat (&buf, bot->mtime);
+	for (i = 0; i < 3; i++)
+	{
+		float angle = (i == YAW) ? bot->yaw : 0;
+		if (bot->protocol == PROTOCOL_NETQUAKE && !NET_QSocketGetProQuakeAngleHack (bot->sock))
+			MSG_WriteAngle (&buf, angle, bot->protocolflags);
+		else
+			MSG_WriteAngle16 (&buf, angle, bot->protocolflags);
+	}
+	MSG_WriteShort (&buf, bot->forwardmove);
+	MSG_WriteShort (&buf, bot->sidemove);
+	MSG_WriteShort (&buf, 0);
+	MSG_WriteByte (&buf, bot->buttons);
+	MSG_WriteByte (&buf, 0);
+
+	if (NET_SendUnreliableMessage (bot->sock, &buf) == -1)
+	{
+		LoadBot_Drop (bot, "lost server connection");
+		return;
+	}
+	bot->bytesout += buf.cursize;
+	bot->buttons &= ~2; // one jump per course change
+}
+
+static void LoadBot_RunBot (loadbot_t *bot)
+{
+	int ret;
+
+	while ((ret = NET_GetMessage (bot->sock)) > 0)
+	{
+		bot->bytesin += net_message.cursize;
+		if (ret == 1)
+			bot->reliablein++;
+		else
+		{
+			if (!bot->unreliableknown)
+			{
+				bot->firstunreliable = bot->sock->unreliableReceiveSequence - 1;
+				bot->unreliableknown = true;
+			}
+			bot->unreliablein++;
+		}
+		if (!LoadBot_ParseServerMessage (bot))
+			return;
+	}
+	if (ret == -1)
+	{
+		LoadBot_Drop (bot, "lost server connection");
+		return;
+	}
+
+	if (bot->signon == SIGNONS && realtime >= bot->nextmove)
+	{
+		bot->nextmove = realtime + 1.0 / q_max (loadbot_movehz.value, 1.f);
+		LoadBot_SendMove (bot);
+		if (!bot->sock)
+			return;
+	}
+
+	if (bot->message.cursize && NET_CanSendMessage (bot->sock))
+	{
+		if (NET_SendMessage (bot->sock, &bot->message) == -1)
+		{
+			LoadBot_Drop (bot, "lost server connection");
+			return;
+		}
+		bot->bytesout += bot->message.cursize;
+		SZ_Clear (&bot->message);
+	}
+}
+
+/*
+====================
+LoadBot_Frame
+
+Called every host frame; connects at most one bot per frame so the server isn't flooded with handshakes
+====================
+*/
+void LoadBot_Frame (void)
+{
+	qboolean  connected = false;
+	loadbot_t *bot;
+	int        i;
+
+	for (i = 0, bot = loadbots; i < loadbot_count; i++, bot++)
+	{
+		if (bot->state == LOADBOT_PENDING && !connected)
+		{
+			connected = true;
+			bot->sock = NET_ConnectAddress (loadbot_address);
+			if (!bot->sock)
+			{
+				LoadBot_Drop (bot, va ("couldn't connect to %s", loadbot_address));
+				continue;
+			}
+			bot->state = LOADBOT_CONNECTED;
+			bot->signonstart = realtime;
+			MSG_WriteByte (&bot->message, clc_nop); // NAT fix, as in CL_EstablishConnection
+		}
+		if (bot->state == LOADBOT_CONNECTED)
+			LoadBot_RunBot (bot);
+	}
+}
+
+static void LoadBot_DisconnectAll (void)
+{
+	int i;
+
+	for (i = 0; i < loadbot_count; i++)
+		LoadBot_Drop (&loadbots[i], NULL);
+	loadbot_count = 0;
+}
+
+/*
+====================
+LoadBot_Connect_f
+
+loadbot_connect <address> [count]
+====================
+*/
+static void LoadBot_Connect_f (void)
+{
+	int        max = LoadBot_MaxBots ();
+	int        count = max;
+	loadbot_t *bot;
+	int        i;
+
+	if (Cmd_Argc () < 2)
+	{
+		Con_Printf ("usage: %s <address> [count]\n", Cmd_Argv (0));
+		return;
+	}
+	if (!max)
+	{
+		Con_Printf ("start with -botclients <count> to reserve sockets for load bots\n");
+		return;
+	}
+	if (Cmd_Argc () > 2)
+		count = CLAMP (1, atoi (Cmd_Argv (2)), max);
+
+	LoadBot_DisconnectAll ();
+	q_strlcpy (loadbot_address, Cmd_Argv (1), sizeof (loadbot_address));
+	for (i = 0, bot = loadbots; i < count; i++, bot++)
+	{
+		memset (bot, 0, sizeof (*bot));
+		bot->state = LOADBOT_PENDING;
+		bot->message.data = bot->messagedata;
+		bot->message.maxsize = sizeof (bot->messagedata);
+		bot->rng = (uint32_t)loadbot_seed.value * 2654435761u + i * 40503u + 1;
+	}
+	loadbot_count = count;
+	loadbot_statstime = realtime;
+	Con_Printf ("connecting %i load bots to %s\n", count, loadbot_address);
+}
+
+static void LoadBot_Disconnect_f (void)
+{
+	LoadBot_DisconnectAll ();
+}
+
+/*
+====================
+LoadBot_Stats_f
+
+loadbot_stats [reset]: per-bot bandwidth and unreliable packet loss since the bots connected or the last reset
+====================
+*/
+static void LoadBot_Stats_f (void)
+{
+	double     elapsed = q_max (realtime - loadbot_statstime, 0.001);
+	double     totalin = 0, totalout = 0;
+	unsigned   expected, received, totalexpected = 0, totalreceived = 0, errors = 0;
+	int        i, active = 0;
+	loadbot_t *bot;
+
+	if (!loadbot_count)
+	{
+		Con_Printf ("no load bots\n");
+		return;
+	}
+
+	if (Cmd_Argc () > 1 && !q_strcasecmp (Cmd_Argv (1), "reset"))
+	{
+		for (i = 0; i < loadbot_count; i++)
+			LoadBot_ResetStats (&loadbots[i]);
+		loadbot_statstime = realtime;
+		return;
+	}
+
+	Con_Printf ("bot state       in B/s  out B/s   loss  signon\n");
+	for (i = 0, bot = loadbots; i < loadbot_count; i++, bot++)
+	{
+		const char *state;
+
+		expected = received = 0;
+		if (bot->sock && bot->unreliableknown)
+		{
+			expected = bot->sock->unreliableReceiveSequence - bot->firstunreliable;
+			received = q_min (bot->unreliablein, expected);
+		}
+		totalexpected += expected;
+		totalreceived += received;
+		totalin += bot->bytesin;
+		totalout += bot->bytesout;
+		errors += bot->parseerrors;
+
+		if (bot->state == LOADBOT_PENDING)
+			state = "pending";
+		else if (bot->state == LOADBOT_DROPPED)
+			state = "dropped";
+		else if (bot->signon == SIGNONS)
+		{
+			state = "active";
+			active++;
+		}
+		else
+			state = va ("signon %i", bot->signon);
+
+		Con_Printf (
+			"%3i %-9s %8.0f %8.0f %5.1f%% %6.2fs\n", i, state, bot->bytesin / elapsed, bot->bytesout / elapsed,
+			expected ? 100.0 * (expected - received) / expected : 0.0, bot->signontime);
+	}
+
+	Con_Printf (
+		"%i of %i bots active over %.1fs: in %.1f kB/s (%.2f per bot), out %.1f kB/s, loss %.2f%%, %u parse errors\n", active, loadbot_count, elapsed,
+		totalin / elapsed / 1024, totalin / elapsed / 1024 / loadbot_count, totalout / elapsed / 1024,
+		totalexpected ? 100.0 * (totalexpected - totalreceived) / totalexpected : 0.0, errors);
+}
+
+/*
+====================
+LoadBot_Init
+====================
+*/
+void LoadBot_Init (void)
+{
+	Cvar_RegisterVariable (&loadbot_movehz);
+	Cvar_RegisterVariable (&loadbot_attack);
+	Cvar_RegisterVariable (&loadbot_jump);
+	Cvar_RegisterVariable (&loadbot_seed);
+
+	Cmd_AddCommand ("loadbot_connect", LoadBot_Connect_f);
+	Cmd_AddCommand ("loadbot_disconnect", LoadBot_Disconnect_f);
+	Cmd_AddCommand ("loadbot_stats", LoadBot_Stats_f);
+}
+
+/*
+====================
+LoadBot_Shutdown
+====================
+*/
+void LoadBot_Shutdown (void)
+{
+	LoadBot_DisconnectAll ();
+}
@@ -24,11 +24,21 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "net_sys.h"
 #include "quakedef.h"
 #include "net_defs.h"
+#include "net_loadbot.h"
 
 qsocket_t *net_activeSockets = NULL;
 qsocket_t *net_freeSockets = NULL;
 int        net_numsockets = 0;
 
+// virtual qsockets by address, so incoming packets don't have to walk every connection
+#define NET_ADDRHASH_SIZE 256 // must be a power of two
+static qsocket_t *net_addrhash[NET_ADDRHASH_SIZE];
+
+// resend/timeout timer wheel, see NET_ScheduleQSocket
+static qsocket_t *net_wheel[NET_WHEEL_SLOTS];
+static qsocket_t *net_duesockets;
+static int64_t    net_wheeltick = -1; // first tick that hasn't been expired yet
+
 qboolean ipxAvailable = false;
 qboolean ipv4Available = false;
 qboolean ipv6Available = false;
@@ -126,6 +136,11 @@ qsocket_t *NET_NewQSocket (void)
 	sock->receiveMessageLength = 0;
 	sock->pending_max_datagram = 1024;
 	sock->proquake_angle_hack = false;
+	sock->compress = false;
+	sock->deflateIn = sock->deflateOut = 0;
+	sock->inflateIn = sock->inflateOut = 0;
+	sock->deflateMessages = sock->inflateMessages = 0;
+	sock->deflateTime = sock->inflateTime = 0;
 
 	return sock;
 }
@@ -152,12 +167,207 @@ void NET_FreeQSocket (qsocket_t *sock)
 			Sys_Error ("NET_FreeQSocket: not active");
 	}
 
+	NET_UnhashQSocket (sock);
+	NET_UnscheduleQSocket (sock);
+	SAFE_FREE (sock->window);
+
 	// add it to free list
 	sock->next = net_freeSockets;
 	net_freeSockets = sock;
 	sock->disconnected = true;
 }
 
+/*
+===================
+NET_HashAddr
+
+Only hashes the parts of the address that the lan drivers' AddrCompare looks at,
+so addresses that compare equal always land in the same chain
+===================
+*/
+static unsigned int NET_HashAddr (struct qsockaddr *addr)
+{
+	const byte  *data;
+	size_t       len, i;
+	unsigned int port;
+	unsigned int hash = 2166136261u;
+
+	if (addr->qsa_family == AF_INET)
+	{
+		data = (const byte *)&((struct sockaddr_in *)addr)->sin_addr;
+		len = sizeof (((struct sockaddr_in *)addr)->sin_addr);
+		port = ((struct sockaddr_in *)addr)->sin_port;
+	}
+	else if (addr->qsa_family == AF_INET6)
+	{
+		data = (const byte *)&((struct sockaddr_in6 *)addr)->sin6_addr;
+		len = sizeof (((struct sockaddr_in6 *)addr)->sin6_addr);
+		port = ((struct sockaddr_in6 *)addr)->sin6_port;
+	}
+	else // ipx and friends are rare enough to share a single chain
+		return 0;
+
+	for (i = 0; i < len; i++)
+		hash = (hash ^ data[i]) * 16777619u;
+	hash = (hash ^ (port & 0xff)) * 16777619u;
+	hash = (hash ^ (port >> 8)) * 16777619u;
+	return hash & (NET_ADDRHASH_SIZE - 1);
+}
+
+/*
+===================
+NET_HashQSocket
+
+Makes a virtual qsocket findable by its address, call once sock->addr is known
+===================
+*/
+void NET_HashQSocket (qsocket_t *sock)
+{
+	qsocket_t **chain;
+
+	NET_UnhashQSocket (sock);
+
+	chain = &net_addrhash[NET_HashAddr (&sock->addr)];
+	sock->hashnext = *chain;
+	if (*chain)
+		(*chain)->hashprev = &sock->hashnext;
+	sock->hashprev = chain;
+	*chain = sock;
+}
+
+void NET_UnhashQSocket (qsocket_t *sock)
+{
+	if (!sock->hashprev)
+		return;
+	*sock->hashprev = sock->hashnext;
+	if (sock->hashnext)
+		sock->hashnext->hashprev = sock->hashprev;
+	sock->hashnext = NULL;
+	sock->hashprev = NULL;
+}
+
+/*
+===================
+NET_FindQSocket
+
+Returns the connected virtual qsocket of the current driver that talks to addr
+through the given lan driver, or NULL
+===================
+*/
+qsocket_t *NET_FindQSocket (int landriver, struct qsockaddr *addr)
+{
+	qsocket_t *s;
+
+	for (s = net_addrhash[NET_HashAddr (addr)]; s; s = s->hashnext)
+	{
+		if (s->driver != net_driverlevel || s->landriver != landriver)
+			continue;
+		if (s->disconnected || !s->isvirtual)
+			continue;
+		if (net_landrivers[landriver].AddrCompare (addr, &s->addr) == 0)
+			return s;
+	}
+	return NULL;
+}
+
+static void NET_LinkDue (qsocket_t **list, qsocket_t *sock, int64_t tick)
+{
+	sock->wheelnext = *list;
+	if (*list)
+		(*list)->wheelprev = &sock->wheelnext;
+	sock->wheelprev = list;
+	sock->wheeltick = tick;
+	*list = sock;
+}
+
+void NET_UnscheduleQSocket (qsocket_t *sock)
+{
+	if (!sock->wheelprev)
+		return;
+	*sock->wheelprev = sock->wheelnext;
+	if (sock->wheelnext)
+		sock->wheelnext->wheelprev = sock->wheelprev;
+	sock->wheelnext = NULL;
+	sock->wheelprev = NULL;
+}
+
+/*
+===================
+NET_ScheduleQSocket
+
+Makes sure the qsocket is returned by NET_NextDueQSocket no later than when.
+A socket that is already due earlier keeps its slot, so callers can simply
+reschedule whenever one of its deadlines may have moved closer. Deadlines
+further away than the wheel span are clamped, which just costs an early visit.
+===================
+*/
+void NET_ScheduleQSocket (qsocket_t *sock, double when)
+{
+	int64_t tick;
+
+	if (net_wheeltick < 0)
+		net_wheeltick = (int64_t)floor (net_time * NET_WHEEL_HZ);
+
+	if (when <= net_time)
+	{
+		if (sock->wheelprev && sock->wheeltick < 0)
+			return; // already due
+		NET_UnscheduleQSocket (sock);
+		NET_LinkDue (&net_duesockets, sock, -1);
+		return;
+	}
+
+	tick = (int64_t)ceil (when * NET_WHEEL_HZ);
+	tick = CLAMP (net_wheeltick, tick, net_wheeltick + NET_WHEEL_SLOTS - 1);
+	if (sock->wheelprev && sock->wheeltick <= tick)
+		return;
+
+	NET_UnscheduleQSocket (sock);
+	NET_LinkDue (&net_wheel[tick & (NET_WHEEL_SLOTS - 1)], sock, tick);
+}
+
+/*
+===================
+NET_NextDueQSocket
+
+Pops the next qsocket whose scheduled time has passed, or NULL once there are
+none left. Sockets are unscheduled when returned, the caller reschedules them.
+===================
+*/
+qsocket_t *NET_NextDueQSocket (void)
+{
+	qsocket_t *sock;
+	int64_t    now = (int64_t)floor (net_time * NET_WHEEL_HZ);
+	int        slots = NET_WHEEL_SLOTS;
+
+	if (net_wheeltick < 0)
+		net_wheeltick = now;
+
+	if (!net_duesockets)
+	{
+		for (; net_wheeltick <= now; net_wheeltick++)
+		{
+			qsocket_t **slot = &net_wheel[net_wheeltick & (NET_WHEEL_SLOTS - 1)];
+
+			if (!slots--)
+			{ // every slot has been drained, skip the rest of the gap
+				net_wheeltick = now + 1;
+				break;
+			}
+			while ((sock = *slot) != NULL)
+			{
+				NET_UnscheduleQSocket (sock);
+				NET_LinkDue (&net_duesockets, sock, -1);
+			}
+		}
+	}
+
+	sock = net_duesockets;
+	if (sock)
+		NET_UnscheduleQSocket (sock);
+	return sock;
+}
+
 int NET_QSocketGetSequenceIn (const qsocket_t *s)
 { // returns the last unreliable sequence that was received
 	return s->unreliableReceiveSequence - 1;
@@ -424,6 +634,22 @@ NET_Connect
 size_t      hostCacheCount = 0;
 hostcache_t hostcache[HOSTCACHESIZE];
 
+static qsocket_t *NET_ConnectDrivers (const char *host, int numdrivers)
+{
+	qsocket_t *ret;
+
+	for (net_driverlevel = 0; net_driverlevel < numdrivers; net_driverlevel++)
+	{
+		if (net_drivers[net_driverlevel].initialized == false)
+			continue;
+		ret = dfunc.Connect (host);
+		if (ret)
+			return ret;
+	}
+
+	return NULL;
+}
+
 qsocket_t *NET_Connect (const char *host)
 {
 	qsocket_t *ret;
@@ -483,14 +709,9 @@ qsocket_t *NET_Connect (const char *host)
 	}
 
 JustDoIt:
-	for (net_driverlevel = 0; net_driverlevel < numdrivers; net_driverlevel++)
-	{
-		if (net_drivers[net_driverlevel].initialized == false)
-			continue;
-		ret = dfunc.Connect (host);
-		if (ret)
-			return ret;
-	}
+	ret = NET_ConnectDrivers (host, numdrivers);
+	if (ret)
+		return ret;
 
 	if (host)
 	{
@@ -503,6 +724,19 @@ JustDoIt:
 	return NULL;
 }
 
+/*
+===================
+NET_ConnectAddress
+
+Connects straight to an address, skipping the server list lookup NET_Connect does for host names
+===================
+*/
+qsocket_t *NET_ConnectAddress (const char *host)
+{
+	SetNetTime ();
+	return NET_ConnectDrivers (host, net_numdrivers);
+}
+
 /*
 ===================
 NET_CheckNewConnections
@@ -718,6 +952,25 @@ qboolean NET_CanSendMessage (qsocket_t *sock)
 	return sfunc.CanSendMessage (sock);
 }
 
+/*
+==================
+NET_BatchWrites
+
+While batching, lan drivers that support it hold back the datagrams they are
+asked to send and flush them together when batching is turned off again
+==================
+*/
+void NET_BatchWrites (qboolean batch)
+{
+	int i;
+
+	for (i = 0; i < net_numlandrivers; i++)
+	{
+		if (net_landrivers[i].initialized && net_landrivers[i].BatchWrites)
+			net_landrivers[i].BatchWrites (batch);
+	}
+}
+
 int NET_SendToAll (sizebuf_t *data, double blocktime)
 {
 	double   start;
@@ -822,7 +1075,7 @@ void NET_Init (void)
 	}
 	net_hostport = DEFAULTnet_hostport;
 
-	net_numsockets = svs.maxclientslimit;
+	net_numsockets = svs.maxclientslimit + LoadBot_MaxBots ();
 	if (cls.state != ca_dedicated)
 		net_numsockets++;
 	if (COM_CheckParm ("-listen") || cls.state == ca_dedicated)
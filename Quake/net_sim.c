@@ -0,0 +1,414 @@
+/*
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+
+// net_sim.c -- network impairment simulator
+
+/*
+The simulator sits between the datagram driver and the lan drivers by replacing their Read and Write entries. Every
+packet that goes through a wrapped driver, in either direction, can be dropped, duplicated, delayed by a fixed latency
+plus jitter, or held back further so that it arrives out of order. Latency applies to each direction, so a round trip
+gains twice net_sim_latency.
+
+The random decisions come from a per-connection generator seeded from net_sim_seed and the order in which connections
+were first seen, so a scripted run over the same connections drops the same packets every time. Changing the profile
+resets the connections and their statistics.
+
+Loopback connections don't go through a lan driver; to simulate a local game, connect to 127.0.0.1 instead of local.
+*/
+
+#include "q_stdinc.h"
+#include "arch_def.h"
+#include "net_sys.h"
+#include "quakedef.h"
+#include "net_defs.h"
+#include "net_sim.h"
+
+#define NETSIM_MAXDRIVERS 4  // lan drivers that can be wrapped, see NETSIM_THUNKS
+#define NETSIM_MAXPEERS   64 // connections with their own statistics and random state
+#define NETSIM_MAXAGE     5.0 // queued packets for sockets that stopped reading are dropped after this long
+
+static cvar_t net_sim_latency = {"net_sim_latency", "0", CVAR_NONE};     // ms, each direction
+static cvar_t net_sim_jitter = {"net_sim_jitter", "0", CVAR_NONE};       // ms of extra random delay
+static cvar_t net_sim_loss = {"net_sim_loss", "0", CVAR_NONE};           // percent
+static cvar_t net_sim_duplicate = {"net_sim_duplicate", "0", CVAR_NONE}; // percent
+static cvar_t net_sim_reorder = {"net_sim_reorder", "0", CVAR_NONE};     // percent held back behind later packets
+static cvar_t net_sim_seed = {"net_sim_seed", "1", CVAR_NONE};
+
+typedef struct netsimpacket_s
+{
+	struct netsimpacket_s *next;
+	double                 release;
+	int                    landriver;
+	sys_socket_t           socket;
+	struct qsockaddr       addr;
+	int                    length;
+	byte                   data[];
+} netsimpacket_t;
+
+enum
+{
+	NETSIM_IN,
+	NETSIM_OUT
+};
+
+typedef struct
+{
+	int              landriver;
+	struct qsockaddr addr;
+	uint32_t         rng[2];
+	unsigned int     packets[2];
+	unsigned int     bytes[2];
+	unsigned int     dropped[2];
+	unsigned int     duplicated[2];
+	unsigned int     reordered[2];
+	double           delay[2]; // sum over delivered packets, for the average
+} netsimpeer_t;
+
+typedef struct
+{
+	const char *name;
+	float       latency, jitter, loss, duplicate, reorder;
+} netsimprofile_t;
+
+static const netsimprofile_t netsim_profiles[] = {
+	{"off", 0, 0, 0, 0, 0},      {"lan", 1, 1, 0, 0, 0},          {"dsl", 20, 5, 0.5, 0, 0.5},
+	{"wifi", 5, 15, 2, 0.5, 2},  {"mobile", 60, 40, 3, 1, 5},     {"satellite", 300, 20, 1, 0, 0},
+	{"lossy", 50, 10, 10, 2, 5},
+};
+
+static net_landriver_t netsim_real[NETSIM_MAXDRIVERS]; // the wrapped drivers' original entries
+static int             netsim_numwrapped;
+static netsimpacket_t *netsim_queue[2]; // by release time
+static netsimpeer_t    netsim_peers[NETSIM_MAXPEERS];
+static int             netsim_numpeers;
+static byte            netsim_buffer[NET_DATAGRAMSIZE];
+
+static qboolean NetSim_Enabled (void)
+{
+	return net_sim_latency.value > 0 || net_sim_jitter.value > 0 || net_sim_loss.value > 0 || net_sim_duplicate.value > 0 || net_sim_reorder.value > 0;
+}
+
+static float NetSim_Random (uint32_t *state)
+{
+	// xorshift32, plenty for coin flips and reproducible everywhere
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+static netsimpeer_t *NetSim_Peer (int landriver, struct qsockaddr *addr)
+{
+	netsimpeer_t *peer;
+	uint32_t      seed;
+	int           i;
+
+	for (i = 0; i < q_min (netsim_numpeers, NETSIM_MAXPEERS); i++)
+	{
+		peer = &netsim_peers[i];
+		if (peer->landriver == landriver && netsim_real[landriver].AddrCompare (addr, &peer->addr) == 0)
+			return peer;
+	}
+
+	// recycle the oldest slot once the table is full
+	peer = &netsim_peers[netsim_numpeers % NETSIM_MAXPEERS];
+	memset (peer, 0, sizeof (*peer));
+	peer->landriver = landriver;
+	peer->addr = *addr;
+	seed = (uint32_t)(int)net_sim_seed.value * 2654435761u + (uint32_t)++netsim_numpeers * 40503u;
+	peer->rng[NETSIM_IN] = seed ^ 0x9e3779b9u;
+	peer->rng[NETSIM_OUT] = seed ^ 0x7f4a7c15u;
+	for (i = 0; i < 2; i++)
+		if (!peer->rng[i])
+			peer->rng[i] = 1; // xorshift gets stuck on zero
+	return peer;
+}
+
+static void NetSim_Enqueue (int dir, double release, int landriver, sys_socket_t socket, struct qsockaddr *addr, const byte *data, int length)
+{
+	netsimpacket_t  *p = (netsimpacket_t *)Mem_Alloc (sizeof (netsimpacket_t) + length);
+	netsimpacket_t **link;
+
+	p->release = release;
+	p->landriver = landriver;
+	p->socket = socket;
+	p->addr = *addr;
+	p->length = length;
+	memcpy (p->data, data, length);
+
+	// keep the queue sorted, after packets that are due at the same time
+	for (link = &netsim_queue[dir]; *link && (*link)->release <= release; link = &(*link)->next)
+		;
+	p->next = *link;
+	*link = p;
+}
+
+/*
+===================
+NetSim_Impair
+
+Decides the fate of one packet and queues whatever copies of it survive
+===================
+*/
+static void NetSim_Impair (int dir, int landriver, sys_socket_t socket, struct qsockaddr *addr, const byte *data, int length)
+{
+	netsimpeer_t *peer = NetSim_Peer (landriver, addr);
+	uint32_t     *rng = &peer->rng[dir];
+	double        now = Sys_DoubleTime ();
+	double        delay;
+
+	peer->packets[dir]++;
+	peer->bytes[dir] += length;
+
+	if (NetSim_Random (rng) * 100 < net_sim_loss.value)
+	{
+		peer->dropped[dir]++;
+		return;
+	}
+
+	delay = (net_sim_latency.value + NetSim_Random (rng) * net_sim_jitter.value) / 1000.0;
+	if (NetSim_Random (rng) * 100 < net_sim_reorder.value)
+	{
+		delay += 0.005 + NetSim_Random (rng) * 0.045;
+		peer->reordered[dir]++;
+	}
+	peer->delay[dir] += delay;
+	NetSim_Enqueue (dir, now + delay, landriver, socket, addr, data, length);
+
+	if (NetSim_Random (rng) * 100 < net_sim_duplicate.value)
+	{
+		peer->duplicated[dir]++;
+		NetSim_Enqueue (dir, now + delay + 0.001 + NetSim_Random (rng) * net_sim_jitter.value / 1000.0, landriver, socket, addr, data, length);
+	}
+}
+
+static void NetSim_Flush (void)
+{
+	netsimpacket_t *p;
+	double          now = Sys_DoubleTime ();
+
+	while ((p = netsim_queue[NETSIM_OUT]) && p->release <= now)
+	{
+		netsim_queue[NETSIM_OUT] = p->next;
+		netsim_real[p->landriver].Write (p->socket, p->data, p->length, &p->addr);
+		Mem_Free (p);
+	}
+	while ((p = netsim_queue[NETSIM_IN]) && p->release < now - NETSIM_MAXAGE)
+	{
+		netsim_queue[NETSIM_IN] = p->next;
+		Mem_Free (p);
+	}
+}
+
+static int NetSim_Read (int landriver, sys_socket_t socketid, byte *buf, int len, struct qsockaddr *addr)
+{
+	netsimpacket_t **link, *p;
+	struct qsockaddr from;
+	double           now;
+	int              ret;
+
+	if (!netsim_queue[NETSIM_IN] && !netsim_queue[NETSIM_OUT] && !NetSim_Enabled ())
+		return netsim_real[landriver].Read (socketid, buf, len, addr);
+
+	NetSim_Flush ();
+
+	// everything the socket has goes into the delay line first
+	while ((ret = netsim_real[landriver].Read (socketid, netsim_buffer, sizeof (netsim_buffer), &from)) > 0)
+		NetSim_Impair (NETSIM_IN, landriver, socketid, &from, netsim_buffer, ret);
+	if (ret < 0)
+		return ret;
+
+	now = Sys_DoubleTime ();
+	for (link = &netsim_queue[NETSIM_IN]; (p = *link) && p->release <= now; link = &p->next)
+	{
+		if (p->socket != socketid || p->landriver != landriver)
+			continue;
+		*link = p->next;
+		ret = q_min (p->length, len);
+		memcpy (buf, p->data, ret);
+		*addr = p->addr;
+		Mem_Free (p);
+		return ret;
+	}
+	return 0;
+}
+
+static int NetSim_Write (int landriver, sys_socket_t socketid, byte *buf, int len, struct qsockaddr *addr)
+{
+	if (!netsim_queue[NETSIM_OUT] && !NetSim_Enabled ())
+		return netsim_real[landriver].Write (socketid, buf, len, addr);
+
+	NetSim_Impair (NETSIM_OUT, landriver, socketid, addr, buf, len);
+	NetSim_Flush ();
+	return len;
+}
+
+// the driver tables have no context pointer, so each wrapped driver gets its own entry points
+#define NETSIM_THUNKS(i)                                                                           \
+	static int NetSim_Read##i (sys_socket_t socketid, byte *buf, int len, struct qsockaddr *addr)  \
+	{                                                                                              \
+		return NetSim_Read (i, socketid, buf, len, addr);                                          \
+	}                                                                                              \
+	static int NetSim_Write##i (sys_socket_t socketid, byte *buf, int len, struct qsockaddr *addr) \
+	{                                                                                              \
+		return NetSim_Write (i, socketid, buf, len, addr);                                         \
+	}
+NETSIM_THUNKS (0)
+NETSIM_THUNKS (1)
+NETSIM_THUNKS (2)
+NETSIM_THUNKS (3)
+
+static int (*const netsim_read[NETSIM_MAXDRIVERS]) (sys_socket_t, byte *, int, struct qsockaddr *) = {NetSim_Read0, NetSim_Read1, NetSim_Read2, NetSim_Read3};
+static int (*const netsim_write[NETSIM_MAXDRIVERS]) (sys_socket_t, byte *, int, struct qsockaddr *) = {
+	NetSim_Write0, NetSim_Write1, NetSim_Write2, NetSim_Write3};
+
+static void NetSim_ResetPeers (void)
+{
+	memset (netsim_peers, 0, sizeof (netsim_peers));
+	netsim_numpeers = 0;
+}
+
+/*
+===================
+NetSim_f
+
+net_sim [profile]: switches to one of the preset profiles, or shows the current settings
+===================
+*/
+static void NetSim_f (void)
+{
+	const netsimprofile_t *profile = NULL;
+	int                    i;
+
+	if (Cmd_Argc () >= 2)
+	{
+		for (i = 0; i < (int)countof (netsim_profiles); i++)
+			if (!q_strcasecmp (Cmd_Argv (1), netsim_profiles[i].name))
+				profile = &netsim_profiles[i];
+		if (!profile)
+		{
+			Con_Printf ("unknown profile \"%s\"\n", Cmd_Argv (1));
+			return;
+		}
+		Cvar_SetValueQuick (&net_sim_latency, profile->latency);
+		Cvar_SetValueQuick (&net_sim_jitter, profile->jitter);
+		Cvar_SetValueQuick (&net_sim_loss, profile->loss);
+		Cvar_SetValueQuick (&net_sim_duplicate, profile->duplicate);
+		Cvar_SetValueQuick (&net_sim_reorder, profile->reorder);
+		NetSim_ResetPeers ();
+	}
+
+	Con_Printf (
+		"latency %gms, jitter %gms, loss %g%%, duplicate %g%%, reorder %g%%, seed %d\n", net_sim_latency.value, net_sim_jitter.value, net_sim_loss.value,
+		net_sim_duplicate.value, net_sim_reorder.value, (int)net_sim_seed.value);
+	if (Cmd_Argc () < 2)
+	{
+		Con_Printf ("profiles:");
+		for (i = 0; i < (int)countof (netsim_profiles); i++)
+			Con_Printf (" %s", netsim_profiles[i].name);
+		Con_Printf ("\n");
+	}
+}
+
+/*
+===================
+NetSim_Stats_f
+
+net_sim_stats [reset]
+===================
+*/
+static void NetSim_Stats_f (void)
+{
+	static const char *dirnames[2] = {"in", "out"};
+	netsimpeer_t      *peer;
+	int                i, dir;
+	unsigned int       delivered;
+
+	if (Cmd_Argc () >= 2 && !strcmp (Cmd_Argv (1), "reset"))
+	{
+		NetSim_ResetPeers ();
+		return;
+	}
+
+	Con_Printf ("address                  dir  packets     bytes  dropped  dup  reorder  avg delay\n");
+	for (i = 0; i < q_min (netsim_numpeers, NETSIM_MAXPEERS); i++)
+	{
+		peer = &netsim_peers[i];
+		for (dir = 0; dir < 2; dir++)
+		{
+			delivered = peer->packets[dir] - peer->dropped[dir];
+			Con_Printf (
+				"%-24s %-3s %8u %9u %8u %4u %8u %8.1fms\n", netsim_real[peer->landriver].AddrToString (&peer->addr, false), dirnames[dir],
+				peer->packets[dir], peer->bytes[dir], peer->dropped[dir], peer->duplicated[dir], peer->reordered[dir],
+				delivered ? peer->delay[dir] * 1000.0 / delivered : 0.0);
+		}
+	}
+}
+
+/*
+===================
+NetSim_Init
+
+Wraps the lan drivers, call once they have been initialized
+===================
+*/
+void NetSim_Init (void)
+{
+	int i;
+
+	Cvar_RegisterVariable (&net_sim_latency);
+	Cvar_RegisterVariable (&net_sim_jitter);
+	Cvar_RegisterVariable (&net_sim_loss);
+	Cvar_RegisterVariable (&net_sim_duplicate);
+	Cvar_RegisterVariable (&net_sim_reorder);
+	Cvar_RegisterVariable (&net_sim_seed);
+	Cmd_AddCommand ("net_sim", NetSim_f);
+	Cmd_AddCommand ("net_sim_stats", NetSim_Stats_f);
+
+	netsim_numwrapped = q_min (net_numlandrivers, NETSIM_MAXDRIVERS);
+	for (i = 0; i < netsim_numwrapped; i++)
+	{
+		netsim_real[i] = net_landrivers[i];
+		net_landrivers[i].Read = netsim_read[i];
+		net_landrivers[i].Write = netsim_write[i];
+	}
+}
+
+void NetSim_Shutdown (void)
+{
+	netsimpacket_t *p;
+	int             dir, i;
+
+	for (dir = 0; dir < 2; dir++)
+	{
+		while ((p = netsim_queue[dir]))
+		{
+			netsim_queue[dir] = p->next;
+			Mem_Free (p);
+		}
+	}
+
+	for (i = 0; i < netsim_numwrapped; i++)
+	{
+		net_landrivers[i].Read = netsim_real[i].Read;
+		net_landrivers[i].Write = netsim_real[i].Write;
+	}
+	netsim_numwrapped = 0;
+}
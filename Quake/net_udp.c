@@ -20,6 +20,13 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 */
 
+#if defined(__linux__)
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE // recvmmsg, sendmmsg
+#endif
+#define UDP_USE_MMSG
+#endif
+
 #include "q_stdinc.h"
 #include "arch_def.h"
 #include "net_sys.h"
@@ -40,6 +47,255 @@ static struct in6_addr myAddrv6;
 
 #include "net_udp.h"
 
+//=============================================================================
+// Batched socket I/O
+//
+// Where recvmmsg/sendmmsg exist, UDP_Read drains the listening sockets up to
+// UDP_RECV_BATCH packets per syscall into a ring and hands them out one at a
+// time, and while writes are batched (see UDP_BatchWrites) UDP_Write only
+// queues the datagram, to be sent with the rest in a single sendmmsg.
+// -nommsg, or a kernel without the syscalls, gets the classic path.
+//=============================================================================
+
+#ifdef UDP_USE_MMSG
+
+#define UDP_RECV_BATCH      32
+#define UDP_SEND_BATCH      256
+#define UDP_SEND_BATCH_SIZE (256 * 1024)
+
+typedef struct
+{
+	sys_socket_t     socketid;
+	int              next, count;
+	int              lengths[UDP_RECV_BATCH];
+	struct qsockaddr addrs[UDP_RECV_BATCH];
+	byte            *buffers; // UDP_RECV_BATCH * NET_DATAGRAMSIZE
+} udprecvring_t;
+
+typedef struct
+{
+	qboolean         active;
+	int              count;
+	int              used;
+	sys_socket_t     sockets[UDP_SEND_BATCH];
+	struct qsockaddr addrs[UDP_SEND_BATCH];
+	socklen_t        addrsizes[UDP_SEND_BATCH];
+	int              offsets[UDP_SEND_BATCH];
+	int              lengths[UDP_SEND_BATCH];
+	byte             data[UDP_SEND_BATCH_SIZE];
+} udpsendbatch_t;
+
+static qboolean       udp_mmsg_disabled;
+static udprecvring_t  udp_recvrings[2]; // net_acceptsocket4, net_acceptsocket6
+static udpsendbatch_t udp_sendbatch;
+
+/*
+============
+UDP_RecvRing
+
+Returns the receive ring for one of the listening sockets, NULL for any other
+============
+*/
+static udprecvring_t *UDP_RecvRing (sys_socket_t socketid)
+{
+	udprecvring_t *ring;
+
+	if (udp_mmsg_disabled || socketid == INVALID_SOCKET)
+		return NULL;
+	if (socketid == net_acceptsocket4)
+		ring = &udp_recvrings[0];
+	else if (socketid == net_acceptsocket6)
+		ring = &udp_recvrings[1];
+	else
+		return NULL;
+
+	if (ring->socketid != socketid)
+	{
+		ring->socketid = socketid;
+		ring->next = ring->count = 0;
+	}
+	if (!ring->buffers)
+		ring->buffers = (byte *)Mem_Alloc (UDP_RECV_BATCH * NET_DATAGRAMSIZE);
+	return ring;
+}
+
+/*
+============
+UDP_FillRecvRing
+
+Returns the number of packets received, 0 if there were none, -1 on errors
+============
+*/
+static int UDP_FillRecvRing (udprecvring_t *ring)
+{
+	struct mmsghdr msgs[UDP_RECV_BATCH];
+	struct iovec   iov[UDP_RECV_BATCH];
+	int            i, ret;
+
+	memset (msgs, 0, sizeof (msgs));
+	for (i = 0; i < UDP_RECV_BATCH; i++)
+	{
+		iov[i].iov_base = ring->buffers + i * NET_DATAGRAMSIZE;
+		iov[i].iov_len = NET_DATAGRAMSIZE;
+		msgs[i].msg_hdr.msg_name = &ring->addrs[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof (struct qsockaddr);
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	ret = recvmmsg (ring->socketid, msgs, UDP_RECV_BATCH, MSG_DONTWAIT, NULL);
+	if (ret == SOCKET_ERROR)
+	{
+		int err = SOCKETERRNO;
+		if (err == NET_EWOULDBLOCK || err == NET_ECONNREFUSED)
+			return 0;
+		if (err == ENOSYS)
+		{
+			udp_mmsg_disabled = true;
+			return -1;
+		}
+		Con_SafePrintf ("UDP_Read, recvmmsg: %s\n", socketerror (err));
+		return -1;
+	}
+
+	for (i = 0; i < ret; i++)
+		ring->lengths[i] = msgs[i].msg_len;
+	ring->next = 0;
+	ring->count = ret;
+	return ret;
+}
+
+/*
+============
+UDP_ReadRing
+============
+*/
+static int UDP_ReadRing (udprecvring_t *ring, byte *buf, int len, struct qsockaddr *addr)
+{
+	int ret;
+
+	if (!ring->count)
+	{
+		ret = UDP_FillRecvRing (ring);
+		if (ret <= 0)
+			return ret;
+	}
+
+	// recvfrom would have truncated it the same way
+	ret = q_min (len, ring->lengths[ring->next]);
+	memcpy (buf, ring->buffers + ring->next * NET_DATAGRAMSIZE, ret);
+	*addr = ring->addrs[ring->next];
+	ring->next++;
+	ring->count--;
+	return ret;
+}
+
+/*
+============
+UDP_FlushWrites
+
+Sends everything UDP_Write queued, one sendmmsg per run of datagrams on the same socket
+============
+*/
+static void UDP_FlushWrites (void)
+{
+	struct mmsghdr msgs[UDP_SEND_BATCH];
+	struct iovec   iov[UDP_SEND_BATCH];
+	int            i, start, end, ret;
+
+	memset (msgs, 0, udp_sendbatch.count * sizeof (msgs[0]));
+	for (i = 0; i < udp_sendbatch.count; i++)
+	{
+		iov[i].iov_base = udp_sendbatch.data + udp_sendbatch.offsets[i];
+		iov[i].iov_len = udp_sendbatch.lengths[i];
+		msgs[i].msg_hdr.msg_name = &udp_sendbatch.addrs[i];
+		msgs[i].msg_hdr.msg_namelen = udp_sendbatch.addrsizes[i];
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	for (start = 0; start < udp_sendbatch.count; start = end)
+	{
+		for (end = start + 1; end < udp_sendbatch.count && udp_sendbatch.sockets[end] == udp_sendbatch.sockets[start]; end++)
+			;
+
+		while (start < end)
+		{
+			if (!udp_mmsg_disabled)
+				ret = sendmmsg (udp_sendbatch.sockets[start], msgs + start, end - start, 0);
+			else if (sendto (udp_sendbatch.sockets[start], iov[start].iov_base, iov[start].iov_len, 0, msgs[start].msg_hdr.msg_name,
+						 udp_sendbatch.addrsizes[start]) != SOCKET_ERROR)
+				ret = 1;
+			else
+				ret = SOCKET_ERROR;
+
+			if (ret == SOCKET_ERROR)
+			{
+				int err = SOCKETERRNO;
+				if (err == ENOSYS && !udp_mmsg_disabled)
+				{
+					udp_mmsg_disabled = true;
+					continue; // retry with sendto
+				}
+				if (err == ENETUNREACH)
+					Con_SafePrintf ("UDP_Write: %s (%s)\n", socketerror (err), UDP_AddrToString (&udp_sendbatch.addrs[start], false));
+				else if (err != NET_EWOULDBLOCK)
+					Con_SafePrintf ("UDP_Write, sendmmsg: %s\n", socketerror (err));
+				ret = 1; // drop it, like a failed sendto
+			}
+			start += ret;
+		}
+	}
+
+	udp_sendbatch.count = 0;
+	udp_sendbatch.used = 0;
+}
+
+/*
+============
+UDP_QueueWrite
+
+Returns false if the datagram should go out right away instead
+============
+*/
+static qboolean UDP_QueueWrite (sys_socket_t socketid, byte *buf, int len, struct qsockaddr *addr, socklen_t addrsize)
+{
+	if (!udp_sendbatch.active || udp_mmsg_disabled || len > UDP_SEND_BATCH_SIZE)
+		return false;
+
+	if (udp_sendbatch.count == UDP_SEND_BATCH || udp_sendbatch.used + len > UDP_SEND_BATCH_SIZE)
+		UDP_FlushWrites ();
+
+	memcpy (udp_sendbatch.data + udp_sendbatch.used, buf, len);
+	udp_sendbatch.sockets[udp_sendbatch.count] = socketid;
+	udp_sendbatch.addrs[udp_sendbatch.count] = *addr;
+	udp_sendbatch.addrsizes[udp_sendbatch.count] = addrsize;
+	udp_sendbatch.offsets[udp_sendbatch.count] = udp_sendbatch.used;
+	udp_sendbatch.lengths[udp_sendbatch.count] = len;
+	udp_sendbatch.count++;
+	udp_sendbatch.used += len;
+	return true;
+}
+
+#endif // UDP_USE_MMSG
+
+/*
+============
+UDP_BatchWrites
+
+While batching, UDP_Write queues datagrams instead of sending them.
+Turning it off sends whatever was queued.
+============
+*/
+void UDP_BatchWrites (qboolean batch)
+{
+#ifdef UDP_USE_MMSG
+	if (!batch && udp_sendbatch.count)
+		UDP_FlushWrites ();
+	udp_sendbatch.active = batch;
+#endif
+}
+
 //=============================================================================
 
 sys_socket_t UDP4_Init (void)
@@ -50,6 +306,11 @@ sys_socket_t UDP4_Init (void)
 	if (COM_CheckParm ("-noudp") || COM_CheckParm ("-noudp4"))
 		return INVALID_SOCKET;
 
+#ifdef UDP_USE_MMSG
+	if (COM_CheckParm ("-nommsg"))
+		udp_mmsg_disabled = true;
+#endif
+
 	myAddr4 = htonl (INADDR_LOOPBACK);
 #ifdef __linux__
 	// gethostbyname(gethostname()) is only supported if the hostname can be looked up on an actual name server
@@ -191,6 +452,20 @@ int UDP_CloseSocket (sys_socket_t socketid)
 {
 	if (socketid == net_broadcastsocket4)
 		net_broadcastsocket4 = INVALID_SOCKET;
+#ifdef UDP_USE_MMSG
+	for (int i = 0; i < 2; i++)
+	{
+		// drop what was read ahead, the descriptor may be reused
+		if (udp_recvrings[i].socketid == socketid)
+		{
+			udp_recvrings[i].socketid = INVALID_SOCKET;
+			udp_recvrings[i].count = 0;
+		}
+	}
+	// queued datagrams may be for this socket
+	if (udp_sendbatch.count)
+		UDP_FlushWrites ();
+#endif
 	return closesocket (socketid);
 }
 
@@ -275,6 +550,10 @@ sys_socket_t UDP4_CheckNewConnections (void)
 	}
 	if (available)
 		return net_acceptsocket4;
+#ifdef UDP_USE_MMSG
+	if (udp_recvrings[0].socketid == net_acceptsocket4 && udp_recvrings[0].count)
+		return net_acceptsocket4;
+#endif
 	// quietly absorb empty packets
 	recvfrom (net_acceptsocket4, buff, 0, 0, (struct sockaddr *)&from, &fromlen);
 	return INVALID_SOCKET;
@@ -287,6 +566,16 @@ int UDP_Read (sys_socket_t socketid, byte *buf, int len, struct qsockaddr *addr)
 	socklen_t addrlen = sizeof (struct qsockaddr);
 	int       ret;
 
+#ifdef UDP_USE_MMSG
+	udprecvring_t *ring = UDP_RecvRing (socketid);
+	if (ring)
+	{
+		ret = UDP_ReadRing (ring, buf, len, addr);
+		if (ret >= 0 || !udp_mmsg_disabled)
+			return ret;
+	}
+#endif
+
 	ret = recvfrom (socketid, buf, len, 0, (struct sockaddr *)addr, &addrlen);
 	if (ret == SOCKET_ERROR)
 	{
@@ -354,6 +643,11 @@ int UDP_Write (sys_socket_t socketid, byte *buf, int len, struct qsockaddr *addr
 		return -1; // some kind of error. a few systems get pissy if the size doesn't exactly match the address family
 	}
 
+#ifdef UDP_USE_MMSG
+	if (UDP_QueueWrite (socketid, buf, len, addr, addrsize))
+		return len;
+#endif
+
 	ret = sendto (socketid, buf, len, 0, (struct sockaddr *)addr, addrsize);
 	if (!hdr->qsa_family)
 		Con_SafePrintf ("UDP_Write: family was cleared\n");
@@ -692,6 +986,10 @@ sys_socket_t UDP6_CheckNewConnections (void)
 	}
 	if (available)
 		return net_acceptsocket6;
+#ifdef UDP_USE_MMSG
+	if (udp_recvrings[1].socketid == net_acceptsocket6 && udp_recvrings[1].count)
+		return net_acceptsocket6;
+#endif
 	// quietly absorb empty packets
 	fromlen = sizeof (from);
 	recvfrom (net_acceptsocket6, buff, 0, 0, (struct sockaddr *)&from, &fromlen);
@@ -41,6 +41,7 @@ int          UDP_AddrCompare (struct qsockaddr *addr1, struct qsockaddr *addr2);
 int          UDP_GetSocketPort (struct qsockaddr *addr);
 int          UDP_SetSocketPort (struct qsockaddr *addr, int port);
 int          UDP4_GetAddresses (qhostaddr_t *addresses, int maxaddresses);
+void         UDP_BatchWrites (qboolean batch);
 
 sys_socket_t UDP6_Init (void);
 void         UDP6_Shutdown (void);
@@ -63,7 +63,8 @@ net_landriver_t net_landrivers[] = {
      WINIPv4_GetAddrFromName,
      WINS_AddrCompare,
      WINS_GetSocketPort,
-     WINS_SetSocketPort},
+     WINS_SetSocketPort,
+     NULL},
 #ifdef IPPROTO_IPV6
 	{"Winsock IPv6",
      false,
@@ -86,7 +87,8 @@ net_landriver_t net_landrivers[] = {
      WINIPv6_GetAddrFromName,
      WINS_AddrCompare,
      WINS_GetSocketPort,
-     WINS_SetSocketPort},
+     WINS_SetSocketPort,
+     NULL},
 #endif
 	{"Winsock IPX",
      false,
@@ -109,6 +111,7 @@ net_landriver_t net_landrivers[] = {
      WIPX_GetAddrFromName,
      WIPX_AddrCompare,
      WIPX_GetSocketPort,
-     WIPX_SetSocketPort}};
+     WIPX_SetSocketPort,
+     NULL}};
 
 const int net_numlandrivers = (sizeof (net_landrivers) / sizeof (net_landrivers[0]));
@@ -4382,8 +4382,7 @@ static void         DrawQC_CharacterQuad (cb_context_t *cbx, float x, float y, i
 		.blendFuncDst = alpha_blend ? RG_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA : 0,
 	};
 
-	RgResult r = rgUploadRasterizedGeometry (vulkan_globals.instance, &info, cbx->cur_viewprojection, &cbx->cur_viewport);
-	RG_CHECK (r);
+	Draw_Batch (cbx, &info);
 }
 static void PF_cl_drawcharacter (void)
 {
@@ -4609,8 +4608,7 @@ static void PF_cl_drawfill (void)
 		.blendFuncDst = RG_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
 	};
 
-	RgResult r = rgUploadRasterizedGeometry (vulkan_globals.instance, &info, cbx->cur_viewprojection, &cbx->cur_viewport);
-	RG_CHECK (r);
+	Draw_Batch (cbx, &info);
 }
 
 void PF_cl_playerkey_internal (int player, const char *key, qboolean retfloat)
@@ -35,18 +35,31 @@ typedef struct
 /* !!! if this is changed, it must be changed in asm_i386.h too !!! */
 typedef struct
 {
-	int  length;
-	int  loopstart;
-	int  speed;
-	int  width;
-	int  stereo;
-	byte data[1]; /* variable sized	*/
+	int                 length;
+	int                 loopstart;
+	int                 speed;
+	int                 width;
+	int                 stereo;
+	int                 memsize; /* bytes held, counted against snd_cachesize	*/
+	struct sndstream_s *stream;  /* NULL if data holds the whole sound		*/
+	byte                data[1]; /* variable sized, empty if streamed	*/
 } sfxcache_t;
 
+/* polyphase windowed sinc resampler, see S_InitResampler */
+typedef struct
+{
+	int      inrate, outrate;
+	int      taps;    /* per output sample, a multiple of 4	*/
+	int      phases;  /* fractional input positions		*/
+	float   *kernels; /* phases * taps				*/
+	qboolean simd;    /* use_simd when it was set up		*/
+} sndresampler_t;
+
 typedef struct sfx_s
 {
-	char        name[MAX_QPATH];
-	sfxcache_t *cache;
+	char         name[MAX_QPATH];
+	sfxcache_t  *cache;
+	unsigned int lastused; /* for evicting the least recently used cache	*/
 } sfx_t;
 
 typedef struct
@@ -174,17 +187,33 @@ extern cvar_t snd_mixspeed;
 extern cvar_t snd_filterquality;
 extern cvar_t sfxvolume;
 extern cvar_t loadas8bit;
+extern cvar_t snd_streamlength;
+extern cvar_t snd_resamplequality;
 
 #define MAX_RAW_SAMPLES 8192
 extern portable_samplepair_t s_rawsamples[MAX_RAW_SAMPLES];
 
 extern cvar_t bgmvolume;
 
-void        S_LocalSound (const char *name);
-sfxcache_t *S_LoadSound (sfx_t *s);
+void         S_LocalSound (const char *name);
+sfxcache_t  *S_LoadSound (sfx_t *s);
+byte        *S_LoadSoundFile (sfx_t *s, int *filesize);
+sfxcache_t  *S_DecodeSound (sfx_t *s, byte *data, int filesize);
+void         S_UnloadSound (sfx_t *s);
+void         S_FreeSfxCache (sfxcache_t *sc);
+unsigned int S_SoundCacheBytes (void);
+const byte  *S_StreamSound (sfxcache_t *sc, int pos, int *count);
 
 wavinfo_t GetWavinfo (const char *name, byte *wav, int wavlength);
 
+qboolean S_InitResampler (sndresampler_t *r, int inrate, int outrate, int quality);
+void     S_FreeResampler (sndresampler_t *r);
+void     S_ResampleRow (const sndresampler_t *r, const float *in, int64_t num, int count, float *out);
+void     S_ResampleSamples (
+		const sndresampler_t *r, const byte *data, int inwidth, int insamples, int loopstart, byte *out, int outwidth, int first, int count);
+
 void SND_InitScaletable (void);
+void SND_MixBenchmark_f (void);
+void SND_ResampleBenchmark_f (void);
 
 #endif /* __QUAKE_SOUND__ */
@@ -263,6 +263,10 @@ static inline int FindFirstBitNonZero (const uint32_t mask)
 	_BitScanForward (&result, mask);
 	return result;
 }
+static inline int FindFirstBitNonZero64 (const uint64_t mask)
+{
+	return (uint32_t)mask ? FindFirstBitNonZero ((uint32_t)mask) : 32 + FindFirstBitNonZero ((uint32_t)(mask >> 32));
+}
 #define THREAD_LOCAL __declspec(thread)
 #define FORCE_INLINE __forceinline
 #else
@@ -270,6 +274,10 @@ static inline int FindFirstBitNonZero (const uint32_t mask)
 {
 	return __builtin_ctz (mask);
 }
+static inline int FindFirstBitNonZero64 (const uint64_t mask)
+{
+	return __builtin_ctzll (mask);
+}
 #define THREAD_LOCAL _Thread_local
 #define FORCE_INLINE __attribute__ ((always_inline)) inline
 #endif
@@ -45,8 +45,16 @@ int                shelf_idx[MAX_EXTENT];
 int                columns[MAX_EXTENT];
 int                rows[MAX_EXTENT];
 
-unsigned blocklights[LMBLOCK_WIDTH * LMBLOCK_HEIGHT * 3 + 1]; // johnfitz -- was 18*18, added lit support (*3) and loosened surface extents maximum
-                                                              // (LMBLOCK_WIDTH*LMBLOCK_HEIGHT)
+// johnfitz -- was 18*18, added lit support (*3) and loosened surface extents maximum
+// per thread so surfaces can be lit from several tasks, grown to the largest surface seen
+static THREAD_LOCAL unsigned *blocklights;
+static THREAD_LOCAL int       blocklights_size;
+
+// world surfaces whose lightmap needs rebuilding this frame, filled while marking
+// surfaces and built in parallel by R_BuildQueuedLightmaps
+static msurface_t    **dirtylightmapsurfs;
+static int             maxdirtylightmapsurfs;
+static atomic_uint32_t numdirtylightmapsurfs;
 
 extern cvar_t r_showtris;
 extern cvar_t r_simd;
@@ -204,7 +212,7 @@ R_DrawBrushModel
 */
 void R_DrawBrushModel (cb_context_t *cbx, entity_t *e, int chain, int entuniqueid)
 {
-	int         i, k;
+	int         i;
 	msurface_t *psurf;
 	float       dot;
 	mplane_t   *pplane;
@@ -240,15 +248,7 @@ void R_DrawBrushModel (cb_context_t *cbx, entity_t *e, int chain, int entuniquei
 	// calculate dynamic lighting for bmodel if it's not an
 	// instanced model
 	if (clmodel->firstmodelsurface != 0)
-	{
-		for (k = 0; k < MAX_DLIGHTS; k++)
-		{
-			if ((cl_dlights[k].die < cl.time) || (!cl_dlights[k].radius))
-				continue;
-
-			R_MarkLights (&cl_dlights[k], k, clmodel->nodes + clmodel->hulls[0].firstclipnode);
-		}
-	}
+		R_MarkLights (R_ActiveDlightBits (), clmodel->nodes + clmodel->hulls[0].firstclipnode);
 
 	R_ClearTextureChains (clmodel, chain);
 	for (i = 0; i < clmodel->nummodelsurfaces; i++, psurf++)
@@ -339,56 +339,104 @@ void R_DrawBrushModel_ShowTris (cb_context_t *cbx, entity_t *e)
 
 /*
 ================
-R_RenderDynamicLightmaps
-called during rendering
+R_LightmapNeedsUpdate
 ================
 */
-void R_RenderDynamicLightmaps (msurface_t *fa)
+static qboolean R_LightmapNeedsUpdate (msurface_t *fa)
 {
-	byte     *base;
-	int       maps;
-	glRect_t *theRect;
-	int       smax, tmax;
+	int maps;
 
 	if (fa->flags & SURF_DRAWTILED) // johnfitz -- not a lightmapped surface
-		return;
+		return false;
+
+	if (!r_dynamic.value)
+		return false;
 
 	// check for lightmap modification
 	for (maps = 0; maps < MAXLIGHTMAPS && fa->styles[maps] != 255; maps++)
 		if (d_lightstylevalue[fa->styles[maps]] != fa->cached_light[maps])
-			goto dynamic;
+			return true;
+
+	return (fa->dlightframe >= r_framecount - 1 && fa->dlightframe <= r_framecount + 1) // dynamic this frame
+	       || fa->cached_dlight;                                                        // dynamic previously
+}
+
+/*
+================
+R_RebuildSurfaceLightmap
+================
+*/
+static void R_RebuildSurfaceLightmap (msurface_t *fa)
+{
+	struct lightmap_s *lm = &lightmaps[fa->lightmaptexturenum];
+	byte              *base;
+
+	base = lm->data;
+	base += fa->light_t * LMBLOCK_WIDTH * LIGHTMAP_BYTES + fa->light_s * LIGHTMAP_BYTES;
+	R_BuildLightMap (fa, base, LMBLOCK_WIDTH * LIGHTMAP_BYTES);
+	// flagged after the texels were written, so an upload that raced with
+	// the write is always followed by another one
+	Atomic_StoreUInt32 (&lm->modified, true);
+}
+
+/*
+================
+R_RenderDynamicLightmaps
+called during rendering
+================
+*/
+void R_RenderDynamicLightmaps (msurface_t *fa)
+{
+	if (R_LightmapNeedsUpdate (fa))
+		R_RebuildSurfaceLightmap (fa);
+}
+
+/*
+================
+R_QueueDynamicLightmap
+
+Like R_RenderDynamicLightmaps, but defers the rebuild of a world
+surface to R_BuildQueuedLightmaps. Safe to call from several tasks
+================
+*/
+void R_QueueDynamicLightmap (msurface_t *fa)
+{
+	uint32_t index;
+
+	if (!R_LightmapNeedsUpdate (fa))
+		return;
+
+	index = Atomic_IncrementUInt32 (&numdirtylightmapsurfs);
+	if (index < (uint32_t)maxdirtylightmapsurfs)
+		dirtylightmapsurfs[index] = fa;
+	else
+		R_RebuildSurfaceLightmap (fa);
+}
 
-	if ((fa->dlightframe >= r_framecount - 1 && fa->dlightframe <= r_framecount + 1) // dynamic this frame
-	    || fa->cached_dlight)           // dynamic previously
+/*
+================
+R_BuildQueuedLightmaps
+
+Rebuilds the index-th of Tasks_NumWorkers () slices of the queued
+surfaces and resets the queue once every slice is done
+================
+*/
+void R_BuildQueuedLightmaps (int index, void *unused)
+{
+	static atomic_uint32_t numslicesdone;
+	const int              numslices = Tasks_NumWorkers ();
+	const int              count = q_min ((int)Atomic_LoadUInt32 (&numdirtylightmapsurfs), maxdirtylightmapsurfs);
+	const int              first = (int)((int64_t)count * index / numslices);
+	const int              last = (int)((int64_t)count * (index + 1) / numslices);
+	int                    i;
+
+	for (i = first; i < last; i++)
+		R_RebuildSurfaceLightmap (dirtylightmapsurfs[i]);
+
+	if ((int)Atomic_IncrementUInt32 (&numslicesdone) == numslices - 1)
 	{
-	dynamic:
-		if (r_dynamic.value)
-		{
-			struct lightmap_s *lm = &lightmaps[fa->lightmaptexturenum];
-			Atomic_StoreUInt32(&lm->modified, true);
-			theRect = &lm->rectchange;
-			if (fa->light_t < theRect->t)
-			{
-				if (theRect->h)
-					theRect->h += theRect->t - fa->light_t;
-				theRect->t = fa->light_t;
-			}
-			if (fa->light_s < theRect->l)
-			{
-				if (theRect->w)
-					theRect->w += theRect->l - fa->light_s;
-				theRect->l = fa->light_s;
-			}
-			smax = (fa->extents[0] >> 4) + 1;
-			tmax = (fa->extents[1] >> 4) + 1;
-			if ((theRect->w + theRect->l) < (fa->light_s + smax))
-				theRect->w = (fa->light_s - theRect->l) + smax;
-			if ((theRect->h + theRect->t) < (fa->light_t + tmax))
-				theRect->h = (fa->light_t - theRect->t) + tmax;
-			base = lm->data;
-			base += fa->light_t * LMBLOCK_WIDTH * LIGHTMAP_BYTES + fa->light_s * LIGHTMAP_BYTES;
-			R_BuildLightMap (fa, base, LMBLOCK_WIDTH * LIGHTMAP_BYTES);
-		}
+		Atomic_StoreUInt32 (&numslicesdone, 0);
+		Atomic_StoreUInt32 (&numdirtylightmapsurfs, 0);
 	}
 }
 
@@ -655,6 +703,10 @@ void GL_BuildLightmaps (void)
 	memset (columns, -1, sizeof (columns));
 	memset (lightmap_idx, 0, sizeof (lightmap_idx));
 	memset (shelf_idx, 0, sizeof (shelf_idx));
+
+	maxdirtylightmapsurfs = cl.worldmodel->numsurfaces;
+	dirtylightmapsurfs = (msurface_t **)Mem_Realloc (dirtylightmapsurfs, maxdirtylightmapsurfs * sizeof (msurface_t *));
+	Atomic_StoreUInt32 (&numdirtylightmapsurfs, 0);
 	
 	for (j = 1; j < MAX_MODELS; j++)
 	{
@@ -683,10 +735,6 @@ void GL_BuildLightmaps (void)
 	{
 		lm = &lightmaps[i];
 		Atomic_StoreUInt32(&lm->modified, false);
-		lm->rectchange.l = LMBLOCK_WIDTH;
-		lm->rectchange.t = LMBLOCK_HEIGHT;
-		lm->rectchange.w = 0;
-		lm->rectchange.h = 0;
 
 		sprintf (name, "lightmap%07i", i);
 		lm->texture = TexMgr_LoadImage (
@@ -851,6 +899,69 @@ void GL_PrepareSIMDData (void)
 #endif // def USE_SIMD
 }
 
+#ifdef USE_SSE2
+/*
+===============
+R_AddDynamicLightRowSSE2
+
+Lights 4 texels of a blocklights row per iteration, with the same
+integer distance approximation and float scaling as the scalar loop
+in R_AddDynamicLights, so both produce identical results. Returns
+the number of texels done, the caller finishes the rest
+===============
+*/
+static int R_AddDynamicLightRowSSE2 (unsigned *bl, int smax, float local0, int td, float minlight, float rad, float cred, float cgreen, float cblue)
+{
+	const __m128i vtd = _mm_set1_epi32 (td);
+	const __m128  vminlight = _mm_set1_ps (minlight);
+	const __m128  vrad = _mm_set1_ps (rad);
+	// colors in the order they're laid out over 4 RGB texels
+	const __m128  vc0 = _mm_setr_ps (cred, cgreen, cblue, cred);
+	const __m128  vc1 = _mm_setr_ps (cgreen, cblue, cred, cgreen);
+	const __m128  vc2 = _mm_setr_ps (cblue, cred, cgreen, cblue);
+	const __m128  vlocal = _mm_set1_ps (local0);
+	const __m128  vstep = _mm_set1_ps (64);
+	__m128        vofs = _mm_setr_ps (0, 16, 32, 48); // exact, so local0 - s * 16 rounds like the scalar code
+	int           s;
+
+	for (s = 0; s + 4 <= smax; s += 4, bl += 12)
+	{
+		__m128i sd = _mm_cvttps_epi32 (_mm_sub_ps (vlocal, vofs));
+		__m128i sign = _mm_srai_epi32 (sd, 31);
+		__m128i gt, dist;
+		__m128  fdist, brightness;
+
+		vofs = _mm_add_ps (vofs, vstep);
+		sd = _mm_sub_epi32 (_mm_xor_si128 (sd, sign), sign);
+
+		// max (sd, td) + (min (sd, td) >> 1)
+		gt = _mm_cmpgt_epi32 (sd, vtd);
+		dist = _mm_add_epi32 (
+			_mm_or_si128 (_mm_and_si128 (gt, sd), _mm_andnot_si128 (gt, vtd)), _mm_srai_epi32 (_mm_or_si128 (_mm_and_si128 (gt, vtd), _mm_andnot_si128 (gt, sd)), 1));
+		fdist = _mm_cvtepi32_ps (dist);
+		if (_mm_movemask_ps (_mm_cmplt_ps (fdist, vminlight)) == 0)
+			continue;
+
+		// unlit texels get zero brightness, which adds nothing
+		brightness = _mm_and_ps (_mm_sub_ps (vrad, fdist), _mm_cmplt_ps (fdist, vminlight));
+		_mm_storeu_si128 (
+			(__m128i *)(bl + 0), _mm_add_epi32 (
+									 _mm_loadu_si128 ((const __m128i *)(bl + 0)),
+									 _mm_cvttps_epi32 (_mm_mul_ps (_mm_shuffle_ps (brightness, brightness, _MM_SHUFFLE (1, 0, 0, 0)), vc0))));
+		_mm_storeu_si128 (
+			(__m128i *)(bl + 4), _mm_add_epi32 (
+									 _mm_loadu_si128 ((const __m128i *)(bl + 4)),
+									 _mm_cvttps_epi32 (_mm_mul_ps (_mm_shuffle_ps (brightness, brightness, _MM_SHUFFLE (2, 2, 1, 1)), vc1))));
+		_mm_storeu_si128 (
+			(__m128i *)(bl + 8), _mm_add_epi32 (
+									 _mm_loadu_si128 ((const __m128i *)(bl + 8)),
+									 _mm_cvttps_epi32 (_mm_mul_ps (_mm_shuffle_ps (brightness, brightness, _MM_SHUFFLE (3, 3, 3, 2)), vc2))));
+	}
+
+	return s;
+}
+#endif // def USE_SSE2
+
 /*
 ===============
 R_AddDynamicLights
@@ -910,7 +1021,15 @@ void R_AddDynamicLights (msurface_t *surf)
 			td = local[1] - t * 16;
 			if (td < 0)
 				td = -td;
-			for (s = 0; s < smax; s++)
+			s = 0;
+#ifdef USE_SSE2
+			if (use_simd)
+			{
+				s = R_AddDynamicLightRowSSE2 (bl, smax, local[0], td, minlight, rad, cred, cgreen, cblue);
+				bl += s * 3;
+			}
+#endif // def USE_SSE2
+			for (; s < smax; s++)
 			{
 				sd = local[0] - s * 16;
 				if (sd < 0)
@@ -1058,6 +1177,13 @@ void R_BuildLightMap (msurface_t *surf, byte *dest, int stride)
 	size = smax * tmax;
 	lightmap = surf->samples;
 
+	if (size * 3 > blocklights_size)
+	{
+		// +1 for the SIMD store in R_StoreLightmap reading one component past the last texel
+		blocklights_size = size * 3;
+		blocklights = (unsigned *)Mem_Realloc (blocklights, (blocklights_size + 1) * sizeof (unsigned));
+	}
+
 	if (cl.worldmodel->lightdata)
 	{
 		// clear to no light
@@ -1100,10 +1226,10 @@ assumes lightmap texture is already bound
 static void R_UploadLightmap (int lmap)
 {
 	struct lightmap_s *lm = &lightmaps[lmap];
-	if (!Atomic_LoadUInt32(&lm->modified))
-		return;
 
-	Atomic_StoreUInt32(&lm->modified, false);
+	// claim the page, anything built after this point sets it again
+	if (!Atomic_ExchangeUInt32 (&lm->modified, false))
+		return;
 
 	if (lm->texture->rtmaterial == RG_NO_MATERIAL)
 	{
@@ -1111,9 +1237,7 @@ static void R_UploadLightmap (int lmap)
 		return;
 	}
 
-	// const int staging_size = LMBLOCK_WIDTH * lm->rectchange.h * 4;
-	// byte *data = lm->data + lm->rectchange.t * LMBLOCK_WIDTH * LIGHTMAP_BYTES;
-
+	// rgUpdateMaterialContents only takes whole textures, so a dirty page goes up in one piece
 	RgMaterialUpdateInfo info = 
 	{
 		.target = lm->texture->rtmaterial,
@@ -1126,11 +1250,6 @@ static void R_UploadLightmap (int lmap)
 	RgResult r = rgUpdateMaterialContents (vulkan_globals.instance, &info);
 	RG_CHECK (r);
 
-	lm->rectchange.l = LMBLOCK_WIDTH;
-	lm->rectchange.t = LMBLOCK_HEIGHT;
-	lm->rectchange.h = 0;
-	lm->rectchange.w = 0;
-
 	Atomic_IncrementUInt32 (&rs_dynamiclightmaps);
 }
 
@@ -1138,6 +1257,8 @@ static void R_UploadLightmap (int lmap)
 /*
 =============
 R_UpdateLightmaps
+
+Uploads whatever R_BuildQueuedLightmaps and the brush entities rebuilt
 =============
 */
 void R_UpdateLightmaps (void *unused)
@@ -1146,7 +1267,10 @@ void R_UpdateLightmaps (void *unused)
 	{
 		assert (false);
 		Con_Warning ("Updating lightmaps using GPU is not implemented");
+		return;
 	}
+
+	R_UploadLightmaps ();
 }
 
 void R_UploadLightmaps (void)
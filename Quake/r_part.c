@@ -36,7 +36,23 @@ int ramp1[8] = {0x6f, 0x6d, 0x6b, 0x69, 0x67, 0x65, 0x63, 0x61};
 int ramp2[8] = {0x6f, 0x6e, 0x6d, 0x6c, 0x6b, 0x6a, 0x68, 0x66};
 int ramp3[8] = {0x6d, 0x6b, 6, 5, 4, 3};
 
-particle_t *active_particles, *free_particles, *particles;
+#define NUM_PARTICLE_TYPES (pt_blob2 + 1)
+
+// particles are stored per type as structure-of-arrays, so that the simulation
+// runs without branching on the type and in SIMD width over each component
+typedef struct
+{
+	int    count;
+	int    capacity;
+	float *org[3];
+	float *vel[3];
+	float *ramp;
+	float *die;
+	byte  *color;
+} particlebucket_t;
+
+static particlebucket_t particlebuckets[NUM_PARTICLE_TYPES];
+static int              r_numactiveparticles;
 
 vec3_t r_pright, r_pup, r_ppn;
 
@@ -52,6 +68,8 @@ static uint32_t *quadindices = NULL;
 
 extern cvar_t r_showtris;
 
+static void R_ParticleBenchmark_f (void);
+
 /*
 ===============
 R_ParticleTextureLookup -- johnfitz -- generate nice antialiased 32x32 circle for particles
@@ -151,6 +169,82 @@ static const gltexture_t *GetParticleTexture (float *out_texturescalefactor)
 	}
 }
 
+/*
+===============
+R_GrowParticleBucket
+
+Buckets live in a single block each: 8 float arrays followed by the colors
+===============
+*/
+static qboolean R_GrowParticleBucket (particlebucket_t *b)
+{
+	int    i, capacity;
+	byte  *block;
+	float *arrays;
+
+	capacity = q_max (b->capacity * 2, 256);
+	capacity = q_min (capacity, (r_numparticles + 3) & ~3);
+	if (capacity <= b->capacity)
+		return false;
+
+	block = (byte *)Mem_Alloc (capacity * (8 * sizeof (float) + 1));
+	arrays = (float *)block;
+	if (b->count)
+	{
+		for (i = 0; i < 3; i++)
+		{
+			memcpy (arrays + i * capacity, b->org[i], b->count * sizeof (float));
+			memcpy (arrays + (3 + i) * capacity, b->vel[i], b->count * sizeof (float));
+		}
+		memcpy (arrays + 6 * capacity, b->ramp, b->count * sizeof (float));
+		memcpy (arrays + 7 * capacity, b->die, b->count * sizeof (float));
+		memcpy (arrays + 8 * capacity, b->color, b->count);
+	}
+
+	SAFE_FREE (b->org[0]);
+	for (i = 0; i < 3; i++)
+	{
+		b->org[i] = arrays + i * capacity;
+		b->vel[i] = arrays + (3 + i) * capacity;
+	}
+	b->ramp = arrays + 6 * capacity;
+	b->die = arrays + 7 * capacity;
+	b->color = (byte *)(arrays + 8 * capacity);
+	b->capacity = capacity;
+	return true;
+}
+
+/*
+===============
+R_NewParticle
+
+Returns false once r_numparticles particles are active
+===============
+*/
+static qboolean R_NewParticle (ptype_t type, const vec3_t org, const vec3_t vel, int color, float ramp, float die)
+{
+	particlebucket_t *b = &particlebuckets[type];
+	int               i;
+
+	if (r_numactiveparticles >= r_numparticles)
+		return false;
+	if (b->count == b->capacity && !R_GrowParticleBucket (b))
+		return false;
+
+	i = b->count++;
+	b->org[0][i] = org[0];
+	b->org[1][i] = org[1];
+	b->org[2][i] = org[2];
+	b->vel[0][i] = vel[0];
+	b->vel[1][i] = vel[1];
+	b->vel[2][i] = vel[2];
+	b->ramp[i] = ramp;
+	b->die[i] = die;
+	b->color[i] = color;
+	r_numactiveparticles++;
+	return true;
+}
+
 /*
 ===============
 R_InitParticleIndexBuffer
@@ -195,9 +289,8 @@ void R_InitParticles (void)
 		r_numparticles = MAX_PARTICLES;
 	}
 
-	particles = (particle_t *)Mem_Alloc (r_numparticles * sizeof (particle_t));
-
 	Cvar_RegisterVariable (&r_particles); // johnfitz
+	Cmd_AddCommand ("partbench", R_ParticleBenchmark_f);
 	// Cvar_RegisterVariable (&r_quadparticles); // johnfitz
 
 	R_InitParticleTextures (); // johnfitz
@@ -219,14 +312,13 @@ float        timescale = 0.01;
 
 void R_EntityParticles (entity_t *ent)
 {
-	int         i;
-	particle_t *p;
-	float       angle;
-	float       sp, sy, cp, cy;
+	int    i;
+	float  angle;
+	float  sp, sy, cp, cy;
 	//	float		sr, cr;
 	//	int		count;
-	vec3_t      forward;
-	float       dist;
+	vec3_t forward, org;
+	float  dist;
 
 	dist = 64;
 	//	count = 50;
@@ -257,20 +349,12 @@ void R_EntityParticles (entity_t *ent)
 		forward[1] = cp * sy;
 		forward[2] = -sp;
 
-		if (!free_particles)
+		org[0] = ent->origin[0] + r_avertexnormals[i][0] * dist + forward[0] * beamlength;
+		org[1] = ent->origin[1] + r_avertexnormals[i][1] * dist + forward[1] * beamlength;
+		org[2] = ent->origin[2] + r_avertexnormals[i][2] * dist + forward[2] * beamlength;
+
+		if (!R_NewParticle (pt_explode, org, vec3_origin, 0x6f, 0, cl.time + 0.01))
 			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
-		p->die = cl.time + 0.01;
-		p->color = 0x6f;
-		p->type = pt_explode;
-
-		p->org[0] = ent->origin[0] + r_avertexnormals[i][0] * dist + forward[0] * beamlength;
-		p->org[1] = ent->origin[1] + r_avertexnormals[i][1] * dist + forward[1] * beamlength;
-		p->org[2] = ent->origin[2] + r_avertexnormals[i][2] * dist + forward[2] * beamlength;
 	}
 }
 
@@ -283,12 +367,9 @@ void R_ClearParticles (void)
 {
 	int i;
 
-	free_particles = &particles[0];
-	active_particles = NULL;
-
-	for (i = 0; i < r_numparticles; i++)
-		particles[i].next = &particles[i + 1];
-	particles[r_numparticles - 1].next = NULL;
+	for (i = 0; i < NUM_PARTICLE_TYPES; i++)
+		particlebuckets[i].count = 0;
+	r_numactiveparticles = 0;
 }
 
 /*
@@ -298,12 +379,11 @@ R_ReadPointFile_f
 */
 void R_ReadPointFile_f (void)
 {
-	FILE       *f;
-	vec3_t      org;
-	int         r;
-	int         c;
-	particle_t *p;
-	char        name[MAX_QPATH];
+	FILE  *f;
+	vec3_t org;
+	int    r;
+	int    c;
+	char   name[MAX_QPATH];
 
 	if (cls.state != ca_connected)
 		return; // need an active map.
@@ -327,21 +407,11 @@ void R_ReadPointFile_f (void)
 			break;
 		c++;
 
-		if (!free_particles)
+		if (!R_NewParticle (pt_static, org, vec3_origin, (-c) & 15, 0, 99999))
 		{
 			Con_Printf ("Not enough free particles\n");
 			break;
 		}
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
-		p->die = 99999;
-		p->color = (-c) & 15;
-		p->type = pt_static;
-		VectorCopy (vec3_origin, p->vel);
-		VectorCopy (org, p->org);
 	}
 
 	fclose (f);
@@ -382,39 +452,21 @@ R_ParticleExplosion
 */
 void R_ParticleExplosion (vec3_t org)
 {
-	int         i, j;
-	particle_t *p;
+	int    i, j;
+	float  ramp;
+	vec3_t porg, pvel;
 
 	for (i = 0; i < 1024; i++)
 	{
-		if (!free_particles)
-			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
-		p->die = cl.time + 5;
-		p->color = ramp1[0];
-		p->ramp = rand () & 3;
-		if (i & 1)
-		{
-			p->type = pt_explode;
-			for (j = 0; j < 3; j++)
-			{
-				p->org[j] = org[j] + ((rand () % 32) - 16);
-				p->vel[j] = (rand () % 512) - 256;
-			}
-		}
-		else
+		ramp = rand () & 3;
+		for (j = 0; j < 3; j++)
 		{
-			p->type = pt_explode2;
-			for (j = 0; j < 3; j++)
-			{
-				p->org[j] = org[j] + ((rand () % 32) - 16);
-				p->vel[j] = (rand () % 512) - 256;
-			}
+			porg[j] = org[j] + ((rand () % 32) - 16);
+			pvel[j] = (rand () % 512) - 256;
 		}
+
+		if (!R_NewParticle ((i & 1) ? pt_explode : pt_explode2, porg, pvel, ramp1[0], ramp, cl.time + 5))
+			return;
 	}
 }
 
@@ -425,29 +477,21 @@ R_ParticleExplosion2
 */
 void R_ParticleExplosion2 (vec3_t org, int colorStart, int colorLength)
 {
-	int         i, j;
-	particle_t *p;
-	int         colorMod = 0;
+	int    i, j;
+	int    colorMod = 0;
+	vec3_t porg, pvel;
 
 	for (i = 0; i < 512; i++)
 	{
-		if (!free_particles)
-			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
-		p->die = cl.time + 0.3;
-		p->color = colorStart + (colorMod % colorLength);
-		colorMod++;
-
-		p->type = pt_blob;
 		for (j = 0; j < 3; j++)
 		{
-			p->org[j] = org[j] + ((rand () % 32) - 16);
-			p->vel[j] = (rand () % 512) - 256;
+			porg[j] = org[j] + ((rand () % 32) - 16);
+			pvel[j] = (rand () % 512) - 256;
 		}
+
+		if (!R_NewParticle (pt_blob, porg, pvel, colorStart + (colorMod % colorLength), 0, cl.time + 0.3))
+			return;
+		colorMod++;
 	}
 }
 
@@ -458,40 +502,26 @@ R_BlobExplosion
 */
 void R_BlobExplosion (vec3_t org)
 {
-	int         i, j;
-	particle_t *p;
+	int    i, j, color;
+	float  die;
+	vec3_t porg, pvel;
 
 	for (i = 0; i < 1024; i++)
 	{
-		if (!free_particles)
-			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
-		p->die = cl.time + 1 + (rand () & 8) * 0.05;
-
+		die = cl.time + 1 + (rand () & 8) * 0.05;
 		if (i & 1)
-		{
-			p->type = pt_blob;
-			p->color = 66 + rand () % 6;
-			for (j = 0; j < 3; j++)
-			{
-				p->org[j] = org[j] + ((rand () % 32) - 16);
-				p->vel[j] = (rand () % 512) - 256;
-			}
-		}
+			color = 66 + rand () % 6;
 		else
+			color = 150 + rand () % 6;
+
+		for (j = 0; j < 3; j++)
 		{
-			p->type = pt_blob2;
-			p->color = 150 + rand () % 6;
-			for (j = 0; j < 3; j++)
-			{
-				p->org[j] = org[j] + ((rand () % 32) - 16);
-				p->vel[j] = (rand () % 512) - 256;
-			}
+			porg[j] = org[j] + ((rand () % 32) - 16);
+			pvel[j] = (rand () % 512) - 256;
 		}
+
+		if (!R_NewParticle ((i & 1) ? pt_blob : pt_blob2, porg, pvel, color, 0, die))
+			return;
 	}
 }
 
@@ -502,53 +532,28 @@ R_RunParticleEffect
 */
 void R_RunParticleEffect (vec3_t org, vec3_t dir, int color, int count)
 {
-	int         i, j;
-	particle_t *p;
+	int    i, j;
+	vec3_t porg, pvel;
+
+	if (count == 1024)
+	{ // rocket explosion
+		R_ParticleExplosion (org);
+		return;
+	}
 
 	for (i = 0; i < count; i++)
 	{
-		if (!free_particles)
-			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
-		if (count == 1024)
-		{ // rocket explosion
-			p->die = cl.time + 5;
-			p->color = ramp1[0];
-			p->ramp = rand () & 3;
-			if (i & 1)
-			{
-				p->type = pt_explode;
-				for (j = 0; j < 3; j++)
-				{
-					p->org[j] = org[j] + ((rand () % 32) - 16);
-					p->vel[j] = (rand () % 512) - 256;
-				}
-			}
-			else
-			{
-				p->type = pt_explode2;
-				for (j = 0; j < 3; j++)
-				{
-					p->org[j] = org[j] + ((rand () % 32) - 16);
-					p->vel[j] = (rand () % 512) - 256;
-				}
-			}
-		}
-		else
+		float die = cl.time + 0.1 * (rand () % 5);
+		int   pcolor = (color & ~7) + (rand () & 7);
+
+		for (j = 0; j < 3; j++)
 		{
-			p->die = cl.time + 0.1 * (rand () % 5);
-			p->color = (color & ~7) + (rand () & 7);
-			p->type = pt_slowgrav;
-			for (j = 0; j < 3; j++)
-			{
-				p->org[j] = org[j] + ((rand () & 15) - 8);
-				p->vel[j] = dir[j] * 15; // + (rand()%300)-150;
-			}
+			porg[j] = org[j] + ((rand () & 15) - 8);
+			pvel[j] = dir[j] * 15; // + (rand()%300)-150;
 		}
+
+		if (!R_NewParticle (pt_slowgrav, porg, pvel, pcolor, 0, die))
+			return;
 	}
 }
 
@@ -559,37 +564,31 @@ R_LavaSplash
 */
 void R_LavaSplash (vec3_t org)
 {
-	int         i, j, k;
-	particle_t *p;
-	float       vel;
-	vec3_t      dir;
+	int    i, j, k, color;
+	float  vel, die;
+	vec3_t dir, porg, pvel;
 
 	for (i = -16; i < 16; i++)
 		for (j = -16; j < 16; j++)
 			for (k = 0; k < 1; k++)
 			{
-				if (!free_particles)
-					return;
-				p = free_particles;
-				free_particles = p->next;
-				p->next = active_particles;
-				active_particles = p;
-
-				p->die = cl.time + 2 + (rand () & 31) * 0.02;
-				p->color = 224 + (rand () & 7);
-				p->type = pt_slowgrav;
+				die = cl.time + 2 + (rand () & 31) * 0.02;
+				color = 224 + (rand () & 7);
 
 				dir[0] = j * 8 + (rand () & 7);
 				dir[1] = i * 8 + (rand () & 7);
 				dir[2] = 256;
 
-				p->org[0] = org[0] + dir[0];
-				p->org[1] = org[1] + dir[1];
-				p->org[2] = org[2] + (rand () & 63);
+				porg[0] = org[0] + dir[0];
+				porg[1] = org[1] + dir[1];
+				porg[2] = org[2] + (rand () & 63);
 
 				VectorNormalize (dir);
 				vel = 50 + (rand () & 63);
-				VectorScale (dir, vel, p->vel);
+				VectorScale (dir, vel, pvel);
+
+				if (!R_NewParticle (pt_slowgrav, porg, pvel, color, 0, die))
+					return;
 			}
 }
 
@@ -600,37 +599,31 @@ R_TeleportSplash
 */
 void R_TeleportSplash (vec3_t org)
 {
-	int         i, j, k;
-	particle_t *p;
-	float       vel;
-	vec3_t      dir;
+	int    i, j, k, color;
+	float  vel, die;
+	vec3_t dir, porg, pvel;
 
 	for (i = -16; i < 16; i += 4)
 		for (j = -16; j < 16; j += 4)
 			for (k = -24; k < 32; k += 4)
 			{
-				if (!free_particles)
-					return;
-				p = free_particles;
-				free_particles = p->next;
-				p->next = active_particles;
-				active_particles = p;
-
-				p->die = cl.time + 0.2 + (rand () & 7) * 0.02;
-				p->color = 7 + (rand () & 7);
-				p->type = pt_slowgrav;
+				die = cl.time + 0.2 + (rand () & 7) * 0.02;
+				color = 7 + (rand () & 7);
 
 				dir[0] = j * 8;
 				dir[1] = i * 8;
 				dir[2] = k * 8;
 
-				p->org[0] = org[0] + i + (rand () & 3);
-				p->org[1] = org[1] + j + (rand () & 3);
-				p->org[2] = org[2] + k + (rand () & 3);
+				porg[0] = org[0] + i + (rand () & 3);
+				porg[1] = org[1] + j + (rand () & 3);
+				porg[2] = org[2] + k + (rand () & 3);
 
 				VectorNormalize (dir);
 				vel = 50 + (rand () & 63);
-				VectorScale (dir, vel, p->vel);
+				VectorScale (dir, vel, pvel);
+
+				if (!R_NewParticle (pt_slowgrav, porg, pvel, color, 0, die))
+					return;
 			}
 }
 
@@ -643,12 +636,12 @@ FIXME -- rename function and use #defined types instead of numbers
 */
 void R_RocketTrail (vec3_t start, vec3_t end, int type)
 {
-	vec3_t      vec;
-	float       len;
-	int         j;
-	particle_t *p;
-	int         dec;
-	static int  tracercount;
+	vec3_t     vec, porg, pvel;
+	float      len, ramp, die;
+	int        j, color;
+	ptype_t    ptype;
+	int        dec;
+	static int tracercount;
 
 	VectorSubtract (end, start, vec);
 	len = VectorNormalize (vec);
@@ -664,187 +657,253 @@ void R_RocketTrail (vec3_t start, vec3_t end, int type)
 	{
 		len -= dec;
 
-		if (!free_particles)
-			return;
-		p = free_particles;
-		free_particles = p->next;
-		p->next = active_particles;
-		active_particles = p;
-
-		VectorCopy (vec3_origin, p->vel);
-		p->die = cl.time + 2;
+		VectorCopy (vec3_origin, pvel);
+		VectorCopy (start, porg);
+		die = cl.time + 2;
+		ramp = 0;
+		color = 0;
+		ptype = pt_static;
 
 		switch (type)
 		{
 		case 0: // rocket trail
-			p->ramp = (rand () & 3);
-			p->color = ramp3[(int)p->ramp];
-			p->type = pt_fire;
+			ramp = (rand () & 3);
+			color = ramp3[(int)ramp];
+			ptype = pt_fire;
 			for (j = 0; j < 3; j++)
-				p->org[j] = start[j] + ((rand () % 6) - 3);
+				porg[j] = start[j] + ((rand () % 6) - 3);
 			break;
 
 		case 1: // smoke smoke
-			p->ramp = (rand () & 3) + 2;
-			p->color = ramp3[(int)p->ramp];
-			p->type = pt_fire;
+			ramp = (rand () & 3) + 2;
+			color = ramp3[(int)ramp];
+			ptype = pt_fire;
 			for (j = 0; j < 3; j++)
-				p->org[j] = start[j] + ((rand () % 6) - 3);
+				porg[j] = start[j] + ((rand () % 6) - 3);
 			break;
 
 		case 2: // blood
-			p->type = pt_grav;
-			p->color = 67 + (rand () & 3);
+			ptype = pt_grav;
+			color = 67 + (rand () & 3);
 			for (j = 0; j < 3; j++)
-				p->org[j] = start[j] + ((rand () % 6) - 3);
+				porg[j] = start[j] + ((rand () % 6) - 3);
 			break;
 
 		case 3:
 		case 5: // tracer
-			p->die = cl.time + 0.5;
-			p->type = pt_static;
+			die = cl.time + 0.5;
+			ptype = pt_static;
 			if (type == 3)
-				p->color = 52 + ((tracercount & 4) << 1);
+				color = 52 + ((tracercount & 4) << 1);
 			else
-				p->color = 230 + ((tracercount & 4) << 1);
+				color = 230 + ((tracercount & 4) << 1);
 
 			tracercount++;
 
-			VectorCopy (start, p->org);
 			if (tracercount & 1)
 			{
-				p->vel[0] = 30 * vec[1];
-				p->vel[1] = 30 * -vec[0];
+				pvel[0] = 30 * vec[1];
+				pvel[1] = 30 * -vec[0];
 			}
 			else
 			{
-				p->vel[0] = 30 * -vec[1];
-				p->vel[1] = 30 * vec[0];
+				pvel[0] = 30 * -vec[1];
+				pvel[1] = 30 * vec[0];
 			}
 			break;
 
 		case 4: // slight blood
-			p->type = pt_grav;
-			p->color = 67 + (rand () & 3);
+			ptype = pt_grav;
+			color = 67 + (rand () & 3);
 			for (j = 0; j < 3; j++)
-				p->org[j] = start[j] + ((rand () % 6) - 3);
+				porg[j] = start[j] + ((rand () % 6) - 3);
 			len -= 3;
 			break;
 
 		case 6: // voor trail
-			p->color = 9 * 16 + 8 + (rand () & 3);
-			p->type = pt_static;
-			p->die = cl.time + 0.3;
+			color = 9 * 16 + 8 + (rand () & 3);
+			ptype = pt_static;
+			die = cl.time + 0.3;
 			for (j = 0; j < 3; j++)
-				p->org[j] = start[j] + ((rand () & 15) - 8);
+				porg[j] = start[j] + ((rand () & 15) - 8);
 			break;
 		}
 
+		if (!R_NewParticle (ptype, porg, pvel, color, ramp, die))
+			return;
+
 		VectorAdd (start, vec, start);
 	}
 }
 
 /*
 ===============
-CL_RunParticles -- johnfitz -- all the particle behavior, separated from R_DrawParticles
+R_ParticleMulAdd
+
+dst[i] += src[i] * scale; dst and src may alias
 ===============
 */
-void CL_RunParticles (void)
+static void R_ParticleMulAdd (float *dst, const float *src, float scale, int count)
 {
-	particle_t   *p, *kill;
-	int           i;
-	float         time1, time2, time3, dvel, frametime, grav;
+	int i = 0;
+
+#ifdef USE_SSE2
+	if (use_simd)
+	{
+		__m128 vscale = _mm_set1_ps (scale);
+		for (; i + 4 <= count; i += 4)
+			_mm_storeu_ps (dst + i, _mm_add_ps (_mm_loadu_ps (dst + i), _mm_mul_ps (_mm_loadu_ps (src + i), vscale)));
+	}
+#endif // def USE_SSE2
+
+	for (; i < count; i++)
+		dst[i] += src[i] * scale;
+}
+
+/*
+===============
+R_ParticleAdd
+
+dst[i] += value
+===============
+*/
+static void R_ParticleAdd (float *dst, float value, int count)
+{
+	int i = 0;
+
+#ifdef USE_SSE2
+	if (use_simd)
+	{
+		__m128 vvalue = _mm_set1_ps (value);
+		for (; i + 4 <= count; i += 4)
+			_mm_storeu_ps (dst + i, _mm_add_ps (_mm_loadu_ps (dst + i), vvalue));
+	}
+#endif // def USE_SSE2
+
+	for (; i < count; i++)
+		dst[i] += value;
+}
+
+/*
+===============
+R_ParticleRamp
+
+Advances the ramp of every particle in b, killing those that ran off its end
+and picking the ramp color for the others
+===============
+*/
+static void R_ParticleRamp (particlebucket_t *b, float step, const int *ramp, int ramplength)
+{
+	int i;
+
+	R_ParticleAdd (b->ramp, step, b->count);
+	for (i = 0; i < b->count; i++)
+	{
+		if (b->ramp[i] >= ramplength)
+			b->die[i] = -1;
+		else
+			b->color[i] = ramp[(int)b->ramp[i]];
+	}
+}
+
+/*
+===============
+R_KillParticles
+
+Swap-removes the particles that died before time
+===============
+*/
+static void R_KillParticles (particlebucket_t *b, double time)
+{
+	int i, j, last;
+
+	for (i = 0; i < b->count;)
+	{
+		if (b->die[i] >= time)
+		{
+			i++;
+			continue;
+		}
+
+		last = --b->count;
+		for (j = 0; j < 3; j++)
+		{
+			b->org[j][i] = b->org[j][last];
+			b->vel[j][i] = b->vel[j][last];
+		}
+		b->ramp[i] = b->ramp[last];
+		b->die[i] = b->die[last];
+		b->color[i] = b->color[last];
+		r_numactiveparticles--;
+	}
+}
+
+/*
+===============
+R_UpdateParticles
+===============
+*/
+static void R_UpdateParticles (float frametime, double time)
+{
+	int           i, type;
+	float         time1, time2, time3, dvel, grav;
 	extern cvar_t sv_gravity;
 
-	frametime = q_max (0.0, cl.time - cl.oldtime);
 	time3 = frametime * 15;
 	time2 = frametime * 10;
 	time1 = frametime * 5;
 	grav = frametime * sv_gravity.value * 0.05;
 	dvel = 4 * frametime;
 
-	for (;;)
+	for (type = 0; type < NUM_PARTICLE_TYPES; type++)
 	{
-		kill = active_particles;
-		if (kill && kill->die < cl.time)
-		{
-			active_particles = kill->next;
-			kill->next = free_particles;
-			free_particles = kill;
-			continue;
-		}
-		break;
-	}
+		particlebucket_t *b = &particlebuckets[type];
 
-	for (p = active_particles; p; p = p->next)
-	{
-		for (;;)
-		{
-			kill = p->next;
-			if (kill && kill->die < cl.time)
-			{
-				p->next = kill->next;
-				kill->next = free_particles;
-				free_particles = kill;
-				continue;
-			}
-			break;
-		}
+		R_KillParticles (b, time);
+		if (!b->count)
+			continue;
 
-		p->org[0] += p->vel[0] * frametime;
-		p->org[1] += p->vel[1] * frametime;
-		p->org[2] += p->vel[2] * frametime;
+		for (i = 0; i < 3; i++)
+			R_ParticleMulAdd (b->org[i], b->vel[i], frametime, b->count);
 
-		switch (p->type)
+		switch (type)
 		{
 		case pt_static:
 			break;
 		case pt_fire:
-			p->ramp += time1;
-			if (p->ramp >= 6)
-				p->die = -1;
-			else
-				p->color = ramp3[(int)p->ramp];
-			p->vel[2] += grav;
+			R_ParticleRamp (b, time1, ramp3, 6);
+			R_ParticleAdd (b->vel[2], grav, b->count);
 			break;
 
 		case pt_explode:
-			p->ramp += time2;
-			if (p->ramp >= 8)
-				p->die = -1;
-			else
-				p->color = ramp1[(int)p->ramp];
+			R_ParticleRamp (b, time2, ramp1, 8);
 			for (i = 0; i < 3; i++)
-				p->vel[i] += p->vel[i] * dvel;
-			p->vel[2] -= grav;
+				R_ParticleMulAdd (b->vel[i], b->vel[i], dvel, b->count);
+			R_ParticleAdd (b->vel[2], -grav, b->count);
 			break;
 
 		case pt_explode2:
-			p->ramp += time3;
-			if (p->ramp >= 8)
-				p->die = -1;
-			else
-				p->color = ramp2[(int)p->ramp];
+			R_ParticleRamp (b, time3, ramp2, 8);
 			for (i = 0; i < 3; i++)
-				p->vel[i] -= p->vel[i] * frametime;
-			p->vel[2] -= grav;
+				R_ParticleMulAdd (b->vel[i], b->vel[i], -frametime, b->count);
+			R_ParticleAdd (b->vel[2], -grav, b->count);
 			break;
 
 		case pt_blob:
 			for (i = 0; i < 3; i++)
-				p->vel[i] += p->vel[i] * dvel;
-			p->vel[2] -= grav;
+				R_ParticleMulAdd (b->vel[i], b->vel[i], dvel, b->count);
+			R_ParticleAdd (b->vel[2], -grav, b->count);
 			break;
 
 		case pt_blob2:
 			for (i = 0; i < 2; i++)
-				p->vel[i] -= p->vel[i] * dvel;
-			p->vel[2] -= grav;
+				R_ParticleMulAdd (b->vel[i], b->vel[i], -dvel, b->count);
+			R_ParticleAdd (b->vel[2], -grav, b->count);
 			break;
 
 		case pt_grav:
 		case pt_slowgrav:
-			p->vel[2] -= grav;
+			R_ParticleAdd (b->vel[2], -grav, b->count);
 			break;
 		}
 	}
@@ -852,24 +911,27 @@ void CL_RunParticles (void)
 
 /*
 ===============
-R_DrawParticlesFaces
+CL_RunParticles -- johnfitz -- all the particle behavior, separated from R_DrawParticles
 ===============
 */
-static void R_DrawParticlesFaces (cb_context_t *cbx)
+void CL_RunParticles (void)
 {
-	particle_t   *p;
-	float         scale, texcoord_scale;
-	vec3_t        up, right, up_right, p_up, p_right, p_up_right;
-	float         texturescalefactor;
-	extern cvar_t r_particles; // johnfitz
-
-	if (CVAR_TO_INT32(r_particles) == 0)
-		return;
+	R_UpdateParticles (q_max (0.0, cl.time - cl.oldtime), cl.time);
+}
 
-	if (!active_particles)
-		return;
+/*
+===============
+R_BuildParticleVertices
 
-	const gltexture_t *texture = GetParticleTexture (&texturescalefactor);
+Writes one billboard per active particle to vertices, straight from the
+particle buckets. Returns the number of vertices written.
+===============
+*/
+static int R_BuildParticleVertices (RgVertex *vertices, float texturescalefactor)
+{
+	float  scale, texcoord_scale;
+	vec3_t up, right, up_right;
+	int    type, i, current_vertex = 0;
 
 	if (QUAD_PARTICLES)
 	{
@@ -884,81 +946,98 @@ static void R_DrawParticlesFaces (cb_context_t *cbx)
 		texcoord_scale = 1.0f;
 	}
 
-	for (int i = 0; i < 3; ++i)
+	for (i = 0; i < 3; ++i)
 		up_right[i] = up[i] + right[i];
 
-	int num_particles = 0;
-	for (p = active_particles; p; p = p->next)
-		num_particles += 1;
-
+	for (type = 0; type < NUM_PARTICLE_TYPES; type++)
+	{
+		const particlebucket_t *b = &particlebuckets[type];
+		const float            *ox = b->org[0], *oy = b->org[1], *oz = b->org[2];
 
-	RgVertex *vertices;
-	if (QUAD_PARTICLES)
-		vertices = RT_AllocScratchMemoryNulled (num_particles * 4 * sizeof (RgVertex));
-	else
-		vertices = RT_AllocScratchMemoryNulled (num_particles * 3 * sizeof (RgVertex));
+		for (i = 0; i < b->count; i++)
+		{
+			// hack a scale up to keep particles from disapearing
+			scale = (ox[i] - r_origin[0]) * vpn[0] + (oy[i] - r_origin[1]) * vpn[1] + (oz[i] - r_origin[2]) * vpn[2];
+			if (scale < 20)
+				scale = 1 + 0.08; // johnfitz -- added .08 to be consistent
+			else
+				scale = 1 + scale * 0.004;
+
+			scale *= texturescalefactor; // johnfitz -- compensate for apparent size of different particle textures
+
+			const byte    *c = (byte *)&d_8to24table[b->color[i]];
+			const uint32_t packed = RT_PackColorToUint32 (c[0], c[1], c[2], 255);
+			RgVertex      *v = &vertices[current_vertex];
+
+			v->position[0] = ox[i];
+			v->position[1] = oy[i];
+			v->position[2] = oz[i];
+			v->texCoord[0] = 0.0f;
+			v->texCoord[1] = 0.0f;
+			v->packedColor = packed;
+			v++;
+
+			v->position[0] = ox[i] + scale * up[0];
+			v->position[1] = oy[i] + scale * up[1];
+			v->position[2] = oz[i] + scale * up[2];
+			v->texCoord[0] = texcoord_scale;
+			v->texCoord[1] = 0.0f;
+			v->packedColor = packed;
+			v++;
+
+			if (QUAD_PARTICLES)
+			{
+				v->position[0] = ox[i] + scale * up_right[0];
+				v->position[1] = oy[i] + scale * up_right[1];
+				v->position[2] = oz[i] + scale * up_right[2];
+				v->texCoord[0] = texcoord_scale;
+				v->texCoord[1] = texcoord_scale;
+				v->packedColor = packed;
+				v++;
+			}
 
+			v->position[0] = ox[i] + scale * right[0];
+			v->position[1] = oy[i] + scale * right[1];
+			v->position[2] = oz[i] + scale * right[2];
+			v->texCoord[0] = 0.0f;
+			v->texCoord[1] = texcoord_scale;
+			v->packedColor = packed;
 
-	int current_vertex = 0;
-	for (p = active_particles; p; p = p->next)
-	{
-		// hack a scale up to keep particles from disapearing
-		scale = (p->org[0] - r_origin[0]) * vpn[0] + (p->org[1] - r_origin[1]) * vpn[1] + (p->org[2] - r_origin[2]) * vpn[2];
-		if (scale < 20)
-			scale = 1 + 0.08; // johnfitz -- added .08 to be consistent
-		else
-			scale = 1 + scale * 0.004;
-
-		scale *= texturescalefactor; // johnfitz -- compensate for apparent size of different particle textures
-
-		byte *c = (byte *)&d_8to24table[(int)p->color];
-
-		vertices[current_vertex].position[0] = p->org[0];
-		vertices[current_vertex].position[1] = p->org[1];
-		vertices[current_vertex].position[2] = p->org[2];
-		vertices[current_vertex].texCoord[0] = 0.0f;
-		vertices[current_vertex].texCoord[1] = 0.0f;
-		vertices[current_vertex].packedColor = RT_PackColorToUint32 (c[0], c[1], c[2], 255);
-		current_vertex++;
-
-		VectorMA (p->org, scale, up, p_up);
-		vertices[current_vertex].position[0] = p_up[0];
-		vertices[current_vertex].position[1] = p_up[1];
-		vertices[current_vertex].position[2] = p_up[2];
-		vertices[current_vertex].texCoord[0] = texcoord_scale;
-		vertices[current_vertex].texCoord[1] = 0.0f;
-		vertices[current_vertex].packedColor = RT_PackColorToUint32 (c[0], c[1], c[2], 255);
-		current_vertex++;
-
-		if (QUAD_PARTICLES)
-		{
-			VectorMA (p->org, scale, up_right, p_up_right);
-			vertices[current_vertex].position[0] = p_up_right[0];
-			vertices[current_vertex].position[1] = p_up_right[1];
-			vertices[current_vertex].position[2] = p_up_right[2];
-			vertices[current_vertex].texCoord[0] = texcoord_scale;
-			vertices[current_vertex].texCoord[1] = texcoord_scale;
-			vertices[current_vertex].packedColor = RT_PackColorToUint32 (c[0], c[1], c[2], 255);
-			current_vertex++;
+			current_vertex += QUAD_PARTICLES ? 4 : 3;
 		}
+	}
 
-		VectorMA (p->org, scale, right, p_right);
-		vertices[current_vertex].position[0] = p_right[0];
-		vertices[current_vertex].position[1] = p_right[1];
-		vertices[current_vertex].position[2] = p_right[2];
-		vertices[current_vertex].texCoord[0] = 0.0f;
-		vertices[current_vertex].texCoord[1] = texcoord_scale;
-		vertices[current_vertex].packedColor = RT_PackColorToUint32 (c[0], c[1], c[2], 255);
-		current_vertex++;
+	return current_vertex;
+}
 
-		Atomic_IncrementUInt32 (&rs_particles);
-	}
+/*
+===============
+R_DrawParticlesFaces
+===============
+*/
+static void R_DrawParticlesFaces (cb_context_t *cbx)
+{
+	float         texturescalefactor;
+	extern cvar_t r_particles; // johnfitz
+
+	if (CVAR_TO_INT32(r_particles) == 0)
+		return;
+
+	if (!r_numactiveparticles)
+		return;
+
+	const gltexture_t *texture = GetParticleTexture (&texturescalefactor);
+
+	RgVertex *vertices = RT_AllocScratchMemoryNulled (r_numactiveparticles * (QUAD_PARTICLES ? 4 : 3) * sizeof (RgVertex));
+	int       current_vertex = R_BuildParticleVertices (vertices, texturescalefactor);
+
+	Atomic_AddUInt32 (&rs_particles, r_numactiveparticles);
 
 	RgRasterizedGeometryUploadInfo info = {
 		.renderType = RG_RASTERIZED_GEOMETRY_RENDER_TYPE_DEFAULT,
 		.vertexCount = current_vertex,
 		.pVertices = vertices,
-		.indexCount = QUAD_PARTICLES ? num_particles * 6 : 0,
+		.indexCount = QUAD_PARTICLES ? r_numactiveparticles * 6 : 0,
 		.pIndices = QUAD_PARTICLES ? quadindices : NULL,
 		.transform = RT_TRANSFORM_IDENTITY,
 		.color = RT_COLOR_WHITE,
@@ -993,3 +1072,65 @@ R_DrawParticles_ShowTris -- johnfitz
 void R_DrawParticles_ShowTris (cb_context_t *cbx)
 {
 }
+
+/*
+===============
+R_ParticleBenchmark_f
+
+partbench [count]: spawns count (default 100000) particles through
+R_ParticleExplosion, then times the simulation and billboard generation.
+Clears all particles when done.
+===============
+*/
+static void R_ParticleBenchmark_f (void)
+{
+	const int   steps = 32;
+	const float frametime = 1.0f / 72.0f;
+	int         count, saved_numparticles, spawned, i, numverts;
+	double      start, spawn_time, run_time, build_time, time;
+	vec3_t      org = {0, 0, 0};
+	RgVertex   *vertices;
+
+	count = (Cmd_Argc () > 1) ? atoi (Cmd_Argv (1)) : 100000;
+	count = q_max (count, 1024);
+
+	saved_numparticles = r_numparticles;
+	r_numparticles = q_max (r_numparticles, count);
+	R_ClearParticles ();
+
+	start = Sys_DoubleTime ();
+	while (r_numactiveparticles < count)
+	{
+		spawned = r_numactiveparticles;
+		R_ParticleExplosion (org);
+		if (r_numactiveparticles == spawned)
+			break;
+	}
+	spawn_time = Sys_DoubleTime () - start;
+	spawned = r_numactiveparticles;
+
+	vertices = (RgVertex *)Mem_Alloc (spawned * (QUAD_PARTICLES ? 4 : 3) * sizeof (RgVertex));
+
+	run_time = build_time = 0.0;
+	time = cl.time;
+	numverts = 0;
+	for (i = 0; i < steps; i++)
+	{
+		time += frametime;
+		start = Sys_DoubleTime ();
+		R_UpdateParticles (frametime, time);
+		run_time += Sys_DoubleTime () - start;
+
+		start = Sys_DoubleTime ();
+		numverts = R_BuildParticleVertices (vertices, 1.0f);
+		build_time += Sys_DoubleTime () - start;
+	}
+
+	Con_Printf ("%i particles spawned in %.2f ms\n", spawned, spawn_time * 1000.0);
+	Con_Printf ("simulate: %.3f ms/step, build: %.3f ms/step (%i verts), %i alive after %i steps\n", run_time * 1000.0 / steps,
+		build_time * 1000.0 / steps, numverts, r_numactiveparticles, steps);
+
+	Mem_Free (vertices);
+	R_ClearParticles ();
+	r_numparticles = saved_numparticles;
+}
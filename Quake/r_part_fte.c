@@ -216,6 +216,7 @@ typedef struct clippeddecal_s
 {
 	struct clippeddecal_s *next;
 	float                  die;
+	unsigned int           serial; // bumped each time the slot is handed out
 
 	int       entity; //>0 is a lerpentity, <0 is a csqc ent. 0 is world. woot.
 	qmodel_t *model;  // just for paranoia
@@ -472,6 +473,7 @@ static clippeddecal_t *free_decals;
 static clippeddecal_t *decals;
 static int             r_numdecals;
 static int             r_decalrecycle;
+static unsigned int    r_decalserial;
 
 static trailstate_t *trailstates;
 static int           ts_cycle; // current cyclic index of trailstates
@@ -485,6 +487,10 @@ static void   R_ParticleDesc_Callback (struct cvar_s *var);
 static cvar_t r_bouncysparks = {"r_bouncysparks", "1"};
 static cvar_t r_part_rain = {"r_part_rain", "1"};
 static cvar_t r_decal_noperpendicular = {"r_decal_noperpendicular", "1"};
+static cvar_t r_decal_merge = {"r_decal_merge", "0.25"}; // fraction of a decal's radius within which a new identical one is dropped
+#ifdef USE_DECALS
+static void PScript_ClearDecalCache (void);
+#endif
 cvar_t        r_particledesc = {"r_particledesc", "classic"};
 static cvar_t r_part_rain_quantity = {"r_part_rain_quantity", "1"};
 static cvar_t r_particle_tracelimit = {"r_particle_tracelimit", "16777216"};
@@ -522,14 +528,18 @@ static scenetris_t    *cl_stris;
 static unsigned int    cl_numstris;
 static unsigned int    cl_maxstris;
 static basicvertex_t  *cl_strisvert[2];
-static basicvertex_t  *cl_curstrisvert;
-static unsigned int    cl_numstrisvert;
 static unsigned int    cl_maxstrisvert[2];
 static unsigned short *cl_strisidx[2];
-static unsigned short *cl_curstrisidx;
-static unsigned int    cl_numstrisidx;
 static unsigned int    cl_maxstrisidx[2];
 
+// write cursors; particle types are simulated in parallel, each into its own region
+static THREAD_LOCAL basicvertex_t  *cl_curstrisvert;
+static THREAD_LOCAL unsigned int    cl_numstrisvert;
+static THREAD_LOCAL unsigned int    cl_endstrisvert;
+static THREAD_LOCAL unsigned short *cl_curstrisidx;
+static THREAD_LOCAL unsigned int    cl_numstrisidx;
+static THREAD_LOCAL unsigned int    cl_endstrisidx;
+
 /*
 Q1BSP_RecursiveHullTrace
 Optimised version of vanilla's SV_RecursiveHullCheck that avoids the excessive pointcontents calls by using the traceline itself to check for contents.
@@ -675,19 +685,15 @@ static qboolean Q1BSP_RecursiveHullCheck (hull_t *hull, int num, float p1f, floa
 	return Q1BSP_RecursiveHullTrace (&ctx, num, p1f, p2f, p1, p2, trace) != rht_impact;
 }
 
-float CL_TraceLine (vec3_t start, vec3_t end, vec3_t impact, vec3_t normal, int *entnum)
-{ // FIXME: not sure what to do about startsolid.
-	int       i;
-	trace_t   trace;
-	float     frac = 1;
-	entity_t *ent;
-	vec3_t    relstart, relend;
-	VectorCopy (end, impact);
-	VectorSet (normal, 0, 0, 1);
+static int num_trace_line_ents;
+static int trace_line_ents[MAX_EDICTS];
 
-	static int num_trace_line_ents;
-	static int trace_line_ents[MAX_EDICTS];
+static void CL_UpdateTraceLineCache (void)
+{
 	static int cache_valid_count = -1;
+	int        i;
+	entity_t  *ent;
+
 	if (cache_valid_count != r_trace_line_cache_counter)
 	{
 		num_trace_line_ents = 0;
@@ -700,6 +706,19 @@ float CL_TraceLine (vec3_t start, vec3_t end, vec3_t impact, vec3_t normal, int
 		}
 		cache_valid_count = r_trace_line_cache_counter;
 	}
+}
+
+float CL_TraceLine (vec3_t start, vec3_t end, vec3_t impact, vec3_t normal, int *entnum)
+{ // FIXME: not sure what to do about startsolid.
+	int       i;
+	trace_t   trace;
+	float     frac = 1;
+	entity_t *ent;
+	vec3_t    relstart, relend;
+	VectorCopy (end, impact);
+	VectorSet (normal, 0, 0, 1);
+
+	CL_UpdateTraceLineCache ();
 
 	if (entnum)
 		*entnum = 0;
@@ -3280,6 +3299,7 @@ void PScript_InitParticles (void)
 	Cvar_RegisterVariable (&r_bouncysparks);
 	Cvar_RegisterVariable (&r_part_rain);
 	Cvar_RegisterVariable (&r_decal_noperpendicular);
+	Cvar_RegisterVariable (&r_decal_merge);
 	Cvar_RegisterVariable (&r_particledesc);
 	Cvar_RegisterVariable (&r_part_rain_quantity);
 	Cvar_RegisterVariable (&r_particle_tracelimit);
@@ -3358,6 +3378,9 @@ void PScript_Shutdown (void)
 	beams = NULL;
 	Mem_Free (decals);
 	decals = NULL;
+#ifdef USE_DECALS
+	PScript_ClearDecalCache (); // the splats point into decals
+#endif
 	Mem_Free (trailstates);
 	trailstates = NULL;
 
@@ -3515,6 +3538,9 @@ void PScript_ClearParticles (void)
 	for (i = 0; i < r_numdecals; i++)
 		decals[i].next = &decals[i + 1];
 	decals[r_numdecals - 1].next = NULL;
+#ifdef USE_DECALS
+	PScript_ClearDecalCache ();
+#endif
 
 	free_beams = &beams[0];
 	for (i = 0; i < r_numbeams; i++)
@@ -3945,6 +3971,8 @@ typedef struct
 
 	float bias1;
 	float bias2;
+
+	clippeddecal_t *firstdecal; // first fragment this clip produced, NULL if none
 } decalctx_t;
 static void PScript_AddDecals (void *vctx, vec3_t *points, size_t numtris)
 {
@@ -3963,6 +3991,9 @@ static void PScript_AddDecals (void *vctx, vec3_t *points, size_t numtris)
 		free_decals = d->next;
 		d->next = ptype->clippeddecals;
 		ptype->clippeddecals = d;
+		d->serial = ++r_decalserial;
+		if (!ctx->firstdecal)
+			ctx->firstdecal = d;
 
 		for (i = 0; i < 3; i++)
 		{
@@ -4042,6 +4073,48 @@ static void                    Mod_ClipDecal (
 // clipped decals actually work by defining the area of the decal with some planes, and then chopping away the entirety of the world based upon those planes
 // (hurrah for bsp to trivially reject most of it) the decal is then textured according to some texture projection.
 #define MAXFRAGMENTVERTS (128 * 3)
+
+// what the clipper needs from each world surface, built once per map: the polygon as
+// plain vec3s and its bounds, so surfaces away from the decal are rejected unclipped
+typedef struct
+{
+	vec3_t mins, maxs;
+	int    firstvert; // -1 if the surface never takes decals
+	int    numverts;
+} decalsurf_t;
+
+typedef struct
+{
+	msurface_t  *surfaces; // the world and its submodels share one surface array
+	int          numsurfaces;
+	decalsurf_t *surfs;
+	vec3_t      *verts;
+} decalsurfcache_t;
+
+static decalsurfcache_t decalsurfcache;
+
+// coarse spatial hash of recent splats, to drop a new splat that lands on an identical
+// one that is still alive instead of stacking fragments on a single spot
+#define DECALSPLAT_CELL    64
+#define DECALSPLAT_BUCKETS 1024
+#define MAX_DECALSPLATS    4096
+typedef struct
+{
+	part_type_t    *ptype; // NULL if unused
+	int             entity;
+	int             next; // 1-based index of the next splat in the bucket
+	int             bucket;
+	float           radius;
+	clippeddecal_t *decal; // one of its fragments, live while its serial still matches
+	unsigned int    serial;
+	vec3_t          center;
+	vec3_t          normal;
+} decalsplat_t;
+
+static decalsplat_t decalsplats[MAX_DECALSPLATS];
+static int          decalsplathash[DECALSPLAT_BUCKETS]; // 1-based, 0 is empty
+static int          decalsplat_cycle;
+
 struct fragmentdecal_s
 {
 	vec3_t center;
@@ -4059,6 +4132,8 @@ struct fragmentdecal_s
 
 	void (*callback) (void *ctx, vec3_t *points, size_t numpoints);
 	void *ctx;
+
+	decalsurfcache_t *surfcache; // NULL when clipping to a model other than the world
 };
 static int Fragment_ClipPolyToPlane (vec3_t *inverts, vec3_t *outverts, int incount, float *plane, float planedist)
 {
@@ -4193,6 +4268,70 @@ static void Fragment_ClipPoly (fragmentdecal_t *dec, int numverts, vec3_t *inver
 	if (numtris)
 		dec->callback (dec->ctx, decalfragmentverts, numtris);
 }
+/*
+===============
+Mod_DecalSurfaceCache
+
+Returns the surface cache for mod if it's the world or one of its submodels
+===============
+*/
+static decalsurfcache_t *Mod_DecalSurfaceCache (qmodel_t *mod)
+{
+	decalsurfcache_t *cache = &decalsurfcache;
+	qmodel_t         *world = cl.worldmodel;
+	int               i, j, k, numverts;
+
+	if (!world || mod->surfaces != world->surfaces)
+		return NULL;
+	if (cache->surfaces == world->surfaces && cache->numsurfaces == world->numsurfaces)
+		return cache;
+
+	SAFE_FREE (cache->surfs);
+	SAFE_FREE (cache->verts);
+	cache->surfaces = world->surfaces;
+	cache->numsurfaces = world->numsurfaces;
+	cache->surfs = (decalsurf_t *)Mem_Alloc (world->numsurfaces * sizeof (decalsurf_t));
+
+	numverts = 0;
+	for (i = 0; i < world->numsurfaces; i++)
+	{
+		const msurface_t *surf = &world->surfaces[i];
+		if (surf->polys)
+			numverts += surf->polys->numverts;
+	}
+	cache->verts = (vec3_t *)Mem_Alloc (q_max (numverts, 1) * sizeof (vec3_t));
+
+	numverts = 0;
+	for (i = 0; i < world->numsurfaces; i++)
+	{
+		const msurface_t *surf = &world->surfaces[i];
+		decalsurf_t      *ds = &cache->surfs[i];
+		const glpoly_t   *poly = surf->polys;
+
+		// water and sky should not get decals, and only warped surfaces have several polys
+		ds->firstvert = -1;
+		if ((surf->flags & (SURF_DRAWSKY | SURF_DRAWTURB)) || !poly || poly->next || poly->numverts > MAXFRAGMENTVERTS)
+			continue;
+
+		ds->firstvert = numverts;
+		ds->numverts = poly->numverts;
+		VectorCopy (poly->verts[0], ds->mins);
+		VectorCopy (poly->verts[0], ds->maxs);
+		for (j = 0; j < poly->numverts; j++)
+		{
+			float *v = cache->verts[numverts++];
+			VectorCopy (poly->verts[j], v);
+			for (k = 0; k < 3; k++)
+			{
+				ds->mins[k] = q_min (ds->mins[k], v[k]);
+				ds->maxs[k] = q_max (ds->maxs[k], v[k]);
+			}
+		}
+	}
+
+	return cache;
+}
+
 // this could be inlined, but I'm lazy.
 static void Q1BSP_Fragment_Surface (fragmentdecal_t *dec, msurface_t *surf)
 {
@@ -4201,6 +4340,18 @@ static void Q1BSP_Fragment_Surface (fragmentdecal_t *dec, msurface_t *surf)
 	glpoly_t *poly;
 	float    *poly_vert;
 
+	if (dec->surfcache)
+	{
+		const decalsurf_t *ds = &dec->surfcache->surfs[surf - dec->surfcache->surfaces];
+		if (ds->firstvert < 0)
+			return;
+		for (i = 0; i < 3; i++)
+			if (dec->center[i] + dec->radius < ds->mins[i] || dec->center[i] - dec->radius > ds->maxs[i])
+				return;
+		Fragment_ClipPoly (dec, ds->numverts, dec->surfcache->verts + ds->firstvert);
+		return;
+	}
+
 	// water and sky should not get decals.
 	if (surf->flags & (SURF_DRAWSKY | SURF_DRAWTURB))
 		return;
@@ -4305,7 +4456,105 @@ static void Mod_ClipDecal (
 	dec.numplanes = 6;
 
 	if (mod && !mod->needload && mod->type == mod_brush)
+	{
+		dec.surfcache = Mod_DecalSurfaceCache (mod);
 		Q1BSP_ClipDecalToNodes (mod, &dec, mod->nodes + mod->hulls[0].firstclipnode);
+	}
+}
+
+/*
+===============
+PScript_DecalSplatBucket
+===============
+*/
+static int PScript_DecalSplatBucket (const vec3_t center)
+{
+	const unsigned int x = (unsigned int)(int)floor (center[0] / DECALSPLAT_CELL);
+	const unsigned int y = (unsigned int)(int)floor (center[1] / DECALSPLAT_CELL);
+	const unsigned int z = (unsigned int)(int)floor (center[2] / DECALSPLAT_CELL);
+
+	return ((x * 73856093u) ^ (y * 19349663u) ^ (z * 83492791u)) & (DECALSPLAT_BUCKETS - 1);
+}
+
+/*
+===============
+PScript_ClearDecalCache
+===============
+*/
+static void PScript_ClearDecalCache (void)
+{
+	SAFE_FREE (decalsurfcache.surfs);
+	SAFE_FREE (decalsurfcache.verts);
+	decalsurfcache.surfaces = NULL;
+	decalsurfcache.numsurfaces = 0;
+
+	memset (decalsplats, 0, sizeof (decalsplats));
+	memset (decalsplathash, 0, sizeof (decalsplathash));
+	decalsplat_cycle = 0;
+}
+
+/*
+===============
+PScript_ClipDecal
+
+Clips the decal described by ctx into the world, unless r_decal_merge finds
+a live splat of the same type close enough to it in the spatial hash
+===============
+*/
+static void PScript_ClipDecal (decalctx_t *ctx, float size)
+{
+	part_type_t  *ptype = ctx->ptype;
+	const float   radius = size * 0.5f;
+	const int     bucket = PScript_DecalSplatBucket (ctx->center);
+	decalsplat_t *splat;
+	int          *link;
+	vec3_t        delta;
+
+	if (r_decal_merge.value > 0)
+	{
+		const float mergedist = radius * r_decal_merge.value;
+		int         i;
+
+		for (i = decalsplathash[bucket]; i; i = splat->next)
+		{
+			splat = &decalsplats[i - 1];
+			if (splat->ptype != ptype || splat->entity != ctx->entity)
+				continue;
+			// the fragment may have expired or been reclaimed by r_decalrecycle
+			if (splat->decal->serial != splat->serial || splat->decal->die < particletime)
+				continue;
+			if (fabs (splat->radius - radius) > mergedist || DotProduct (splat->normal, ctx->normal) < 0.9f)
+				continue;
+			VectorSubtract (splat->center, ctx->center, delta);
+			if (DotProduct (delta, delta) < mergedist * mergedist)
+				return;
+		}
+	}
+
+	ctx->firstdecal = NULL;
+	Mod_ClipDecal (ctx->model, ctx->center, ctx->normal, ctx->tangent2, ctx->tangent1, size, ptype->surfflagmask, ptype->surfflagmatch, PScript_AddDecals, ctx);
+	if (!ctx->firstdecal)
+		return; // nothing landed, so nothing to merge into
+
+	// remember the splat, recycling the oldest slot
+	splat = &decalsplats[decalsplat_cycle];
+	if (splat->ptype)
+	{
+		for (link = &decalsplathash[splat->bucket]; *link != decalsplat_cycle + 1; link = &decalsplats[*link - 1].next)
+			;
+		*link = splat->next;
+	}
+	splat->ptype = ptype;
+	splat->entity = ctx->entity;
+	splat->radius = radius;
+	splat->decal = ctx->firstdecal;
+	splat->serial = ctx->firstdecal->serial;
+	VectorCopy (ctx->center, splat->center);
+	VectorCopy (ctx->normal, splat->normal);
+	splat->bucket = bucket;
+	splat->next = decalsplathash[bucket];
+	decalsplathash[bucket] = decalsplat_cycle + 1;
+	decalsplat_cycle = (decalsplat_cycle + 1) % MAX_DECALSPLATS;
 }
 #endif
 
@@ -4505,8 +4754,7 @@ int PScript_RunParticleEffectState (vec3_t org, vec3_t dir, float count, int typ
 				ctx.bias1 += ptype->texsstride * (rand () % ptype->randsmax);
 
 			// inserts decals through a callback.
-			Mod_ClipDecal (
-				ctx.model, ctx.center, ctx.normal, ctx.tangent2, ctx.tangent1, m, ptype->surfflagmask, ptype->surfflagmatch, PScript_AddDecals, &ctx);
+			PScript_ClipDecal (&ctx, m);
 #endif
 			if (ptype->assoc < 0)
 				break;
@@ -5587,9 +5835,7 @@ static void ReallocateVertexBuffer ()
     const size_t new_size = new_count * sizeof (basicvertex_t);
 	Sys_Printf ("Reallocating FTE particle vertex buffer (%u KB)\n", (int)(new_size / 1024));
 
-	cl_curstrisvert = Mem_Realloc (cl_curstrisvert, new_size);
-
-	cl_strisvert[current_buffer_index] = cl_curstrisvert;
+	cl_strisvert[current_buffer_index] = Mem_Realloc (cl_strisvert[current_buffer_index], new_size);
 	cl_maxstrisvert[current_buffer_index] = new_count;
 }
 
@@ -5599,9 +5845,7 @@ static void ReallocateIndexBuffer ()
 	const size_t new_size = new_count * sizeof (unsigned short);
 	Sys_Printf ("Reallocating FTE particle index buffer (%u KB)\n", (int)(new_size / 1024));
 
-	cl_curstrisidx = Mem_Realloc (cl_curstrisidx, new_size);
-
-	cl_strisidx[current_buffer_index] = cl_curstrisidx;
+	cl_strisidx[current_buffer_index] = Mem_Realloc (cl_strisidx[current_buffer_index], new_size);
 	cl_maxstrisidx[current_buffer_index] = new_count;
 }
 
@@ -5612,8 +5856,8 @@ static void R_AddFanSparkParticle (scenetris_t *t, particle_t *p, plooks_t *type
 	vec3_t v, cr, o2;
 	float  scale;
 
-	if (cl_numstrisvert + 3 > cl_maxstrisvert[current_buffer_index])
-		ReallocateVertexBuffer ();
+	if (cl_numstrisvert + 3 > cl_endstrisvert)
+		return;
 
 	scale = (p->org[0] - r_origin[0]) * vpn[0] + (p->org[1] - r_origin[1]) * vpn[1] + (p->org[2] - r_origin[2]) * vpn[2];
 	scale = (scale * p->scale) * (type->invscalefactor) + p->scale * (type->scalefactor * 250);
@@ -5657,8 +5901,8 @@ static void R_AddFanSparkParticle (scenetris_t *t, particle_t *p, plooks_t *type
 	VectorMA (o2, -p->scale, cr, cl_curstrisvert[cl_numstrisvert + 1].position);
 	VectorMA (o2, p->scale, cr, cl_curstrisvert[cl_numstrisvert + 2].position);
 
-	if (cl_numstrisidx + 3 > cl_maxstrisidx[current_buffer_index])
-		ReallocateIndexBuffer ();
+	if (cl_numstrisidx + 3 > cl_endstrisidx)
+		return;
 
 	cl_curstrisidx[cl_numstrisidx++] = (cl_numstrisvert - t->firstvert) + 0;
 	cl_curstrisidx[cl_numstrisidx++] = (cl_numstrisvert - t->firstvert) + 1;
@@ -5672,8 +5916,8 @@ static void R_AddFanSparkParticle (scenetris_t *t, particle_t *p, plooks_t *type
 
 static void R_AddLineSparkParticle (scenetris_t *t, particle_t *p, plooks_t *type)
 {
-	if (cl_numstrisvert + 2 > cl_maxstrisvert[current_buffer_index])
-		ReallocateVertexBuffer ();
+	if (cl_numstrisvert + 2 > cl_endstrisvert)
+		return;
 
 	if (type->premul)
 	{
@@ -5698,8 +5942,8 @@ static void R_AddLineSparkParticle (scenetris_t *t, particle_t *p, plooks_t *typ
 	VectorCopy (p->org, cl_curstrisvert[cl_numstrisvert + 0].position);
 	VectorMA (p->org, -1.0 / 10, p->vel, cl_curstrisvert[cl_numstrisvert + 1].position);
 
-	if (cl_numstrisidx + 2 > cl_maxstrisidx[current_buffer_index])
-		ReallocateIndexBuffer ();
+	if (cl_numstrisidx + 2 > cl_endstrisidx)
+		return;
 
 	cl_curstrisidx[cl_numstrisidx++] = (cl_numstrisvert - t->firstvert) + 0;
 	cl_curstrisidx[cl_numstrisidx++] = (cl_numstrisvert - t->firstvert) + 1;
@@ -5714,8 +5958,8 @@ static void R_AddTSparkParticle (scenetris_t *t, particle_t *p, plooks_t *type)
 {
 	vec3_t v, cr, o2;
 
-	if (cl_numstrisvert + 4 > cl_maxstrisvert[current_buffer_index])
-		ReallocateVertexBuffer ();
+	if (cl_numstrisvert + 4 > cl_endstrisvert)
+		return;
 
 	if (type->premul)
 	{
@@ -5777,8 +6021,8 @@ static void R_AddTSparkParticle (scenetris_t *t, particle_t *p, plooks_t *type)
 	VectorMA (o2, p->scale * 0.5, cr, cl_curstrisvert[cl_numstrisvert + 2].position);
 	VectorMA (o2, -p->scale * 0.5, cr, cl_curstrisvert[cl_numstrisvert + 3].position);
 
-	if (cl_numstrisidx + 6 > cl_maxstrisidx[current_buffer_index])
-		ReallocateIndexBuffer ();
+	if (cl_numstrisidx + 6 > cl_endstrisidx)
+		return;
 
 	cl_curstrisidx[cl_numstrisidx++] = (cl_numstrisvert - t->firstvert) + 0;
 	cl_curstrisidx[cl_numstrisidx++] = (cl_numstrisvert - t->firstvert) + 1;
@@ -5809,8 +6053,8 @@ static void R_DrawParticleBeam (scenetris_t *t, beamseg_t *b, plooks_t *type)
 		return;
 	p = b->p;
 
-	if (cl_numstrisvert + 4 > cl_maxstrisvert[current_buffer_index])
-		ReallocateVertexBuffer ();
+	if (cl_numstrisvert + 4 > cl_endstrisvert)
+		return;
 
 	VectorSubtract (r_refdef.vieworg, q->org, v);
 	VectorNormalize (v);
@@ -5838,8 +6082,8 @@ static void R_DrawParticleBeam (scenetris_t *t, beamseg_t *b, plooks_t *type)
 
 	t->numvert += 4;
 
-	if (cl_numstrisidx + 6 > cl_maxstrisidx[current_buffer_index])
-		ReallocateIndexBuffer ();
+	if (cl_numstrisidx + 6 > cl_endstrisidx)
+		return;
 
 	cl_curstrisidx[cl_numstrisidx++] = (cl_numstrisvert - t->firstvert) + 0;
 	cl_curstrisidx[cl_numstrisidx++] = (cl_numstrisvert - t->firstvert) + 1;
@@ -5848,13 +6092,13 @@ static void R_DrawParticleBeam (scenetris_t *t, beamseg_t *b, plooks_t *type)
 	cl_curstrisidx[cl_numstrisidx++] = (cl_numstrisvert - t->firstvert) + 2;
 	cl_curstrisidx[cl_numstrisidx++] = (cl_numstrisvert - t->firstvert) + 3;
 	cl_numstrisvert += 4;
-	t->numidx += 4;
+	t->numidx += 6;
 }
 
 static void R_AddClippedDecal (scenetris_t *t, clippeddecal_t *d, plooks_t *type)
 {
-	if (cl_numstrisvert + 4 > cl_maxstrisvert[current_buffer_index])
-		ReallocateVertexBuffer ();
+	if (cl_numstrisvert + 4 > cl_endstrisvert)
+		return;
 
 	if (d->entity > 0)
 	{
@@ -5911,8 +6155,8 @@ static void R_AddClippedDecal (scenetris_t *t, clippeddecal_t *d, plooks_t *type
 	Vector2Copy (d->texcoords[1], cl_curstrisvert[cl_numstrisvert + 1].texcoord);
 	Vector2Copy (d->texcoords[2], cl_curstrisvert[cl_numstrisvert + 2].texcoord);
 
-	if (cl_numstrisidx + 3 > cl_maxstrisidx[current_buffer_index])
-		ReallocateIndexBuffer ();
+	if (cl_numstrisidx + 3 > cl_endstrisidx)
+		return;
 
 	cl_curstrisidx[cl_numstrisidx++] = (cl_numstrisvert - t->firstvert) + 0;
 	cl_curstrisidx[cl_numstrisidx++] = (cl_numstrisvert - t->firstvert) + 1;
@@ -5929,8 +6173,8 @@ static void R_AddUnclippedDecal (scenetris_t *t, particle_t *p, plooks_t *type)
 	float  x, y;
 	vec3_t sdir, tdir;
 
-	if (cl_numstrisvert + 4 > cl_maxstrisvert[current_buffer_index])
-		ReallocateVertexBuffer ();
+	if (cl_numstrisvert + 4 > cl_endstrisvert)
+		return;
 
 	if (type->premul)
 	{
@@ -5992,8 +6236,8 @@ static void R_AddUnclippedDecal (scenetris_t *t, particle_t *p, plooks_t *type)
 		VectorMA (p->org, p->scale, sdir, cl_curstrisvert[cl_numstrisvert + 3].position);
 	}
 
-	if (cl_numstrisidx + 6 > cl_maxstrisidx[current_buffer_index])
-		ReallocateIndexBuffer ();
+	if (cl_numstrisidx + 6 > cl_endstrisidx)
+		return;
 
 	cl_curstrisidx[cl_numstrisidx++] = (cl_numstrisvert - t->firstvert) + 0;
 	cl_curstrisidx[cl_numstrisidx++] = (cl_numstrisvert - t->firstvert) + 1;
@@ -6012,8 +6256,8 @@ static void R_AddTexturedParticle (scenetris_t *t, particle_t *p, plooks_t *type
 {
 	float scale, x, y;
 
-	if (cl_numstrisvert + 4 > cl_maxstrisvert[current_buffer_index])
-		ReallocateVertexBuffer ();
+	if (cl_numstrisvert + 4 > cl_endstrisvert)
+		return;
 
 	if (type->scalefactor == 1)
 		scale = p->scale * 0.25;
@@ -6081,8 +6325,8 @@ static void R_AddTexturedParticle (scenetris_t *t, particle_t *p, plooks_t *type
 		VectorMA (p->org, scale, pright, cl_curstrisvert[cl_numstrisvert + 3].position);
 	}
 
-	if (cl_numstrisidx + 6 > cl_maxstrisidx[current_buffer_index])
-		ReallocateIndexBuffer ();
+	if (cl_numstrisidx + 6 > cl_endstrisidx)
+		return;
 
 	cl_curstrisidx[cl_numstrisidx++] = (cl_numstrisvert - t->firstvert) + 0;
 	cl_curstrisidx[cl_numstrisidx++] = (cl_numstrisvert - t->firstvert) + 1;
@@ -6097,14 +6341,228 @@ static void R_AddTexturedParticle (scenetris_t *t, particle_t *p, plooks_t *type
 	t->numidx += 6;
 }
 
-static void PScript_DrawParticleTypes (cb_context_t *cbx, float pframetime)
+// work that a particle type job can't do itself because it touches other types or shared
+// lists; recorded by the job and replayed in run list order by PScript_FinishParticleTypes
+typedef enum
+{
+	PEV_EFFECT, // PScript_RunParticleEffectState (org, dir, count, ptype)
+	PEV_TRAIL,  // PScript_ParticleTrail (org, dir, ptype) with the trailstate of p
+	PEV_DECAL,  // PScript_SplatterDecal
+} pevent_type_t;
+
+typedef struct
+{
+	pevent_type_t type;
+	int           ptype;
+	int           entity;
+	float         count;
+	vec3_t        org;
+	vec3_t        dir;
+	particle_t   *p;
+} pevent_t;
+
+typedef struct
+{
+	part_type_t *type;
+
+	// output region in the current vertex and index buffers
+	unsigned int firstvert, endvert, numvert;
+	unsigned int firstidx, endidx, numidx;
+	scenetris_t *stris;
+	unsigned int numstris, maxstris;
+
+	// this job's share of r_particle_tracelimit, fixed before the jobs run
+	unsigned int numtraces, maxtraces;
+
+	// xorshift32 state, seeded from the type and frame since rand () is shared by all jobs
+	uint32_t rng;
+
+	// freed once every job has finished, in run list order
+	particle_t     *kill_list, *kill_first;
+	clippeddecal_t *dkill_list, *dkill_first;
+	beamseg_t      *bkill_list, *bkill_first;
+
+	pevent_t *events;
+	int       numevents, maxevents;
+} ptypejob_t;
+
+static ptypejob_t     *ptypejobs;
+static int             numptypejobs, maxptypejobs;
+static atomic_uint32_t nextptypejob;
+static float           ptypeframetime;
+static qboolean        ptypedoflurry;
+static qboolean        ptypeprepared;
+static uint32_t        ptypeframe;
+
+/*
+===============
+PScript_JobRandom
+
+Returns a number in [0, 1) from the job's own generator
+===============
+*/
+static float PScript_JobRandom (ptypejob_t *job)
+{
+	uint32_t x = job->rng;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	job->rng = x;
+	return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+/*
+===============
+PScript_AddTypeEvent
+===============
+*/
+static pevent_t *PScript_AddTypeEvent (ptypejob_t *job, pevent_type_t type, int ptype, const vec3_t org, const vec3_t dir)
+{
+	pevent_t *ev;
+
+	if (job->numevents == job->maxevents)
+	{
+		job->maxevents = q_max (job->maxevents * 2, 64);
+		job->events = Mem_Realloc (job->events, sizeof (*job->events) * job->maxevents);
+	}
+	ev = &job->events[job->numevents++];
+	ev->type = type;
+	ev->ptype = ptype;
+	ev->entity = 0;
+	ev->count = 1;
+	ev->p = NULL;
+	VectorCopy (org, ev->org);
+	VectorCopy (dir, ev->dir);
+	return ev;
+}
+
+/*
+===============
+PScript_NewTypeSceneTri
+
+Continues the job's last batch if it has the same looks and still has
+room for 16 bit indices, otherwise starts a new one
+===============
+*/
+static scenetris_t *PScript_NewTypeSceneTri (ptypejob_t *job, gltexture_t *texture, blendmode_t blendmode, int beflags)
+{
+	scenetris_t *scenetri;
+
+	if (job->numstris)
+	{
+		scenetri = &job->stris[job->numstris - 1];
+		if (scenetri->texture == texture && scenetri->blendmode == blendmode && scenetri->beflags == beflags &&
+		    cl_numstrisvert - scenetri->firstvert < MAX_INDICES - 6)
+			return scenetri;
+	}
+
+	if (job->numstris == job->maxstris)
+	{
+		job->maxstris += 8;
+		job->stris = Mem_Realloc (job->stris, sizeof (*job->stris) * job->maxstris);
+	}
+	scenetri = &job->stris[job->numstris++];
+	scenetri->texture = texture;
+	scenetri->blendmode = blendmode;
+	scenetri->beflags = beflags;
+	scenetri->firstidx = cl_numstrisidx;
+	scenetri->firstvert = cl_numstrisvert;
+	scenetri->numvert = 0;
+	scenetri->numidx = 0;
+	return scenetri;
+}
+
+/*
+===============
+PScript_CheckSceneTriOverflow
+===============
+*/
+static inline scenetris_t *PScript_CheckSceneTriOverflow (ptypejob_t *job, scenetris_t *scenetri)
+{
+	// generate a new mesh if the old one overflowed. yay smc...
+	if (cl_numstrisvert - scenetri->firstvert >= MAX_INDICES - 6)
+		return PScript_NewTypeSceneTri (job, scenetri->texture, scenetri->blendmode, scenetri->beflags);
+	return scenetri;
+}
+
+#ifdef USE_DECALS
+/*
+===============
+PScript_SplatterDecal
+
+A particle of a clipbounce -2 type hit a wall and leaves a decal there
+===============
+*/
+static void PScript_SplatterDecal (part_type_t *type, vec3_t org, vec3_t normal, int e, float scale)
+{
+	decalctx_t ctx;
+	float      m;
+	vec3_t     vec = {0.5, 0.5, 0.431};
+	qmodel_t  *model;
+
+	ctx.entity = e;
+	if (!ctx.entity)
+	{
+		model = cl.worldmodel;
+		VectorCopy (org, ctx.center);
+	}
+	else
+	{ // this trace hit a door or something.
+		entity_t *ent = CL_EntityNum (e);
+		model = ent->model;
+		VectorSubtract (org, ent->origin, ctx.center);
+		// FIXME: rotate center+normal around entity.
+	}
+
+	if (!model)
+		return;
+	ctx.model = model;
+
+	VectorScale (normal, -1, ctx.normal);
+	VectorNormalize (ctx.normal);
+
+	VectorNormalize (vec);
+	CrossProduct (ctx.normal, vec, ctx.tangent1);
+	RotatePointAroundVector (ctx.tangent2, ctx.normal, ctx.tangent1, frandom () * 360);
+	CrossProduct (ctx.normal, ctx.tangent2, ctx.tangent1);
+
+	VectorNormalize (ctx.tangent1);
+	VectorNormalize (ctx.tangent2);
+
+	ctx.ptype = type;
+	ctx.scale1 = type->s2 - type->s1;
+	ctx.bias1 = type->s1 + (ctx.scale1 * 0.5);
+	ctx.scale2 = type->t2 - type->t1;
+	ctx.bias2 = type->t1 + (ctx.scale2 * 0.5);
+	m = scale * (1.5 + frandom () * 0.5) * 0.5; // decals should be a little bigger, for some reason.
+	ctx.scale0 = 2.0 / m;
+	ctx.scale1 /= m;
+	ctx.scale2 /= m;
+
+	// inserts decals through a callback.
+	PScript_ClipDecal (&ctx, m);
+}
+#endif
+
+/*
+===============
+PScript_RunParticleType
+
+Simulates one particle type and writes its geometry into the region reserved
+for the job. Runs in parallel with the other types, so anything that spawns
+particles or frees into the shared lists is deferred to the job's events
+and kill lists.
+===============
+*/
+static void PScript_RunParticleType (ptypejob_t *job)
 {
 	void (*bdraw) (scenetris_t * t, beamseg_t * p, plooks_t * type);
 	void (*tdraw) (scenetris_t * t, particle_t * p, plooks_t * type);
 
+	part_type_t    *type = job->type;
+	const float     pframetime = ptypeframetime;
 	vec3_t          oldorg;
 	vec3_t          stop, normal;
-	part_type_t    *type, *lastvalidtype;
 	particle_t     *p, *kill;
 	clippeddecal_t *d, *dkill;
 	ramp_t         *ramp;
@@ -6112,689 +6570,714 @@ static void PScript_DrawParticleTypes (cb_context_t *cbx, float pframetime)
 	vec3_t          friction;
 	scenetris_t    *scenetri;
 	float           dist;
-	particle_t     *kill_list, *kill_first; // the kill list is to stop particles from being freed and reused whilst still in this loop
-	                                        // which is bad because beams need to find out when particles died. Reuse can do wierd things.
-	                                        // remember that they're not drawn instantly either.
 	beamseg_t      *b, *bkill;
+	int             rampind;
+	int             batchflags;
 
-	int          traces = r_particle_tracelimit.value;
-	int          rampind;
-	static float flurrytime;
-	qboolean     doflurry;
-	int          batchflags;
-	unsigned int i, o;
+	cl_curstrisvert = cl_strisvert[current_buffer_index];
+	cl_curstrisidx = cl_strisidx[current_buffer_index];
+	cl_numstrisvert = job->firstvert;
+	cl_numstrisidx = job->firstidx;
+	cl_endstrisvert = job->endvert;
+	cl_endstrisidx = job->endidx;
 
-	if (r_plooksdirty)
+	if (type->clippeddecals)
 	{
-		int j, k;
-
-		pe_default = PScript_FindParticleType ("PE_DEFAULT");
-		pe_size2 = PScript_FindParticleType ("PE_SIZE2");
-		pe_size3 = PScript_FindParticleType ("PE_SIZE3");
-		pe_defaulttrail = PScript_FindParticleType ("PE_DEFAULTTRAIL");
+		scenetri = PScript_NewTypeSceneTri (job, type->looks.texture, type->looks.blendmode, 0);
 
-		for (j = 0; j < numparticletypes; j++)
+		for (;;)
 		{
-			// set the fallback
-			part_type[j].slooks = &part_type[j].looks;
-			for (k = j - 1; k-- > 0;)
+			dkill = type->clippeddecals;
+			if (dkill && dkill->die < particletime)
 			{
-				if (!memcmp (&part_type[j].looks, &part_type[k].looks, sizeof (plooks_t)))
+				type->clippeddecals = dkill->next;
+				dkill->next = job->dkill_list;
+				job->dkill_list = dkill;
+				if (!job->dkill_first)
+					job->dkill_first = dkill;
+				continue;
+			}
+			break;
+		}
+		for (d = type->clippeddecals; d; d = d->next)
+		{
+			for (;;)
+			{
+				dkill = d->next;
+				if (dkill && dkill->die < particletime)
 				{
-					part_type[j].slooks = part_type[k].slooks;
-					break;
+					d->next = dkill->next;
+					dkill->next = job->dkill_list;
+					job->dkill_list = dkill;
+					if (!job->dkill_first)
+						job->dkill_first = dkill;
+					continue;
 				}
+				break;
 			}
-		}
-		r_plooksdirty = false;
-		CL_RegisterParticles ();
-		PScript_RecalculateSkyTris ();
-	}
 
-	VectorScale (vup, 1.5, pup);
-	VectorScale (vright, 1.5, pright);
+			if (d->die - particletime <= type->die)
+			{
+				switch (type->rampmode)
+				{
+				case RAMP_NEAREST:
+					rampind = (int)(type->rampindexes * (type->die - (d->die - particletime)) / type->die);
+					if (rampind >= type->rampindexes)
+						rampind = type->rampindexes - 1;
+					ramp = type->ramp + rampind;
+					VectorCopy (ramp->rgb, d->rgba);
+					d->rgba[3] = ramp->alpha;
+					break;
+				case RAMP_LERP:
+				{
+					float frac = (type->rampindexes * (type->die - (d->die - particletime)) / type->die);
+					int   s1, s2;
+					s1 = frac;
+					s2 = s1 + 1;
+					if (s1 > type->rampindexes - 1)
+						s1 = type->rampindexes - 1;
+					if (s2 > type->rampindexes - 1)
+						s2 = type->rampindexes - 1;
+					frac -= s1;
+					VectorInterpolate (type->ramp[s1].rgb, frac, type->ramp[s2].rgb, d->rgba);
+					FloatInterpolate (type->ramp[s1].alpha, frac, type->ramp[s2].alpha, d->rgba[3]);
+				}
+				break;
+				case RAMP_DELTA: // particle ramps
+					ramp = type->ramp + (int)(type->rampindexes * (type->die - (d->die - particletime)) / type->die);
+					VectorMA (d->rgba, pframetime, ramp->rgb, d->rgba);
+					d->rgba[3] -= pframetime * ramp->alpha;
+					break;
+				case RAMP_NONE: // particle changes acording to it's preset properties.
+					if (particletime < (d->die - type->die + type->rgbchangetime))
+					{
+						d->rgba[0] += pframetime * type->rgbchange[0];
+						d->rgba[1] += pframetime * type->rgbchange[1];
+						d->rgba[2] += pframetime * type->rgbchange[2];
+					}
+					d->rgba[3] += pframetime * type->alphachange;
+				}
+			}
 
-	kill_list = kill_first = NULL;
+			scenetri = PScript_CheckSceneTriOverflow (job, scenetri);
+			R_AddClippedDecal (scenetri, d, type->slooks);
+		}
+	}
 
-	flurrytime -= pframetime;
-	if (flurrytime < 0)
+	bdraw = NULL;
+	tdraw = NULL;
+	batchflags = 0;
+
+	// set drawing methods by type and cvars and hope branch
+	// prediction takes care of the rest
+	switch (type->looks.type)
 	{
-		doflurry = true;
-		flurrytime = 0.1 + frandom () * 0.3;
+	default:
+	case PT_INVISIBLE:
+		break;
+	case PT_BEAM:
+		bdraw = R_DrawParticleBeam;
+		break;
+	case PT_CDECAL:
+		break;
+	case PT_UDECAL:
+		tdraw = R_AddUnclippedDecal;
+		break;
+	case PT_NORMAL:
+		tdraw = R_AddTexturedParticle;
+		break;
+	case PT_SPARK:
+		tdraw = R_AddLineSparkParticle;
+		batchflags = BEF_LINES;
+		break;
+	case PT_SPARKFAN:
+		tdraw = R_AddFanSparkParticle;
+		break;
+	case PT_TEXTUREDSPARK:
+		tdraw = R_AddTSparkParticle;
+		break;
 	}
-	else
-		doflurry = false;
 
-	if (!free_decals)
+	scenetri = PScript_NewTypeSceneTri (job, type->looks.texture, type->looks.blendmode, batchflags);
+
+	if (!type->die)
 	{
-		// mark some as dead, so we can keep spawning new ones next frame.
-		for (i = 0; i < 256; i++)
+		while ((p = type->particles))
 		{
-			decals[r_decalrecycle].die = -1;
-			if (++r_decalrecycle >= r_numdecals)
-				r_decalrecycle = 0;
+			if (tdraw)
+			{
+				scenetri = PScript_CheckSceneTriOverflow (job, scenetri);
+				tdraw (scenetri, p, type->slooks);
+			}
+
+			// make sure emitter runs at least once
+			if (type->emit >= 0 && type->emitstart <= 0)
+				PScript_AddTypeEvent (job, PEV_EFFECT, type->emit, p->org, p->vel);
+
+			type->particles = p->next;
+			p->next = job->kill_list;
+			job->kill_list = p;
+			if (!job->kill_first) // branch here is probably faster than list traversal later
+				job->kill_first = p;
 		}
-	}
-	if (!free_particles)
-	{
-		// mark some as dead.
-		for (i = 0; i < 256; i++)
+
+		while ((b = type->beams) && (b->flags & BS_DEAD))
 		{
-			particles[r_particlerecycle].die = -1;
-			if (++r_particlerecycle >= r_numparticles)
-				r_particlerecycle = 0;
+			type->beams = b->next;
+			b->next = job->bkill_list;
+			job->bkill_list = b;
+			if (!job->bkill_first)
+				job->bkill_first = b;
 		}
-	}
 
-	for (type = part_run_list, lastvalidtype = NULL; type != NULL; type = type->nexttorun)
-	{
-		if (type->clippeddecals)
+		while (b)
 		{
-			if (cl_numstris && cl_stris[cl_numstris - 1].texture == type->looks.texture && cl_stris[cl_numstris - 1].blendmode == type->looks.blendmode &&
-			    cl_stris[cl_numstris - 1].beflags == 0)
-				scenetri = &cl_stris[cl_numstris - 1];
-			else
+			if (!(b->flags & BS_NODRAW))
 			{
-				if (cl_numstris == cl_maxstris)
+				// no BS_NODRAW implies b->next != NULL
+				// BS_NODRAW should imply b->next == NULL or b->next->flags & BS_DEAD
+				VectorCopy (b->next->p->org, stop);
+				VectorCopy (b->p->org, oldorg);
+				VectorSubtract (stop, oldorg, b->next->dir);
+				VectorNormalize (b->next->dir);
+				if (bdraw)
 				{
-					cl_maxstris += 8;
-					cl_stris = Mem_Realloc (cl_stris, sizeof (*cl_stris) * cl_maxstris);
+					scenetri = PScript_CheckSceneTriOverflow (job, scenetri);
+					bdraw (scenetri, b, type->slooks);
 				}
-				scenetri = &cl_stris[cl_numstris++];
-				scenetri->texture = type->looks.texture;
-				scenetri->blendmode = type->looks.blendmode;
-				scenetri->beflags = 0;
-				scenetri->firstidx = cl_numstrisidx;
-				scenetri->firstvert = cl_numstrisvert;
-				scenetri->numvert = 0;
-				scenetri->numidx = 0;
 			}
 
+			// clean up dead entries ahead of current
 			for (;;)
 			{
-				dkill = type->clippeddecals;
-				if (dkill && dkill->die < particletime)
+				bkill = b->next;
+				if (bkill && (bkill->flags & BS_DEAD))
 				{
-					type->clippeddecals = dkill->next;
-					dkill->next = free_decals;
-					free_decals = dkill;
+					b->next = bkill->next;
+					bkill->next = job->bkill_list;
+					job->bkill_list = bkill;
+					if (!job->bkill_first)
+						job->bkill_first = bkill;
 					continue;
 				}
 				break;
 			}
-			for (d = type->clippeddecals; d; d = d->next)
-			{
-				for (;;)
-				{
-					dkill = d->next;
-					if (dkill && dkill->die < particletime)
-					{
-						d->next = dkill->next;
-						dkill->next = free_decals;
-						free_decals = dkill;
-						continue;
-					}
-					break;
-				}
-
-				if (d->die - particletime <= type->die)
-				{
-					switch (type->rampmode)
-					{
-					case RAMP_NEAREST:
-						rampind = (int)(type->rampindexes * (type->die - (d->die - particletime)) / type->die);
-						if (rampind >= type->rampindexes)
-							rampind = type->rampindexes - 1;
-						ramp = type->ramp + rampind;
-						VectorCopy (ramp->rgb, d->rgba);
-						d->rgba[3] = ramp->alpha;
-						break;
-					case RAMP_LERP:
-					{
-						float frac = (type->rampindexes * (type->die - (d->die - particletime)) / type->die);
-						int   s1, s2;
-						s1 = frac;
-						s2 = s1 + 1;
-						if (s1 > type->rampindexes - 1)
-							s1 = type->rampindexes - 1;
-						if (s2 > type->rampindexes - 1)
-							s2 = type->rampindexes - 1;
-						frac -= s1;
-						VectorInterpolate (type->ramp[s1].rgb, frac, type->ramp[s2].rgb, d->rgba);
-						FloatInterpolate (type->ramp[s1].alpha, frac, type->ramp[s2].alpha, d->rgba[3]);
-					}
-					break;
-					case RAMP_DELTA: // particle ramps
-						ramp = type->ramp + (int)(type->rampindexes * (type->die - (d->die - particletime)) / type->die);
-						VectorMA (d->rgba, pframetime, ramp->rgb, d->rgba);
-						d->rgba[3] -= pframetime * ramp->alpha;
-						break;
-					case RAMP_NONE: // particle changes acording to it's preset properties.
-						if (particletime < (d->die - type->die + type->rgbchangetime))
-						{
-							d->rgba[0] += pframetime * type->rgbchange[0];
-							d->rgba[1] += pframetime * type->rgbchange[1];
-							d->rgba[2] += pframetime * type->rgbchange[2];
-						}
-						d->rgba[3] += pframetime * type->alphachange;
-					}
-				}
 
-				if (cl_numstrisvert - scenetri->firstvert >= MAX_INDICES - 6)
-				{
-					// generate a new mesh if the old one overflowed. yay smc...
-					if (cl_numstris == cl_maxstris)
-					{
-						cl_maxstris += 8;
-						cl_stris = Mem_Realloc (cl_stris, sizeof (*cl_stris) * cl_maxstris);
-					}
-					scenetri = &cl_stris[cl_numstris++];
-					scenetri->texture = scenetri[-1].texture;
-					scenetri->blendmode = scenetri[-1].blendmode;
-					scenetri->beflags = scenetri[-1].beflags;
-					scenetri->firstidx = cl_numstrisidx;
-					scenetri->firstvert = cl_numstrisvert;
-					scenetri->numvert = 0;
-					scenetri->numidx = 0;
-				}
-				R_AddClippedDecal (scenetri, d, type->slooks);
-			}
+			b->flags |= BS_DEAD;
+			b = b->next;
 		}
 
-		bdraw = NULL;
-		tdraw = NULL;
-		batchflags = 0;
+		goto done;
+	}
 
-		// set drawing methods by type and cvars and hope branch
-		// prediction takes care of the rest
-		switch (type->looks.type)
+	// kill off early ones.
+	for (;;)
+	{
+		kill = type->particles;
+		if (kill && kill->die < particletime)
 		{
-		default:
-		case PT_INVISIBLE:
-			break;
-		case PT_BEAM:
-			bdraw = R_DrawParticleBeam;
-			break;
-		case PT_CDECAL:
-			break;
-		case PT_UDECAL:
-			tdraw = R_AddUnclippedDecal;
-			break;
-		case PT_NORMAL:
-			tdraw = R_AddTexturedParticle;
-			break;
-		case PT_SPARK:
-			tdraw = R_AddLineSparkParticle;
-			batchflags = BEF_LINES;
-			break;
-		case PT_SPARKFAN:
-			tdraw = R_AddFanSparkParticle;
-			break;
-		case PT_TEXTUREDSPARK:
-			tdraw = R_AddTSparkParticle;
-			break;
+			type->particles = kill->next;
+			kill->next = job->kill_list;
+			job->kill_list = kill;
+			if (!job->kill_first)
+				job->kill_first = kill;
+			continue;
 		}
+		break;
+	}
 
-		if (cl_numstris && cl_stris[cl_numstris - 1].texture == type->looks.texture && cl_stris[cl_numstris - 1].blendmode == type->looks.blendmode &&
-		    cl_stris[cl_numstris - 1].beflags == batchflags)
-			scenetri = &cl_stris[cl_numstris - 1];
-		else
+	grav = type->gravity * pframetime;
+	friction[0] = 1 - type->friction[0] * pframetime;
+	friction[1] = 1 - type->friction[1] * pframetime;
+	friction[2] = 1 - type->friction[2] * pframetime;
+
+	for (p = type->particles; p; p = p->next)
+	{
+		for (;;)
 		{
-			if (cl_numstris == cl_maxstris)
+			kill = p->next;
+			if (kill && kill->die < particletime)
 			{
-				cl_maxstris += 8;
-				cl_stris = Mem_Realloc (cl_stris, sizeof (*cl_stris) * cl_maxstris);
+				p->next = kill->next;
+				kill->next = job->kill_list;
+				job->kill_list = kill;
+				if (!job->kill_first)
+					job->kill_first = kill;
+				continue;
 			}
-			scenetri = &cl_stris[cl_numstris++];
-			scenetri->texture = type->looks.texture;
-			scenetri->blendmode = type->looks.blendmode;
-			scenetri->beflags = batchflags;
-			scenetri->firstidx = cl_numstrisidx;
-			scenetri->firstvert = cl_numstrisvert;
-			scenetri->numvert = 0;
-			scenetri->numidx = 0;
+			break;
 		}
 
-		if (!type->die)
+		VectorCopy (p->org, oldorg);
+		if (type->flags & PT_VELOCITY)
 		{
-			while ((p = type->particles))
-			{
-				if (scenetri && tdraw)
-				{
-					if (cl_numstrisvert - scenetri->firstvert >= MAX_INDICES - 6)
-					{
-						// generate a new mesh if the old one overflowed. yay smc...
-						if (cl_numstris == cl_maxstris)
-						{
-							cl_maxstris += 8;
-							cl_stris = Mem_Realloc (cl_stris, sizeof (*cl_stris) * cl_maxstris);
-						}
-						scenetri = &cl_stris[cl_numstris++];
-						scenetri->texture = scenetri[-1].texture;
-						scenetri->blendmode = scenetri[-1].blendmode;
-						scenetri->beflags = scenetri[-1].beflags;
-						scenetri->firstidx = cl_numstrisidx;
-						scenetri->firstvert = cl_numstrisvert;
-						scenetri->numvert = 0;
-						scenetri->numidx = 0;
-					}
-					tdraw (scenetri, p, type->slooks);
-				}
-
-				// make sure emitter runs at least once
-				if (type->emit >= 0 && type->emitstart <= 0)
-					PScript_RunParticleEffectState (p->org, p->vel, 1, type->emit, NULL);
-
-				type->particles = p->next;
-				p->next = kill_list;
-				kill_list = p;
-				if (!kill_first) // branch here is probably faster than list traversal later
-					kill_first = p;
-			}
-
-			if (type->beams)
-			{
-				b = type->beams;
-			}
-
-			while ((b = type->beams) && (b->flags & BS_DEAD))
+			p->org[0] += p->vel[0] * pframetime;
+			p->org[1] += p->vel[1] * pframetime;
+			p->org[2] += p->vel[2] * pframetime;
+			p->vel[2] -= grav;
+			if (type->flags & PT_FRICTION)
 			{
-				type->beams = b->next;
-				b->next = free_beams;
-				free_beams = b;
+				p->vel[0] *= friction[0];
+				p->vel[1] *= friction[1];
+				p->vel[2] *= friction[2];
 			}
-
-			while (b)
-			{
-				if (!(b->flags & BS_NODRAW))
-				{
-					// no BS_NODRAW implies b->next != NULL
-					// BS_NODRAW should imply b->next == NULL or b->next->flags & BS_DEAD
-					VectorCopy (b->next->p->org, stop);
-					VectorCopy (b->p->org, oldorg);
-					VectorSubtract (stop, oldorg, b->next->dir);
-					VectorNormalize (b->next->dir);
-					if (bdraw)
-						bdraw (scenetri, b, type->slooks);
-				}
-
-				// clean up dead entries ahead of current
-				for (;;)
-				{
-					bkill = b->next;
-					if (bkill && (bkill->flags & BS_DEAD))
-					{
-						b->next = bkill->next;
-						bkill->next = free_beams;
-						free_beams = bkill;
-						continue;
-					}
-					break;
-				}
-
-				b->flags |= BS_DEAD;
-				b = b->next;
+			if (type->flurry && ptypedoflurry)
+			{ // these should probably be partially synced,
+				p->vel[0] += (PScript_JobRandom (job) * 2 - 1) * type->flurry;
+				p->vel[1] += (PScript_JobRandom (job) * 2 - 1) * type->flurry;
 			}
-
-			goto endtype;
 		}
 
-		// kill off early ones.
-		if (type->emittime < 0)
+		p->angle += p->rotationspeed * pframetime;
+
+		switch (type->rampmode)
 		{
-			for (;;)
+		case RAMP_NEAREST:
+			rampind = (int)(type->rampindexes * (type->die - (p->die - particletime)) / type->die);
+			if (rampind >= type->rampindexes)
+				rampind = type->rampindexes - 1;
+			ramp = type->ramp + rampind;
+			VectorCopy (ramp->rgb, p->rgba);
+			p->rgba[3] = ramp->alpha;
+			p->scale = ramp->scale;
+			break;
+		case RAMP_LERP:
+		{
+			float frac = (type->rampindexes * (type->die - (p->die - particletime)) / type->die);
+			int   s1, s2;
+			s1 = frac;
+			s2 = s1 + 1;
+			if (s1 > type->rampindexes - 1)
+				s1 = type->rampindexes - 1;
+			if (s2 > type->rampindexes - 1)
+				s2 = type->rampindexes - 1;
+			frac -= s1;
+			VectorInterpolate (type->ramp[s1].rgb, frac, type->ramp[s2].rgb, p->rgba);
+			FloatInterpolate (type->ramp[s1].alpha, frac, type->ramp[s2].alpha, p->rgba[3]);
+			FloatInterpolate (type->ramp[s1].scale, frac, type->ramp[s2].scale, p->scale);
+		}
+		break;
+		case RAMP_DELTA: // particle ramps
+			rampind = (int)(type->rampindexes * (type->die - (p->die - particletime)) / type->die);
+			if (rampind >= type->rampindexes)
+				rampind = type->rampindexes - 1;
+			ramp = type->ramp + rampind;
+			VectorMA (p->rgba, pframetime, ramp->rgb, p->rgba);
+			p->rgba[3] -= pframetime * ramp->alpha;
+			p->scale += pframetime * ramp->scale;
+			break;
+		case RAMP_NONE: // particle changes acording to it's preset properties.
+			if (particletime < (p->die - type->die + type->rgbchangetime))
 			{
-				kill = type->particles;
-				if (kill && kill->die < particletime)
-				{
-					PScript_DelinkTrailstate (&kill->state.trailstate);
-					type->particles = kill->next;
-					kill->next = kill_list;
-					kill_list = kill;
-					if (!kill_first)
-						kill_first = kill;
-					continue;
-				}
-				break;
+				p->rgba[0] += pframetime * type->rgbchange[0];
+				p->rgba[1] += pframetime * type->rgbchange[1];
+				p->rgba[2] += pframetime * type->rgbchange[2];
 			}
+			p->rgba[3] += pframetime * type->alphachange;
+			p->scale += pframetime * type->scaledelta;
 		}
-		else
+
+		if (type->emit >= 0)
 		{
-			for (;;)
+			if (type->emittime < 0)
+				PScript_AddTypeEvent (job, PEV_TRAIL, type->emit, oldorg, p->org)->p = p;
+			else if (p->state.nextemit < particletime)
 			{
-				kill = type->particles;
-				if (kill && kill->die < particletime)
-				{
-					type->particles = kill->next;
-					kill->next = kill_list;
-					kill_list = kill;
-					if (!kill_first)
-						kill_first = kill;
-					continue;
-				}
-				break;
+				p->state.nextemit = particletime + type->emittime + PScript_JobRandom (job) * type->emitrand;
+				PScript_AddTypeEvent (job, PEV_EFFECT, type->emit, p->org, p->vel);
 			}
 		}
 
-		grav = type->gravity * pframetime;
-		friction[0] = 1 - type->friction[0] * pframetime;
-		friction[1] = 1 - type->friction[1] * pframetime;
-		friction[2] = 1 - type->friction[2] * pframetime;
-
-		for (p = type->particles; p; p = p->next)
+		if (type->cliptype >= 0 && r_bouncysparks.value)
 		{
-			if (type->emittime < 0)
+			VectorSubtract (p->org, p->oldorg, stop);
+			if (!type->clipbounce || DotProduct (stop, stop) > 10 * 10)
 			{
-				for (;;)
+				int e;
+				if (job->numtraces++ < job->maxtraces && CL_TraceLine (p->oldorg, p->org, stop, normal, &e) < 1)
 				{
-					kill = p->next;
-					if (kill && kill->die < particletime)
+					if (type->clipbounce < 0)
 					{
-						PScript_DelinkTrailstate (&kill->state.trailstate);
-						p->next = kill->next;
-						kill->next = kill_list;
-						kill_list = kill;
-						if (!kill_first)
-							kill_first = kill;
+						p->die = -1;
+#ifdef USE_DECALS
+						if (type->clipbounce == -2)
+						{ // this type of particle splatters itself as a decal when it hits a wall.
+							pevent_t *ev = PScript_AddTypeEvent (job, PEV_DECAL, type - part_type, p->org, normal);
+							ev->entity = e;
+							ev->count = p->scale;
+						}
+#endif
 						continue;
 					}
-					break;
-				}
-			}
-			else
-			{
-				for (;;)
-				{
-					kill = p->next;
-					if (kill && kill->die < particletime)
+					else if (part_type + type->cliptype == type)
+					{                                       // bounce
+						dist = DotProduct (p->vel, normal); // * (-1-(rand()/(float)0x7fff)/2);
+						dist *= -type->clipbounce;
+						VectorMA (p->vel, dist, normal, p->vel);
+						VectorCopy (stop, p->org);
+
+						if (!*type->texname && VectorLength (p->vel) < 1000 * pframetime && type->looks.type == PT_NORMAL)
+						{
+							p->die = -1;
+							continue;
+						}
+					}
+					else
 					{
-						p->next = kill->next;
-						kill->next = kill_list;
-						kill_list = kill;
-						if (!kill_first)
-							kill_first = kill;
+						p->die = -1;
+						VectorNormalize (p->vel);
+
+						if (type->clipbounce)
+						{
+							VectorScale (normal, type->clipbounce, normal);
+							PScript_AddTypeEvent (job, PEV_EFFECT, type->cliptype, stop, normal)->count =
+								type->clipcount / part_type[type->cliptype].count;
+						}
+						else
+							PScript_AddTypeEvent (job, PEV_EFFECT, type->cliptype, stop, p->vel)->count =
+								type->clipcount / part_type[type->cliptype].count;
 						continue;
 					}
-					break;
 				}
+				VectorCopy (p->org, p->oldorg);
 			}
+		}
+		if (tdraw)
+		{
+			scenetri = PScript_CheckSceneTriOverflow (job, scenetri);
+			tdraw (scenetri, p, type->slooks);
+		}
+	}
 
-			VectorCopy (p->org, oldorg);
-			if (type->flags & PT_VELOCITY)
-			{
-				p->org[0] += p->vel[0] * pframetime;
-				p->org[1] += p->vel[1] * pframetime;
-				p->org[2] += p->vel[2] * pframetime;
-				p->vel[2] -= grav;
-				if (type->flags & PT_FRICTION)
-				{
-					p->vel[0] *= friction[0];
-					p->vel[1] *= friction[1];
-					p->vel[2] *= friction[2];
-				}
-				if (type->flurry && doflurry)
-				{ // these should probably be partially synced,
-					p->vel[0] += crandom () * type->flurry;
-					p->vel[1] += crandom () * type->flurry;
-				}
-			}
-
-			p->angle += p->rotationspeed * pframetime;
-
-			switch (type->rampmode)
-			{
-			case RAMP_NEAREST:
-				rampind = (int)(type->rampindexes * (type->die - (p->die - particletime)) / type->die);
-				if (rampind >= type->rampindexes)
-					rampind = type->rampindexes - 1;
-				ramp = type->ramp + rampind;
-				VectorCopy (ramp->rgb, p->rgba);
-				p->rgba[3] = ramp->alpha;
-				p->scale = ramp->scale;
-				break;
-			case RAMP_LERP:
-			{
-				float frac = (type->rampindexes * (type->die - (p->die - particletime)) / type->die);
-				int   s1, s2;
-				s1 = frac;
-				s2 = s1 + 1;
-				if (s1 > type->rampindexes - 1)
-					s1 = type->rampindexes - 1;
-				if (s2 > type->rampindexes - 1)
-					s2 = type->rampindexes - 1;
-				frac -= s1;
-				VectorInterpolate (type->ramp[s1].rgb, frac, type->ramp[s2].rgb, p->rgba);
-				FloatInterpolate (type->ramp[s1].alpha, frac, type->ramp[s2].alpha, p->rgba[3]);
-				FloatInterpolate (type->ramp[s1].scale, frac, type->ramp[s2].scale, p->scale);
-			}
-			break;
-			case RAMP_DELTA: // particle ramps
-				rampind = (int)(type->rampindexes * (type->die - (p->die - particletime)) / type->die);
-				if (rampind >= type->rampindexes)
-					rampind = type->rampindexes - 1;
-				ramp = type->ramp + rampind;
-				VectorMA (p->rgba, pframetime, ramp->rgb, p->rgba);
-				p->rgba[3] -= pframetime * ramp->alpha;
-				p->scale += pframetime * ramp->scale;
-				break;
-			case RAMP_NONE: // particle changes acording to it's preset properties.
-				if (particletime < (p->die - type->die + type->rgbchangetime))
-				{
-					p->rgba[0] += pframetime * type->rgbchange[0];
-					p->rgba[1] += pframetime * type->rgbchange[1];
-					p->rgba[2] += pframetime * type->rgbchange[2];
-				}
-				p->rgba[3] += pframetime * type->alphachange;
-				p->scale += pframetime * type->scaledelta;
-			}
+	// beams are dealt with here
 
-			if (type->emit >= 0)
-			{
-				if (type->emittime < 0)
-					PScript_ParticleTrail (oldorg, p->org, type->emit, pframetime, 0, NULL, &p->state.trailstate);
-				else if (p->state.nextemit < particletime)
-				{
-					p->state.nextemit = particletime + type->emittime + frandom () * type->emitrand;
-					PScript_RunParticleEffectState (p->org, p->vel, 1, type->emit, NULL);
-				}
-			}
+	// kill early entries
+	for (;;)
+	{
+		bkill = type->beams;
+		if (bkill && (bkill->flags & BS_DEAD || bkill->p->die < particletime) && !(bkill->flags & BS_LASTSEG))
+		{
+			type->beams = bkill->next;
+			bkill->next = job->bkill_list;
+			job->bkill_list = bkill;
+			if (!job->bkill_first)
+				job->bkill_first = bkill;
+			continue;
+		}
+		break;
+	}
 
-			if (type->cliptype >= 0 && r_bouncysparks.value)
+	b = type->beams;
+	if (b)
+	{
+		for (;;)
+		{
+			if (b->next)
 			{
-				VectorSubtract (p->org, p->oldorg, stop);
-				if (!type->clipbounce || DotProduct (stop, stop) > 10 * 10)
+				// mark dead entries
+				if (b->flags & (BS_LASTSEG | BS_DEAD | BS_NODRAW))
 				{
-					int e;
-					if (traces-- > 0 && CL_TraceLine (p->oldorg, p->org, stop, normal, &e) < 1)
+					// kill some more dead entries
+					for (;;)
 					{
-						if (type->clipbounce < 0)
+						bkill = b->next;
+						if (bkill && (bkill->flags & BS_DEAD) && !(bkill->flags & BS_LASTSEG))
 						{
-							p->die = -1;
-#ifdef USE_DECALS
-							if (type->clipbounce == -2)
-							{ // this type of particle splatters itself as a decal when it hits a wall.
-								decalctx_t ctx;
-								float      m;
-								vec3_t     vec = {0.5, 0.5, 0.431};
-								qmodel_t  *model;
-
-								ctx.entity = e;
-								if (!ctx.entity)
-								{
-									model = cl.worldmodel;
-									VectorCopy (p->org, ctx.center);
-								}
-								else if (e)
-								{ // this trace hit a door or something.
-									entity_t *ent = CL_EntityNum (e);
-									model = ent->model;
-									VectorSubtract (p->org, ent->origin, ctx.center);
-									// FIXME: rotate center+normal around entity.
-								}
-								else
-									continue; // err, no idea.
-
-								VectorScale (normal, -1, ctx.normal);
-								VectorNormalize (ctx.normal);
-
-								VectorNormalize (vec);
-								CrossProduct (ctx.normal, vec, ctx.tangent1);
-								RotatePointAroundVector (ctx.tangent2, ctx.normal, ctx.tangent1, frandom () * 360);
-								CrossProduct (ctx.normal, ctx.tangent2, ctx.tangent1);
-
-								VectorNormalize (ctx.tangent1);
-								VectorNormalize (ctx.tangent2);
-
-								ctx.ptype = type;
-								ctx.scale1 = type->s2 - type->s1;
-								ctx.bias1 = type->s1 + (ctx.scale1 * 0.5);
-								ctx.scale2 = type->t2 - type->t1;
-								ctx.bias2 = type->t1 + (ctx.scale2 * 0.5);
-								m = p->scale * (1.5 + frandom () * 0.5) * 0.5; // decals should be a little bigger, for some reason.
-								ctx.scale0 = 2.0 / m;
-								ctx.scale1 /= m;
-								ctx.scale2 /= m;
-
-								// inserts decals through a callback.
-								Mod_ClipDecal (
-									model, ctx.center, ctx.normal, ctx.tangent2, ctx.tangent1, m, type->surfflagmask, type->surfflagmatch, PScript_AddDecals,
-									&ctx);
-							}
-#endif
-							continue;
-						}
-						else if (part_type + type->cliptype == type)
-						{                                       // bounce
-							dist = DotProduct (p->vel, normal); // * (-1-(rand()/(float)0x7fff)/2);
-							dist *= -type->clipbounce;
-							VectorMA (p->vel, dist, normal, p->vel);
-							VectorCopy (stop, p->org);
-
-							if (!*type->texname && VectorLength (p->vel) < 1000 * pframetime && type->looks.type == PT_NORMAL)
-							{
-								p->die = -1;
-								continue;
-							}
-						}
-						else
-						{
-							p->die = -1;
-							VectorNormalize (p->vel);
-
-							if (type->clipbounce)
-							{
-								VectorScale (normal, type->clipbounce, normal);
-								PScript_RunParticleEffectState (stop, normal, type->clipcount / part_type[type->cliptype].count, type->cliptype, NULL);
-							}
-							else
-								PScript_RunParticleEffectState (stop, p->vel, type->clipcount / part_type[type->cliptype].count, type->cliptype, NULL);
+							b->next = bkill->next;
+							bkill->next = job->bkill_list;
+							job->bkill_list = bkill;
+							if (!job->bkill_first)
+								job->bkill_first = bkill;
 							continue;
 						}
+						break;
 					}
-					VectorCopy (p->org, p->oldorg);
+
+					if (!bkill) // have to check so we don't hit NULL->next
+						continue;
 				}
-			}
-			if (scenetri && tdraw)
-			{
-				if (cl_numstrisvert - scenetri->firstvert >= MAX_INDICES - 6)
+				else
 				{
-					// generate a new mesh if the old one overflowed. yay smc...
-					if (cl_numstris == cl_maxstris)
+					if (!(b->next->flags & BS_DEAD))
 					{
-						cl_maxstris += 8;
-						cl_stris = Mem_Realloc (cl_stris, sizeof (*cl_stris) * cl_maxstris);
+						VectorCopy (b->next->p->org, stop);
+						VectorCopy (b->p->org, oldorg);
+						VectorSubtract (stop, oldorg, b->next->dir);
+						VectorNormalize (b->next->dir);
+						if (bdraw)
+						{
+							VectorAdd (stop, oldorg, stop);
+							VectorScale (stop, 0.5, stop);
+						}
 					}
-					scenetri = &cl_stris[cl_numstris++];
-					scenetri->texture = scenetri[-1].texture;
-					scenetri->blendmode = scenetri[-1].blendmode;
-					scenetri->beflags = scenetri[-1].beflags;
-					scenetri->firstidx = cl_numstrisidx;
-					scenetri->firstvert = cl_numstrisvert;
-					scenetri->numvert = 0;
-					scenetri->numidx = 0;
+
+					if (b->p->die < particletime)
+						b->flags |= BS_DEAD;
 				}
-				tdraw (scenetri, p, type->slooks);
 			}
+			else
+			{
+				if (b->p->die < particletime) // end of the list check
+					b->flags |= BS_DEAD;
+
+				break;
+			}
+
+			if (b->p->die < particletime)
+				b->flags |= BS_DEAD;
+
+			b = b->next;
 		}
+	}
 
-		// beams are dealt with here
+done:
+	job->numvert = cl_numstrisvert;
+	job->numidx = cl_numstrisidx;
+}
 
-		// kill early entries
-		for (;;)
+/*
+===============
+PScript_PrepareParticleTypes
+
+Serial setup for the type jobs: one job per type in the run list, each
+with a vertex and index region large enough for everything it could draw
+===============
+*/
+static void PScript_PrepareParticleTypes (float pframetime)
+{
+	static float flurrytime;
+	part_type_t *type;
+	unsigned int i, numverts, numidx;
+	uint64_t     numclipping, tracelimit;
+
+	if (r_plooksdirty)
+	{
+		int j, k;
+
+		pe_default = PScript_FindParticleType ("PE_DEFAULT");
+		pe_size2 = PScript_FindParticleType ("PE_SIZE2");
+		pe_size3 = PScript_FindParticleType ("PE_SIZE3");
+		pe_defaulttrail = PScript_FindParticleType ("PE_DEFAULTTRAIL");
+
+		for (j = 0; j < numparticletypes; j++)
 		{
-			bkill = type->beams;
-			if (bkill && (bkill->flags & BS_DEAD || bkill->p->die < particletime) && !(bkill->flags & BS_LASTSEG))
+			// set the fallback
+			part_type[j].slooks = &part_type[j].looks;
+			for (k = j - 1; k-- > 0;)
 			{
-				type->beams = bkill->next;
-				bkill->next = free_beams;
-				free_beams = bkill;
-				continue;
+				if (!memcmp (&part_type[j].looks, &part_type[k].looks, sizeof (plooks_t)))
+				{
+					part_type[j].slooks = part_type[k].slooks;
+					break;
+				}
 			}
-			break;
 		}
+		r_plooksdirty = false;
+		CL_RegisterParticles ();
+		PScript_RecalculateSkyTris ();
+	}
 
-		b = type->beams;
-		if (b)
+	VectorScale (vup, 1.5, pup);
+	VectorScale (vright, 1.5, pright);
+
+	flurrytime -= pframetime;
+	if (flurrytime < 0)
+	{
+		ptypedoflurry = true;
+		flurrytime = 0.1 + frandom () * 0.3;
+	}
+	else
+		ptypedoflurry = false;
+
+	if (!free_decals)
+	{
+		// mark some as dead, so we can keep spawning new ones next frame.
+		for (i = 0; i < 256; i++)
 		{
-			for (;;)
-			{
-				if (b->next)
-				{
-					// mark dead entries
-					if (b->flags & (BS_LASTSEG | BS_DEAD | BS_NODRAW))
-					{
-						// kill some more dead entries
-						for (;;)
-						{
-							bkill = b->next;
-							if (bkill && (bkill->flags & BS_DEAD) && !(bkill->flags & BS_LASTSEG))
-							{
-								b->next = bkill->next;
-								bkill->next = free_beams;
-								free_beams = bkill;
-								continue;
-							}
-							break;
-						}
+			decals[r_decalrecycle].die = -1;
+			if (++r_decalrecycle >= r_numdecals)
+				r_decalrecycle = 0;
+		}
+	}
+	if (!free_particles)
+	{
+		// mark some as dead.
+		for (i = 0; i < 256; i++)
+		{
+			particles[r_particlerecycle].die = -1;
+			if (++r_particlerecycle >= r_numparticles)
+				r_particlerecycle = 0;
+		}
+	}
 
-						if (!bkill) // have to check so we don't hit NULL->next
-							continue;
-					}
-					else
-					{
-						if (!(b->next->flags & BS_DEAD))
-						{
-							VectorCopy (b->next->p->org, stop);
-							VectorCopy (b->p->org, oldorg);
-							VectorSubtract (stop, oldorg, b->next->dir);
-							VectorNormalize (b->next->dir);
-							if (bdraw)
-							{
-								VectorAdd (stop, oldorg, stop);
-								VectorScale (stop, 0.5, stop);
-							}
-						}
+	// the entity list is cached on first use, which mustn't happen on several jobs at once
+	CL_UpdateTraceLineCache ();
+	ptypeframetime = pframetime;
 
-						if (b->p->die < particletime)
-							b->flags |= BS_DEAD;
-					}
-				}
-				else
-				{
-					if (b->p->die < particletime) // end of the list check
-						b->flags |= BS_DEAD;
+	numptypejobs = 0;
+	numverts = numidx = 0;
+	numclipping = 0;
+	ptypeframe++;
+	for (type = part_run_list; type; type = type->nexttorun)
+	{
+		ptypejob_t     *job;
+		particle_t     *p;
+		beamseg_t      *b;
+		clippeddecal_t *d;
+		unsigned int    count = 0;
 
-					break;
-				}
+		if (numptypejobs == maxptypejobs)
+		{
+			maxptypejobs = q_max (maxptypejobs * 2, 64);
+			ptypejobs = Mem_Realloc (ptypejobs, sizeof (*ptypejobs) * maxptypejobs);
+			memset (ptypejobs + numptypejobs, 0, sizeof (*ptypejobs) * (maxptypejobs - numptypejobs));
+		}
+		job = &ptypejobs[numptypejobs++];
 
-				if (b->p->die < particletime)
-					b->flags |= BS_DEAD;
+		// every primitive takes at most 4 vertices and 6 indices
+		for (p = type->particles; p; p = p->next)
+			count++;
+		job->maxtraces = (type->cliptype >= 0) ? count : 0;
+		for (b = type->beams; b; b = b->next)
+			count++;
+		for (d = type->clippeddecals; d; d = d->next)
+			count++;
+
+		job->type = type;
+		job->firstvert = job->numvert = numverts;
+		job->firstidx = job->numidx = numidx;
+		numverts += count * 4;
+		numidx += count * 6;
+		job->endvert = numverts;
+		job->endidx = numidx;
+		job->numstris = 0;
+		job->kill_list = job->kill_first = NULL;
+		job->dkill_list = job->dkill_first = NULL;
+		job->bkill_list = job->bkill_first = NULL;
+		job->numevents = 0;
+		job->numtraces = 0;
+		job->rng = ((uint32_t)(type - part_type) + 1) * 2654435761u ^ ptypeframe * 40503u;
+		if (!job->rng)
+			job->rng = 1; // xorshift gets stuck on zero
+		numclipping += job->maxtraces;
+	}
+
+	// share the traces out by how many particles each type may clip, so which ones
+	// go without doesn't depend on what order the jobs happen to run in
+	tracelimit = (uint64_t)q_max (r_particle_tracelimit.value, 0.0f);
+	if (numclipping > tracelimit)
+		for (i = 0; i < numptypejobs; i++)
+			ptypejobs[i].maxtraces = ptypejobs[i].maxtraces * tracelimit / numclipping;
+
+	while (cl_maxstrisvert[current_buffer_index] < numverts)
+		ReallocateVertexBuffer ();
+	while (cl_maxstrisidx[current_buffer_index] < numidx)
+		ReallocateIndexBuffer ();
+
+	Atomic_StoreUInt32 (&nextptypejob, 0u);
+}
+
+/*
+===============
+PScript_PackTypeGeometry
+
+Moves the geometry of a finished job down so that it directly follows the
+previous job's, continuing the previous batch when the looks match
+===============
+*/
+static void PScript_PackTypeGeometry (ptypejob_t *job)
+{
+	unsigned int i, j;
+
+	for (i = 0; i < job->numstris; i++)
+	{
+		scenetris_t       *src = &job->stris[i];
+		const unsigned int vertend = (i + 1 < job->numstris) ? job->stris[i + 1].firstvert : job->numvert;
+		const unsigned int idxend = (i + 1 < job->numstris) ? job->stris[i + 1].firstidx : job->numidx;
+		const unsigned int numvert = vertend - src->firstvert;
+		const unsigned int numidx = idxend - src->firstidx;
+		scenetris_t       *dst;
+		unsigned int       rebase = 0;
 
-				b = b->next;
+		if (!numidx)
+			continue;
+
+		memmove (cl_curstrisvert + cl_numstrisvert, cl_curstrisvert + src->firstvert, numvert * sizeof (*cl_curstrisvert));
+		memmove (cl_curstrisidx + cl_numstrisidx, cl_curstrisidx + src->firstidx, numidx * sizeof (*cl_curstrisidx));
+
+		dst = cl_numstris ? &cl_stris[cl_numstris - 1] : NULL;
+		if (dst && dst->texture == src->texture && dst->blendmode == src->blendmode && dst->beflags == src->beflags &&
+		    dst->numvert + numvert < MAX_INDICES - 6)
+		{
+			rebase = dst->numvert;
+			for (j = 0; j < numidx; j++)
+				cl_curstrisidx[cl_numstrisidx + j] += rebase;
+		}
+		else
+		{
+			if (cl_numstris == cl_maxstris)
+			{
+				cl_maxstris += 8;
+				cl_stris = Mem_Realloc (cl_stris, sizeof (*cl_stris) * cl_maxstris);
 			}
+			dst = &cl_stris[cl_numstris++];
+			dst->texture = src->texture;
+			dst->blendmode = src->blendmode;
+			dst->beflags = src->beflags;
+			dst->firstvert = cl_numstrisvert;
+			dst->firstidx = cl_numstrisidx;
+			dst->numvert = 0;
+			dst->numidx = 0;
 		}
 
-	endtype:
+		dst->numvert += numvert;
+		dst->numidx += numidx;
+		cl_numstrisvert += numvert;
+		cl_numstrisidx += numidx;
+	}
+}
+
+/*
+===============
+PScript_FinishParticleTypes
+
+Serial merge of the type jobs, in run list order so the result doesn't
+depend on how the jobs were scheduled
+===============
+*/
+static void PScript_FinishParticleTypes (void)
+{
+	part_type_t *type, *lastvalidtype;
+	particle_t  *p;
+	int          i, j;
+
+	// the jobs are done with the buffers, pack them for upload on this thread
+	cl_curstrisvert = cl_strisvert[current_buffer_index];
+	cl_curstrisidx = cl_strisidx[current_buffer_index];
+	cl_numstrisvert = 0;
+	cl_numstrisidx = 0;
+
+	for (i = 0, lastvalidtype = NULL; i < numptypejobs; i++)
+	{
+		ptypejob_t *job = &ptypejobs[i];
+
+		type = job->type;
+		PScript_PackTypeGeometry (job);
+
+		if (type->die && type->emittime < 0)
+			for (p = job->kill_list; p; p = p->next)
+				PScript_DelinkTrailstate (&p->state.trailstate);
+
+		if (job->dkill_list)
+		{
+			job->dkill_first->next = free_decals;
+			free_decals = job->dkill_list;
+		}
+		if (job->bkill_list)
+		{
+			job->bkill_first->next = free_beams;
+			free_beams = job->bkill_list;
+		}
 
 		// delete from run list if necessary
 		if (!type->particles && !type->beams && !type->clippeddecals)
@@ -6811,14 +7294,52 @@ static void PScript_DrawParticleTypes (cb_context_t *cbx, float pframetime)
 			lastvalidtype = type;
 	}
 
-	// lazy delete for particles is done here
-	if (kill_list)
+	for (i = 0; i < numptypejobs; i++)
 	{
-		kill_first->next = free_particles;
-		free_particles = kill_list;
+		ptypejob_t *job = &ptypejobs[i];
+
+		for (j = 0; j < job->numevents; j++)
+		{
+			pevent_t *ev = &job->events[j];
+			switch (ev->type)
+			{
+			case PEV_EFFECT:
+				PScript_RunParticleEffectState (ev->org, ev->dir, ev->count, ev->ptype, NULL);
+				break;
+			case PEV_TRAIL:
+				PScript_ParticleTrail (ev->org, ev->dir, ev->ptype, ptypeframetime, 0, NULL, &ev->p->state.trailstate);
+				break;
+			case PEV_DECAL:
+#ifdef USE_DECALS
+				PScript_SplatterDecal (&part_type[ev->ptype], ev->org, ev->dir, ev->entity, ev->count);
+#endif
+				break;
+			}
+		}
+	}
+
+	// lazy delete for particles is done here, after the events that might still refer to them
+	for (i = 0; i < numptypejobs; i++)
+	{
+		ptypejob_t *job = &ptypejobs[i];
+		if (job->kill_list)
+		{
+			job->kill_first->next = free_particles;
+			free_particles = job->kill_list;
+		}
 	}
 
-	particletime += pframetime;
+	particletime += ptypeframetime;
+}
+
+/*
+===============
+PScript_UploadParticleTypes
+===============
+*/
+static void PScript_UploadParticleTypes (cb_context_t *cbx)
+{
+	unsigned int i, o;
 
 	if (!cl_numstris)
 		return;
@@ -6826,15 +7347,12 @@ static void PScript_DrawParticleTypes (cb_context_t *cbx, float pframetime)
 	R_BeginDebugUtilsLabel (cbx, "FTE Particles");
 	Fog_DisableGFog (cbx);
 
-
-	uint8_t *memallc = RT_AllocScratchMemoryNulled (
-		cl_maxstrisvert[current_buffer_index] * sizeof (RgVertex) + 
-	    cl_maxstrisidx[current_buffer_index] * sizeof(uint32_t));
+	uint8_t *memallc = RT_AllocScratchMemoryNulled (cl_numstrisvert * sizeof (RgVertex) + cl_numstrisidx * sizeof (uint32_t));
 
 	RgVertex *rtvertices = (RgVertex *)memallc;
-	for (uint32_t v = 0; v < cl_maxstrisvert[current_buffer_index]; v++)
+	for (uint32_t v = 0; v < cl_numstrisvert; v++)
 	{
-		basicvertex_t *src = &cl_strisvert[current_buffer_index][v];
+		basicvertex_t *src = &cl_curstrisvert[v];
 		RgVertex      *dst = &rtvertices[v];
 
 		memcpy (dst->position, src->position, sizeof (float) * 3);
@@ -6842,10 +7360,10 @@ static void PScript_DrawParticleTypes (cb_context_t *cbx, float pframetime)
 		dst->packedColor = RT_PackColorToUint32 (src->color[0], src->color[1], src->color[2], src->color[3]);
 	}
 
-	uint32_t *rtindices = (uint32_t *)(memallc + (cl_maxstrisvert[current_buffer_index] * sizeof (RgVertex)));
-	for (uint32_t v = 0; v < cl_maxstrisidx[current_buffer_index]; v++)
+	uint32_t *rtindices = (uint32_t *)(memallc + (cl_numstrisvert * sizeof (RgVertex)));
+	for (uint32_t v = 0; v < cl_numstrisidx; v++)
 	{
-		rtindices[v] = cl_strisidx[current_buffer_index][v];
+		rtindices[v] = cl_curstrisidx[v];
 	}
 
 	for (o = 0; o < 3; o++)
@@ -6934,10 +7452,14 @@ static void PScript_DrawParticleTypes (cb_context_t *cbx, float pframetime)
 
 /*
 ===============
-PScript_DrawParticles
+PScript_PrepareParticles
+
+First step of drawing the scripted particles: emits rain and sets up one job
+per running particle type. The jobs are run by PScript_RunParticleTypes,
+after which PScript_DrawParticles merges and draws their results.
 ===============
 */
-void PScript_DrawParticles (cb_context_t *cbx)
+void PScript_PrepareParticles (void)
 {
 	int          i;
 	entity_t    *ent;
@@ -6954,10 +7476,9 @@ void PScript_DrawParticles (cb_context_t *cbx)
 
 	current_buffer_index = (current_buffer_index + 1) % 2;
 	cl_numstris = 0;
-	cl_numstrisvert = 0;
-	cl_numstrisidx = 0;
-	cl_curstrisvert = cl_strisvert[current_buffer_index];
-	cl_curstrisidx = cl_strisidx[current_buffer_index];
+	numptypejobs = 0;
+	Atomic_StoreUInt32 (&nextptypejob, 0u);
+	ptypeprepared = false;
 
 	if (!r_particles.value)
 		return;
@@ -6978,7 +7499,38 @@ void PScript_DrawParticles (cb_context_t *cbx)
 		}
 	}
 
-	PScript_DrawParticleTypes (cbx, pframetime);
+	PScript_PrepareParticleTypes (pframetime);
+	ptypeprepared = true;
+}
+
+/*
+===============
+PScript_RunParticleTypes
+
+Indexed task body; every index keeps taking type jobs until none are left
+===============
+*/
+void PScript_RunParticleTypes (int index, void *unused)
+{
+	uint32_t job;
+
+	while ((job = Atomic_IncrementUInt32 (&nextptypejob)) < (uint32_t)numptypejobs)
+		PScript_RunParticleType (&ptypejobs[job]);
+}
+
+/*
+===============
+PScript_DrawParticles
+===============
+*/
+void PScript_DrawParticles (cb_context_t *cbx)
+{
+	if (!ptypeprepared)
+		return;
+	ptypeprepared = false;
+
+	PScript_FinishParticleTypes ();
+	PScript_UploadParticleTypes (cbx);
 }
 
 /*
@@ -358,7 +358,7 @@ void R_MarkVisSurfacesSIMD (qboolean *use_tasks)
 			++brushpolys;
 			R_ChainSurface (surf, chain_world);
 			if (!r_gpulightmapupdate.value)
-				R_RenderDynamicLightmaps (surf);
+				R_QueueDynamicLightmap (surf);
 			else if (surf->lightmaptexturenum >= 0)
 				Atomic_StoreUInt32 (&lightmaps[surf->lightmaptexturenum].modified, true);
 			if (surf->texinfo->texture->warpimage)
@@ -436,7 +436,9 @@ void R_BackfaceCullSurfacesSIMD (int index, void *unused)
 		const int i = FindFirstBitNonZero (mask_iter);
 
 		surf = &cl.worldmodel->surfaces[(index * 32) + i];
-		if (surf->lightmaptexturenum >= 0)
+		if (!r_gpulightmapupdate.value)
+			R_QueueDynamicLightmap (surf);
+		else if (surf->lightmaptexturenum >= 0)
 			Atomic_StoreUInt32 (&lightmaps[surf->lightmaptexturenum].modified, true);
 		if (surf->texinfo->texture->warpimage)
 			Atomic_StoreUInt32 (&surf->texinfo->texture->update_warp, true);
@@ -544,7 +546,7 @@ void R_MarkVisSurfaces (qboolean *use_tasks)
                 ++brushpolys;
                 R_ChainSurface (surf, chain_world);
                 if (!r_gpulightmapupdate.value)
-                    R_RenderDynamicLightmaps (surf);
+                    R_QueueDynamicLightmap (surf);
                 else if (surf->lightmaptexturenum >= 0)
                     Atomic_StoreUInt32 (&lightmaps[surf->lightmaptexturenum].modified, true);
                 if (surf->texinfo->texture->warpimage)
@@ -1250,8 +1252,6 @@ void R_DrawTextureChains (cb_context_t *cbx, qmodel_t *model, entity_t *ent, tex
 	else
 		entalpha = 1;
 
-	if (!r_gpulightmapupdate.value)
-		R_UploadLightmaps ();
 	R_DrawTextureChains_Multitexture (cbx, model, ent, chain, entalpha, 0, model->numtextures, entuniqueid);
 }
 
@@ -1340,8 +1340,6 @@ void R_DrawWorld (cb_context_t *cbx, int index)
 		return;
 
 	R_BeginDebugUtilsLabel (cbx, "World");
-	if (!r_gpulightmapupdate.value)
-		R_UploadLightmaps ();
 	R_DrawTextureChains_Multitexture (cbx, cl.worldmodel, NULL, chain_world, 1, world_texstart[index], world_texend[index], ENT_UNIQUEID_WORLD);
 
 #if RT_USE_SPHERE_INSTEAD_OF_POLY
@@ -178,9 +178,14 @@ typedef struct client_s
 	} * previousentities;
 	size_t        numpreviousentities;
 	size_t        maxpreviousentities;
-	unsigned int  snapshotresume;
+	unsigned int  snapshotresume;       // index into snapshotorder for replacement deltas
 	unsigned int *pendingentities_bits; // UF_ flags for each entity
 	size_t        numpendingentities;   // realloc if too small
+	unsigned int *snapshotorder;        // pending entities, most important first
+	size_t        numsnapshotorder;
+	size_t        maxsnapshotorder;
+	float        *entpriority;          // accumulated while an entity waits to be sent, see SV_EntityPriority
+	size_t        numentpriority;
 #define SENDFLAG_PRESENT 0x80000000u    // tracks that we previously sent one of these ents (resulting in a remove if the ent gets remove()d).
 #define SENDFLAG_REMOVE  0x40000000u    // for packetloss to signal that we need to resend a remove.
 #define SENDFLAG_USABLE  0x00ffffffu    // SendFlags bits that the qc is actually able to use (don't get confused if the mod uses SendFlags=-1).
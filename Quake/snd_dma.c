@@ -49,10 +49,13 @@ static dma_t    sn;
 volatile dma_t *shm = NULL;
 
 vec3_t listener_origin;
+static vec3_t play_origin; // the main thread's own copy, listener_origin belongs to the mixer
 vec3_t listener_forward;
 vec3_t listener_right;
 vec3_t listener_up;
 
+static int listener_viewentity; // cl.viewentity as of the last listener update
+
 #define sound_nominal_clip_dist 1000.0
 
 int soundtime;   // sample PAIRS
@@ -62,8 +65,20 @@ int                   s_rawend;
 portable_samplepair_t s_rawsamples[MAX_RAW_SAMPLES];
 
 #define MAX_SFX 1024
-static sfx_t *known_sfx = NULL; // hunk allocated [MAX_SFX]
-static int    num_sfx;
+static sfx_t    *known_sfx = NULL; // hunk allocated [MAX_SFX]
+static int       num_sfx;
+
+static unsigned int snd_cache_clock; // bumped whenever a sound is used, see S_TrimSoundCache
+
+// sounds from the last precache list, loaded by background tasks
+static sfx_t        *preload_sfx[MAX_SFX];
+static byte         *preload_data[MAX_SFX]; // read on the main thread, decoded by the tasks
+static int           preload_size[MAX_SFX];
+static int           num_preload_sfx;
+static task_handle_t preload_task;
+static qboolean      preload_collecting; // between S_BeginPrecaching and S_EndPrecaching
+static qboolean      preload_running;
+static strhash_t known_sfx_hash = {"sounds"};
 
 static sfx_t *ambient_sfx[NUM_AMBIENTS];
 
@@ -71,11 +86,76 @@ static qboolean sound_started = false;
 
 SDL_mutex *snd_mutex;
 
+// =======================================================================
+// Mixer thread
+//
+// With snd_mixthread set, spatialization and mixing run on their own thread.
+// The main thread never touches the channels then: S_StartSound, S_StopSound,
+// S_StaticSound and S_Update push commands into a single producer/single
+// consumer ring, which the mixer drains in order with snd_mutex held. Rare
+// operations (S_StopAllSounds, S_ClearBuffer, S_BlockSound...) still take
+// snd_mutex directly, after running whatever is queued.
+// =======================================================================
+
+typedef enum
+{
+	SNDCMD_START,
+	SNDCMD_STOP,
+	SNDCMD_STATIC,
+	SNDCMD_UPDATE,
+} sndcmdtype_t;
+
+typedef struct
+{
+	sndcmdtype_t type;
+	int          entnum; // viewentity for SNDCMD_UPDATE
+	int          entchannel;
+	sfx_t       *sfx;
+	vec3_t       origin;
+	float        vol;
+	float        attenuation;
+
+	// SNDCMD_UPDATE
+	vec3_t   forward, right, up;
+	qboolean ambients; // false to leave the ambient channels alone
+	float    ambient_levels[NUM_AMBIENTS]; // < 0 to silence the channel
+} sndcmd_t;
+
+#define SND_QUEUE_SIZE       1024 // must be a power of two
+#define SND_MIXER_PERIOD_MS  5
+
+static sndcmd_t        snd_queue[SND_QUEUE_SIZE];
+static atomic_uint32_t snd_queue_head; // written by the main thread
+static atomic_uint32_t snd_queue_tail; // written with snd_mutex held
+
+static SDL_Thread     *snd_mixer_thread;
+static atomic_uint32_t snd_mixer_quit;
+static qboolean        snd_have_listener; // an update was run since the last start
+
+static int num_static_channels; // main thread view of the static channels, for the overflow warning
+
+// stats for soundinfo
+static atomic_uint32_t snd_underruns;
+static atomic_uint32_t snd_latency;   // samples mixed ahead of the DMA position after the last mix
+static atomic_uint32_t snd_mix_usec;  // duration of the last mix
+static atomic_uint32_t snd_active_channels;
+
+static void S_StartSoundNow (int entnum, int entchannel, sfx_t *sfx, vec3_t origin, float fvol, float attenuation);
+static qboolean S_PreloadDone (uint32_t timeout);
+static void S_TrimSoundCache (void);
+static void S_StopSoundNow (int entnum, int entchannel);
+static void S_StaticSoundNow (sfx_t *sfx, vec3_t origin, float vol, float attenuation);
+static void S_UpdateListener (const sndcmd_t *cmd);
+static void S_SpatializeChannels (void);
+
 cvar_t bgmvolume = {"bgmvolume", "1", CVAR_ARCHIVE};
 cvar_t sfxvolume = {"volume", "0.7", CVAR_ARCHIVE};
 
 cvar_t precache = {"precache", "1", CVAR_NONE};
 cvar_t loadas8bit = {"loadas8bit", "0", CVAR_NONE};
+cvar_t snd_streamlength = {"snd_streamlength", "10", CVAR_ARCHIVE}; // looped sounds longer than this many seconds are streamed
+
+static cvar_t snd_cachesize = {"snd_cachesize", "64", CVAR_ARCHIVE}; // megabytes of decoded sounds to keep, 0 for no limit
 
 cvar_t sndspeed = {"sndspeed", "11025", CVAR_NONE};
 cvar_t snd_mixspeed = {"snd_mixspeed", "44100", CVAR_NONE};
@@ -88,6 +168,11 @@ cvar_t snd_mixspeed = {"snd_mixspeed", "44100", CVAR_NONE};
 
 cvar_t snd_filterquality = {"snd_filterquality", SND_FILTERQUALITY_DEFAULT, CVAR_NONE};
 
+// 0 picks the nearest sample like before, 1-3 use a polyphase windowed sinc with 16, 32 or 64 taps
+cvar_t snd_resamplequality = {"snd_resamplequality", "2", CVAR_ARCHIVE};
+
+static cvar_t snd_mixthread = {"snd_mixthread", "1", CVAR_ARCHIVE};
+
 static cvar_t nosound = {"nosound", "0", CVAR_NONE};
 static cvar_t ambient_level = {"ambient_level", "0.3", CVAR_NONE};
 static cvar_t ambient_fade = {"ambient_fade", "100", CVAR_NONE};
@@ -109,6 +194,154 @@ static void S_SoundInfo_f (void)
 	Con_Printf ("%5d submission_chunk\n", shm->submission_chunk);
 	Con_Printf ("%5d total_channels\n", total_channels);
 	Con_Printf ("%p dma buffer\n", shm->buffer);
+	Con_Printf ("mixing on %s thread\n", snd_mixer_thread ? "its own" : "the main");
+	Con_Printf ("%5.1f ms mix latency\n", Atomic_LoadUInt32 (&snd_latency) * 1000.0 / shm->speed);
+	Con_Printf ("%5.2f ms last mix\n", Atomic_LoadUInt32 (&snd_mix_usec) / 1000.0);
+	Con_Printf ("%5u underruns\n", Atomic_LoadUInt32 (&snd_underruns));
+}
+
+/*
+================
+S_RunCommand
+
+Runs a queued command, with snd_mutex held
+================
+*/
+static void S_RunCommand (sndcmd_t *cmd)
+{
+	switch (cmd->type)
+	{
+	case SNDCMD_START:
+		S_StartSoundNow (cmd->entnum, cmd->entchannel, cmd->sfx, cmd->origin, cmd->vol, cmd->attenuation);
+		break;
+	case SNDCMD_STOP:
+		S_StopSoundNow (cmd->entnum, cmd->entchannel);
+		break;
+	case SNDCMD_STATIC:
+		S_StaticSoundNow (cmd->sfx, cmd->origin, cmd->vol, cmd->attenuation);
+		break;
+	case SNDCMD_UPDATE:
+		S_UpdateListener (cmd);
+		break;
+	}
+}
+
+/*
+================
+S_RunCommands
+
+Drains the command queue, with snd_mutex held
+================
+*/
+static void S_RunCommands (void)
+{
+	const uint32_t head = Atomic_LoadUInt32 (&snd_queue_head);
+	uint32_t       tail = Atomic_LoadUInt32 (&snd_queue_tail);
+
+	for (; tail != head; tail++)
+		S_RunCommand (&snd_queue[tail & (SND_QUEUE_SIZE - 1)]);
+	Atomic_StoreUInt32 (&snd_queue_tail, tail);
+}
+
+/*
+================
+S_QueueCommand
+
+Hands a command to the mixer thread, or runs it right away without one
+================
+*/
+static void S_QueueCommand (sndcmd_t *cmd)
+{
+	uint32_t head;
+
+	if (!snd_mixer_thread)
+	{
+		SDL_LockMutex (snd_mutex);
+		S_RunCommand (cmd);
+		SDL_UnlockMutex (snd_mutex);
+		return;
+	}
+
+	head = Atomic_LoadUInt32 (&snd_queue_head);
+	if (head - Atomic_LoadUInt32 (&snd_queue_tail) == SND_QUEUE_SIZE)
+	{
+		// the mixer is falling behind, catch up here
+		SDL_LockMutex (snd_mutex);
+		S_RunCommands ();
+		S_RunCommand (cmd);
+		SDL_UnlockMutex (snd_mutex);
+		return;
+	}
+
+	snd_queue[head & (SND_QUEUE_SIZE - 1)] = *cmd;
+	Atomic_StoreUInt32 (&snd_queue_head, head + 1);
+}
+
+/*
+================
+S_MixerThread
+================
+*/
+static int S_MixerThread (void *unused)
+{
+	while (!Atomic_LoadUInt32 (&snd_mixer_quit))
+	{
+		SDL_LockMutex (snd_mutex);
+		S_RunCommands ();
+		if (sound_started && !snd_blocked && snd_have_listener)
+		{
+			S_SpatializeChannels ();
+			S_Update_ ();
+		}
+		SDL_UnlockMutex (snd_mutex);
+
+		SDL_Delay (SND_MIXER_PERIOD_MS);
+	}
+
+	return 0;
+}
+
+/*
+================
+S_StartMixerThread
+================
+*/
+static void S_StartMixerThread (void)
+{
+	if (snd_mixer_thread || !sound_started)
+		return;
+
+	Atomic_StoreUInt32 (&snd_mixer_quit, false);
+	snd_mixer_thread = SDL_CreateThread (S_MixerThread, "S_MixerThread", NULL);
+	if (!snd_mixer_thread)
+		Con_Printf ("Couldn't create the mixer thread, mixing on the main thread\n");
+}
+
+/*
+================
+S_StopMixerThread
+================
+*/
+static void S_StopMixerThread (void)
+{
+	if (!snd_mixer_thread)
+		return;
+
+	Atomic_StoreUInt32 (&snd_mixer_quit, true);
+	SDL_WaitThread (snd_mixer_thread, NULL);
+	snd_mixer_thread = NULL;
+
+	SDL_LockMutex (snd_mutex);
+	S_RunCommands ();
+	SDL_UnlockMutex (snd_mutex);
+}
+
+static void SND_Callback_snd_mixthread (cvar_t *var)
+{
+	if (var->value)
+		S_StartMixerThread ();
+	else
+		S_StopMixerThread ();
 }
 
 static void SND_Callback_sfxvolume (cvar_t *var)
@@ -168,6 +401,8 @@ void S_Init (void)
 	Cvar_RegisterVariable (&sfxvolume);
 	Cvar_RegisterVariable (&precache);
 	Cvar_RegisterVariable (&loadas8bit);
+	Cvar_RegisterVariable (&snd_streamlength);
+	Cvar_RegisterVariable (&snd_cachesize);
 	Cvar_RegisterVariable (&bgmvolume);
 	Cvar_RegisterVariable (&ambient_level);
 	Cvar_RegisterVariable (&ambient_fade);
@@ -177,6 +412,8 @@ void S_Init (void)
 	Cvar_RegisterVariable (&sndspeed);
 	Cvar_RegisterVariable (&snd_mixspeed);
 	Cvar_RegisterVariable (&snd_filterquality);
+	Cvar_RegisterVariable (&snd_mixthread);
+	Cvar_RegisterVariable (&snd_resamplequality);
 
 	if (safemode || COM_CheckParm ("-nosound"))
 		return;
@@ -188,6 +425,8 @@ void S_Init (void)
 	Cmd_AddCommand ("stopsound", S_StopAllSoundsC);
 	Cmd_AddCommand ("soundlist", S_SoundList);
 	Cmd_AddCommand ("soundinfo", S_SoundInfo_f);
+	Cmd_AddCommand ("snd_mixbench", SND_MixBenchmark_f);
+	Cmd_AddCommand ("snd_resamplebench", SND_ResampleBenchmark_f);
 
 	i = COM_CheckParm ("-sndspeed");
 	if (i && i < com_argc - 1)
@@ -203,11 +442,13 @@ void S_Init (void)
 
 	Cvar_SetCallback (&sfxvolume, SND_Callback_sfxvolume);
 	Cvar_SetCallback (&snd_filterquality, &SND_Callback_snd_filterquality);
+	Cvar_SetCallback (&snd_mixthread, &SND_Callback_snd_mixthread);
 
 	SND_InitScaletable ();
 
 	known_sfx = (sfx_t *)Mem_Alloc (MAX_SFX * sizeof (sfx_t));
 	num_sfx = 0;
+	StrHash_Clear (&known_sfx_hash);
 
 	snd_initialized = true;
 
@@ -225,6 +466,9 @@ void S_Init (void)
 	S_CodecInit ();
 
 	S_StopAllSounds (true);
+
+	if (snd_mixthread.value)
+		S_StartMixerThread ();
 }
 
 // =======================================================================
@@ -235,6 +479,9 @@ void S_Shutdown (void)
 	if (!sound_started)
 		return;
 
+	S_PreloadDone (SDL_MUTEX_MAXWAIT);
+	S_StopMixerThread ();
+
 	sound_started = 0;
 	snd_blocked = 0;
 
@@ -256,7 +503,6 @@ S_FindName
 */
 static sfx_t *S_FindName (const char *name)
 {
-	int    i;
 	sfx_t *sfx;
 
 	if (!name)
@@ -266,19 +512,16 @@ static sfx_t *S_FindName (const char *name)
 		Sys_Error ("Sound name too long: %s", name);
 
 	// see if already loaded
-	for (i = 0; i < num_sfx; i++)
-	{
-		if (!strcmp (known_sfx[i].name, name))
-		{
-			return &known_sfx[i];
-		}
-	}
+	sfx = (sfx_t *)StrHash_Find (&known_sfx_hash, name, NULL);
+	if (sfx)
+		return sfx;
 
 	if (num_sfx == MAX_SFX)
 		Sys_Error ("S_FindName: out of sfx_t");
 
-	sfx = &known_sfx[i];
+	sfx = &known_sfx[num_sfx];
 	q_strlcpy (sfx->name, name, sizeof (sfx->name));
+	StrHash_Insert (&known_sfx_hash, sfx->name, NULL, sfx);
 
 	num_sfx++;
 
@@ -312,10 +555,20 @@ sfx_t *S_PrecacheSound (const char *name)
 		return NULL;
 
 	sfx = S_FindName (name);
+	sfx->lastused = ++snd_cache_clock;
 
 	// cache it in
 	if (precache.value)
-		S_LoadSound (sfx);
+	{
+		if (preload_collecting)
+		{
+			// S_EndPrecaching hands these to the workers
+			if (num_preload_sfx < MAX_SFX)
+				preload_sfx[num_preload_sfx++] = sfx;
+		}
+		else
+			S_LoadSound (sfx);
+	}
 
 	return sfx;
 }
@@ -348,7 +601,7 @@ channel_t *SND_PickChannel (int entnum, int entchannel)
 		}
 
 		// don't let monster sounds override player sounds
-		if (snd_channels[ch_idx].entnum == cl.viewentity && entnum != cl.viewentity && snd_channels[ch_idx].sfx)
+		if (snd_channels[ch_idx].entnum == listener_viewentity && entnum != listener_viewentity && snd_channels[ch_idx].sfx)
 			continue;
 
 		if (snd_channels[ch_idx].end - paintedtime < life_left)
@@ -382,7 +635,7 @@ void SND_Spatialize (channel_t *ch)
 	vec3_t source_vec;
 
 	// anything coming from the view entity will always be full volume
-	if (ch->entnum == cl.viewentity)
+	if (ch->entnum == listener_viewentity)
 	{
 		ch->leftvol = ch->master_vol;
 		ch->rightvol = ch->master_vol;
@@ -422,6 +675,28 @@ void SND_Spatialize (channel_t *ch)
 // =======================================================================
 
 void S_StartSound (int entnum, int entchannel, sfx_t *sfx, vec3_t origin, float fvol, float attenuation)
+{
+	sndcmd_t cmd;
+
+	if (!sound_started || !sfx || nosound.value)
+		return;
+
+	// load it here, so the mixer only ever finds it in the cache
+	if (!S_LoadSound (sfx))
+		return;
+	sfx->lastused = ++snd_cache_clock;
+
+	cmd.type = SNDCMD_START;
+	cmd.entnum = entnum;
+	cmd.entchannel = entchannel;
+	cmd.sfx = sfx;
+	VectorCopy (origin, cmd.origin);
+	cmd.vol = fvol;
+	cmd.attenuation = attenuation;
+	S_QueueCommand (&cmd);
+}
+
+static void S_StartSoundNow (int entnum, int entchannel, sfx_t *sfx, vec3_t origin, float fvol, float attenuation)
 {
 	channel_t  *target_chan, *check;
 	sfxcache_t *sc;
@@ -492,6 +767,16 @@ unlock_mutex:
 }
 
 void S_StopSound (int entnum, int entchannel)
+{
+	sndcmd_t cmd;
+
+	cmd.type = SNDCMD_STOP;
+	cmd.entnum = entnum;
+	cmd.entchannel = entchannel;
+	S_QueueCommand (&cmd);
+}
+
+static void S_StopSoundNow (int entnum, int entchannel)
 {
 	int i;
 
@@ -522,7 +807,11 @@ void S_StopAllSounds (qboolean clear)
 	if (!sound_started)
 		goto unlock_mutex;
 
+	// what was queued before this is stopped too
+	S_RunCommands ();
+
 	total_channels = MAX_DYNAMIC_CHANNELS + NUM_AMBIENTS; // no statics
+	num_static_channels = 0;
 
 	for (i = 0; i < MAX_CHANNELS; i++)
 	{
@@ -579,32 +868,49 @@ S_StaticSound
 */
 void S_StaticSound (sfx_t *sfx, vec3_t origin, float vol, float attenuation)
 {
-	channel_t  *ss;
+	sndcmd_t    cmd;
 	sfxcache_t *sc;
 
 	if (!sfx)
 		return;
 
+	if (num_static_channels == MAX_CHANNELS - MAX_DYNAMIC_CHANNELS - NUM_AMBIENTS)
+	{
+		Con_Printf ("total_channels == MAX_CHANNELS\n");
+		return;
+	}
+	num_static_channels++;
+
+	// checked here, so the mixer thread doesn't have to print
+	sc = S_LoadSound (sfx);
+	sfx->lastused = ++snd_cache_clock;
+	if (sc && sc->loopstart == -1)
+		Con_Printf ("Sound %s not looped\n", sfx->name);
+
+	cmd.type = SNDCMD_STATIC;
+	cmd.sfx = sfx;
+	VectorCopy (origin, cmd.origin);
+	cmd.vol = vol;
+	cmd.attenuation = attenuation;
+	S_QueueCommand (&cmd);
+}
+
+static void S_StaticSoundNow (sfx_t *sfx, vec3_t origin, float vol, float attenuation)
+{
+	channel_t  *ss;
+	sfxcache_t *sc;
+
 	SDL_LockMutex (snd_mutex);
 
 	if (total_channels == MAX_CHANNELS)
-	{
-		Con_Printf ("total_channels == MAX_CHANNELS\n");
 		goto unlock_mutex;
-	}
 
 	ss = &snd_channels[total_channels];
 	total_channels++;
 
 	sc = S_LoadSound (sfx);
-	if (!sc)
-		goto unlock_mutex;
-
-	if (sc->loopstart == -1)
-	{
-		Con_Printf ("Sound %s not looped\n", sfx->name);
+	if (!sc || sc->loopstart == -1)
 		goto unlock_mutex;
-	}
 
 	ss->sfx = sfx;
 	VectorCopy (origin, ss->origin);
@@ -623,37 +929,34 @@ unlock_mutex:
 /*
 ===================
 S_UpdateAmbientSounds
+
+Fades the ambient levels towards the ones of the leaf origin is in.
+Returns false if the ambient channels should be left alone
 ===================
 */
-static void S_UpdateAmbientSounds (void)
+static qboolean S_UpdateAmbientSounds (vec3_t origin, float *ambient_levels)
 {
 	mleaf_t     *l;
 	int          ambient_channel;
-	channel_t   *chan;
 	static float vol, levels[NUM_AMBIENTS]; // Spike: fixing ambient levels not changing at high enough framerates due to integer precison.
 
-	SDL_LockMutex (snd_mutex);
-
 	// no ambients when disconnected
 	if (cls.state != ca_connected || cls.signon != SIGNONS)
-		goto unlock_mutex;
+		return false;
 	// calc ambient sound levels
 	if (!cl.worldmodel || cl.worldmodel->needload)
-		goto unlock_mutex;
+		return false;
 
-	l = Mod_PointInLeaf (listener_origin, cl.worldmodel);
+	l = Mod_PointInLeaf (origin, cl.worldmodel);
 	if (!l || !ambient_level.value)
 	{
 		for (ambient_channel = 0; ambient_channel < NUM_AMBIENTS; ambient_channel++)
-			snd_channels[ambient_channel].sfx = NULL;
-		goto unlock_mutex;
+			ambient_levels[ambient_channel] = -1;
+		return true;
 	}
 
 	for (ambient_channel = 0; ambient_channel < NUM_AMBIENTS; ambient_channel++)
 	{
-		chan = &snd_channels[ambient_channel];
-		chan->sfx = ambient_sfx[ambient_channel];
-
 		vol = (int)(ambient_level.value * l->ambient_sound_level[ambient_channel]);
 		if (vol < 8)
 			vol = 0;
@@ -665,18 +968,151 @@ static void S_UpdateAmbientSounds (void)
 			if (levels[ambient_channel] > vol)
 				levels[ambient_channel] = vol;
 		}
-		else if (chan->master_vol > vol)
+		else if ((int)levels[ambient_channel] > vol)
 		{
 			levels[ambient_channel] -= (host_frametime * ambient_fade.value);
 			if (levels[ambient_channel] < vol)
 				levels[ambient_channel] = vol;
 		}
 
-		chan->leftvol = chan->rightvol = chan->master_vol = levels[ambient_channel];
+		ambient_levels[ambient_channel] = levels[ambient_channel];
 	}
 
-unlock_mutex:
-	SDL_UnlockMutex (snd_mutex);
+	return true;
+}
+
+/*
+===================
+S_UpdateListener
+
+Applies a listener update from S_Update, with snd_mutex held
+===================
+*/
+static void S_UpdateListener (const sndcmd_t *cmd)
+{
+	int        ambient_channel;
+	channel_t *chan;
+
+	VectorCopy (cmd->origin, listener_origin);
+	VectorCopy (cmd->forward, listener_forward);
+	VectorCopy (cmd->right, listener_right);
+	VectorCopy (cmd->up, listener_up);
+	listener_viewentity = cmd->entnum;
+	snd_have_listener = true;
+
+	if (!cmd->ambients)
+		return;
+
+	for (ambient_channel = 0; ambient_channel < NUM_AMBIENTS; ambient_channel++)
+	{
+		chan = &snd_channels[ambient_channel];
+		if (cmd->ambient_levels[ambient_channel] < 0)
+		{
+			chan->sfx = NULL;
+			continue;
+		}
+		chan->sfx = ambient_sfx[ambient_channel];
+		chan->leftvol = chan->rightvol = chan->master_vol = cmd->ambient_levels[ambient_channel];
+	}
+}
+
+// resampler state carried across S_RawSamples calls, so the filter sees a continuous stream
+#define MAX_RAW_HISTORY 64 // taps of the largest filter
+
+static struct
+{
+	sndresampler_t resampler;
+	int            rate, outrate, quality;
+	int            numhistory;
+	float          history[2][MAX_RAW_HISTORY];
+	int64_t        num; // position of the next output, see S_ResampleRow
+} rawresample;
+
+/*
+===================
+S_RawSamplesResampled
+
+S_RawSamples through the polyphase resampler. Returns false if
+snd_resamplequality or the rates call for the nearest sample stepper
+===================
+*/
+static qboolean S_RawSamplesResampled (int samples, int rate, int width, int channels, byte *data, int intVolume)
+{
+	sndresampler_t *r = &rawresample.resampler;
+	const int       quality = (int)snd_resamplequality.value;
+	float          *inbuf, *outbuf;
+	float          *in[2], *out[2];
+	int             len, numout, consumed;
+	int             c, i, dst;
+
+	if ((channels != 1 && channels != 2) || (width != 1 && width != 2))
+		return false;
+
+	if (rawresample.rate != rate || rawresample.outrate != shm->speed || rawresample.quality != quality)
+	{
+		S_FreeResampler (r);
+		rawresample.rate = rate;
+		rawresample.outrate = shm->speed;
+		rawresample.quality = quality;
+		rawresample.num = 0;
+		if (!S_InitResampler (r, rate, shm->speed, quality))
+			return false;
+
+		// silence before the first sample, so it lands in the middle of the filter
+		rawresample.numhistory = r->taps / 2 - 1;
+		memset (rawresample.history, 0, sizeof (rawresample.history));
+	}
+	if (!r->kernels)
+		return false;
+
+	len = rawresample.numhistory + samples;
+	TEMP_ALLOC (float, inbuf, len * channels);
+	in[0] = inbuf;
+	in[1] = inbuf + len;
+
+	for (c = 0; c < channels; c++)
+	{
+		memcpy (in[c], rawresample.history[c], rawresample.numhistory * sizeof (float));
+		for (i = 0; i < samples; i++)
+		{
+			if (width == 2)
+				in[c][rawresample.numhistory + i] = ((short *)data)[i * channels + c];
+			else
+				in[c][rawresample.numhistory + i] = (((byte *)data)[i * channels + c] - 128) * 256;
+		}
+	}
+
+	// every output needs all of its taps
+	numout = 0;
+	if (len >= r->taps)
+		numout = (int)((((int64_t)(len - r->taps) + 1) * r->outrate - 1 - rawresample.num) / r->inrate) + 1;
+	numout = q_max (numout, 0);
+
+	TEMP_ALLOC (float, outbuf, q_max (numout, 1) * channels);
+	out[0] = outbuf;
+	out[1] = outbuf + numout;
+	for (c = 0; c < channels; c++)
+		S_ResampleRow (r, in[c], rawresample.num, numout, out[c]);
+
+	for (i = 0; i < numout; i++)
+	{
+		dst = s_rawend & (MAX_RAW_SAMPLES - 1);
+		s_rawend++;
+		s_rawsamples[dst].left = CLAMP (-32768, Q_rint (out[0][i]), 32767) * intVolume;
+		s_rawsamples[dst].right = CLAMP (-32768, Q_rint (out[channels - 1][i]), 32767) * intVolume;
+	}
+
+	// keep what the next outputs still need
+	rawresample.num += (int64_t)numout * r->inrate;
+	consumed = (int)(rawresample.num / r->outrate);
+	rawresample.num -= (int64_t)consumed * r->outrate;
+	rawresample.numhistory = len - consumed;
+	for (c = 0; c < channels; c++)
+		memcpy (rawresample.history[c], in[c] + consumed, rawresample.numhistory * sizeof (float));
+
+	TEMP_FREE (outbuf);
+	TEMP_FREE (inbuf);
+	return true;
 }
 
 /*
@@ -696,12 +1132,17 @@ void S_RawSamples (int samples, int rate, int width, int channels, byte *data, f
 	float scale;
 	int   intVolume;
 
+	SDL_LockMutex (snd_mutex);
+
 	if (s_rawend < paintedtime)
 		s_rawend = paintedtime;
 
 	scale = (float)rate / shm->speed;
 	intVolume = (int)(256 * volume);
 
+	if (S_RawSamplesResampled (samples, rate, width, channels, data, intVolume))
+		goto unlock_mutex;
+
 	if (channels == 2 && width == 2)
 	{
 		for (i = 0;; i++)
@@ -762,34 +1203,25 @@ void S_RawSamples (int samples, int rate, int width, int channels, byte *data, f
 			s_rawsamples[dst].right = (((byte *)data)[src] - 128) * intVolume;
 		}
 	}
+
+unlock_mutex:
+	SDL_UnlockMutex (snd_mutex);
 }
 
 /*
 ============
-S_Update
+S_SpatializeChannels
 
-Called once each time through the main loop
+Respatializes the static and dynamic channels, with snd_mutex held
 ============
 */
-void S_Update (vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
+static void S_SpatializeChannels (void)
 {
 	int        i, j;
 	int        total;
 	channel_t *ch;
 	channel_t *combine;
 
-	SDL_LockMutex (snd_mutex);
-	if (!sound_started || (snd_blocked > 0))
-		goto unlock_mutex;
-
-	VectorCopy (origin, listener_origin);
-	VectorCopy (forward, listener_forward);
-	VectorCopy (right, listener_right);
-	VectorCopy (up, listener_up);
-
-	// update general area ambient sound sources
-	S_UpdateAmbientSounds ();
-
 	combine = NULL;
 
 	// update spatialization for static and dynamic sounds
@@ -840,33 +1272,66 @@ void S_Update (vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
 		}
 	}
 
-	//
-	// debugging output
-	//
-	if (snd_show.value)
+	// for snd_show
+	total = 0;
+	ch = snd_channels;
+	for (i = 0; i < total_channels; i++, ch++)
 	{
-		total = 0;
-		ch = snd_channels;
-		for (i = 0; i < total_channels; i++, ch++)
+		if (ch->sfx && (ch->leftvol || ch->rightvol))
 		{
-			if (ch->sfx && (ch->leftvol || ch->rightvol))
-			{
-				//	Con_Printf ("%3i %3i %s\n", ch->leftvol, ch->rightvol, ch->sfx->name);
-				total++;
-			}
+			//	Con_Printf ("%3i %3i %s\n", ch->leftvol, ch->rightvol, ch->sfx->name);
+			total++;
 		}
-
-		Con_Printf ("----(%i)----\n", total);
 	}
+	Atomic_StoreUInt32 (&snd_active_channels, total);
+}
+
+/*
+============
+S_Update
+
+Called once each time through the main loop
+============
+*/
+void S_Update (vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
+{
+	sndcmd_t cmd;
+
+	if (!sound_started || (snd_blocked > 0))
+		return;
+
+	cmd.type = SNDCMD_UPDATE;
+	VectorCopy (origin, cmd.origin);
+	VectorCopy (forward, cmd.forward);
+	VectorCopy (right, cmd.right);
+	VectorCopy (up, cmd.up);
+	cmd.entnum = cl.viewentity;
+
+	// update general area ambient sound sources
+	VectorCopy (origin, play_origin);
+	cmd.ambients = S_UpdateAmbientSounds (origin, cmd.ambient_levels);
+
+	S_QueueCommand (&cmd);
+
+	S_TrimSoundCache ();
+
+	//
+	// debugging output
+	//
+	if (snd_show.value)
+		Con_Printf ("----(%i)----\n", Atomic_LoadUInt32 (&snd_active_channels));
 
 	// add raw data from streamed samples
 	//	BGM_Update();	// moved to the main loop just before S_Update ()
 
-	// mix some sound
-	S_Update_ ();
-
-unlock_mutex:
-	SDL_UnlockMutex (snd_mutex);
+	// mix some sound, unless the mixer thread does
+	if (!snd_mixer_thread)
+	{
+		SDL_LockMutex (snd_mutex);
+		S_SpatializeChannels ();
+		S_Update_ ();
+		SDL_UnlockMutex (snd_mutex);
+	}
 }
 
 static void GetSoundtime (void)
@@ -900,7 +1365,7 @@ static void GetSoundtime (void)
 
 void S_ExtraUpdate (void)
 {
-	if (snd_noextraupdate.value)
+	if (snd_noextraupdate.value || snd_mixer_thread)
 		return; // don't pollute timings
 	S_Update_ ();
 }
@@ -909,6 +1374,7 @@ static void S_Update_ (void)
 {
 	unsigned int endtime;
 	int          samps;
+	double       start;
 
 	if (!snd_initialized)
 		return;
@@ -930,6 +1396,7 @@ static void S_Update_ (void)
 	{
 		//	Con_Printf ("S_Update_ : overflow\n");
 		paintedtime = soundtime;
+		Atomic_IncrementUInt32 (&snd_underruns);
 	}
 
 	// mix ahead of current position
@@ -937,7 +1404,10 @@ static void S_Update_ (void)
 	samps = shm->samples >> (shm->channels - 1);
 	endtime = q_min (endtime, (unsigned int)(soundtime + samps));
 
+	start = Sys_DoubleTime ();
 	S_PaintChannels (endtime);
+	Atomic_StoreUInt32 (&snd_mix_usec, (uint32_t)((Sys_DoubleTime () - start) * 1000000.0));
+	Atomic_StoreUInt32 (&snd_latency, paintedtime - soundtime);
 
 	SNDDMA_Submit ();
 
@@ -985,18 +1455,89 @@ S_ClearAll
 */
 void S_ClearAll (void)
 {
+	S_PreloadDone (SDL_MUTEX_MAXWAIT);
+
 	SDL_LockMutex (snd_mutex);
+	S_RunCommands ();
 
 	for (int i = 0; i < num_sfx; ++i)
+		S_UnloadSound (&known_sfx[i]);
+
+	SDL_UnlockMutex (snd_mutex);
+}
+
+/*
+===============================================================================
+S_TrimSoundCache
+
+Evicts the least recently used sounds until the decoded samples fit in
+snd_cachesize again. Sounds that are playing, queued for the mixer or used
+by the ambient channels stay.
+===============================================================================
+*/
+typedef struct
+{
+	sfx_t       *sfx;
+	unsigned int lastused;
+} sndlru_t;
+
+static int S_CompareLRU (const void *a, const void *b)
+{
+	// compare ages rather than clock values, so a wrapped clock still sorts right
+	const unsigned int agea = snd_cache_clock - ((const sndlru_t *)a)->lastused;
+	const unsigned int ageb = snd_cache_clock - ((const sndlru_t *)b)->lastused;
+	return (agea < ageb) - (agea > ageb);
+}
+
+static void S_TrimSoundCache (void)
+{
+	const unsigned int budget = (unsigned int)q_max (snd_cachesize.value, 0.f) * 1024 * 1024;
+	int                i, num_lru;
+	uint32_t           tail, head;
+	byte              *pinned;
+	sndlru_t          *lru;
+
+	if (!budget || S_SoundCacheBytes () <= budget || !S_PreloadDone (0))
+		return;
+
+	TEMP_ALLOC (byte, pinned, num_sfx);
+	TEMP_ALLOC (sndlru_t, lru, num_sfx);
+	memset (pinned, 0, num_sfx);
+
+	SDL_LockMutex (snd_mutex);
+
+	for (i = 0; i < total_channels; i++)
+		if (snd_channels[i].sfx)
+			pinned[snd_channels[i].sfx - known_sfx] = true;
+	for (i = 0; i < NUM_AMBIENTS; i++)
+		if (ambient_sfx[i])
+			pinned[ambient_sfx[i] - known_sfx] = true;
+	head = Atomic_LoadUInt32 (&snd_queue_head);
+	for (tail = Atomic_LoadUInt32 (&snd_queue_tail); tail != head; tail++)
 	{
-		if (known_sfx[i].cache)
-		{
-			Mem_Free (known_sfx[i].cache);
-			known_sfx[i].cache = NULL;
-		}
+		const sndcmd_t *cmd = &snd_queue[tail & (SND_QUEUE_SIZE - 1)];
+		if (cmd->type == SNDCMD_START || cmd->type == SNDCMD_STATIC)
+			pinned[cmd->sfx - known_sfx] = true;
 	}
 
+	num_lru = 0;
+	for (i = 0; i < num_sfx; i++)
+	{
+		if (!known_sfx[i].cache || pinned[i])
+			continue;
+		lru[num_lru].sfx = &known_sfx[i];
+		lru[num_lru].lastused = known_sfx[i].lastused;
+		num_lru++;
+	}
+	qsort (lru, num_lru, sizeof (sndlru_t), S_CompareLRU);
+
+	for (i = 0; i < num_lru && S_SoundCacheBytes () > budget; i++)
+		S_UnloadSound (lru[i].sfx);
+
 	SDL_UnlockMutex (snd_mutex);
+
+	TEMP_FREE (lru);
+	TEMP_FREE (pinned);
 }
 
 /*
@@ -1023,7 +1564,7 @@ static void S_Play (void)
 			q_strlcat (name, ".wav", sizeof (name));
 		}
 		sfx = S_PrecacheSound (name);
-		S_StartSound (hash++, 0, sfx, listener_origin, 1.0, 1.0);
+		S_StartSound (hash++, 0, sfx, play_origin, 1.0, 1.0);
 		i++;
 	}
 }
@@ -1046,7 +1587,7 @@ static void S_PlayVol (void)
 		}
 		sfx = S_PrecacheSound (name);
 		vol = atof (Cmd_Argv (i + 1));
-		S_StartSound (hash++, 0, sfx, listener_origin, vol, 1.0);
+		S_StartSound (hash++, 0, sfx, play_origin, vol, 1.0);
 		i += 2;
 	}
 }
@@ -1064,42 +1605,98 @@ static void S_SoundList (void)
 		sc = (sfxcache_t *)sfx->cache;
 		if (!sc)
 			continue;
-		size = sc->length * sc->width * (sc->stereo + 1);
+		size = sc->memsize;
 		total += size;
-		if (sc->loopstart >= 0)
+		if (sc->stream)
+			Con_SafePrintf ("S");
+		else if (sc->loopstart >= 0)
 			Con_SafePrintf ("L"); // johnfitz -- was Con_Printf
 		else
 			Con_SafePrintf (" ");                                             // johnfitz -- was Con_Printf
 		Con_SafePrintf ("(%2db) %6i : %s\n", sc->width * 8, size, sfx->name); // johnfitz -- was Con_Printf
 	}
 	Con_Printf ("%i sounds, %i bytes\n", num_sfx, total); // johnfitz -- added count
+	if (snd_cachesize.value > 0)
+		Con_Printf ("cache budget %i bytes\n", (int)snd_cachesize.value * 1024 * 1024);
 }
 
 void S_LocalSound (const char *name)
 {
 	sfx_t *sfx;
 
-	SDL_LockMutex (snd_mutex);
-
 	if (nosound.value)
-		goto unlock_mutex;
+		return;
 	if (!sound_started)
-		goto unlock_mutex;
+		return;
 
 	sfx = S_PrecacheSound (name);
 	if (!sfx)
 	{
 		Con_Printf ("S_LocalSound: can't cache %s\n", name);
-		goto unlock_mutex;
+		return;
 	}
 	S_StartSound (cl.viewentity, -1, sfx, vec3_origin, 1, 1);
-
-unlock_mutex:
-	SDL_UnlockMutex (snd_mutex);
 }
 
 void S_ClearPrecache (void) {}
 
-void S_BeginPrecaching (void) {}
+/*
+==================
+S_PreloadSound
+==================
+*/
+static void S_PreloadSound (int index, void *unused)
+{
+	if (preload_data[index])
+		S_DecodeSound (preload_sfx[index], preload_data[index], preload_size[index]);
+}
+
+/*
+==================
+S_PreloadDone
+
+Waits up to timeout ms for the preload tasks, returns true once they finished
+==================
+*/
+static qboolean S_PreloadDone (uint32_t timeout)
+{
+	if (preload_running && !Task_Join (preload_task, timeout))
+		return false;
+	preload_running = false;
+	return true;
+}
+
+/*
+==================
+S_BeginPrecaching
+
+Sounds precached until S_EndPrecaching are loaded on the workers instead
+of one after the other on the main thread.
+==================
+*/
+void S_BeginPrecaching (void)
+{
+	S_PreloadDone (SDL_MUTEX_MAXWAIT);
+	num_preload_sfx = 0;
+	preload_collecting = sound_started && !nosound.value;
+}
+
+/*
+==================
+S_EndPrecaching
+
+The files are read here, only decoding and resampling go to the workers
+==================
+*/
+void S_EndPrecaching (void)
+{
+	int i;
 
-void S_EndPrecaching (void) {}
+	preload_collecting = false;
+	if (!num_preload_sfx)
+		return;
+	for (i = 0; i < num_preload_sfx; i++)
+		preload_data[i] = preload_sfx[i]->cache ? NULL : S_LoadSoundFile (preload_sfx[i], &preload_size[i]);
+	preload_running = true;
+	preload_task = Task_AllocateAssignIndexedFuncAndSubmit (S_PreloadSound, num_preload_sfx, NULL, 0);
+}
@@ -24,48 +24,71 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 extern SDL_mutex *snd_mutex;
 
+// looped sounds longer than snd_streamlength seconds keep the file in memory
+// and are resampled SND_STREAM_CHUNK samples at a time while they play. The
+// chunks start at multiples of SND_STREAM_CHUNK, and the last few used are
+// kept, so channels playing the same sound at different spots don't evict
+// each other's
+#define SND_STREAM_CHUNK 16384
+#define SND_STREAM_SLOTS 4
+
+typedef struct
+{
+	int   chunk; // pos / SND_STREAM_CHUNK of the samples held, -1 if none
+	int   lastuse;
+	byte *data;
+} sndstreamslot_t;
+
+typedef struct sndstream_s
+{
+	byte           *file; // the whole wav file
+	byte           *data; // first sample in file
+	int             inwidth;
+	int             insamples;
+	int             inloopstart;
+	float           stepscale;
+	sndresampler_t  resampler;
+	int             usecount;
+	sndstreamslot_t slots[SND_STREAM_SLOTS];
+} sndstream_t;
+
+static atomic_uint32_t snd_cache_bytes;
+
 /*
 ================
-ResampleSfx
+ResampleSfxData
+
+Resamples count output samples starting at first, with the polyphase
+resampler if snd_resamplequality set one up, else by picking the nearest
+sample. The resampler's taps past the end wrap to inloopstart
 ================
 */
-static void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, byte *data)
+static void ResampleSfxData (
+	byte *out, int outwidth, const byte *data, int inwidth, int insamples, int inloopstart, float stepscale, const sndresampler_t *resampler, int first,
+	int count)
 {
-	int         outcount;
-	int         srcsample;
-	float       stepscale;
-	int         i;
-	int         sample, samplefrac, fracstep;
-	sfxcache_t *sc = sfx->cache;
-
-	stepscale = (float)inrate / shm->speed; // this is usually 0.5, 1, or 2
-
-	outcount = sc->length / stepscale;
-	sc->length = outcount;
-	if (sc->loopstart != -1)
-		sc->loopstart = sc->loopstart / stepscale;
+	int srcsample;
+	int i;
+	int sample, samplefrac, fracstep;
 
-	sc->speed = shm->speed;
-	if (loadas8bit.value)
-		sc->width = 1;
-	else
-		sc->width = inwidth;
-	sc->stereo = 0;
-
-	// resample / decimate to the current source rate
+	if (resampler->kernels)
+	{
+		S_ResampleSamples (resampler, data, inwidth, insamples, inloopstart, out, outwidth, first, count);
+		return;
+	}
 
-	if (stepscale == 1 && inwidth == 1 && sc->width == 1)
+	if (stepscale == 1 && inwidth == 1 && outwidth == 1)
 	{
 		// fast special case
-		for (i = 0; i < outcount; i++)
-			((signed char *)sc->data)[i] = (int)((unsigned char)(data[i]) - 128);
+		for (i = 0; i < count; i++)
+			((signed char *)out)[i] = (int)((unsigned char)(data[first + i]) - 128);
 	}
 	else
 	{
 		// general case
-		samplefrac = 0;
 		fracstep = stepscale * 256;
-		for (i = 0; i < outcount; i++)
+		samplefrac = first * fracstep;
+		for (i = 0; i < count; i++)
 		{
 			srcsample = samplefrac >> 8;
 			samplefrac += fracstep;
@@ -73,39 +96,73 @@ static void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, byte *data)
 				sample = LittleShort (((short *)data)[srcsample]);
 			else
 				sample = (unsigned int)((unsigned char)(data[srcsample]) - 128) << 8;
-			if (sc->width == 2)
-				((short *)sc->data)[i] = sample;
+			if (outwidth == 2)
+				((short *)out)[i] = sample;
 			else
-				((signed char *)sc->data)[i] = sample >> 8;
+				((signed char *)out)[i] = sample >> 8;
 		}
 	}
 }
 
-//=============================================================================
-
 /*
-==============
-S_LoadSound
-==============
+================
+ResampleSfx
+================
 */
-sfxcache_t *S_LoadSound (sfx_t *s)
+static void ResampleSfx (sfxcache_t *sc, int inrate, int inwidth, byte *data)
 {
-	char        namebuffer[256];
-	byte       *data = NULL;
-	wavinfo_t   info;
-	int         len;
-	float       stepscale;
-	sfxcache_t *sc = NULL;
+	int            outcount, insamples, inloopstart;
+	float          stepscale;
+	sndresampler_t resampler;
 
-	SDL_LockMutex (snd_mutex);
+	stepscale = (float)inrate / shm->speed; // this is usually 0.5, 1, or 2
 
-	// see if still in memory
-	if (s->cache)
+	insamples = sc->length;
+	inloopstart = sc->loopstart;
+	outcount = sc->length / stepscale;
+	sc->length = outcount;
+	if (sc->loopstart != -1)
+		sc->loopstart = sc->loopstart / stepscale;
+
+	sc->speed = shm->speed;
+	if (loadas8bit.value)
+		sc->width = 1;
+	else
+		sc->width = inwidth;
+	sc->stereo = 0;
+
+	// resample / decimate to the current source rate
+	if (sc->stream)
 	{
-		sc = s->cache;
-		goto unlock_mutex;
+		// filled in by S_StreamSound
+		sc->stream->inwidth = inwidth;
+		sc->stream->insamples = insamples;
+		sc->stream->inloopstart = inloopstart;
+		sc->stream->stepscale = stepscale;
+		sc->stream->data = data;
+		S_InitResampler (&sc->stream->resampler, inrate, shm->speed, (int)snd_resamplequality.value);
+		return;
 	}
 
+	S_InitResampler (&resampler, inrate, shm->speed, (int)snd_resamplequality.value);
+	ResampleSfxData (sc->data, sc->width, data, inwidth, insamples, inloopstart, stepscale, &resampler, 0, outcount);
+	S_FreeResampler (&resampler);
+}
+
+//=============================================================================
+
+/*
+==============
+S_LoadSoundFile
+
+Main thread only, the file system isn't thread safe
+==============
+*/
+byte *S_LoadSoundFile (sfx_t *s, int *filesize)
+{
+	char  namebuffer[256];
+	byte *data;
+
 	//	Con_Printf ("S_LoadSound: %x\n", (int)stackbuf);
 
 	// load it in
@@ -115,55 +172,288 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	//	Con_Printf ("loading %s\n",namebuffer);
 
 	data = COM_LoadFile (namebuffer, NULL);
+	*filesize = com_filesize;
 
 	if (!data)
-	{
 		Con_Printf ("Couldn't load %s\n", namebuffer);
-		goto unlock_mutex;
-	}
+	return data;
+}
+
+/*
+==============
+S_LoadSound
+==============
+*/
+sfxcache_t *S_LoadSound (sfx_t *s)
+{
+	byte *data;
+	int   filesize;
 
-	info = GetWavinfo (s->name, data, com_filesize);
+	// see if still in memory
+	if (s->cache)
+		return s->cache;
+
+	data = S_LoadSoundFile (s, &filesize);
+	if (!data)
+		return NULL;
+	return S_DecodeSound (s, data, filesize);
+}
+
+/*
+==============
+S_DecodeSound
+
+Takes over data from S_LoadSoundFile. Safe on any thread: the sound is decoded
+without snd_mutex held, so the mixer thread keeps running meanwhile; the lock
+only covers publishing the cache.
+==============
+*/
+sfxcache_t *S_DecodeSound (sfx_t *s, byte *data, int filesize)
+{
+	wavinfo_t   info;
+	int         len;
+	float       stepscale;
+	sfxcache_t *sc = NULL;
+
+	info = GetWavinfo (s->name, data, filesize);
 	if (info.channels != 1)
 	{
 		Con_Printf ("%s is a stereo sample\n", s->name);
-		goto unlock_mutex;
+		goto done;
 	}
 
 	if (info.width != 1 && info.width != 2)
 	{
 		Con_Printf ("%s is not 8 or 16 bit\n", s->name);
-		goto unlock_mutex;
+		goto done;
 	}
 
 	stepscale = (float)info.rate / shm->speed;
 	len = info.samples / stepscale;
 
-	len = len * info.width * info.channels;
-
 	if (info.samples == 0 || len == 0)
 	{
 		Con_Printf ("%s has zero samples\n", s->name);
-		goto unlock_mutex;
+		goto done;
 	}
 
-	sc = (sfxcache_t *)Mem_Alloc (len + sizeof (sfxcache_t));
-	if (!sc)
-		goto unlock_mutex;
+	if (info.loopstart >= 0 && snd_streamlength.value > 0 && len > SND_STREAM_CHUNK && len > snd_streamlength.value * shm->speed)
+	{
+		int i;
+
+		sc = (sfxcache_t *)Mem_Alloc (sizeof (sfxcache_t));
+		sc->stream = (sndstream_t *)Mem_Alloc (sizeof (sndstream_t) + SND_STREAM_SLOTS * SND_STREAM_CHUNK * info.width);
+		sc->stream->file = data;
+		for (i = 0; i < SND_STREAM_SLOTS; i++)
+		{
+			sc->stream->slots[i].chunk = -1;
+			sc->stream->slots[i].data = (byte *)(sc->stream + 1) + i * SND_STREAM_CHUNK * info.width;
+		}
+		sc->memsize = sizeof (sfxcache_t) + sizeof (sndstream_t) + SND_STREAM_SLOTS * SND_STREAM_CHUNK * info.width + filesize;
+		data = NULL; // kept by the stream
+	}
+	else
+	{
+		len = len * info.width * info.channels;
+		sc = (sfxcache_t *)Mem_Alloc (len + sizeof (sfxcache_t));
+		sc->memsize = len + sizeof (sfxcache_t);
+	}
 	sc->length = info.samples;
 	sc->loopstart = info.loopstart;
 	sc->speed = info.rate;
 	sc->width = info.width;
 	sc->stereo = info.channels;
 
-	s->cache = sc;
-	ResampleSfx (s, sc->speed, sc->width, data + info.dataofs);
+	ResampleSfx (sc, sc->speed, sc->width, (sc->stream ? sc->stream->file : data) + info.dataofs);
+	if (sc->stream)
+		sc->memsize += sc->stream->resampler.phases * sc->stream->resampler.taps * sizeof (float);
 
-unlock_mutex:
-	Mem_Free (data);
+	SDL_LockMutex (snd_mutex);
+	if (s->cache)
+	{
+		// loaded by the other thread in the meantime
+		S_FreeSfxCache (sc);
+		sc = s->cache;
+	}
+	else
+	{
+		s->cache = sc;
+		Atomic_AddUInt32 (&snd_cache_bytes, sc->memsize);
+	}
 	SDL_UnlockMutex (snd_mutex);
+
+done:
+	Mem_Free (data);
 	return sc;
 }
 
+/*
+==============
+S_FreeSfxCache
+==============
+*/
+void S_FreeSfxCache (sfxcache_t *sc)
+{
+	if (sc->stream)
+	{
+		S_FreeResampler (&sc->stream->resampler);
+		Mem_Free (sc->stream->file);
+		Mem_Free (sc->stream);
+	}
+	Mem_Free (sc);
+}
+
+/*
+==============
+S_UnloadSound
+
+Drops the decoded samples of a sound, with snd_mutex held. The caller
+makes sure no channel is still playing it
+==============
+*/
+void S_UnloadSound (sfx_t *s)
+{
+	if (!s->cache)
+		return;
+
+	Atomic_AddUInt32 (&snd_cache_bytes, -(uint32_t)s->cache->memsize);
+	S_FreeSfxCache (s->cache);
+	s->cache = NULL;
+}
+
+/*
+==============
+S_SoundCacheBytes
+==============
+*/
+unsigned int S_SoundCacheBytes (void)
+{
+	return Atomic_LoadUInt32 (&snd_cache_bytes);
+}
+
+/*
+==============
+S_StreamSound
+
+Returns the samples of a streamed sound from pos on, resampling the chunk
+they are in if it isn't held yet, with snd_mutex held. Lowers count to how
+many of them can be painted
+==============
+*/
+const byte *S_StreamSound (sfxcache_t *sc, int pos, int *count)
+{
+	sndstream_t     *stream = sc->stream;
+	const int        chunk = pos / SND_STREAM_CHUNK;
+	const int        first = chunk * SND_STREAM_CHUNK;
+	const int        last = q_min (first + SND_STREAM_CHUNK, sc->length);
+	sndstreamslot_t *slot = &stream->slots[0];
+	int              i;
+
+	for (i = 0; i < SND_STREAM_SLOTS; i++)
+	{
+		if (stream->slots[i].chunk == chunk)
+		{
+			slot = &stream->slots[i];
+			break;
+		}
+		if (stream->slots[i].lastuse < slot->lastuse)
+			slot = &stream->slots[i];
+	}
+
+	if (slot->chunk != chunk)
+	{
+		// evicts the least recently used chunk
+		slot->chunk = chunk;
+		ResampleSfxData (
+			slot->data, sc->width, stream->data, stream->inwidth, stream->insamples, stream->inloopstart, stream->stepscale, &stream->resampler, first,
+			last - first);
+	}
+	slot->lastuse = ++stream->usecount;
+
+	*count = q_min (*count, last - pos);
+	return slot->data + (pos - first) * sc->width;
+}
+
+/*
+==============
+SND_ResampleBenchmark_f
+
+snd_resamplebench [sounds]: converts sounds (default 64) synthetic one second
+samples at 11025 and 22050 Hz, 8 and 16 bit, to the output rate at every
+snd_resamplequality, with the scalar and the SIMD dot products. Reports the
+time and throughput of each, and whether both paths give the same samples.
+The choice is made on the benchmark's own resamplers, use_simd is left alone
+since the mixer thread and the sound loading tasks go by it.
+==============
+*/
+void SND_ResampleBenchmark_f (void)
+{
+	const int      outrate = shm ? shm->speed : 44100;
+	const qboolean saved_use_simd = use_simd;
+	int            numsounds, quality, mode, i, j, seed;
+	int            inrate, inwidth;
+	byte          *in, *out;
+	uint32_t       hash, hashes[2];
+	sndresampler_t resamplers[2];
+	double         start, elapsed;
+	int64_t        numout;
+
+	numsounds = (Cmd_Argc () > 1) ? atoi (Cmd_Argv (1)) : 64;
+	numsounds = q_max (numsounds, 1);
+
+	// one second of 16 bit samples at 22050 Hz is enough room for every source
+	in = (byte *)Mem_Alloc (22050 * 2);
+	out = (byte *)Mem_Alloc ((outrate + 1) * 2);
+	seed = 1;
+	for (i = 0; i < 22050; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		((short *)in)[i] = (short)(seed >> 8);
+	}
+
+	for (quality = 0; quality <= 3; quality++)
+	{
+		S_InitResampler (&resamplers[0], 11025, outrate, quality);
+		S_InitResampler (&resamplers[1], 22050, outrate, quality);
+
+		for (mode = 0; mode < 2; mode++)
+		{
+			if (mode == 1 && (!quality || !saved_use_simd))
+				break;
+			resamplers[0].simd = resamplers[1].simd = (mode == 1);
+
+			hash = 2166136261u;
+			numout = 0;
+			elapsed = 0.0;
+			for (i = 0; i < numsounds; i++)
+			{
+				inrate = (i & 1) ? 22050 : 11025;
+				inwidth = (i & 2) ? 2 : 1;
+				start = Sys_DoubleTime ();
+				ResampleSfxData (out, inwidth, in, inwidth, inrate, -1, (float)inrate / outrate, &resamplers[i & 1], 0, outrate);
+				elapsed += Sys_DoubleTime () - start;
+				for (j = 0; j < outrate * inwidth; j++)
+					hash = (hash ^ out[j]) * 16777619u;
+				numout += outrate;
+			}
+			hashes[mode] = hash;
+
+			Con_Printf (
+				"quality %i (%2i taps) %s: %8.2f ms, %7.1f Msamples/s\n", quality, quality ? resamplers[0].taps : 1, mode ? "simd  " : "scalar",
+				elapsed * 1000.0, numout / q_max (elapsed, 1e-9) / 1000000.0);
+		}
+
+		if (mode == 2)
+			Con_Printf ("quality %i results %s\n", quality, (hashes[0] != hashes[1]) ? "DIFFER" : "match");
+
+		S_FreeResampler (&resamplers[0]);
+		S_FreeResampler (&resamplers[1]);
+	}
+
+	Mem_Free (out);
+	Mem_Free (in);
+}
+
 /*
 ===============================================================================
 
@@ -172,11 +462,11 @@ WAV loading
 ===============================================================================
 */
 
-static byte *data_p;
-static byte *iff_end;
-static byte *last_chunk;
-static byte *iff_data;
-static int   iff_chunk_len;
+static THREAD_LOCAL byte *data_p;
+static THREAD_LOCAL byte *iff_end;
+static THREAD_LOCAL byte *last_chunk;
+static THREAD_LOCAL byte *iff_data;
+static THREAD_LOCAL int   iff_chunk_len;
 
 static short GetLittleShort (void)
 {
@@ -23,6 +23,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "quakedef.h"
 
+extern SDL_mutex *snd_mutex;
+
 #define PAINTBUFFER_SIZE 2048
 portable_samplepair_t paintbuffer[PAINTBUFFER_SIZE];
 int                   snd_scaletable[32][256];
@@ -31,12 +33,68 @@ short                *snd_out;
 
 static int snd_vol;
 
+#ifdef USE_SSE2
+/*
+==============
+SND_MulLo32
+
+Low 32 bits of a 32x32 bit multiply, which SSE2 lacks (pmulld is SSE4.1)
+==============
+*/
+static inline __m128i SND_MulLo32 (__m128i a, __m128i b)
+{
+	const __m128i even = _mm_mul_epu32 (a, b);
+	const __m128i odd = _mm_mul_epu32 (_mm_srli_epi64 (a, 32), _mm_srli_epi64 (b, 32));
+	return _mm_unpacklo_epi32 (_mm_shuffle_epi32 (even, _MM_SHUFFLE (0, 0, 2, 0)), _mm_shuffle_epi32 (odd, _MM_SHUFFLE (0, 0, 2, 0)));
+}
+
+/*
+==============
+SND_DivPow2
+
+Signed division by 1 << shift, rounding towards zero like C does
+==============
+*/
+static inline __m128i SND_DivPow2 (__m128i v, int shift)
+{
+	const __m128i bias = _mm_srli_epi32 (_mm_srai_epi32 (v, 31), 32 - shift);
+	return _mm_srai_epi32 (_mm_add_epi32 (v, bias), shift);
+}
+
+/*
+==============
+SND_AddSamplePairs
+
+Adds 4 left and 4 right samples to 4 consecutive paintbuffer pairs
+==============
+*/
+static inline void SND_AddSamplePairs (portable_samplepair_t *out, __m128i left, __m128i right)
+{
+	__m128i *p = (__m128i *)out;
+	_mm_storeu_si128 (p, _mm_add_epi32 (_mm_loadu_si128 (p), _mm_unpacklo_epi32 (left, right)));
+	_mm_storeu_si128 (p + 1, _mm_add_epi32 (_mm_loadu_si128 (p + 1), _mm_unpackhi_epi32 (left, right)));
+}
+#endif // def USE_SSE2
+
 static void Snd_WriteLinearBlastStereo16 (void)
 {
-	int i;
+	int i = 0;
 	int val;
 
-	for (i = 0; i < snd_linear_count; i += 2)
+#ifdef USE_SSE2
+	// packs saturates exactly like the clamp below
+	if (use_simd)
+	{
+		for (; i + 8 <= snd_linear_count; i += 8)
+		{
+			const __m128i lo = SND_DivPow2 (_mm_loadu_si128 ((const __m128i *)(snd_p + i)), 8);
+			const __m128i hi = SND_DivPow2 (_mm_loadu_si128 ((const __m128i *)(snd_p + i + 4)), 8);
+			_mm_storeu_si128 ((__m128i *)(snd_out + i), _mm_packs_epi32 (lo, hi));
+		}
+	}
+#endif // def USE_SSE2
+
+	for (; i < snd_linear_count; i += 2)
 	{
 		val = snd_p[i] / 256;
 		if (val > SHRT_MAX)
@@ -197,6 +255,7 @@ typedef struct
 {
 	float *memory;     // kernelsize floats
 	float *kernel;     // kernelsize floats
+	float *phases;     // kernel[j + 4 * n] at phases[j * kernelsize / 4 + n], for the SIMD path
 	int    kernelsize; // M+1, rounded up to be a multiple of 16
 	int    M;          // M value used to make kernel, even
 	int    parity;     // 0-3
@@ -205,12 +264,16 @@ typedef struct
 
 static void S_UpdateFilter (filter_t *filter, int M, float f_c)
 {
+	int i;
+
 	if (filter->f_c != f_c || filter->M != M)
 	{
 		if (filter->memory != NULL)
 			Mem_Free (filter->memory);
 		if (filter->kernel != NULL)
 			Mem_Free (filter->kernel);
+		if (filter->phases != NULL)
+			Mem_Free (filter->phases);
 
 		filter->M = M;
 		filter->f_c = f_c;
@@ -220,10 +283,237 @@ static void S_UpdateFilter (filter_t *filter, int M, float f_c)
 		filter->kernelsize = (M + 1) + 16 - ((M + 1) % 16);
 		filter->memory = (float *)Mem_Alloc (filter->kernelsize * sizeof (float));
 		filter->kernel = (float *)Mem_Alloc (filter->kernelsize * sizeof (float));
+		filter->phases = (float *)Mem_Alloc (filter->kernelsize * sizeof (float));
 
 		S_MakeBlackmanWindowKernel (filter->kernel, M, f_c);
+
+		for (i = 0; i < filter->kernelsize; i++)
+			filter->phases[(i % 4) * (filter->kernelsize / 4) + i / 4] = filter->kernel[i];
+	}
+}
+
+#define SND_RESAMPLE_PHASES 128
+
+/*
+==============
+S_InitResampler
+
+Builds the polyphase filter bank for converting inrate to outrate. A single
+Blackman windowed sinc is made at SND_RESAMPLE_PHASES times the input rate,
+and every phase takes every SND_RESAMPLE_PHASES-th point of it, starting at
+its own fractional offset. Each phase is normalized for unity gain.
+
+quality 1, 2 and 3 use 16, 32 and 64 taps. Returns false for quality 0 or
+matching rates, in which case the caller steps through the samples as before.
+==============
+*/
+qboolean S_InitResampler (sndresampler_t *r, int inrate, int outrate, int quality)
+{
+	float *prototype;
+	float  f_c, sum;
+	int    M, phase, k;
+
+	memset (r, 0, sizeof (*r));
+	if (quality <= 0 || inrate <= 0 || outrate <= 0 || inrate == outrate)
+		return false;
+
+	r->inrate = inrate;
+	r->outrate = outrate;
+	r->taps = 8 << q_min (quality, 3);
+	r->phases = SND_RESAMPLE_PHASES;
+	r->simd = use_simd;
+
+	// pass up to 90% of the lower of the two nyquist frequencies
+	f_c = 0.45f * q_min (1.f, (float)outrate / inrate) / r->phases;
+	M = r->taps * r->phases;
+	prototype = (float *)Mem_Alloc ((M + 1) * sizeof (float));
+	S_MakeBlackmanWindowKernel (prototype, M, f_c);
+
+	r->kernels = (float *)Mem_Alloc (r->phases * r->taps * sizeof (float));
+	for (phase = 0; phase < r->phases; phase++)
+	{
+		float *kernel = r->kernels + phase * r->taps;
+
+		// tap k reads input sample base - taps/2 + 1 + k for output position base + phase/phases
+		sum = 0;
+		for (k = 0; k < r->taps; k++)
+		{
+			kernel[k] = prototype[(k + 1) * r->phases - phase];
+			sum += kernel[k];
+		}
+		for (k = 0; k < r->taps; k++)
+			kernel[k] /= sum;
+	}
+
+	Mem_Free (prototype);
+	return true;
+}
+
+/*
+==============
+S_FreeResampler
+==============
+*/
+void S_FreeResampler (sndresampler_t *r)
+{
+	SAFE_FREE (r->kernels);
+}
+
+/*
+==============
+S_ResampleDot
+
+Both paths keep 4 partial sums and add them up in the same order, so they
+give the same result
+==============
+*/
+static inline float S_ResampleDot (const float *in, const float *kernel, int taps, qboolean simd)
+{
+	float sum[4] = {0, 0, 0, 0};
+	int   k;
+
+#ifdef USE_SSE2
+	if (simd)
+	{
+		__m128 acc = _mm_setzero_ps ();
+		for (k = 0; k < taps; k += 4)
+			acc = _mm_add_ps (acc, _mm_mul_ps (_mm_loadu_ps (in + k), _mm_loadu_ps (kernel + k)));
+		acc = _mm_add_ps (acc, _mm_movehl_ps (acc, acc));
+		acc = _mm_add_ss (acc, _mm_shuffle_ps (acc, acc, _MM_SHUFFLE (1, 1, 1, 1)));
+		return _mm_cvtss_f32 (acc);
+	}
+#endif // def USE_SSE2
+
+	for (k = 0; k < taps; k += 4)
+	{
+		sum[0] += in[k + 0] * kernel[k + 0];
+		sum[1] += in[k + 1] * kernel[k + 1];
+		sum[2] += in[k + 2] * kernel[k + 2];
+		sum[3] += in[k + 3] * kernel[k + 3];
+	}
+	return (sum[0] + sum[2]) + (sum[1] + sum[3]);
+}
+
+/*
+==============
+S_ResampleRow
+
+Writes count output samples. The first one is at input position num / outrate,
+relative to in, and in[num / outrate] is its first tap
+==============
+*/
+void S_ResampleRow (const sndresampler_t *r, const float *in, int64_t num, int count, float *out)
+{
+	int i;
+
+	for (i = 0; i < count; i++, num += r->inrate)
+	{
+		const int64_t base = num / r->outrate;
+		const int     phase = (int)((num % r->outrate) * r->phases / r->outrate);
+		out[i] = S_ResampleDot (in + base, r->kernels + phase * r->taps, r->taps, r->simd);
+	}
+}
+
+/*
+==============
+S_ResampleSamples
+
+Resamples output samples first to first + count - 1 of a mono sound with
+insamples samples, reading silence before the start, and past the end too
+unless the sound loops back to input sample loopstart
+==============
+*/
+void S_ResampleSamples (
+	const sndresampler_t *r, const byte *data, int inwidth, int insamples, int loopstart, byte *out, int outwidth, int first, int count)
+{
+	const int64_t firstnum = (int64_t)first * r->inrate;
+	const int64_t lo = firstnum / r->outrate - r->taps / 2 + 1;
+	const int64_t hi = ((int64_t)(first + count - 1) * r->inrate) / r->outrate - r->taps / 2 + 1 + r->taps;
+	float        *in, *resampled;
+	int64_t       src, s;
+	int           i, sample;
+
+	if (count <= 0)
+		return;
+
+	TEMP_ALLOC (float, in, hi - lo);
+	TEMP_ALLOC (float, resampled, count);
+
+	for (src = lo; src < hi; src++)
+	{
+		s = src;
+		if (s >= insamples && loopstart >= 0 && loopstart < insamples)
+			s = loopstart + (s - insamples) % (insamples - loopstart);
+		if (s < 0 || s >= insamples)
+			in[src - lo] = 0;
+		else if (inwidth == 2)
+			in[src - lo] = LittleShort (((const short *)data)[s]);
+		else
+			in[src - lo] = (data[s] - 128) * 256;
+	}
+
+	S_ResampleRow (r, in, firstnum - (lo + r->taps / 2 - 1) * r->outrate, count, resampled);
+
+	for (i = 0; i < count; i++)
+	{
+		sample = CLAMP (-32768, Q_rint (resampled[i]), 32767);
+		if (outwidth == 2)
+			((short *)out)[i] = sample;
+		else
+			((signed char *)out)[i] = sample >> 8;
+	}
+
+	TEMP_FREE (resampled);
+	TEMP_FREE (in);
+}
+
+#ifdef USE_SSE2
+/*
+==============
+S_ApplyFilterSSE2
+
+Same convolution as the scalar loop in S_ApplyFilter. Every tap reads an
+input sample at the same position modulo 4, so with the input and the
+kernel split into 4 phases the 4 partial sums are contiguous loads. The
+sums are added in the same order, so the result is bit exact.
+==============
+*/
+static void S_ApplyFilterSSE2 (filter_t *filter, const float *input, int *data, int stride, int count)
+{
+	const int kernelsize = filter->kernelsize;
+	const int phasesize = kernelsize / 4;
+	const int first = (4 - filter->parity) % 4;
+	const int numdecimated = (kernelsize + count - first + 3) / 4;
+	int       parity = filter->parity;
+	int       i, m;
+	float    *decimated;
+
+	TEMP_ALLOC (float, decimated, numdecimated);
+	for (i = 0; i < numdecimated; i++)
+		decimated[i] = input[first + 4 * i];
+
+	for (i = 0; i < count; i++)
+	{
+		const int    j = (4 - parity) % 4;
+		const float *kernel = filter->phases + j * phasesize;
+		const float *in = decimated + (i + j - first) / 4;
+		__m128       acc = _mm_setzero_ps ();
+		float        val[4];
+
+		for (m = 0; m < phasesize; m += 4)
+			acc = _mm_add_ps (acc, _mm_mul_ps (_mm_loadu_ps (kernel + m), _mm_loadu_ps (in + m)));
+		_mm_storeu_ps (val, acc);
+
+		data[i * stride] = (val[0] + val[1] + val[2] + val[3]) * (32768.0 * 256.0 * 4.0);
+
+		parity = (parity + 1) % 4;
 	}
+
+	filter->parity = parity;
+
+	TEMP_FREE (decimated);
 }
+#endif // def USE_SSE2
 
 /*
 ==============
@@ -237,7 +527,7 @@ kernel is 4x faster, because we can skip 3/4 of the input samples that are
 known to be 0 and skip 3/4 of the filter kernel.
 ==============
 */
-static void S_ApplyFilter (filter_t *filter, int *data, int stride, int count)
+static void S_ApplyFilter (filter_t *filter, int *data, int stride, int count, qboolean simd)
 {
 	int          i, j;
 	float       *input;
@@ -260,6 +550,15 @@ static void S_ApplyFilter (filter_t *filter, int *data, int stride, int count)
 	memcpy (filter->memory, input + count, filter->kernelsize * sizeof (float));
 
 	// apply the filter
+#ifdef USE_SSE2
+	if (simd)
+	{
+		S_ApplyFilterSSE2 (filter, input, data, stride, count);
+		TEMP_FREE (input);
+		return;
+	}
+#endif // def USE_SSE2
+
 	parity = filter->parity;
 
 	for (i = 0; i < count; i++)
@@ -296,7 +595,7 @@ assumes 44100Hz sample rate, and lowpasses at around 5kHz
 memory should be a zero-filled filter_t struct
 ==============
 */
-static void S_LowpassFilter (int *data, int stride, int count, filter_t *memory)
+static void S_LowpassFilter (int *data, int stride, int count, filter_t *memory, qboolean simd)
 {
 	int   M;
 	float bw, f_c;
@@ -329,7 +628,7 @@ static void S_LowpassFilter (int *data, int stride, int count, filter_t *memory)
 	f_c = (bw * 11025 / 2.0) / 44100.0;
 
 	S_UpdateFilter (memory, M, f_c);
-	S_ApplyFilter (memory, data, stride, count);
+	S_ApplyFilter (memory, data, stride, count, simd);
 }
 
 /*
@@ -340,15 +639,54 @@ CHANNEL MIXING
 ===============================================================================
 */
 
-static void SND_PaintChannelFrom8 (channel_t *ch, sfxcache_t *sc, int endtime, int paintbufferstart);
-static void SND_PaintChannelFrom16 (channel_t *ch, sfxcache_t *sc, int endtime, int paintbufferstart);
+static void SND_PaintChannelFrom8 (channel_t *ch, const byte *samples, int endtime, int paintbufferstart, qboolean simd);
+static void SND_PaintChannelFrom16 (channel_t *ch, const byte *samples, int endtime, int paintbufferstart, qboolean simd);
+
+/*
+==============
+SND_ClampPaintBuffer
+
+clip each sample to 0dB, then reduce by 6dB (to leave some headroom for
+the lowpass filter and the music). the lowpass will smooth out the
+clipping
+==============
+*/
+static void SND_ClampPaintBuffer (int count, qboolean simd)
+{
+	int *p = (int *)paintbuffer;
+	int  i = 0;
+
+	count *= 2;
+
+#ifdef USE_SSE2
+	if (simd)
+	{
+		const __m128i lo = _mm_set1_epi32 (-32768 * 256);
+		const __m128i hi = _mm_set1_epi32 (32767 * 256);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i v = _mm_loadu_si128 ((const __m128i *)(p + i));
+			__m128i mask = _mm_cmpgt_epi32 (v, hi);
+			v = _mm_or_si128 (_mm_and_si128 (mask, hi), _mm_andnot_si128 (mask, v));
+			mask = _mm_cmplt_epi32 (v, lo);
+			v = _mm_or_si128 (_mm_and_si128 (mask, lo), _mm_andnot_si128 (mask, v));
+			_mm_storeu_si128 ((__m128i *)(p + i), SND_DivPow2 (v, 1));
+		}
+	}
+#endif // def USE_SSE2
+
+	for (; i < count; i++)
+		p[i] = CLAMP (-32768 * 256, p[i], 32767 * 256) / 2;
+}
 
 void S_PaintChannels (int endtime)
 {
-	int         i;
-	int         end, ltime, count;
-	channel_t  *ch;
-	sfxcache_t *sc;
+	const qboolean simd = use_simd;
+	int            i;
+	int            end, ltime, count;
+	channel_t     *ch;
+	sfxcache_t    *sc;
+	const byte    *samples;
 
 	snd_vol = sfxvolume.value * 256;
 
@@ -370,7 +708,8 @@ void S_PaintChannels (int endtime)
 				continue;
 			if (!ch->leftvol && !ch->rightvol)
 				continue;
-			sc = S_LoadSound (ch->sfx);
+			// channels keep their sound cached, it's only gone after S_ClearAll
+			sc = ch->sfx->cache;
 			if (!sc)
 				continue;
 
@@ -385,12 +724,17 @@ void S_PaintChannels (int endtime)
 
 				if (count > 0)
 				{
+					if (sc->stream)
+						samples = S_StreamSound (sc, ch->pos, &count);
+					else
+						samples = sc->data + ch->pos * sc->width;
+
 					// the last param to SND_PaintChannelFrom is the index
 					// to start painting to in the paintbuffer, usually 0.
 					if (sc->width == 1)
-						SND_PaintChannelFrom8 (ch, sc, count, ltime - paintedtime);
+						SND_PaintChannelFrom8 (ch, samples, count, ltime - paintedtime, simd);
 					else
-						SND_PaintChannelFrom16 (ch, sc, count, ltime - paintedtime);
+						SND_PaintChannelFrom16 (ch, samples, count, ltime - paintedtime, simd);
 
 					ltime += count;
 				}
@@ -412,21 +756,14 @@ void S_PaintChannels (int endtime)
 			}
 		}
 
-		// clip each sample to 0dB, then reduce by 6dB (to leave some headroom for
-		// the lowpass filter and the music). the lowpass will smooth out the
-		// clipping
-		for (i = 0; i < end - paintedtime; i++)
-		{
-			paintbuffer[i].left = CLAMP (-32768 * 256, paintbuffer[i].left, 32767 * 256) / 2;
-			paintbuffer[i].right = CLAMP (-32768 * 256, paintbuffer[i].right, 32767 * 256) / 2;
-		}
+		SND_ClampPaintBuffer (end - paintedtime, simd);
 
 		// apply a lowpass filter
 		if (sndspeed.value == 11025 && shm->speed == 44100)
 		{
 			static filter_t memory_l, memory_r;
-			S_LowpassFilter ((int *)paintbuffer, 2, end - paintedtime, &memory_l);
-			S_LowpassFilter (((int *)paintbuffer) + 1, 2, end - paintedtime, &memory_r);
+			S_LowpassFilter ((int *)paintbuffer, 2, end - paintedtime, &memory_l, simd);
+			S_LowpassFilter (((int *)paintbuffer) + 1, 2, end - paintedtime, &memory_r, simd);
 		}
 
 		// paint in the music
@@ -478,7 +815,7 @@ void SND_InitScaletable (void)
 	}
 }
 
-static void SND_PaintChannelFrom8 (channel_t *ch, sfxcache_t *sc, int count, int paintbufferstart)
+static void SND_PaintChannelFrom8 (channel_t *ch, const byte *samples, int count, int paintbufferstart, qboolean simd)
 {
 	int            data;
 	int           *lscale, *rscale;
@@ -492,9 +829,28 @@ static void SND_PaintChannelFrom8 (channel_t *ch, sfxcache_t *sc, int count, int
 
 	lscale = snd_scaletable[ch->leftvol >> 3];
 	rscale = snd_scaletable[ch->rightvol >> 3];
-	sfx = (unsigned char *)sc->data + ch->pos;
+	sfx = (unsigned char *)samples;
+	i = 0;
 
-	for (i = 0; i < count; i++)
+#ifdef USE_SSE2
+	// every table entry is the signed sample times entry 1
+	if (simd)
+	{
+		const __m128i vlscale = _mm_set1_epi32 (lscale[1]);
+		const __m128i vrscale = _mm_set1_epi32 (rscale[1]);
+		for (; i + 4 <= count; i += 4)
+		{
+			int32_t packed;
+			memcpy (&packed, sfx + i, sizeof (packed));
+			__m128i v = _mm_cvtsi32_si128 (packed);
+			v = _mm_unpacklo_epi8 (v, v);
+			v = _mm_srai_epi32 (_mm_unpacklo_epi16 (v, v), 24);
+			SND_AddSamplePairs (&paintbuffer[paintbufferstart + i], SND_MulLo32 (v, vlscale), SND_MulLo32 (v, vrscale));
+		}
+	}
+#endif // def USE_SSE2
+
+	for (; i < count; i++)
 	{
 		data = sfx[i];
 		paintbuffer[paintbufferstart + i].left += lscale[data];
@@ -504,7 +860,7 @@ static void SND_PaintChannelFrom8 (channel_t *ch, sfxcache_t *sc, int count, int
 	ch->pos += count;
 }
 
-static void SND_PaintChannelFrom16 (channel_t *ch, sfxcache_t *sc, int count, int paintbufferstart)
+static void SND_PaintChannelFrom16 (channel_t *ch, const byte *samples, int count, int paintbufferstart, qboolean simd)
 {
 	int           data;
 	int           left, right;
@@ -516,9 +872,24 @@ static void SND_PaintChannelFrom16 (channel_t *ch, sfxcache_t *sc, int count, in
 	rightvol = ch->rightvol * snd_vol;
 	leftvol /= 256;
 	rightvol /= 256;
-	sfx = (signed short *)sc->data + ch->pos;
+	sfx = (signed short *)samples;
+	i = 0;
 
-	for (i = 0; i < count; i++)
+#ifdef USE_SSE2
+	if (simd)
+	{
+		const __m128i vleftvol = _mm_set1_epi32 (leftvol);
+		const __m128i vrightvol = _mm_set1_epi32 (rightvol);
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128i v = _mm_loadl_epi64 ((const __m128i *)(sfx + i));
+			v = _mm_srai_epi32 (_mm_unpacklo_epi16 (v, v), 16);
+			SND_AddSamplePairs (&paintbuffer[paintbufferstart + i], SND_MulLo32 (v, vleftvol), SND_MulLo32 (v, vrightvol));
+		}
+	}
+#endif // def USE_SSE2
+
+	for (; i < count; i++)
 	{
 		data = sfx[i];
 		// this was causing integer overflow as observed in quakespasm
@@ -533,3 +904,115 @@ static void SND_PaintChannelFrom16 (channel_t *ch, sfxcache_t *sc, int count, in
 
 	ch->pos += count;
 }
+
+/*
+==============
+SND_MixBenchmark_f
+
+snd_mixbench [channels]: mixes PAINTBUFFER_SIZE samples from channels
+(default 64) synthetic 8 and 16 bit channels, then clamps and lowpass
+filters them, with the scalar and the SIMD routines. Reports the time
+of each stage and whether both produce the same paint buffer. The mixer
+thread is held off meanwhile, the benchmark uses its globals.
+==============
+*/
+void SND_MixBenchmark_f (void)
+{
+	const int              passes = 32;
+	const int              numsamples = PAINTBUFFER_SIZE;
+	qboolean               simd;
+	int                    saved_snd_vol;
+	int                    numchannels, mode, pass, i, seed;
+	sfxcache_t            *sc8, *sc16;
+	channel_t              ch;
+	filter_t               filter_l, filter_r;
+	portable_samplepair_t *results[2] = {NULL, NULL};
+	double                 start, paint_time, clamp_time, filter_time;
+
+	numchannels = (Cmd_Argc () > 1) ? atoi (Cmd_Argv (1)) : 64;
+	numchannels = q_max (numchannels, 1);
+
+	sc8 = (sfxcache_t *)Mem_Alloc (sizeof (sfxcache_t) + numsamples);
+	sc16 = (sfxcache_t *)Mem_Alloc (sizeof (sfxcache_t) + numsamples * 2);
+	sc8->length = sc16->length = numsamples;
+	sc8->width = 1;
+	sc16->width = 2;
+	sc8->loopstart = sc16->loopstart = -1;
+	seed = 1;
+	for (i = 0; i < numsamples; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		sc8->data[i] = (seed >> 16) & 0xff;
+		((signed short *)sc16->data)[i] = (short)(seed >> 8);
+	}
+
+	SDL_LockMutex (snd_mutex);
+	saved_snd_vol = snd_vol;
+	snd_vol = sfxvolume.value * 256;
+
+	for (mode = 0; mode < 2; mode++)
+	{
+		if (mode == 1 && !use_simd)
+		{
+			Con_Printf ("SIMD mixing unavailable (r_simd 0 or no SSE2), scalar only\n");
+			break;
+		}
+		simd = (mode == 1);
+
+		memset (&filter_l, 0, sizeof (filter_l));
+		memset (&filter_r, 0, sizeof (filter_r));
+		paint_time = clamp_time = filter_time = 0.0;
+
+		for (pass = 0; pass < passes; pass++)
+		{
+			memset (paintbuffer, 0, numsamples * sizeof (portable_samplepair_t));
+
+			start = Sys_DoubleTime ();
+			for (i = 0; i < numchannels; i++)
+			{
+				memset (&ch, 0, sizeof (ch));
+				ch.leftvol = 64 + (i * 37) % 192;
+				ch.rightvol = 255 - (i * 53) % 192;
+				if (i & 1)
+					SND_PaintChannelFrom16 (&ch, sc16->data, numsamples, 0, simd);
+				else
+					SND_PaintChannelFrom8 (&ch, sc8->data, numsamples, 0, simd);
+			}
+			paint_time += Sys_DoubleTime () - start;
+
+			start = Sys_DoubleTime ();
+			SND_ClampPaintBuffer (numsamples, simd);
+			clamp_time += Sys_DoubleTime () - start;
+
+			start = Sys_DoubleTime ();
+			S_LowpassFilter ((int *)paintbuffer, 2, numsamples, &filter_l, simd);
+			S_LowpassFilter (((int *)paintbuffer) + 1, 2, numsamples, &filter_r, simd);
+			filter_time += Sys_DoubleTime () - start;
+		}
+
+		results[mode] = (portable_samplepair_t *)Mem_Alloc (numsamples * sizeof (portable_samplepair_t));
+		memcpy (results[mode], paintbuffer, numsamples * sizeof (portable_samplepair_t));
+
+		Con_Printf (
+			"%s: paint %.3f ms, clamp %.3f ms, filter %.3f ms per %i samples x %i channels\n", mode ? "simd  " : "scalar", paint_time * 1000.0 / passes,
+			clamp_time * 1000.0 / passes, filter_time * 1000.0 / passes, numsamples, numchannels);
+
+		Mem_Free (filter_l.memory);
+		Mem_Free (filter_l.kernel);
+		Mem_Free (filter_l.phases);
+		Mem_Free (filter_r.memory);
+		Mem_Free (filter_r.kernel);
+		Mem_Free (filter_r.phases);
+	}
+
+	if (results[0] && results[1])
+		Con_Printf ("results %s\n", memcmp (results[0], results[1], numsamples * sizeof (portable_samplepair_t)) ? "DIFFER" : "match");
+
+	snd_vol = saved_snd_vol;
+	memset (paintbuffer, 0, sizeof (paintbuffer));
+	SDL_UnlockMutex (snd_mutex);
+	SAFE_FREE (results[0]);
+	SAFE_FREE (results[1]);
+	Mem_Free (sc8);
+	Mem_Free (sc16);
+}
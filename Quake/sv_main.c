@@ -394,6 +394,78 @@ static struct entity_num_state_s *snapshot_entstate;
 static size_t                     snapshot_numents;
 static size_t                     snapshot_maxents;
 
+#define SV_PRIORITY_ALWAYS 1e30f // the client's own entity, removals and full resets go out before anything else
+
+typedef struct
+{
+	unsigned int num;
+	float        priority;
+	edict_t     *ent;
+} entitypriority_t;
+
+static entitypriority_t *priority_ents; // scratch list for ranking one client's entities
+static size_t            priority_maxents;
+
+/*
+=============
+SV_EntityPriority
+
+How much an update for ent is worth to the viewer at org this frame: nearby entities, fast movers and whatever is in
+front of the view score highest. The score is added to the client's running total for the entity every frame it
+waits to be sent, and the total is cleared once it goes out, so entities that keep missing a full packet gain on the
+ones that made it instead of losing out by edict number.
+=============
+*/
+static float SV_EntityPriority (edict_t *ent, const vec3_t org, const vec3_t forward)
+{
+	vec3_t delta;
+	float  dist, priority;
+	int    i;
+
+	// brush entities keep their origin at 0 0 0, so use the middle of the box
+	for (i = 0; i < 3; i++)
+		delta[i] = (ent->v.absmin[i] + ent->v.absmax[i]) * 0.5f - org[i];
+	dist = VectorLength (delta);
+
+	priority = 256.f / (256.f + dist);
+	priority += q_min (VectorLength (ent->v.velocity) / 800.f, 1.f) * 0.5f;
+	if (DotProduct (delta, forward) > dist * 0.5f)
+		priority *= 2; // roughly inside the view cone
+	return priority;
+}
+
+static float *SV_EntityPriorities (client_t *client)
+{
+	if (client->numentpriority < (size_t)qcvm->num_edicts)
+	{
+		size_t newmax = qcvm->num_edicts + 64;
+		client->entpriority = Mem_Realloc (client->entpriority, sizeof (*client->entpriority) * newmax);
+		memset (client->entpriority + client->numentpriority, 0, sizeof (*client->entpriority) * (newmax - client->numentpriority));
+		client->numentpriority = newmax;
+	}
+	return client->entpriority;
+}
+
+static entitypriority_t *SV_PriorityCandidate (size_t index)
+{
+	if (index >= priority_maxents)
+	{
+		priority_maxents = index + 256;
+		priority_ents = Mem_Realloc (priority_ents, sizeof (*priority_ents) * priority_maxents);
+	}
+	return &priority_ents[index];
+}
+
+static int SV_ComparePriority (const void *a, const void *b)
+{
+	const entitypriority_t *pa = (const entitypriority_t *)a;
+	const entitypriority_t *pb = (const entitypriority_t *)b;
+
+	if (pa->priority != pb->priority)
+		return (pa->priority > pb->priority) ? -1 : 1;
+	return (pa->num > pb->num) - (pa->num < pb->num);
+}
+
 void SVFTE_DestroyFrames (client_t *client)
 {
 	int i;
@@ -414,6 +486,11 @@ void SVFTE_DestroyFrames (client_t *client)
 		Mem_Free (client->pendingentities_bits);
 	client->pendingentities_bits = NULL;
 	client->numpendingentities = 0;
+	SAFE_FREE (client->snapshotorder);
+	client->numsnapshotorder = 0;
+	client->maxsnapshotorder = 0;
+	SAFE_FREE (client->entpriority);
+	client->numentpriority = 0;
 
 	while (client->numframes > 0)
 	{
@@ -435,6 +512,8 @@ static void SVFTE_SetupFrames (client_t *client)
 	memset (client->oldstats_i, 0, sizeof (client->oldstats_i));
 	memset (client->oldstats_f, 0, sizeof (client->oldstats_f));
 	client->lastmovemessage = 0; // it'll clear this too
+	SAFE_FREE (client->entpriority);
+	client->numentpriority = 0;
 
 	if (!client->protocol_pext2)
 	{
@@ -668,11 +747,74 @@ static void SVFTE_CalcEntityDeltas (client_t *client)
 	snapshot_numents = 0;
 	snapshot_maxents = (olds != NULL) ? (oldstop - olds) : 0;
 }
+/*
+=============
+SVFTE_OrderSnapshot
+
+Ranks the entities with pending deltas so the first packet of each snapshot carries the most important ones, and
+anything that doesn't make it this frame keeps its bits and its accumulated priority for the next. Entities with
+nothing pending start over, so one that sat idle doesn't jump the queue the first time it changes.
+=============
+*/
+static void SVFTE_OrderSnapshot (client_t *client)
+{
+	float            *priority = SV_EntityPriorities (client);
+	unsigned int      clentnum = NUM_FOR_EDICT (client->edict);
+	unsigned int      entbits;
+	size_t            entnum, n = 0;
+	entitypriority_t *c;
+
+	for (entnum = 0; entnum < client->numpendingentities; entnum++)
+	{
+		entbits = client->pendingentities_bits[entnum];
+		if (!(entbits & ~UF_RESET2))
+		{
+			if (entnum < client->numentpriority)
+				priority[entnum] = 0;
+			continue;
+		}
+		c = SV_PriorityCandidate (n++);
+		c->num = entnum;
+		if (entnum == 0 || entnum == clentnum || (entbits & UF_REMOVE))
+			c->priority = SV_PRIORITY_ALWAYS;
+		else
+			c->priority = (entnum < client->numentpriority) ? priority[entnum] : 0;
+	}
+	qsort (priority_ents, n, sizeof (*priority_ents), SV_ComparePriority);
+
+	if (n > client->maxsnapshotorder)
+	{
+		client->maxsnapshotorder = n + 64;
+		client->snapshotorder = Mem_Realloc (client->snapshotorder, sizeof (*client->snapshotorder) * client->maxsnapshotorder);
+	}
+	for (entnum = 0; entnum < n; entnum++)
+		client->snapshotorder[entnum] = priority_ents[entnum].num;
+	client->numsnapshotorder = n;
+	client->snapshotresume = 0;
+}
+
+static struct entity_num_state_s *SVFTE_FindEntityState (client_t *client, size_t entnum)
+{
+	size_t lo = 0, hi = client->numpreviousentities, mid;
+
+	while (lo < hi)
+	{
+		mid = (lo + hi) / 2;
+		if (client->previousentities[mid].num < entnum)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	if (lo < client->numpreviousentities && client->previousentities[lo].num == entnum)
+		return &client->previousentities[lo];
+	return NULL;
+}
+
 static void SVFTE_WriteEntitiesToClient (client_t *client, sizebuf_t *msg, size_t overflowsize)
 {
-	struct entity_num_state_s *state, *stateend;
+	struct entity_num_state_s *state;
 	unsigned int               entbits, logbits, netbits;
-	size_t                     entnum;
+	size_t                     entnum, order;
 	int                        sequence = NET_QSocketGetSequenceOut (client->netconnection);
 	size_t                     origmaxsize = msg->maxsize;
 	size_t                     rollbacksize; // I'm too lazy to figure out sizes (especially if someone updates this for bone states or whatever)
@@ -682,17 +824,15 @@ static void SVFTE_WriteEntitiesToClient (client_t *client, sizebuf_t *msg, size_
 
 	msg->maxsize = overflowsize;
 
-	state = client->previousentities;
-	stateend = state + client->numpreviousentities;
-
 	MSG_WriteByte (msg, svcfte_updateentities);
 
 	frame->numents = 0;
 	if (client->protocol_pext2 & PEXT2_PREDINFO)
 		MSG_WriteShort (msg, (client->lastmovemessage & 0xffff));
 	MSG_WriteFloat (msg, frame->timestamp); // should be the time the last physics frame was run.
-	for (entnum = client->snapshotresume; entnum < client->numpendingentities; entnum++)
+	for (order = client->snapshotresume; order < client->numsnapshotorder; order++)
 	{
+		entnum = client->snapshotorder[order];
 		entbits = client->pendingentities_bits[entnum];
 		if (!(entbits & ~UF_RESET2))
 			continue; // nothing to send (if reset2 is still set, then leave it pending until there's more data
@@ -713,9 +853,8 @@ static void SVFTE_WriteEntitiesToClient (client_t *client, sizebuf_t *msg, size_
 		}
 		else
 		{
-			while (state < stateend && state->num < entnum)
-				state++;
-			if (state < stateend && state->num == entnum)
+			state = SVFTE_FindEntityState (client, entnum);
+			if (state)
 			{
 				if (entbits & UF_RESET2)
 				{
@@ -763,12 +902,14 @@ static void SVFTE_WriteEntitiesToClient (client_t *client, sizebuf_t *msg, size_
 		frame->ents[frame->numents].ebits = logbits;
 		frame->ents[frame->numents].csqcbits = 0;
 		frame->numents++;
+		if (entnum < client->numentpriority)
+			client->entpriority[entnum] = 0;
 	}
 	msg->maxsize = origmaxsize;
 	MSG_WriteShort (msg, 0); // eom
 
 	// remember how far we got, so we can keep things flushed, instead of only updating the first N entities.
-	client->snapshotresume = entnum;
+	client->snapshotresume = order;
 
 	if (msg->cursize > 1024 && dev_peakstats.packetsize <= 1024)
 		Con_DWarning ("%i byte packet exceeds standard limit of 1024.\n", msg->cursize);
@@ -845,10 +986,13 @@ static void SVFTE_BuildSnapshotForClient (client_t *client)
 	struct entity_num_state_s *ents = snapshot_entstate;
 	size_t                     numents = 0;
 	size_t                     maxents = snapshot_maxents;
+	float                     *priority = SV_EntityPriorities (client);
+	vec3_t                     forward, right, up;
 
 	// find the client's PVS
 	VectorAdd (clent->v.origin, clent->v.view_ofs, org);
 	pvs = SV_FatPVS (org, qcvm->worldmodel);
+	AngleVectors (clent->v.v_angle, forward, right, up);
 
 	if (maxentities > (unsigned int)qcvm->num_edicts)
 		maxentities = (unsigned int)qcvm->num_edicts;
@@ -916,6 +1060,8 @@ static void SVFTE_BuildSnapshotForClient (client_t *client)
 		// EFLAGS_VIEWMODEL was handled above
 		ents[numents].state.eflags |= eflags;
 
+		if (ent != clent)
+			priority[e] += SV_EntityPriority (ent, org, forward);
 		numents++;
 	}
 
@@ -1833,15 +1979,18 @@ SV_WriteEntitiesToClient
 */
 void SV_WriteEntitiesToClient (client_t *client, sizebuf_t *msg)
 {
-	edict_t     *clent = client->edict;
-	unsigned int e, i, maxedict = qcvm->num_edicts;
-	int          bits;
-	byte        *pvs;
-	vec3_t       org;
-	float        miss;
-	edict_t     *ent;
-	eval_t      *val;
-	int          maxsize = msg->maxsize;
+	edict_t          *clent = client->edict;
+	unsigned int      e, i, maxedict = qcvm->num_edicts;
+	int               bits;
+	byte             *pvs;
+	vec3_t            org, forward, right, up;
+	float             miss;
+	edict_t          *ent;
+	eval_t           *val;
+	int               maxsize = msg->maxsize;
+	float            *priority = SV_EntityPriorities (client);
+	entitypriority_t *c;
+	size_t            numcandidates = 0, candidate;
 
 	// try to avoid sounds getting lost. flickering entities are weird, but missing sounds+particles are just eerie.
 	maxsize -= client->datagram.cursize;
@@ -1853,8 +2002,9 @@ void SV_WriteEntitiesToClient (client_t *client, sizebuf_t *msg)
 	// find the client's PVS
 	VectorAdd (clent->v.origin, clent->v.view_ofs, org);
 	pvs = SV_FatPVS (org, qcvm->worldmodel);
+	AngleVectors (clent->v.v_angle, forward, right, up);
 
-	// send over all entities (excpet the client) that touch the pvs
+	// collect all entities (excpet the client) that touch the pvs
 	ent = NEXT_EDICT (qcvm->edicts);
 	for (e = 1; e < maxedict; e++, ent = NEXT_EDICT (ent))
 	{
@@ -1884,10 +2034,40 @@ void SV_WriteEntitiesToClient (client_t *client, sizebuf_t *msg)
 				continue; // not visible
 		}
 
-		// johnfitz -- max size for protocol 15 is 18 bytes, not 16 as originally
-		// assumed here.  And, for protocol 85 the max size is actually 24 bytes.
-		// For float coords and angles the limit is 39.
-		// FIXME: Use tighter limit according to protocol flags and send bits.
+		// johnfitz -- alpha
+		//  TODO: find a cleaner place to put this code
+		val = GetEdictFieldValue (ent, qcvm->extfields.alpha);
+		if (val)
+			ent->alpha = ENTALPHA_ENCODE (val->_float);
+
+		// don't send invisible entities unless they have effects
+		if (ent->alpha == ENTALPHA_ZERO && !((int)ent->v.effects & sv.effectsmask))
+			continue;
+		// johnfitz
+
+		c = SV_PriorityCandidate (numcandidates++);
+		c->num = e;
+		c->ent = ent;
+		if (ent == clent)
+			c->priority = SV_PRIORITY_ALWAYS;
+		else
+			c->priority = priority[e] += SV_EntityPriority (ent, org, forward);
+	}
+
+	// every update is sent relative to the baseline, so when they can't all fit, the most important ones go first and
+	// the rest keep their accumulated priority for the next frame.
+	// johnfitz -- max size for protocol 15 is 18 bytes, not 16 as originally
+	// assumed here.  And, for protocol 85 the max size is actually 24 bytes.
+	// For float coords and angles the limit is 39.
+	// FIXME: Use tighter limit according to protocol flags and send bits.
+	if (msg->cursize + (int)numcandidates * 39 > maxsize)
+		qsort (priority_ents, numcandidates, sizeof (*priority_ents), SV_ComparePriority);
+
+	for (candidate = 0; candidate < numcandidates; candidate++)
+	{
+		e = priority_ents[candidate].num;
+		ent = priority_ents[candidate].ent;
+
 		if (msg->cursize + 39 > maxsize)
 		{
 			// johnfitz -- less spammy overflow message
@@ -1896,9 +2076,10 @@ void SV_WriteEntitiesToClient (client_t *client, sizebuf_t *msg)
 				Con_Printf ("Packet overflow!\n");
 				dev_overflows.packetsize = realtime;
 			}
-			goto stats;
+			break;
 			// johnfitz
 		}
+		priority[e] = 0;
 
 		// send an update
 		bits = 0;
@@ -1937,17 +2118,6 @@ void SV_WriteEntitiesToClient (client_t *client, sizebuf_t *msg)
 		if (ent->baseline.modelindex != ent->v.modelindex)
 			bits |= U_MODEL;
 
-		// johnfitz -- alpha
-		//  TODO: find a cleaner place to put this code
-		val = GetEdictFieldValue (ent, qcvm->extfields.alpha);
-		if (val)
-			ent->alpha = ENTALPHA_ENCODE (val->_float);
-
-		// don't send invisible entities unless they have effects
-		if (ent->alpha == ENTALPHA_ZERO && !((int)ent->v.effects & sv.effectsmask))
-			continue;
-		// johnfitz
-
 		// johnfitz -- PROTOCOL_FITZQUAKE
 		if (sv.protocol != PROTOCOL_NETQUAKE)
 		{
@@ -2029,7 +2199,6 @@ void SV_WriteEntitiesToClient (client_t *client, sizebuf_t *msg)
 	}
 
 	// johnfitz -- devstats
-stats:
 	if (msg->cursize > 1024 && dev_peakstats.packetsize <= 1024)
 		Con_DWarning ("%i byte packet exceeds standard limit of 1024 (max = %d).\n", msg->cursize, msg->maxsize);
 	dev_stats.packetsize = msg->cursize;
@@ -2277,7 +2446,7 @@ void SV_PresendClientDatagram (client_t *client)
 		return; // brute force networking.
 	SVFTE_BuildSnapshotForClient (client);
 	SVFTE_CalcEntityDeltas (client);
-	client->snapshotresume = 0;
+	SVFTE_OrderSnapshot (client);
 }
 
 
@@ -2342,7 +2511,7 @@ qboolean SV_SendClientDatagram (client_t *client)
 			// this delta protocol doesn't wipe old state just because there's a new packet.
 			// the server isn't required to sync with the client frames either
 			// so we can just spam multiple packets to keep our udp data under the MTU
-			while (client->snapshotresume < client->numpendingentities)
+			while (client->snapshotresume < client->numsnapshotorder)
 			{
 				NET_SendUnreliableMessage (client->netconnection, &msg);
 				SZ_Clear (&msg);
@@ -2625,7 +2794,8 @@ void SV_SendClientMessages (void)
 		SV_PresendClientDatagram (host_client); // generates client snapshots (and updates csqc pending flags)
 	}
 
-	// build individual updates
+	// build individual updates, the datagrams all go out together at the end
+	NET_BatchWrites (true);
 	for (i = 0, host_client = svs.clients; i < svs.maxclients; i++, host_client++)
 	{
 		if (!host_client->active)
@@ -2741,6 +2911,7 @@ void SV_SendClientMessages (void)
 			}
 		}
 	}
+	NET_BatchWrites (false);
 
 	// clear muzzle flashes
 	SV_CleanupEnts ();